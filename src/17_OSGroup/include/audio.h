@@ -0,0 +1,48 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include "libc/system.h"
+
+// Sampled audio is passed around as unsigned 8-bit mono PCM. Output drivers
+// pull it from an audio source one block at a time, at their sample rate.
+
+#define AUDIO_SILENCE 0x80
+
+typedef struct audio_source {
+    // Fill up to count samples, returns how many were written. 0 means the
+    // source has run out.
+    uint32_t (*read)(struct audio_source* source, uint8_t* samples, uint32_t count);
+    void* ctx;
+} audio_source_t;
+
+// A device that plays audio sources. Drivers register one when they find
+// their hardware; playback goes to the output selected last.
+typedef struct audio_output {
+    const char* name;
+    uint32_t sample_rate;       // Rate sources must render at
+    bool (*start)(audio_source_t* source);
+    void (*stop)();
+    bool (*active)();
+} audio_output_t;
+
+#define AUDIO_MAX_OUTPUTS 4
+
+// Add an output and make it the current one. Returns -1 if there is no room.
+int audio_register_output(audio_output_t* output);
+
+// The current output, NULL if there is none
+audio_output_t* audio_current_output();
+
+// Make the named output the current one, returns false if there is none
+bool audio_select_output(const char* name);
+
+// Registered output number index, NULL past the end
+audio_output_t* audio_get_output(uint32_t index);
+
+// Stop every output and play source on the current one
+bool audio_play(audio_source_t* source);
+
+// Stop every output
+void audio_stop();
+
+#endif // AUDIO_H
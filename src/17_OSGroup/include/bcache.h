@@ -0,0 +1,106 @@
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include "blockdev.h"
+#include "block.h"
+
+// Buffer cache: 4 KiB blocks of the block devices kept in memory, looked
+// up by (device, block) in a hash table. Filesystems read and write
+// through it instead of going to the disk for every metadata access.
+//
+// Eviction is 2Q: a block seen for the first time goes on a short FIFO
+// (A1in) and is forgotten when it falls off the end, leaving only its
+// number on a ghost list (A1out). A block asked for again while it is
+// still remembered there goes on the main LRU list (Am). One pass over a
+// big file therefore cannot push the FAT and the directories out.
+//
+// Reads that move through a device one block after another start
+// read-ahead: the next blocks are queued on the block layer without
+// waiting for them, and the window doubles while the pattern holds. They
+// arrive when the queue next runs, in idle() or when somebody waits for
+// one of them.
+//
+// Writes only mark blocks dirty. An idle handler writes back blocks that
+// have been dirty for BCACHE_WRITEBACK_MS, bcache_sync() writes everything
+// at once.
+
+#define BCACHE_BLOCK_SIZE    4096
+#define BCACHE_BLOCK_SECTORS (BCACHE_BLOCK_SIZE / BLOCKDEV_SECTOR_SIZE)
+#define BCACHE_BUFFERS       128        // 512 KiB of cached data
+#define BCACHE_HASH_SIZE     256        // Buckets, a power of two
+#define BCACHE_A1IN_BUFFERS  (BCACHE_BUFFERS / 4)
+#define BCACHE_GHOSTS        (BCACHE_BUFFERS / 2)
+
+#define BCACHE_READAHEAD_MIN 4          // Blocks in the first read-ahead window
+#define BCACHE_READAHEAD_MAX 32
+#define BCACHE_SEQUENTIAL    2          // Consecutive blocks before read-ahead starts
+
+#define BCACHE_FLUSH_MS      1000       // How often the idle handler looks for dirty blocks
+#define BCACHE_WRITEBACK_MS  3000       // How long a block may stay dirty
+
+// Buffer flags
+#define BCACHE_VALID     0x01           // Data matches the disk or is newer
+#define BCACHE_DIRTY     0x02           // Data is newer than the disk
+#define BCACHE_BUSY      0x04           // A read or write is in flight
+#define BCACHE_READAHEAD 0x08           // Read ahead and not asked for yet
+
+struct bcache_buffer {
+    blockdev_t* dev;
+    uint32_t block;
+    uint32_t sectors;                   // Less than a block at the end of the disk
+    uint8_t* data;
+    uint8_t flags;
+    uint8_t list;                       // Which 2Q list the buffer is on
+    uint16_t refs;                      // Holders, a referenced buffer is never evicted
+    uint32_t dirty_tick;                // When it was first dirtied
+    struct bcache_buffer* hash_next;
+    struct bcache_buffer* prev;         // On its 2Q list, head is most recent
+    struct bcache_buffer* next;
+    struct block_request request;
+};
+
+struct bcache_stats {
+    uint32_t lookups;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t promotions;                // Misses that hit a ghost and went to Am
+    uint32_t evictions;
+    uint32_t readahead;                 // Blocks read ahead
+    uint32_t readahead_hits;            // Read ahead blocks later asked for
+    uint32_t readahead_wasted;          // Read ahead blocks evicted unused
+    uint32_t writebacks;                // Dirty blocks written
+    uint32_t errors;
+    uint32_t dirty;                     // Dirty blocks now
+};
+
+// Start the write-back idle handler
+void init_bcache();
+
+// The block, read from the disk if it is not cached, with a reference
+// held. NULL on a read error, or if every buffer is in use.
+struct bcache_buffer* bcache_get(blockdev_t* dev, uint32_t block);
+
+// Same, but the block is about to be overwritten completely, so it is not
+// read: an uncached block comes back zeroed
+struct bcache_buffer* bcache_get_new(blockdev_t* dev, uint32_t block);
+
+void bcache_release(struct bcache_buffer* buffer);
+
+// The buffer's data was changed and has to go back to the disk
+void bcache_mark_dirty(struct bcache_buffer* buffer);
+
+// Copy sectors in or out through the cache
+bool bcache_read(blockdev_t* dev, uint32_t lba, uint32_t count, void* buffer);
+bool bcache_write(blockdev_t* dev, uint32_t lba, uint32_t count, const void* buffer);
+
+// Write every dirty block of the device back and flush the disk's cache.
+// dev NULL does it for every device.
+bool bcache_sync(blockdev_t* dev);
+
+// Sync the device, then drop all its blocks from the cache
+bool bcache_invalidate(blockdev_t* dev);
+
+void bcache_get_stats(struct bcache_stats* stats);
+void bcache_reset_stats();
+
+#endif // BCACHE_H
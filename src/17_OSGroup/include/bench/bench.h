@@ -0,0 +1,45 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "libc/system.h"
+
+// Boot-time benchmarks, built when CONFIG_BENCHMARKS is defined
+// (UIAOS_BENCHMARKS in CMake). Timing uses the TSC for cycles and the PIT
+// for wall-clock milliseconds, so interrupts must be enabled.
+
+typedef struct {
+    uint64_t start_tsc;     // TSC when the measurement started
+    uint32_t start_ticks;   // PIT ticks when the measurement started
+    uint64_t cycles;        // Elapsed TSC cycles, set by bench_stop()
+    uint32_t ms;            // Elapsed milliseconds, set by bench_stop()
+} bench_timer_t;
+
+void bench_start(bench_timer_t* timer);
+void bench_stop(bench_timer_t* timer);
+
+// Print "<name>: <ops> <unit> in <ms> ms, <cycles> cycles each"
+void bench_report(const char* name, const bench_timer_t* timer, uint32_t ops, const char* unit);
+
+// Operations per second for a finished measurement
+uint32_t bench_rate(const bench_timer_t* timer, uint32_t ops);
+
+// Run every benchmark, called from kernel_main
+void run_benchmarks();
+
+// Individual benchmark groups
+void bench_console();
+void bench_framebuffer();
+void bench_format();
+void bench_keymap();
+void bench_pcm();
+void bench_synth();
+void bench_sb16();
+void bench_song();
+void bench_disk();
+
+// Sequential and random read speed of one block device, mode is a label
+// for the driver setting being measured
+struct blockdev;
+void bench_blockdev(struct blockdev* dev, const char* mode);
+
+#endif // BENCH_H
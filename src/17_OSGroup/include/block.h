@@ -0,0 +1,94 @@
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include "blockdev.h"
+
+// Block layer: asynchronous requests between filesystems and the block
+// device drivers. Every device gets a request queue run by a deadline
+// scheduler:
+//  - requests are kept sorted by sector and served in one direction, from
+//    where the last command ended, wrapping around at the end (C-SCAN)
+//  - a request that continues or precedes a queued one in the same
+//    direction is merged with it and the lot goes to the driver as a
+//    single scatter-gather command
+//  - a request still queued past its deadline goes first
+// Plugging a queue holds dispatch back, so a burst of requests can be
+// sorted and merged before any of it reaches the disk. Requests for the
+// same sectors are not ordered against each other, whoever needs a write
+// on disk before reading it back waits for the write first.
+//
+// The drivers are synchronous, so queues are run when they are unplugged,
+// when somebody waits for a request, and from idle(). Completion callbacks
+// run from there, never from an interrupt handler, and may submit more
+// requests.
+
+#define BLOCK_READ_DEADLINE_MS  50
+#define BLOCK_WRITE_DEADLINE_MS 500
+#define BLOCK_PLUG_MS           3       // idle() unplugs a queue held this long
+
+struct block_request;
+typedef void (*block_callback_t)(struct block_request* request);
+
+struct block_request {
+    blockdev_t* dev;
+    bool write;
+    uint32_t lba;
+    uint32_t count;             // Sectors
+    void* buffer;
+    block_callback_t done;      // Called on completion, may be NULL
+    void* ctx;
+
+    // Set by the block layer
+    volatile bool completed;
+    bool ok;
+    uint64_t submitted;         // TSC at submission
+    uint32_t deadline;          // PIT tick
+    uint32_t sectors;           // Of the merged command, on its first request
+    uint32_t segments;          // Same
+    struct block_request* next;     // Sector order
+    struct block_request* fifo;     // Submission order
+    struct block_request* merged;   // Next request of the same command
+};
+
+struct block_queue_stats {
+    uint32_t submitted;
+    uint32_t merged;            // Requests that joined another one's command
+    uint32_t dispatched;        // Commands issued to the driver
+    uint32_t completed;
+    uint32_t errors;
+    uint32_t expired;           // Taken out of order because of their deadline
+    uint32_t depth;             // Requests submitted but not completed
+    uint32_t max_depth;
+    uint32_t average_latency_us;    // Submission to completion
+    uint32_t max_latency_us;
+};
+
+// Start running queues from idle()
+void init_block();
+
+void block_request_init(struct block_request* request, blockdev_t* dev, bool write, uint32_t lba,
+                        uint32_t count, void* buffer, block_callback_t done, void* ctx);
+
+// Queue a request. Fails, without calling the callback, if it is outside
+// the disk or writes to a read-only one.
+bool block_submit(struct block_request* request);
+
+// Hold the queue back until the matching block_unplug(). Plugs nest.
+void block_plug(blockdev_t* dev);
+void block_unplug(blockdev_t* dev);
+
+// Run the queue until the request has completed, plugged or not. Returns
+// whether it succeeded.
+bool block_wait(struct block_request* request);
+
+// Submit and wait
+bool block_read(blockdev_t* dev, uint32_t lba, uint32_t count, void* buffer);
+bool block_write(blockdev_t* dev, uint32_t lba, uint32_t count, const void* buffer);
+
+// Dispatch everything queued on the device, plugged or not
+void block_run_queue(blockdev_t* dev);
+
+void block_get_stats(blockdev_t* dev, struct block_queue_stats* stats);
+void block_reset_stats(blockdev_t* dev);
+
+#endif // BLOCK_H
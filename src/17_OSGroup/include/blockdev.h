@@ -0,0 +1,78 @@
+#ifndef BLOCKDEV_H
+#define BLOCKDEV_H
+
+#include "libc/system.h"
+
+// Block devices: disks addressed in 512-byte sectors. Drivers register one
+// per disk they find and everything above them (benchmarks, the block
+// layer, filesystems) goes through this interface, whichever driver is
+// underneath. Transfers are synchronous and must not be started from an
+// interrupt handler. Buffers are used for DMA directly, so they must be
+// 2-byte aligned kernel memory (identity mapped).
+
+#define BLOCKDEV_SECTOR_SIZE 512
+#define BLOCKDEV_MAX_DEVICES 8
+#define BLOCKDEV_NAME_SIZE   8
+#define BLOCKDEV_MAX_SEGMENTS 16
+
+// One piece of a scattered transfer
+typedef struct {
+    void* buffer;
+    uint32_t sectors;
+} blockdev_segment_t;
+
+struct block_queue;
+
+typedef struct blockdev {
+    char name[BLOCKDEV_NAME_SIZE];  // e.g. "hdb"
+    uint32_t sectors;               // Capacity
+    uint32_t max_sectors;           // Most sectors the driver takes per call
+    bool read_only;
+
+    // Transfer count sectors starting at lba, count is at most max_sectors
+    // and the range is within the disk. Return false on an error.
+    bool (*read)(struct blockdev* dev, uint32_t lba, uint32_t count, void* buffer);
+    bool (*write)(struct blockdev* dev, uint32_t lba, uint32_t count, const void* buffer);
+    // Make written data durable, NULL if the device has no write cache
+    bool (*flush)(struct blockdev* dev);
+    // Optional scatter-gather transfer: sectors from lba on go to or come
+    // from the segments in turn, at most max_segments of them and
+    // max_sectors in total. The block layer issues merged requests with it.
+    bool (*transfer)(struct blockdev* dev, bool write, uint32_t lba,
+                     const blockdev_segment_t* segments, uint32_t count);
+    uint32_t max_segments;
+    void* ctx;
+
+    struct block_queue* queue;      // Request queue, see block.h
+
+    // Statistics, kept by blockdev_read(), blockdev_write() and blockdev_transfer()
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t sectors_read;
+    uint32_t sectors_written;
+    uint32_t errors;
+} blockdev_t;
+
+// Add a device. Returns -1 if there is no room.
+int blockdev_register(blockdev_t* dev);
+
+uint32_t blockdev_count();
+
+// Device number index, NULL past the end
+blockdev_t* blockdev_get(uint32_t index);
+
+// Device by name, NULL if there is none
+blockdev_t* blockdev_find(const char* name);
+
+// Transfer any number of sectors, split into calls the driver can take.
+// Fails without touching the disk if the range is outside it.
+bool blockdev_read(blockdev_t* dev, uint32_t lba, uint32_t count, void* buffer);
+bool blockdev_write(blockdev_t* dev, uint32_t lba, uint32_t count, const void* buffer);
+bool blockdev_flush(blockdev_t* dev);
+
+// One scatter-gather command through the driver's transfer hook, which
+// must exist. The segments must fit the driver's limits.
+bool blockdev_transfer(blockdev_t* dev, bool write, uint32_t lba,
+                       const blockdev_segment_t* segments, uint32_t count);
+
+#endif // BLOCKDEV_H
@@ -0,0 +1,25 @@
+#ifndef BOOTINFO_H
+#define BOOTINFO_H
+
+#include "libc/system.h"
+#include "multiboot2.h"
+
+// The multiboot2 information structure is copied into the kernel at boot,
+// because the bootloader may have placed it outside the memory that is
+// identity mapped once paging is enabled.
+#define BOOTINFO_MAX_SIZE 8192
+
+// Boot modules are copied too, into this much space. The module tags are
+// then changed to point at the copies; a module that does not fit is left
+// with mod_start == mod_end == 0.
+#define BOOTINFO_MODULE_SPACE 65536
+
+// Copy the boot information, must be called before paging is enabled.
+// Returns false if the magic does not match or the structure is too big.
+bool bootinfo_init(uint32_t magic, const void* info);
+
+// Find the first tag of the given type after `after`, or the first one in
+// the structure when `after` is NULL. Returns NULL when there is none.
+struct multiboot_tag* bootinfo_find_tag(uint32_t type, struct multiboot_tag* after);
+
+#endif // BOOTINFO_H
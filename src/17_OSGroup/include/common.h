@@ -7,6 +7,41 @@
 void outb(uint16_t port, uint8_t value);
 uint8_t inb(uint16_t port);
 uint16_t inw(uint16_t port);
+void outw(uint16_t port, uint16_t value);
+void outl(uint16_t port, uint32_t value);
+uint32_t inl(uint16_t port);
+
+// Move count 16-bit words between a port and memory (rep insw/outsw)
+void insw(uint16_t port, void* buffer, uint32_t count);
+void outsw(uint16_t port, const void* buffer, uint32_t count);
+
+// Disable interrupts and return the previous EFLAGS, so the caller can
+// restore the old interrupt state with interrupts_restore() afterwards.
+uint32_t interrupts_save();
+void interrupts_restore(uint32_t flags);
+
+// Read the CPU time stamp counter
+static inline uint64_t read_tsc()
+{
+    uint32_t low, high;
+    asm volatile ("rdtsc" : "=a" (low), "=d" (high));
+    return ((uint64_t)high << 32) | low;
+}
+
+// Divide a 64-bit value by a 32-bit one. Plain 64-bit division would need
+// __udivdi3 from libgcc, which the kernel is not linked against.
+static inline uint64_t div64_32(uint64_t n, uint32_t d, uint32_t* rem)
+{
+    uint32_t high = n >> 32;
+    uint32_t q_high = high / d;
+    uint32_t q_low, r;
+    high %= d;
+    // high < d, so the quotient of the lower division fits in 32 bits
+    asm ("divl %4" : "=a" (q_low), "=d" (r) : "a" ((uint32_t)n), "d" (high), "rm" (d));
+    if (rem)
+        *rem = r;
+    return ((uint64_t)q_high << 32) | q_low;
+}
 
 #endif
 
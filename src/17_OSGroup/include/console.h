@@ -0,0 +1,25 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include "libc/system.h"
+
+// Line-buffered console on top of the monitor. Text is collected in a
+// buffer and handed to the monitor in runs when a line ends, when the
+// buffer fills up, or on an explicit flush, so the hardware cursor is
+// moved once per flush instead of once per character.
+
+#define CONSOLE_BUFFER_SIZE 256
+
+// Queue a single character
+void console_putc(char c);
+
+// Queue a run of characters
+void console_write(const char* data, size_t size);
+
+// Write everything queued so far to the screen
+void console_flush();
+
+// Also send everything written to the console out on the serial port
+void console_set_serial_mirror(bool enabled);
+
+#endif // CONSOLE_H
@@ -0,0 +1,60 @@
+#ifndef AC97_H
+#define AC97_H
+
+#include "libc/system.h"
+#include "audio.h"
+
+// Intel AC'97 playback (ICH, as emulated by QEMU's -device AC97). The
+// controller is found on PCI and plays 16-bit stereo by bus-master DMA
+// from a ring of buffers described by a buffer descriptor list (BDL).
+// The hardware raises an interrupt as each buffer completes and stops by
+// itself at the last valid entry, so the CPU only renders buffers that
+// have been played, and a late refill is a clean pause instead of stale
+// audio.
+// https://wiki.osdev.org/AC97
+
+#define AC97_VENDOR_ID  0x8086
+#define AC97_DEVICE_ID  0x2415
+
+// Rate asked for when the codec supports variable rates, otherwise the
+// fixed AC97_FIXED_RATE is used
+#define AC97_RATE       22050
+#define AC97_FIXED_RATE 48000
+
+// Ring of buffers the BDL entries cycle through, frames per buffer.
+// 8 x 1024 frames at 22050 Hz is about 370 ms of audio in flight.
+#define AC97_BUFFERS        8
+#define AC97_BUFFER_FRAMES  1024
+
+struct ac97_stats {
+    uint32_t interrupts;        // Interrupts taken
+    uint32_t buffers;           // Buffers rendered
+    uint32_t underruns;         // Times the DMA caught up with the last valid entry
+};
+
+// Register the PCI driver, which resets the controller and registers the
+// "ac97" audio output when one is found. Returns false if there is no
+// AC'97 controller, so init_pci() must have run.
+bool init_ac97();
+
+bool ac97_present();
+
+// Rate the codec actually plays at
+uint32_t ac97_sample_rate();
+
+// Start playing source at ac97_sample_rate(). Fails if there is no
+// controller or it is already playing.
+bool ac97_start(audio_source_t* source);
+
+void ac97_stop();
+
+bool ac97_active();
+
+// Render every buffer the DMA has finished with. Runs from idle() on its
+// own, busy code can call it to keep the audio going.
+void ac97_pump();
+
+void ac97_get_stats(struct ac97_stats* stats);
+void ac97_reset_stats();
+
+#endif // AC97_H
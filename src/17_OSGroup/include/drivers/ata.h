@@ -0,0 +1,58 @@
+#ifndef ATA_H
+#define ATA_H
+
+#include "libc/system.h"
+#include "blockdev.h"
+
+// ATA hard disks on an IDE controller, as emulated by QEMU's PIIX3. Each
+// drive found by IDENTIFY becomes a block device named hda-hdd (primary
+// master, primary slave, secondary master, secondary slave), so the FAT32
+// disk.iso given to QEMU as -hdb shows up as "hdb".
+//
+// When the controller is found on PCI, transfers use bus-master DMA: the
+// driver builds a PRD table over the caller's buffer, starts the engine
+// and halts until IRQ14/15 reports completion. Without a bus-master
+// controller, or if DMA fails, sectors are moved by PIO instead.
+// https://wiki.osdev.org/ATA_PIO_Mode
+// https://wiki.osdev.org/ATA/ATAPI_using_DMA
+
+// Legacy (compatibility mode) channel resources
+#define ATA_PRIMARY_IO     0x1F0
+#define ATA_PRIMARY_CTRL   0x3F6
+#define ATA_PRIMARY_IRQ    14
+#define ATA_SECONDARY_IO   0x170
+#define ATA_SECONDARY_CTRL 0x376
+#define ATA_SECONDARY_IRQ  15
+
+#define ATA_CHANNELS 2
+#define ATA_DRIVES   4
+
+// Most sectors per command: 256 is the LBA28 limit
+#define ATA_MAX_SECTORS 256
+
+// How long a DMA transfer may take before it is given up
+#define ATA_TIMEOUT_MS 5000
+
+struct ata_stats {
+    uint32_t dma_transfers;     // Commands done by bus-master DMA
+    uint32_t pio_transfers;     // Commands done by PIO
+    uint32_t interrupts;        // Completion interrupts taken
+    uint32_t errors;            // Commands the drive failed
+    uint32_t timeouts;          // DMA transfers that never completed
+};
+
+// Find the controller and the drives on it and register a block device for
+// each drive. Needs init_pci() first, and interrupts enabled for DMA.
+// Returns the number of drives found.
+uint32_t init_ata();
+
+// Whether any drive can do DMA
+bool ata_dma_available();
+
+// Turn DMA off (e.g. to compare against PIO) or back on where supported
+void ata_set_dma(bool enabled);
+
+void ata_get_stats(struct ata_stats* stats);
+void ata_reset_stats();
+
+#endif // ATA_H
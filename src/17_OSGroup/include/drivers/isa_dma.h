@@ -0,0 +1,31 @@
+#ifndef ISA_DMA_H
+#define ISA_DMA_H
+
+#include "libc/system.h"
+
+// The two 8237 DMA controllers of the ISA bus. Channels 0-3 move bytes,
+// channels 5-7 move 16-bit words, channel 4 cascades the two controllers.
+// A transfer must sit below 16 MiB and must not cross a 64 KiB boundary
+// (128 KiB for the 16-bit channels), since only the low 16 address bits
+// count up.
+// https://wiki.osdev.org/ISA_DMA
+
+#define ISA_DMA_LIMIT 0x1000000
+
+// Mode bits, the channel number is filled in by isa_dma_setup()
+#define ISA_DMA_MODE_WRITE     0x04   // Device to memory
+#define ISA_DMA_MODE_READ      0x08   // Memory to device
+#define ISA_DMA_MODE_AUTO_INIT 0x10   // Start over when the count runs out
+#define ISA_DMA_MODE_SINGLE    0x40   // One transfer per device request
+
+// Program channel to move length bytes at physical address phys and
+// unmask it. Returns false if the channel or buffer cannot be used.
+bool isa_dma_setup(uint8_t channel, uint32_t phys, uint32_t length, uint8_t mode);
+
+void isa_dma_mask(uint8_t channel);
+void isa_dma_unmask(uint8_t channel);
+
+// Bytes the channel has left to move in the current cycle
+uint32_t isa_dma_residue(uint8_t channel);
+
+#endif // ISA_DMA_H
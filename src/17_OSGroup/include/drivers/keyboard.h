@@ -0,0 +1,39 @@
+#ifndef KEYBOARD_H
+#define KEYBOARD_H
+
+#include "libc/system.h"
+#include "keymap.h"
+
+// PS/2 keyboard driver. The IRQ1 handler (top half) only moves scancodes
+// from the controller into a ring buffer. Decoding them into key events
+// (bottom half) happens in the context of whoever reads the keyboard, with
+// interrupts enabled, through the keymap tables.
+// https://wiki.osdev.org/PS/2_Keyboard
+
+#define KEYBOARD_DATA_PORT   0x60
+#define KEYBOARD_STATUS_PORT 0x64
+#define KEYBOARD_IRQ         1
+
+// Ring buffer sizes, must be powers of two
+#define KEYBOARD_SCANCODE_BUFFER 128
+#define KEYBOARD_EVENT_BUFFER    64
+
+void init_keyboard();
+
+// Decode every scancode received so far into key events
+void keyboard_process();
+
+// Take the next key event, returns false if there is none
+bool keyboard_read_event(key_event_t* event);
+
+// Wait for a key press that produces a character and return it
+char keyboard_getc();
+
+// Read a line with echo and backspace editing. The line is terminated,
+// without the newline, and its length is returned.
+size_t read_line(char* buffer, size_t size);
+
+// Scancodes and events lost because nobody read the keyboard in time
+uint32_t keyboard_dropped();
+
+#endif // KEYBOARD_H
@@ -0,0 +1,45 @@
+#ifndef MOUSE_H
+#define MOUSE_H
+
+#include "libc/system.h"
+
+// PS/2 mouse on the auxiliary port of the keyboard controller. Packets are
+// assembled in the IRQ12 handler and published as motion events; motion
+// that piles up before the reader gets to it is merged into one event.
+// https://wiki.osdev.org/PS/2_Mouse
+
+#define MOUSE_IRQ 12
+
+// Event queue size, must be a power of two
+#define MOUSE_EVENT_BUFFER 32
+
+// A packet whose bytes are further apart than this is started over
+#define MOUSE_PACKET_TIMEOUT_MS 20
+
+#define MOUSE_BUTTON_LEFT   0x01
+#define MOUSE_BUTTON_RIGHT  0x02
+#define MOUSE_BUTTON_MIDDLE 0x04
+
+typedef struct {
+    int32_t dx;         // Positive is to the right
+    int32_t dy;         // Positive is up
+    int32_t wheel;      // Positive is towards the user
+    uint8_t buttons;    // MOUSE_BUTTON_* held during the motion
+} mouse_event_t;
+
+// Enable the auxiliary port and the mouse. Returns false if there is none.
+bool init_mouse();
+
+// Take the next event, returns false if there is none
+bool mouse_read_event(mouse_event_t* event);
+
+// Whether the mouse sends 4-byte packets with a scroll wheel
+bool mouse_has_wheel();
+
+// Packets thrown away because they were out of sync
+uint32_t mouse_resyncs();
+
+// Events lost because the queue was full
+uint32_t mouse_dropped();
+
+#endif // MOUSE_H
@@ -0,0 +1,150 @@
+#ifndef PCI_H
+#define PCI_H
+
+#include "libc/system.h"
+
+// PCI configuration space access through mechanism #1 (ports 0xCF8/0xCFC),
+// bus enumeration and a driver registry. init_pci() walks the buses once
+// from the host bridge through every PCI-to-PCI bridge and records each
+// function with its decoded BARs in a device table. Drivers register the
+// IDs or class codes they handle and are probed for every matching device,
+// whichever of the two comes first.
+// https://wiki.osdev.org/PCI
+
+#define PCI_CONFIG_ADDRESS 0xCF8
+#define PCI_CONFIG_DATA    0xCFC
+
+// Configuration header offsets
+#define PCI_VENDOR_ID      0x00
+#define PCI_DEVICE_ID      0x02
+#define PCI_COMMAND        0x04
+#define PCI_STATUS         0x06
+#define PCI_REVISION       0x08
+#define PCI_PROG_IF        0x09
+#define PCI_SUBCLASS       0x0A
+#define PCI_CLASS          0x0B
+#define PCI_HEADER_TYPE    0x0E
+#define PCI_BAR0           0x10
+#define PCI_SECONDARY_BUS  0x19     // PCI-to-PCI bridges only
+#define PCI_INTERRUPT_LINE 0x3C
+#define PCI_INTERRUPT_PIN  0x3D
+
+#define PCI_COMMAND_IO         0x0001
+#define PCI_COMMAND_MEMORY     0x0002
+#define PCI_COMMAND_BUS_MASTER 0x0004
+
+// Bit 0 of a BAR tells I/O space from memory space
+#define PCI_BAR_IO         0x01
+#define PCI_BAR_IO_MASK    0xFFFFFFFC
+#define PCI_BAR_MEM_MASK   0xFFFFFFF0
+
+// Memory BAR types, bits 1-2
+#define PCI_BAR_MEM_TYPE     0x06
+#define PCI_BAR_MEM_64       0x04
+#define PCI_BAR_PREFETCHABLE 0x08
+
+#define PCI_VENDOR_NONE    0xFFFF
+
+#define PCI_HEADER_GENERAL 0x00
+#define PCI_HEADER_BRIDGE  0x01
+#define PCI_HEADER_MULTIFUNCTION 0x80
+
+// Class codes the kernel cares about
+#define PCI_CLASS_STORAGE    0x01
+#define PCI_CLASS_NETWORK    0x02
+#define PCI_CLASS_DISPLAY    0x03
+#define PCI_CLASS_MULTIMEDIA 0x04
+#define PCI_CLASS_BRIDGE     0x06
+
+#define PCI_SUBCLASS_HOST_BRIDGE 0x00
+#define PCI_SUBCLASS_IDE        0x01
+#define PCI_SUBCLASS_PCI_BRIDGE 0x04
+
+#define PCI_INTERRUPT_NONE 0xFF
+
+#define PCI_MAX_DEVICES 32
+#define PCI_MAX_DRIVERS 8
+#define PCI_MAX_BARS    6
+
+// Wildcards for struct pci_device_id
+#define PCI_ANY_ID    0xFFFF
+#define PCI_ANY_CLASS 0xFF
+
+typedef struct {
+    uint8_t bus;
+    uint8_t slot;
+    uint8_t function;
+} pci_address_t;
+
+typedef struct {
+    uint32_t base;              // Port or physical address, 0 if unused
+    uint32_t size;              // Bytes decoded, 0 if not sized
+    bool io;                    // I/O space rather than memory
+    bool prefetchable;
+} pci_bar_t;
+
+struct pci_driver;
+
+struct pci_device {
+    pci_address_t address;
+    uint16_t vendor;
+    uint16_t device;
+    uint8_t class_code;
+    uint8_t subclass;
+    uint8_t prog_if;
+    uint8_t revision;
+    uint8_t header_type;        // Without the multifunction bit
+    uint8_t interrupt_line;     // PIC line, PCI_INTERRUPT_NONE if none
+    uint8_t interrupt_pin;      // 1-4 for INTA-INTD, 0 if none
+    pci_bar_t bars[PCI_MAX_BARS];
+    const struct pci_driver* driver;    // Driver that claimed it, if any
+};
+
+// What a driver handles: vendor and device, class and subclass, or both.
+// A list of them ends with an entry whose vendor is 0.
+struct pci_device_id {
+    uint16_t vendor;            // PCI_ANY_ID matches any
+    uint16_t device;            // PCI_ANY_ID matches any
+    uint8_t class_code;         // PCI_ANY_CLASS matches any
+    uint8_t subclass;           // PCI_ANY_CLASS matches any
+};
+
+struct pci_driver {
+    const char* name;
+    const struct pci_device_id* ids;
+    // Set the device up, returns false if the driver does not take it
+    bool (*probe)(struct pci_device* device);
+};
+
+uint32_t pci_config_read32(pci_address_t address, uint8_t offset);
+uint16_t pci_config_read16(pci_address_t address, uint8_t offset);
+uint8_t pci_config_read8(pci_address_t address, uint8_t offset);
+void pci_config_write32(pci_address_t address, uint8_t offset, uint32_t value);
+void pci_config_write16(pci_address_t address, uint8_t offset, uint16_t value);
+
+// Enumerate every bus and report how long it took. Devices are then
+// offered to the drivers registered so far.
+void init_pci();
+
+// Add a driver and probe it against the devices found so far. Returns false
+// if the registry is full.
+bool pci_register_driver(const struct pci_driver* driver);
+
+uint32_t pci_device_count();
+
+// Device number index of the table, NULL past the end
+struct pci_device* pci_get_device(uint32_t index);
+
+// First device with the given IDs, NULL if there is none
+struct pci_device* pci_find(uint16_t vendor, uint16_t device);
+
+// Look for a function with the given IDs, returns false if there is none
+bool pci_find_device(uint16_t vendor, uint16_t device, pci_address_t* address);
+
+// Short name of a class code, e.g. "storage"
+const char* pci_class_name(uint8_t class_code);
+
+// Set bits in the command register, e.g. to turn on bus mastering
+void pci_enable(pci_address_t address, uint16_t command);
+
+#endif // PCI_H
@@ -0,0 +1,48 @@
+#ifndef PCSPEAKER_H
+#define PCSPEAKER_H
+
+#include "libc/system.h"
+#include "audio.h"
+#include "pit.h"
+
+// Sampled audio through the PC speaker. PIT channel 0 is sped up to the
+// sample rate and every interrupt restarts channel 2 as a one-shot whose
+// length is proportional to the sample, so the speaker sees one pulse per
+// sample (pulse-width modulation). Channel 0 interrupts are counted down to
+// keep the regular 1 ms tick going.
+// https://wiki.osdev.org/PC_Speaker
+
+// PIT input clocks per sample: 1193180 / 64 = 18643 Hz. It is also the
+// PWM period, which leaves about 6 bits of resolution per sample.
+#define PCSPK_PCM_DIVISOR     64
+#define PCSPK_PCM_RATE        (PIT_BASE_FREQUENCY / PCSPK_PCM_DIVISOR)
+
+// Samples per block. Two blocks are used: one plays while the other is
+// filled from idle().
+#define PCSPK_PCM_BLOCK_SIZE  1024
+
+struct pcspk_pcm_stats {
+    uint32_t played;            // Samples sent to the speaker
+    uint32_t dropped;           // Samples replaced by silence because no block was ready
+    uint32_t max_isr_cycles;    // Longest time spent in the sample interrupt
+};
+
+// Register the PC speaker as the "pcspk" audio output
+void init_pcspk_pcm();
+
+// Start playing source. Fails if PCM playback is already running.
+bool pcspk_pcm_start(audio_source_t* source);
+
+// Stop playback and put the timer back to 1 kHz
+void pcspk_pcm_stop();
+
+bool pcspk_pcm_active();
+
+// Refill empty blocks from the source. Runs from idle() on its own, busy
+// code can call it to keep the audio going.
+void pcspk_pcm_pump();
+
+void pcspk_pcm_get_stats(struct pcspk_pcm_stats* stats);
+void pcspk_pcm_reset_stats();
+
+#endif // PCSPEAKER_H
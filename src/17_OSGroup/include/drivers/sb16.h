@@ -0,0 +1,52 @@
+#ifndef SB16_H
+#define SB16_H
+
+#include "libc/system.h"
+#include "audio.h"
+
+// Sound Blaster 16 playback. The DSP plays 8-bit mono samples straight from
+// a buffer in low memory through ISA DMA in auto-init mode, so the buffer
+// loops forever without CPU help. The DSP raises an interrupt after every
+// half of the buffer. The half that just finished is then rendered again
+// by the audio source, in place, while the other half plays.
+// https://wiki.osdev.org/Sound_Blaster_16
+
+#define SB16_BASE_PORT  0x220
+#define SB16_RATE       22050
+
+// Samples per half of the DMA buffer, one interrupt per half:
+// 22050 / 2048 gives about 11 interrupts a second
+#define SB16_HALF_SIZE  2048
+#define SB16_BUFFER_SIZE (SB16_HALF_SIZE * 2)
+
+struct sb16_stats {
+    uint32_t interrupts;        // Half-buffer interrupts taken
+    uint32_t underruns;         // Halves that were not rendered in time
+    uint32_t max_isr_cycles;    // Longest time spent in the interrupt
+};
+
+// Reset the DSP, set up its IRQ and DMA channel and register the "sb16"
+// audio output. Returns false if there is no Sound Blaster 16.
+bool init_sb16();
+
+bool sb16_present();
+
+// DSP version, major in the high byte
+uint16_t sb16_version();
+
+// Start playing source at SB16_RATE. Fails if there is no card or it is
+// already playing.
+bool sb16_start(audio_source_t* source);
+
+void sb16_stop();
+
+bool sb16_active();
+
+// Render the half that is free. Runs from idle() on its own, busy code can
+// call it to keep the audio going.
+void sb16_pump();
+
+void sb16_get_stats(struct sb16_stats* stats);
+void sb16_reset_stats();
+
+#endif // SB16_H
@@ -0,0 +1,40 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include "libc/system.h"
+
+// Interrupt-driven 16550 UART driver for COM1.
+// https://wiki.osdev.org/Serial_Ports
+
+#define SERIAL_COM1_PORT 0x3F8
+#define SERIAL_COM1_IRQ  4
+#define SERIAL_BAUD_RATE 115200
+
+// Transmit and receive ring buffer sizes, must be powers of two
+#define SERIAL_TX_BUFFER_SIZE 8192
+#define SERIAL_RX_BUFFER_SIZE 256
+
+// Probe and set up COM1. Returns false if no working UART was found.
+bool init_serial();
+
+// Whether init_serial() found a UART
+bool serial_present();
+
+// Queue bytes for transmission, '\n' is sent as "\r\n". Never waits: bytes
+// that do not fit in the transmit buffer are dropped and counted.
+void serial_write(const char* data, size_t size);
+
+// Read up to size received bytes, returns how many were read
+size_t serial_read(char* data, size_t size);
+
+// Next received byte, or -1 if there is none
+int serial_getc();
+
+// Push out everything queued by polling the UART. Only for when interrupts
+// are off for good, e.g. in panic().
+void serial_drain();
+
+// Bytes dropped because the transmit buffer was full
+uint32_t serial_dropped();
+
+#endif // SERIAL_H
@@ -0,0 +1,113 @@
+#ifndef VIRTIO_H
+#define VIRTIO_H
+
+#include "libc/system.h"
+
+// Legacy virtio over PCI: the I/O port register block in BAR0 that QEMU's
+// transitional devices offer, and split virtqueues. A virtqueue is a ring
+// of descriptors pointing at buffers, an available ring the driver puts
+// descriptor chains on and a used ring the device returns them on. The
+// queue memory must be physically contiguous and page aligned; the kernel
+// is identity mapped, so a static buffer will do.
+// https://docs.oasis-open.org/virtio/virtio/v1.1/virtio-v1.1.html
+
+#define VIRTIO_VENDOR_ID 0x1AF4
+
+// Legacy register block
+#define VIRTIO_REG_DEVICE_FEATURES 0x00
+#define VIRTIO_REG_GUEST_FEATURES  0x04
+#define VIRTIO_REG_QUEUE_ADDRESS   0x08     // Page frame number of the queue
+#define VIRTIO_REG_QUEUE_SIZE      0x0C
+#define VIRTIO_REG_QUEUE_SELECT    0x0E
+#define VIRTIO_REG_QUEUE_NOTIFY    0x10
+#define VIRTIO_REG_DEVICE_STATUS   0x12
+#define VIRTIO_REG_ISR_STATUS      0x13     // Reading it acknowledges the interrupt
+#define VIRTIO_REG_CONFIG          0x14     // Device specific, without MSI-X
+
+#define VIRTIO_STATUS_ACKNOWLEDGE 0x01
+#define VIRTIO_STATUS_DRIVER      0x02
+#define VIRTIO_STATUS_DRIVER_OK   0x04
+#define VIRTIO_STATUS_FAILED      0x80
+
+#define VIRTIO_ISR_QUEUE          0x01
+
+#define VIRTIO_F_RING_INDIRECT_DESC (1UL << 28)
+
+#define VIRTQ_DESC_F_NEXT     0x01
+#define VIRTQ_DESC_F_WRITE    0x02  // The device writes the buffer
+#define VIRTQ_DESC_F_INDIRECT 0x04  // The buffer is a table of descriptors
+
+#define VIRTQ_AVAIL_F_NO_INTERRUPT 0x01
+
+#define VIRTQ_ALIGN    4096         // Legacy used ring alignment
+#define VIRTQ_MAX_SIZE 1024         // Largest queue the memory is sized for
+
+// Memory a queue of the given size takes
+#define VIRTQ_ALIGN_UP(x) (((x) + VIRTQ_ALIGN - 1) & ~(VIRTQ_ALIGN - 1))
+#define VIRTQ_MEMORY_SIZE(n) ((uint32_t)(VIRTQ_ALIGN_UP(16 * (n) + 6 + 2 * (n)) + VIRTQ_ALIGN_UP(6 + 8 * (n))))
+
+struct virtq_desc {
+    uint64_t address;
+    uint32_t length;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed));
+
+struct virtq_avail {
+    uint16_t flags;
+    uint16_t index;
+    uint16_t ring[];
+} __attribute__((packed));
+
+struct virtq_used_elem {
+    uint32_t id;                // Head of the chain that was used
+    uint32_t length;            // Bytes the device wrote
+} __attribute__((packed));
+
+struct virtq_used {
+    uint16_t flags;
+    uint16_t index;
+    struct virtq_used_elem ring[];
+} __attribute__((packed));
+
+struct virtq {
+    uint16_t io;                // Register block of the device
+    uint16_t queue;             // Queue number
+    uint16_t size;              // Entries, set by the device
+    uint16_t last_used;         // Used ring position processed so far
+    uint16_t added;             // Chains made available since the last kick
+    struct virtq_desc* desc;
+    struct virtq_avail* avail;
+    volatile struct virtq_used* used;
+    uint32_t kicks;             // Notifications sent
+};
+
+// Reset the device, acknowledge it and agree on features: the ones the
+// device offers out of wanted. Returns the features in use.
+uint32_t virtio_negotiate(uint16_t io, uint32_t wanted);
+
+// Set up queue number queue in memory (page aligned, at least
+// VIRTQ_MEMORY_SIZE(queue size) bytes). Fails if the queue does not exist
+// or is too big.
+bool virtq_init(struct virtq* vq, uint16_t io, uint16_t queue, void* memory, uint32_t memory_size);
+
+// Tell the device the driver is ready
+void virtio_driver_ok(uint16_t io);
+
+// Put the chain starting at descriptor head on the available ring. The
+// device is not told until virtq_kick(), so several chains can go at once.
+void virtq_submit(struct virtq* vq, uint16_t head);
+
+// Notify the device of everything submitted since the last kick
+void virtq_kick(struct virtq* vq);
+
+// Take the next chain the device is done with, false if there is none
+bool virtq_next_used(struct virtq* vq, uint32_t* head, uint32_t* length);
+
+// Ask the device not to interrupt when it uses buffers, for polling
+void virtq_suppress_interrupts(struct virtq* vq, bool suppress);
+
+// Read and thereby acknowledge the interrupt status
+uint8_t virtio_ack_interrupt(uint16_t io);
+
+#endif // VIRTIO_H
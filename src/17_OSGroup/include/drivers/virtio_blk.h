@@ -0,0 +1,45 @@
+#ifndef VIRTIO_BLK_H
+#define VIRTIO_BLK_H
+
+#include "libc/system.h"
+#include "blockdev.h"
+
+// virtio-blk disks (QEMU's -drive if=virtio), through the legacy PCI
+// interface. Each disk becomes a block device vda, vdb, ...
+//
+// A transfer is cut into requests of up to VIRTIO_BLK_REQUEST_SECTORS.
+// Each request goes on the ring as a single indirect descriptor (header,
+// up to BLOCKDEV_MAX_SEGMENTS data buffers, status), when the device
+// supports that. All requests of a transfer
+// are submitted before the device is notified once. Completion is
+// interrupt driven by default. In polling mode the device is asked not to
+// interrupt at all and the used ring is watched instead.
+
+#define VIRTIO_BLK_DEVICE_ID 0x1001     // Transitional (legacy) block device
+
+#define VIRTIO_BLK_MAX_DEVICES     2
+#define VIRTIO_BLK_SLOTS           32   // Requests in flight per disk
+#define VIRTIO_BLK_REQUEST_SECTORS 256  // Largest request, 128 KiB
+#define VIRTIO_BLK_MAX_SECTORS     1024 // Largest transfer taken in one batch
+
+struct virtio_blk_stats {
+    uint32_t requests;          // Requests completed
+    uint32_t kicks;             // Device notifications
+    uint32_t interrupts;        // Interrupts taken
+    uint32_t errors;            // Requests the device failed
+    uint32_t timeouts;          // Waits given up on, each followed by a device reset
+};
+
+// Register the PCI driver and set up every virtio-blk disk. Needs
+// init_pci() first. Returns the number of disks.
+uint32_t init_virtio_blk();
+
+// Switch between interrupt driven completion and polling with the
+// device's interrupts suppressed
+void virtio_blk_set_polling(bool polling);
+
+// Totals over every disk
+void virtio_blk_get_stats(struct virtio_blk_stats* stats);
+void virtio_blk_reset_stats();
+
+#endif // VIRTIO_BLK_H
@@ -0,0 +1,29 @@
+#ifndef FBCON_H
+#define FBCON_H
+
+#include "libc/system.h"
+#include "multiboot2.h"
+
+// Framebuffer console: draws the monitor's text grid on a linear
+// framebuffer, using the built-in 8x16 VGA font.
+
+#define FONT_WIDTH 8
+#define FONT_HEIGHT 16
+
+// Number of colour pairs whose pre-rendered glyph rows are kept around
+#define FBCON_CACHE_SLOTS 4
+
+extern const uint8_t font8x16[256][FONT_HEIGHT];
+
+// Map the framebuffer described by the multiboot2 tag and move the monitor
+// onto it. Only 32 bits per pixel direct colour is supported. Returns false
+// and leaves the console in text mode otherwise. Paging must be enabled.
+bool fbcon_init(struct multiboot_tag_framebuffer* tag);
+
+// Whether a framebuffer was set up by fbcon_init()
+bool fbcon_active();
+
+// Make the framebuffer the monitor's backend again (clears the screen)
+void fbcon_attach();
+
+#endif // FBCON_H
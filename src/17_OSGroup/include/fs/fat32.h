@@ -0,0 +1,173 @@
+#ifndef FAT32_H
+#define FAT32_H
+
+#include "libc/system.h"
+#include "blockdev.h"
+
+// FAT32 filesystem on a block device, either a whole disk formatted by
+// mkfs.fat (the create-fat32-disk target's disk.iso has no partition
+// table) or the first FAT32 partition of a partitioned one. All disk
+// access goes through the buffer cache.
+//
+// - The FAT is kept in memory when it is at most FAT32_FAT_CACHE_MAX.
+//   Changes go to every copy through the buffer cache as they are made.
+// - An open file keeps its cluster chain as a sorted array of runs of
+//   consecutive clusters. Finding the cluster for a file position is a
+//   binary search over the runs instead of a walk along the chain.
+// - The first lookup in a directory reads all of it into a hash table of
+//   names. Later lookups there go straight to the entry.
+//
+// Long file names are read and written. Names are ASCII and matched
+// without regard to case. Timestamps are a fixed date, there is no clock.
+
+#define FAT32_NAME_MAX      255
+#define FAT32_FAT_CACHE_MAX (512 * 1024)
+#define FAT32_DENTRIES      128         // Names remembered by the directory hash
+#define FAT32_DIRS          16          // Directories whose names are remembered
+#define FAT32_NAME_HASH     64          // Buckets, a power of two
+
+// Directory entry attributes
+#define FAT32_ATTR_READ_ONLY 0x01
+#define FAT32_ATTR_HIDDEN    0x02
+#define FAT32_ATTR_SYSTEM    0x04
+#define FAT32_ATTR_VOLUME_ID 0x08
+#define FAT32_ATTR_DIRECTORY 0x10
+#define FAT32_ATTR_ARCHIVE   0x20
+#define FAT32_ATTR_LONG_NAME 0x0F
+
+// A directory entry as found on disk
+struct fat32_entry {
+    char name[FAT32_NAME_MAX + 1];      // Long name, or the short one
+    char short_name[11];                // Space padded 8.3, as stored
+    uint8_t attr;
+    uint32_t cluster;                   // First cluster, 0 for an empty file
+    uint32_t size;
+    uint32_t dir;                       // First cluster of its directory
+    uint32_t offset;                    // Of the short entry in the directory
+    uint8_t slots;                      // Long name entries in front of it
+};
+
+// A name remembered in the directory hash
+struct fat32_dentry {
+    uint32_t dir;                       // 0 if the slot is free
+    uint32_t hash;
+    uint32_t cluster;
+    uint32_t size;
+    uint32_t offset;
+    uint8_t slots;
+    uint8_t attr;
+    char short_name[11];
+    char name[FAT32_NAME_MAX + 1];
+    struct fat32_dentry* next;          // In its bucket, or on the free list
+};
+
+struct fat32_dir_state {
+    uint32_t cluster;                   // 0 if the slot is free
+    uint32_t used;                      // For evicting the least recently used
+    bool complete;                      // Every name of the directory is hashed
+};
+
+struct fat32_stats {
+    uint32_t lookups;                   // Path components looked up
+    uint32_t hashed;                    // Answered by the directory hash
+    uint32_t scans;                     // Directories read from disk
+    uint32_t seeks;                     // Cluster lookups in a file
+    uint32_t searches;                  // Of those, binary searches over the runs
+};
+
+typedef struct fat32_fs {
+    blockdev_t* dev;
+    uint32_t start;                     // First sector of the volume
+    uint32_t sectors;
+    uint32_t sectors_per_cluster;
+    uint32_t cluster_size;              // In bytes
+    uint32_t fat_start;                 // Sector of the first FAT
+    uint32_t fat_sectors;               // Per copy
+    uint32_t fat_count;
+    uint32_t active_fat;                // The only one in use if mirroring is off
+    bool mirrored;
+    uint32_t data_start;                // Sector of cluster 2
+    uint32_t clusters;                  // Data clusters, numbered from 2
+    uint32_t root;                      // First cluster of the root directory
+    uint32_t fsinfo;                    // FSInfo sector, 0 if there is none
+    uint32_t free_clusters;
+    uint32_t next_free;                 // Where the search for a free cluster starts
+    char label[12];
+
+    uint32_t* fat;                      // In-memory FAT, NULL if it is too big
+
+    struct fat32_dentry dentries[FAT32_DENTRIES];
+    struct fat32_dentry* hash[FAT32_NAME_HASH];
+    struct fat32_dentry* free_dentries;
+    struct fat32_dir_state dirs[FAT32_DIRS];
+    uint32_t dir_clock;
+    struct fat32_stats stats;
+} fat32_fs_t;
+
+// A file clusters index to index + count - 1 are clusters cluster to
+// cluster + count - 1 on disk
+struct fat32_extent {
+    uint32_t index;
+    uint32_t cluster;
+    uint32_t count;
+};
+
+typedef struct fat32_file {
+    fat32_fs_t* fs;
+    uint32_t dir;                       // Directory holding the entry, 0 for the root itself
+    uint32_t offset;                    // Of the short entry in it
+    uint32_t cluster;                   // First cluster, 0 if the file is empty
+    uint32_t size;
+    uint32_t position;
+    uint8_t attr;
+    bool dirty;                         // Size or first cluster changed since opening
+    struct fat32_extent* extents;       // The cluster chain in runs, by index
+    uint32_t extent_count;
+    uint32_t extent_capacity;
+    uint32_t chain;                     // Clusters in the chain
+    uint32_t hint;                      // Run used last
+} fat32_file_t;
+
+typedef struct {
+    fat32_file_t file;
+    uint32_t offset;                    // Next entry
+} fat32_dir_t;
+
+// Find the filesystem on the device. Returns false if there is none.
+bool fat32_mount(fat32_fs_t* fs, blockdev_t* dev);
+
+// Sync, then let go of the memory. Every file must be closed.
+bool fat32_unmount(fat32_fs_t* fs);
+
+// Write the free cluster count back and sync the cache
+bool fat32_sync(fat32_fs_t* fs);
+
+// Open an existing file or directory. Paths are absolute or relative to
+// the root, separated by '/'.
+bool fat32_open(fat32_fs_t* fs, const char* path, fat32_file_t* file);
+
+// Open a file for writing, created empty if it does not exist and
+// truncated if it does
+bool fat32_create(fat32_fs_t* fs, const char* path, fat32_file_t* file);
+
+// Write the size back to the directory entry and free the run array
+bool fat32_close(fat32_file_t* file);
+
+// Bytes transferred, fewer at the end of the file, -1 on an error
+int32_t fat32_read(fat32_file_t* file, void* buffer, uint32_t size);
+int32_t fat32_write(fat32_file_t* file, const void* buffer, uint32_t size);
+
+// Move to position, which may not be past the end of the file
+bool fat32_seek(fat32_file_t* file, uint32_t position);
+
+// Delete a file or an empty directory
+bool fat32_remove(fat32_fs_t* fs, const char* path);
+
+bool fat32_mkdir(fat32_fs_t* fs, const char* path);
+
+// List a directory, leaving out "." and ".."
+bool fat32_opendir(fat32_fs_t* fs, const char* path, fat32_dir_t* dir);
+bool fat32_readdir(fat32_dir_t* dir, struct fat32_entry* entry);
+void fat32_closedir(fat32_dir_t* dir);
+
+#endif // FAT32_H
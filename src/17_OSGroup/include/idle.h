@@ -0,0 +1,27 @@
+#ifndef IDLE_H
+#define IDLE_H
+
+#include "libc/system.h"
+
+// Background work for a kernel without threads. Whenever code waits for an
+// interrupt it calls idle(), which runs every registered idle handler and
+// then halts until the next interrupt. Handlers run with interrupts enabled,
+// so this is where work too slow for an interrupt handler goes (refilling
+// audio buffers, flushing caches).
+
+#define IDLE_MAX_HANDLERS 8
+
+typedef void (*idle_handler_t)(void* ctx);
+
+// Returns 0 on success, -1 if every slot is taken
+int register_idle_handler(idle_handler_t handler, void* ctx);
+void unregister_idle_handler(idle_handler_t handler, void* ctx);
+
+// Run the idle handlers without halting, for busy loops that still want
+// background work to make progress
+void idle_poll();
+
+// Run the idle handlers, then wait for the next interrupt
+void idle();
+
+#endif // IDLE_H
@@ -1,3 +0,0 @@
-#pragma once
-
-char scancode_to_ascii(unsigned char* scan_code);
\ No newline at end of file
@@ -124,6 +124,24 @@ typedef struct registers
 // Typedef for ISR handler function pointer
 typedef void (*isr_t)(registers_t*, void*);
 
+// Return values for IRQ handlers. A shared line walks every handler in its
+// chain, so each handler reports whether its device raised the interrupt.
+#define IRQ_NONE    0   // The interrupt was not for this handler
+#define IRQ_HANDLED 1   // The handler serviced the interrupt
+
+// Typedef for IRQ handler function pointer
+typedef int (*irq_handler_t)(registers_t*, void*);
+
+// Maximum number of IRQ handlers that can be registered across all lines
+#define IRQ_MAX_ACTIONS 32
+
+// One entry in the handler chain of an IRQ line
+struct irq_action_t {
+    irq_handler_t handler;       // Handler function pointer (NULL if the slot is free)
+    void *data;                  // Context data
+    struct irq_action_t *next;   // Next handler sharing the same line
+};
+
 // Structure to store interrupt handler information
 struct int_handler_t {
     int num;            // Interrupt number
@@ -131,14 +149,54 @@ struct int_handler_t {
     void *data;         // Context data
 };
 
-// Register an IRQ handler
-void register_irq_handler(int irq, isr_t handler, void* ctx);
+// Register an IRQ handler. The irq can be given either as a line (0-15) or as
+// its remapped vector (IRQ0-IRQ15). Handlers are chained, so several drivers
+// can share one line, and the line is unmasked when its first handler arrives.
+// Returns 0 on success and -1 if the irq is invalid or no slots are left.
+int register_irq_handler(int irq, irq_handler_t handler, void* ctx);
+
+// Remove a previously registered IRQ handler. The line is masked again once
+// nobody listens to it.
+void unregister_irq_handler(int irq, irq_handler_t handler, void* ctx);
+
+// A fast handler runs before the chain of a line, right after the EOI and
+// with interrupts off. It is meant for devices that interrupt at very high
+// rates (e.g. PCM output on the timer): returning IRQ_HANDLED ends the
+// interrupt there, IRQ_NONE lets the chain run as usual. One per line,
+// NULL removes it.
+typedef int (*irq_fast_handler_t)(registers_t*);
+void irq_set_fast_handler(int irq, irq_fast_handler_t handler);
+
+// Mask/unmask a single IRQ line in the PIC
+void irq_enable_line(int irq);
+void irq_disable_line(int irq);
+
+// Nested interrupts. Handlers of a nestable line run with interrupts
+// enabled after the EOI, with their own and all lower-priority lines masked,
+// so higher-priority lines (e.g. the timer) can preempt them. IRQ handlers
+// run on a dedicated interrupt stack, and nesting stops at IRQ_MAX_NESTING
+// levels or when less than IRQ_STACK_MIN_FREE bytes of that stack are left.
+// The stack itself is in isr_asm.asm, the build gives both the same size.
+#define IRQ_STACK_SIZE      CONFIG_IRQ_STACK_SIZE
+#define IRQ_STACK_MIN_FREE  1024
+#define IRQ_MAX_NESTING     4
+
+// Opt a line in or out of nesting (off for every line by default)
+void irq_set_nestable(int irq, bool nestable);
+
+// Deepest IRQ nesting seen so far
+uint32_t irq_nesting_max();
+
+// Number of spurious IRQ7/IRQ15 interrupts seen so far
+uint32_t irq_spurious_count();
+
+// Number of interrupts on a line that no registered handler claimed
+uint32_t irq_unhandled_count(int irq);
 
 // Register a general interrupt handler
 void register_interrupt_handler(uint8_t n, isr_t handler, void* context);
 
-// Arrays to store interrupt and IRQ handlers
+// Array to store interrupt handlers
 static struct int_handler_t int_handlers[IDT_ENTRIES];
-static struct int_handler_t irq_handlers[IRQ_COUNT];
 
 #endif // INTERRUPTS_H
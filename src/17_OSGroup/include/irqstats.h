@@ -0,0 +1,64 @@
+#ifndef IRQSTATS_H
+#define IRQSTATS_H
+
+#include "libc/stdint.h"
+#include "common.h"
+#include "descriptor_tables.h"
+
+// Per-vector interrupt counters and handler latency histograms.
+// Built only when CONFIG_IRQ_STATS is defined (UIAOS_IRQ_STATS in CMake),
+// otherwise every hook below expands to nothing.
+
+// Histogram buckets are powers of two of TSC cycles. Bucket 0 holds
+// everything below 2^IRQ_STATS_MIN_SHIFT cycles, the last one everything above.
+#define IRQ_STATS_BUCKETS 16
+#define IRQ_STATS_MIN_SHIFT 7
+
+#ifdef CONFIG_IRQ_STATS
+
+struct irq_stats_t {
+    uint32_t count;                           // Times the vector fired
+    uint32_t max_cycles;                      // Slowest handler run
+    uint64_t total_cycles;                    // Sum of all handler runs
+    uint32_t histogram[IRQ_STATS_BUCKETS];    // log2 latency histogram
+};
+
+extern struct irq_stats_t irq_stats[IDT_ENTRIES];
+
+// Account one handler run of the given vector
+static inline void irq_stats_record(uint8_t vector, uint32_t cycles)
+{
+    struct irq_stats_t* s = &irq_stats[vector];
+    int bucket = 31 - __builtin_clz(cycles | 1) - IRQ_STATS_MIN_SHIFT;
+    if (bucket < 0)
+        bucket = 0;
+    if (bucket >= IRQ_STATS_BUCKETS)
+        bucket = IRQ_STATS_BUCKETS - 1;
+
+    s->count++;
+    s->total_cycles += cycles;
+    s->histogram[bucket]++;
+    if (cycles > s->max_cycles)
+        s->max_cycles = cycles;
+}
+
+// Start/stop timing a handler in the dispatch path
+#define IRQ_STATS_BEGIN(start) uint32_t start = (uint32_t)read_tsc()
+#define IRQ_STATS_END(vector, start) irq_stats_record((vector), (uint32_t)read_tsc() - (start))
+
+// Print every vector that fired, with its latency histogram
+void irq_stats_dump();
+
+// Clear all counters
+void irq_stats_reset();
+
+#else
+
+#define IRQ_STATS_BEGIN(start)
+#define IRQ_STATS_END(vector, start)
+#define irq_stats_dump()
+#define irq_stats_reset()
+
+#endif // CONFIG_IRQ_STATS
+
+#endif // IRQSTATS_H
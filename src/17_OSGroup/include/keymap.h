@@ -0,0 +1,172 @@
+#ifndef KEYMAP_H
+#define KEYMAP_H
+
+#include "libc/stdint.h"
+
+// Table-driven keymap. Scancodes are first turned into layout-independent
+// key codes, which a keyboard layout then turns into characters. The
+// scancode and layout tables are generated at compile time (keymap.cpp),
+// so decoding a key is a handful of table lookups without branches.
+
+// Key codes, numbered like the Linux input key codes. Up to KEY_F12 they
+// match the scancode set 1 make codes.
+#define KEY_NONE        0x00
+#define KEY_ESC         0x01
+#define KEY_1           0x02
+#define KEY_2           0x03
+#define KEY_3           0x04
+#define KEY_4           0x05
+#define KEY_5           0x06
+#define KEY_6           0x07
+#define KEY_7           0x08
+#define KEY_8           0x09
+#define KEY_9           0x0A
+#define KEY_0           0x0B
+#define KEY_MINUS       0x0C
+#define KEY_EQUAL       0x0D
+#define KEY_BACKSPACE   0x0E
+#define KEY_TAB         0x0F
+#define KEY_Q           0x10
+#define KEY_W           0x11
+#define KEY_E           0x12
+#define KEY_R           0x13
+#define KEY_T           0x14
+#define KEY_Y           0x15
+#define KEY_U           0x16
+#define KEY_I           0x17
+#define KEY_O           0x18
+#define KEY_P           0x19
+#define KEY_LEFTBRACE   0x1A
+#define KEY_RIGHTBRACE  0x1B
+#define KEY_ENTER       0x1C
+#define KEY_LEFTCTRL    0x1D
+#define KEY_A           0x1E
+#define KEY_S           0x1F
+#define KEY_D           0x20
+#define KEY_F           0x21
+#define KEY_G           0x22
+#define KEY_H           0x23
+#define KEY_J           0x24
+#define KEY_K           0x25
+#define KEY_L           0x26
+#define KEY_SEMICOLON   0x27
+#define KEY_APOSTROPHE  0x28
+#define KEY_GRAVE       0x29
+#define KEY_LEFTSHIFT   0x2A
+#define KEY_BACKSLASH   0x2B
+#define KEY_Z           0x2C
+#define KEY_X           0x2D
+#define KEY_C           0x2E
+#define KEY_V           0x2F
+#define KEY_B           0x30
+#define KEY_N           0x31
+#define KEY_M           0x32
+#define KEY_COMMA       0x33
+#define KEY_DOT         0x34
+#define KEY_SLASH       0x35
+#define KEY_RIGHTSHIFT  0x36
+#define KEY_KPASTERISK  0x37
+#define KEY_LEFTALT     0x38
+#define KEY_SPACE       0x39
+#define KEY_CAPSLOCK    0x3A
+#define KEY_F1          0x3B
+#define KEY_F2          0x3C
+#define KEY_F3          0x3D
+#define KEY_F4          0x3E
+#define KEY_F5          0x3F
+#define KEY_F6          0x40
+#define KEY_F7          0x41
+#define KEY_F8          0x42
+#define KEY_F9          0x43
+#define KEY_F10         0x44
+#define KEY_NUMLOCK     0x45
+#define KEY_SCROLLLOCK  0x46
+#define KEY_KP7         0x47
+#define KEY_KP8         0x48
+#define KEY_KP9         0x49
+#define KEY_KPMINUS     0x4A
+#define KEY_KP4         0x4B
+#define KEY_KP5         0x4C
+#define KEY_KP6         0x4D
+#define KEY_KPPLUS      0x4E
+#define KEY_KP1         0x4F
+#define KEY_KP2         0x50
+#define KEY_KP3         0x51
+#define KEY_KP0         0x52
+#define KEY_KPDOT       0x53
+#define KEY_102ND       0x56    // The extra key next to left shift on ISO keyboards
+#define KEY_F11         0x57
+#define KEY_F12         0x58
+#define KEY_KPENTER     0x60
+#define KEY_RIGHTCTRL   0x61
+#define KEY_KPSLASH     0x62
+#define KEY_SYSRQ       0x63
+#define KEY_RIGHTALT    0x64
+#define KEY_HOME        0x66
+#define KEY_UP          0x67
+#define KEY_PAGEUP      0x68
+#define KEY_LEFT        0x69
+#define KEY_RIGHT       0x6A
+#define KEY_END         0x6B
+#define KEY_DOWN        0x6C
+#define KEY_PAGEDOWN    0x6D
+#define KEY_INSERT      0x6E
+#define KEY_DELETE      0x6F
+#define KEY_LEFTMETA    0x7D
+#define KEY_RIGHTMETA   0x7E
+#define KEY_COMPOSE     0x7F
+
+#define KEYCODE_COUNT   128
+
+// Modifier state at the time of a key event
+#define KEY_MOD_SHIFT 0x01
+#define KEY_MOD_CTRL  0x02
+#define KEY_MOD_ALT   0x04
+#define KEY_MOD_CAPS  0x08
+#define KEY_MOD_ALTGR 0x10
+#define KEY_MOD_NUM   0x20
+
+// Lock bits, keymap_state.locks
+#define KEY_LOCK_CAPS   0x01
+#define KEY_LOCK_NUM    0x02
+#define KEY_LOCK_SCROLL 0x04
+
+// Key event flags
+#define KEY_EVENT_RELEASED 0x01
+#define KEY_EVENT_REPEAT   0x02   // Typematic repeat of a key that is held down
+
+typedef struct {
+    uint8_t keycode;    // KEY_*, keypad keys without Num Lock come as the navigation keys
+    uint8_t modifiers;  // KEY_MOD_* after this event was applied
+    uint8_t flags;      // KEY_EVENT_*
+    char ascii;         // Character in the current layout, 0 if none
+} key_event_t;
+
+// Modifier and lock state carried from one key event to the next
+struct keymap_state {
+    uint32_t held;                          // Modifier keys held down
+    uint32_t locks;                         // Caps, num and scroll lock
+    uint32_t keys_down[KEYCODE_COUNT / 32]; // Every key held down, to spot repeats
+};
+
+typedef struct keymap_layout keymap_layout_t;
+
+// Key code for a scancode set 1 make or break code, with extended set if
+// it followed an 0xE0 prefix. KEY_NONE for codes that are not keys.
+uint8_t keymap_set1_keycode(uint8_t scancode, int extended);
+
+// Key code for a scancode set 2 code (without the 0xF0 break prefix)
+uint8_t keymap_set2_keycode(uint8_t scancode, int extended);
+
+// Decode a set 1 make or break code into event, updating state
+void keymap_decode_set1(struct keymap_state* state, uint8_t scancode, int extended, key_event_t* event);
+
+// Layouts built into the kernel, looked up by name ("us", "no")
+const keymap_layout_t* keymap_find_layout(const char* name);
+const char* keymap_layout_name(const keymap_layout_t* layout);
+
+// The layout used by keymap_decode_set1()
+void keymap_set_layout(const keymap_layout_t* layout);
+const keymap_layout_t* keymap_current_layout();
+
+#endif // KEYMAP_H
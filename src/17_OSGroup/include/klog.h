@@ -0,0 +1,59 @@
+#ifndef KLOG_H
+#define KLOG_H
+
+#include "libc/system.h"
+
+// Kernel log. Records go into a fixed-size ring in O(1), from any context
+// including interrupt handlers, and are written to the console later from
+// the timer tick. The ring keeps the most recent KLOG_RECORDS records, so
+// messages that scrolled off the screen (or were never shown) can still be
+// looked at, e.g. when the kernel panics.
+
+// Log levels, lower is more important
+#define KLOG_EMERG   0
+#define KLOG_ALERT   1
+#define KLOG_CRIT    2
+#define KLOG_ERR     3
+#define KLOG_WARNING 4
+#define KLOG_NOTICE  5
+#define KLOG_INFO    6
+#define KLOG_DEBUG   7
+
+#define KLOG_RECORDS     256    // Must be a power of two
+#define KLOG_TEXT_SIZE   116    // Longer messages are cut off
+
+// Records drained to the console per timer tick
+#define KLOG_DRAIN_BUDGET 8
+
+// Records printed by panic()
+#define KLOG_PANIC_TAIL 16
+
+struct klog_record {
+    volatile uint32_t seq;      // Sequence number, 0 while being written
+    uint32_t timestamp;         // PIT ticks (ms) when logged
+    uint8_t level;
+    uint8_t cpu;
+    uint16_t length;
+    char text[KLOG_TEXT_SIZE];
+};
+
+// Start draining the log to the console from the timer tick. Records logged
+// before this are kept and drained once it has been called.
+void init_klog();
+
+// Append a record. Does not touch the console.
+void klog(int level, const char* __restrict__ format, ...);
+
+// Only records at this level or more important are drained to the console
+void klog_set_console_level(int level);
+
+// Drain up to max pending records to the console, returns how many were written
+uint32_t klog_drain(uint32_t max);
+
+// Synchronously print the last count records, whether drained or not
+void klog_print_tail(uint32_t count);
+
+// Records overwritten before they could be drained
+uint32_t klog_lost();
+
+#endif // KLOG_H
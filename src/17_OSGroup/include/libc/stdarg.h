@@ -12,3 +12,6 @@ typedef __builtin_va_list va_list;
 // va_arg
 #define va_arg(v, l) __builtin_va_arg(v, l)
 
+
+// va_copy
+#define va_copy(d, s) __builtin_va_copy(d, s)
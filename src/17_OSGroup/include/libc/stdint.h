@@ -3,8 +3,15 @@
 
 typedef long unsigned int size_t;
 typedef long unsigned int uint32_t;
+typedef unsigned long long uint64_t;
 typedef unsigned short uint16_t;
 typedef unsigned char uint8_t;
 typedef long int int32_t;
+typedef long long int64_t;
 typedef short int16_t;
 typedef signed char int8_t;
+typedef long unsigned int uintptr_t;
+
+#define UINT8_MAX  0xFF
+#define UINT16_MAX 0xFFFF
+#define UINT32_MAX 0xFFFFFFFFUL
@@ -1,5 +1,19 @@
 #pragma once
 
+#include "libc/stdarg.h"
+
+// Receives formatted output in runs
+typedef void (*format_sink_t)(void* ctx, const char* data, size_t length);
+
 int putchar(int ic);
 bool print(const char* data, size_t length);
-int printf(const char* __restrict__ format, ...);
\ No newline at end of file
+int printf(const char* __restrict__ format, ...);
+int vprintf(const char* __restrict__ format, va_list parameters);
+
+// Format into buffer, writing at most size bytes including the terminator.
+// Returns the length the full output would have had.
+int snprintf(char* __restrict__ buffer, size_t size, const char* __restrict__ format, ...);
+int vsnprintf(char* __restrict__ buffer, size_t size, const char* __restrict__ format, va_list parameters);
+
+// The formatting engine behind printf, hands its output to sink
+int vformat(format_sink_t sink, void* ctx, const char* __restrict__ format, va_list parameters);
@@ -1,4 +1,9 @@
 #pragma once
 
 
-size_t strlen(const char* str);
\ No newline at end of file
+size_t strlen(const char* str);
+int strcmp(const char* a, const char* b);
+int strncmp(const char* a, const char* b, size_t n);
+char* strcpy(char* dest, const char* src);
+char* strchr(const char* str, int c);
+char* strrchr(const char* str, int c);
@@ -35,8 +35,10 @@ extern void free(void *mem); /* Frees memory previously allocated */
 
 /* Function declarations for memory manipulation */
 extern void* memcpy(void* dest, const void* src, size_t num ); /* Copies num bytes from src to dest */
+extern void* memmove(void* dest, const void* src, size_t num ); /* Copies num bytes from src to dest, the regions may overlap */
 extern void* memset (void * ptr, int value, size_t num ); /* Sets num bytes starting from ptr to value */
 extern void* memset16 (void *ptr, uint16_t value, size_t num); /* Sets num bytes starting from ptr to a 16-bit value */
+extern int memcmp(const void* a, const void* b, size_t num); /* Compares num bytes, returns 0 if they are equal */
 
 /* Other helper functions*/
 void print_memory_layout();
@@ -7,6 +7,7 @@
 #include "common.h"
 #include "libc/stdint.h"
 #include "libc/stddef.h"
+#include "libc/stdbool.h"
 
 void monitor_initialize() ;
 void monitor_setcolor(uint8_t color);
@@ -18,4 +19,36 @@ void monitor_write(const char* data, size_t size);
 void monitor_write_hex(uint32_t n);
 void monitor_write_dec(uint32_t n);
 
+// Output is drawn into a shadow buffer in RAM. monitor_flush() copies the
+// changed rows to video memory. In deferred mode that happens at most once
+// per timer tick instead of after every write.
+void monitor_flush();
+void monitor_set_deferred(bool deferred);
+
+// Largest text grid the shadow buffer can hold
+#define MONITOR_MAX_COLS 160
+#define MONITOR_MAX_ROWS 64
+
+// Something that can display the shadow buffer. Cells are VGA text mode
+// entries (character in the low byte, colour attribute in the high byte).
+struct monitor_backend {
+    // Draw one full row of cells at screen row y
+    void (*draw_row)(size_t y, const uint16_t* cells, size_t cols);
+    // Move the displayed contents up by the given number of rows, or NULL
+    // to have every row redrawn after scrolling
+    void (*scroll)(size_t lines);
+    // Show the cursor at the given cell
+    void (*set_cursor)(size_t x, size_t y);
+    // Whether set_cursor() paints over the cells (and must be redone
+    // whenever the row under the cursor is redrawn)
+    bool soft_cursor;
+};
+
+// Switch the screen to another backend with a cols x rows text grid, or
+// back to VGA text mode when backend is NULL. The screen is cleared.
+void monitor_set_backend(const struct monitor_backend* backend, size_t cols, size_t rows);
+
+// Current size of the text grid
+void monitor_get_size(size_t* cols, size_t* rows);
+
 #endif // MONITOR_H
\ No newline at end of file
@@ -25,7 +25,25 @@
 
 
 void init_pit();
+
+// Reprogram channel 0 to run at PIT_BASE_FREQUENCY / divisor. Whoever does
+// this must keep the 1 ms tick going (see irq_set_fast_handler()).
+// pit_reset_divisor() goes back to TARGET_FREQUENCY.
+void pit_set_divisor(uint16_t divisor);
+void pit_reset_divisor();
+uint32_t pit_get_ticks();
 void sleep_interrupt(uint32_t milliseconds);
 void sleep_busy(uint32_t milliseconds);
+
+// TSC cycles per millisecond, measured over one timer tick the first time
+// it is called. Interrupts must be enabled.
+uint32_t pit_tsc_per_ms();
+
+#ifdef CONFIG_IRQ_STATS
+// Measure the spread between timer ticks, e.g. before and after enabling
+// IRQ nesting while the keyboard is being flooded
+void pit_jitter_reset();
+void pit_jitter_report();
+#endif
 #endif
 
@@ -0,0 +1,37 @@
+#ifndef SONG_LIBRARY_H
+#define SONG_LIBRARY_H
+
+#include "song/song.h"
+
+// Every song the kernel knows about: the built-in ones, which are stored
+// in the compact song format (song/song_format.h), and any encoded songs
+// or Standard MIDI Files (song/midi.h) the bootloader loaded as modules.
+// Songs are decoded as they play.
+
+#define SONG_LIBRARY_MAX 16
+
+// A song compiled into the kernel, see src/apps/song/songs.c
+struct builtin_song {
+    const char* name;
+    const uint8_t* data;
+    uint32_t size;
+};
+
+extern const struct builtin_song builtin_songs[];
+extern const uint32_t builtin_song_count;
+
+// Set up the built-in songs and the songs among the boot modules
+void init_song_library();
+
+// Add an encoded song or a Standard MIDI File. The name and the data are
+// used in place and must stay around. False if it is neither, or the
+// library is full.
+bool song_library_add(const char* name, const void* data, uint32_t size);
+
+uint32_t song_library_count();
+
+// Song number index, NULL past the end
+Song* song_library_get(uint32_t index);
+const char* song_library_name(uint32_t index);
+
+#endif // SONG_LIBRARY_H
@@ -0,0 +1,70 @@
+#ifndef MIDI_H
+#define MIDI_H
+
+#include "song/song.h"
+
+// Standard MIDI File (type 0 and 1) player. The tracks are read straight
+// from the file in memory and merged in time order with a min-heap, one
+// event at a time. Delta times are turned into PIT ticks with the tempo in
+// force, and the highest held note becomes the melody, so the result is a
+// note stream the sequencer plays like any other song. Nothing is
+// allocated while the file plays, the merge state lives in the cursor.
+// https://www.midi.org/specifications/file-format-specifications/standard-midi-files
+
+#define MIDI_MAX_TRACKS      16
+#define MIDI_DEFAULT_TEMPO   500000     // Microseconds per quarter note (120 bpm)
+#define MIDI_DRUM_CHANNEL    9          // Channel 10, percussion, not melody
+
+struct midi_track {
+    const uint8_t* data;
+    uint32_t size;
+};
+
+struct midi_file {
+    note_stream_t stream;
+    uint16_t format;
+    uint16_t division;          // Ticks per quarter note, or SMPTE timing
+    bool smpte;                 // Division is in frames, tempo events do not apply
+    uint32_t unit;              // File ticks per tempo unit, times microseconds per PIT tick
+    uint32_t track_count;
+    struct midi_track tracks[MIDI_MAX_TRACKS];
+};
+
+// Where a cursor is in a track
+struct midi_track_state {
+    uint32_t position;          // Offset of the next event
+    uint32_t time;              // Absolute time of the next event, in file ticks
+    uint8_t status;             // Running status
+    bool done;
+};
+
+// Where a cursor is in the file, kept in the cursor's state
+struct midi_state {
+    struct midi_track_state tracks[MIDI_MAX_TRACKS];
+
+    // Tracks that still have events, as a min-heap on their next time
+    uint8_t heap[MIDI_MAX_TRACKS];
+    uint32_t heap_size;
+
+    // Time keeping: file ticks are converted to PIT ticks as they pass
+    uint32_t tempo;             // Microseconds per quarter note
+    uint32_t file_time;         // File ticks processed
+    uint32_t pit_time;          // The same in PIT ticks
+    uint32_t remainder;         // Left over from the conversion
+
+    // Melody extraction
+    uint8_t held[128];          // Note-ons without a note-off yet, per key
+    uint32_t held_mask[4];      // Keys with held[key] != 0
+    int sounding;               // Key being output, -1 for silence
+    uint32_t segment_start;     // PIT time it started at
+};
+
+// Whether data starts like a Standard MIDI File
+bool midi_detect(const void* data, uint32_t size);
+
+// Parse the header and track chunks and point song at the file. The note
+// count is worked out by playing the file through once. The data must stay
+// around for as long as the song is used.
+bool midi_init(struct midi_file* midi, const void* data, uint32_t size, Song* song);
+
+#endif // MIDI_H
@@ -0,0 +1,41 @@
+#ifndef SEQUENCER_H
+#define SEQUENCER_H
+
+#include "song/song.h"
+
+// Song sequencer driven by the timer tick. Songs are queued and played in
+// the background: every PIT tick advances the playback position, and the
+// next note is started from the tick handler once the current one is over.
+// Positions are in PIT ticks (1 ms) from the start of the current song.
+
+#define SEQUENCER_QUEUE_SIZE 16
+
+void init_sequencer();
+
+// Add a song to the end of the queue. Returns false if the queue is full.
+bool sequencer_queue(Song* song);
+
+// Stop playing and forget every queued song
+void sequencer_stop();
+
+// Hold playback at the current position, and carry on from there
+void sequencer_pause();
+void sequencer_resume();
+
+// Skip to the next queued song
+void sequencer_next();
+
+// Jump to a position in the current song. Returns false if it is past the end.
+bool sequencer_seek(uint32_t position);
+
+// Playback position and length of the current song, in ticks
+uint32_t sequencer_position();
+uint32_t sequencer_length();
+
+bool sequencer_is_playing();
+bool sequencer_is_paused();
+
+// Songs waiting after the current one
+uint32_t sequencer_queued();
+
+#endif // SEQUENCER_H
@@ -10,12 +10,45 @@ typedef struct {
     uint32_t duration;  // The duration of the note in milliseconds
 } Note;
 
+// Room for the playback state a stream keeps in each cursor
+#define SONG_STREAM_STATE_SIZE 512
+
+// A source of notes that are produced one at a time, e.g. by a decoder.
+// The stream itself does not change while it plays: the position lives in
+// the state of the cursor walking it, so several cursors can play the same
+// song at once.
+typedef struct note_stream {
+    // Produce the next note and move state past it, returns false at the end
+    bool (*next)(const struct note_stream* stream, void* state, Note* note);
+    // Set state to the first note
+    void (*rewind)(const struct note_stream* stream, void* state);
+    void* ctx;
+} note_stream_t;
+
 // Define a struct to represent a song
 typedef struct {
     Note* notes;        // Pointer to an array of Note structs representing the song
     uint32_t length;    // The number of notes in the song
+    uint32_t duration;  // Sum of the note durations in ms
+    note_stream_t* stream;  // If set, the notes come from here instead of the array
 } Song;
 
+// Walks the notes of a song, whether they are in an array or a stream
+typedef struct {
+    const Song* song;
+    uint32_t index;     // Notes produced so far
+    uint32_t state[SONG_STREAM_STATE_SIZE / sizeof(uint32_t)];  // The stream's position
+} song_cursor_t;
+
+void song_cursor_init(song_cursor_t* cursor, const Song* song);
+
+// Next note of the song, returns false at the end
+bool song_cursor_next(song_cursor_t* cursor, Note* note);
+
+// Sum of the note durations in ms, found by walking the whole song. Too
+// slow for an interrupt handler, the library measures each song once.
+uint32_t song_measure(const Song* song);
+
 // Define a struct to represent a song player
 typedef struct {
     void (*play_song)(Song* song); // Function pointer to a function that plays a song
@@ -26,100 +59,14 @@ typedef struct {
 SongPlayer* create_song_player();
 void play_song_impl(Song *song) ;
 
-static Note music_1[] = {
-    {E5, 250}, {R, 125}, {E5, 125}, {R, 125}, {E5, 125}, {R, 125},
-    {C5, 125}, {E5, 125}, {G5, 125}, {R, 125}, {G4, 125}, {R, 250},
-
-    {C5, 125}, {R, 250}, {G4, 125}, {R, 125}, {E4, 125}, {R, 125},
-    {A4, 125}, {B4, 125}, {R, 125}, {A_SHARP4, 125}, {A4, 125}, {R, 125},
-    {G4, 125}, {E5, 125}, {G5, 125}, {A5, 125}, {F5, 125}, {G5, 125},
-    {R, 125}, {E5, 125}, {C5, 125}, {D5, 125}, {B4, 125}, {R, 125},
-
-    {C5, 125}, {R, 250}, {G4, 125}, {R, 125}, {E4, 125}, {R, 125},
-    {A4, 125}, {B4, 125}, {R, 125}, {A_SHARP4, 125}, {A4, 125}, {R, 125},
-    {G4, 125}, {E5, 125}, {G5, 125}, {A5, 125}, {F5, 125}, {G5, 125},
-    {R, 125}, {E5, 125}, {C5, 125}, {D5, 125}, {B4, 125}, {R, 125},
-};
-
-static Note starwars_theme[] = {
-    // Opening phrase
-    {A4, 500}, {A4, 500}, {A4, 500}, 
-    {F4, 375}, {C5, 125}, 
-    {A4, 500}, {F4, 375}, {C5, 125}, {A4, 1000}, 
-    {E5, 500}, {E5, 500}, {E5, 500}, 
-    {F5, 375}, {C5, 125},
-    
-    // Next phrase
-    {G4, 500}, {F4, 375}, {C5, 125}, {A4, 1000}, 
-    {A5, 500}, {A4, 375}, {A4, 125}, 
-    {A5, 500}, {G5, 375}, {F5, 125}, {E5, 125}, {D5, 125}, 
-    {C5, 250}, {B4, 250}, {A4, 500},
-
-    // End note
-    {R, 500}
-};
-
-
-static Note battlefield_1942_theme[] = {
-    // Attempt at the opening part of the Battlefield 1942 theme
-    {E4, 500}, {G4, 500}, {B4, 300}, {E5, 200}, 
-    {D5, 200}, {B4, 300}, {G4, 500}, {B4, 300}, 
-    {E5, 200}, {D5, 200}, {B4, 300}, {G4, 500}, 
-    {B4, 300}, {E5, 200}, {G5, 200}, {E5, 300}, 
-
-    // Continue with the next part of the melody
-    {D5, 200}, {B4, 300}, {G4, 500}, {E4, 500}, 
-    {G4, 500}, {B4, 300}, {E5, 200}, {D5, 200}, 
-    {B4, 300}, {G4, 500}, {B4, 300}, {E5, 200}, 
-    {D5, 200}, {B4, 300}, {G4, 500}, {B4, 300}, 
-    {E5, 200}, {G5, 200}, {E5, 300}, {D5, 200}, 
-    {B4, 300}, {G4, 500}, 
-
-    // Repeat or modify as needed
-    // ...
-
-    // End note
-    {R, 500}
-};
-
-
-static Note music_2[] = {
-    {A4, 200}, {E5, 200}, {A5, 200}, {R, 100}, {A5, 200}, {A5, 200}, {Gs5, 200}, {A5, 200},
-    {R, 100}, {E5, 200}, {R, 100}, {E5, 200}, {R, 100}, {E5, 200}, {R, 100}, {E5, 200},
-    {A4, 200}, {E5, 200}, {A5, 200}, {R, 100}, {A5, 200}, {A5, 200}, {Gs5, 200}, {A5, 200},
-    {R, 100}, {E5, 200}, {R, 100}, {E5, 200}, {R, 100}, {E5, 200}, {R, 100}, {E5, 200},
-    {A4, 200}, {E5, 200}, {A5, 200}, {R, 100}, {A5, 200}, {A5, 200}, {Gs5, 200}, {A5, 200},
-    {R, 100}, {E5, 200}, {R, 100}, {E5, 200}, {R, 100}, {E5, 200}, {R, 100}, {E5, 200}
-};
-
-static Note music_3[] = {
-    {E4, 200}, {E4, 200}, {F4, 200}, {G4, 200}, {G4, 200}, {F4, 200}, {E4, 200}, {D4, 200},
-    {C4, 200}, {C4, 200}, {D4, 200}, {E4, 200}, {E4, 400}, {R, 200},
-    {D4, 200}, {D4, 200}, {E4, 200}, {F4, 200}, {F4, 200}, {E4, 200}, {D4, 200}, {C4, 200},
-    {A4, 200}, {A4, 200}, {A4, 200}, {G4, 400}
-};
-
-static Note music_4[] = {
-    {C4, 500}, {D4, 500}, {E4, 500}, {C4, 500},
-    {C4, 500}, {D4, 500}, {E4, 500}, {C4, 500},
-    {E4, 500}, {F4, 500}, {G4, 1000},
-    {E4, 500}, {F4, 500}, {G4, 1000},
-    {G4, 250}, {A4, 250}, {G4, 250}, {F4, 250}, {E4, 500}, {C4, 500},
-    {G4, 250}, {A4, 250}, {G4, 250}, {F4, 250}, {E4, 500}, {C4, 500},
-    {C4, 500}, {G3, 500}, {C4, 1000},
-    {C4, 500}, {G3, 500}, {C4, 1000}
-};
-
-static Note music_5[] = {
-    {E4, 375}, {C4, 375}, {D4, 375}, {A3, 375}, {B3, 375}, {D4, 375}, {C4, 375}, {A3, 375},
-    {E4, 375}, {C4, 375}, {D4, 375}, {A3, 375}, {B3, 375}, {D4, 375}, {C4, 375}, {A3, 375},
-};
+// A SongPlayer that renders songs as samples on the current audio output
+// instead of driving the PC speaker tone by tone
+SongPlayer* create_pcm_song_player();
 
-static Note music_6[] = {
-    {F4, 250}, {F4, 250}, {F4, 250}, {C5, 250}, {A_SHARP4, 250}, {G_SHARP4, 250}, {F4, 500},
-    {F4, 250}, {F4, 250}, {F4, 250}, {C5, 250}, {A_SHARP4, 250}, {G_SHARP4, 250}, {F4, 500},
-    {A_SHARP4, 250}, {A_SHARP4, 250}, {A_SHARP4, 250}, {F5, 250}, {D5, 250}, {C5, 250}, {A_SHARP4, 500},
-    {A_SHARP4, 250}, {A_SHARP4, 250}, {A_SHARP4, 250}, {F5, 250}, {D5, 250}, {C5, 250}, {A_SHARP4, 500},
-};
+// PC speaker control, driving PIT channel 2
+void enable_speaker();
+void disable_speaker();
+void play_sound(uint32_t frequency);
+void stop_sound();
 
 #endif
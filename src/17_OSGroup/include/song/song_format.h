@@ -0,0 +1,65 @@
+#ifndef SONG_FORMAT_H
+#define SONG_FORMAT_H
+
+#include "song/song.h"
+
+// Compact encoded songs. Notes are indexes into the frequencies.h table
+// (C0 = 0 up to B9 = 119), stored as the difference from the previous
+// note, so most notes take a single byte.
+//
+//   "SNG1"           magic
+//   varint count     number of notes, rests included
+//   tokens           until count notes have been produced
+//
+// Varints are unsigned LEB128 (7 bits per byte, low bits first). A token
+// is a varint whose low two bits give its kind and whose upper bits its
+// argument:
+//
+//   0  note, index += zigzag(argument), same duration as before
+//   1  note, index += zigzag(argument), a varint duration in ms follows
+//   2  argument + 1 rests of the same duration as before
+//   3  argument + 1 rests, a varint duration in ms follows
+//
+// Zigzag maps 0, -1, 1, -2, ... to 0, 1, 2, 3, ... The index starts at
+// A4 and the duration at 0. scripts/encode_songs.py writes this format.
+
+#define SONG_FORMAT_MAGIC       "SNG1"
+#define SONG_FORMAT_MAGIC_SIZE  4
+#define SONG_FORMAT_FIRST_INDEX 57      // A4
+#define SONG_FORMAT_NOTE_COUNT  120     // C0 to B9
+
+#define SONG_TOKEN_NOTE          0
+#define SONG_TOKEN_NOTE_DURATION 1
+#define SONG_TOKEN_REST          2
+#define SONG_TOKEN_REST_DURATION 3
+
+// Streaming decoder, produces one Note at a time straight from the
+// encoded bytes without allocating anything
+struct song_decoder {
+    note_stream_t stream;
+    const uint8_t* data;
+    uint32_t size;
+    uint32_t body;              // Offset of the first token
+    uint32_t count;             // Notes in the song
+};
+
+// Where a cursor is in an encoded song
+struct song_decoder_state {
+    uint32_t position;          // Offset of the next token
+    uint32_t index;             // Note index of the previous note
+    uint32_t duration;          // Duration of the previous note or rest
+    uint32_t rests;             // Rests left of the current run
+    bool error;                 // The data turned out to be broken
+};
+
+// Frequency of a note index, 0 if it is out of range
+uint32_t song_note_frequency(uint32_t index);
+
+// Whether data starts like an encoded song
+bool song_format_detect(const void* data, uint32_t size);
+
+// Check the header and set up decoder, then point song at it. The data
+// must stay around for as long as the song is used.
+bool song_decoder_init(struct song_decoder* decoder, const void* data, uint32_t size, Song* song);
+
+#endif // SONG_FORMAT_H
@@ -0,0 +1,25 @@
+#ifndef SONG_PCM_H
+#define SONG_PCM_H
+
+#include "song/song.h"
+#include "audio.h"
+
+// Streaming decoder that renders a Song as sampled audio: a square wave per
+// note, produced block by block as the output driver asks for it.
+
+#define SONG_PCM_AMPLITUDE 96   // Peak distance from AUDIO_SILENCE
+
+struct song_pcm {
+    audio_source_t source;
+    song_cursor_t cursor;
+    uint32_t sample_rate;
+    bool done;                  // Past the last note
+    uint32_t note_samples;      // Samples left of that note
+    uint32_t phase;             // Oscillator phase, a full cycle is 2^32
+    uint32_t phase_step;        // Phase added per sample
+};
+
+// Set up decoder to render song at sample_rate and return its audio source
+audio_source_t* song_pcm_init(struct song_pcm* decoder, const Song* song, uint32_t sample_rate);
+
+#endif // SONG_PCM_H
@@ -0,0 +1,110 @@
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include "song/song.h"
+#include "audio.h"
+
+// Polyphonic software synthesizer. Every voice is an oscillator with an
+// ADSR envelope, and the voices are summed by a fixed-point mixer into
+// unsigned 8-bit blocks, so a synth is just another audio source. All the
+// arithmetic is integer, the kernel never saves FPU state.
+
+#define SYNTH_MAX_VOICES 8
+#define SYNTH_CHUNK      64         // Samples mixed per pass over the voices
+
+// Envelope levels are fixed point, SYNTH_LEVEL_MAX is full volume
+#define SYNTH_LEVEL_BITS 23
+#define SYNTH_LEVEL_MAX  (1 << SYNTH_LEVEL_BITS)
+
+#define SYNTH_VELOCITY_MAX 127
+
+// Mixer gain is 8.8 fixed point. The default lets four voices at full
+// velocity play before the output clips.
+#define SYNTH_DEFAULT_GAIN 64
+
+typedef enum {
+    SYNTH_SQUARE,
+    SYNTH_TRIANGLE,
+    SYNTH_NOISE,
+} synth_waveform_t;
+
+// Times are in milliseconds, sustain is a fraction of full volume out of 256
+typedef struct {
+    uint16_t attack_ms;
+    uint16_t decay_ms;
+    uint16_t sustain;
+    uint16_t release_ms;
+} synth_envelope_t;
+
+typedef enum {
+    SYNTH_STAGE_OFF,
+    SYNTH_STAGE_ATTACK,
+    SYNTH_STAGE_DECAY,
+    SYNTH_STAGE_SUSTAIN,
+    SYNTH_STAGE_RELEASE,
+} synth_stage_t;
+
+struct synth_voice {
+    synth_waveform_t waveform;
+    synth_stage_t stage;
+    uint32_t phase;             // Oscillator phase, a full cycle is 2^32
+    uint32_t phase_step;        // Phase added per sample
+    uint16_t noise;             // LFSR state of the noise oscillator
+    uint8_t velocity;           // 0-SYNTH_VELOCITY_MAX
+    int32_t level;              // Envelope level, 0-SYNTH_LEVEL_MAX
+    int32_t level_step;         // Added to level every sample
+    uint32_t stage_samples;     // Samples left of the current stage
+    uint32_t gate_samples;      // Samples until the release, 0 = until synth_note_off()
+    uint32_t age;               // When the voice was started, for voice stealing
+    synth_envelope_t envelope;
+};
+
+struct synth {
+    audio_source_t source;
+    uint32_t sample_rate;
+    uint32_t gain;              // Mixer gain, 8.8 fixed point
+    uint32_t clipped;           // Output samples that had to be clipped
+    uint32_t started;           // Notes started so far
+    synth_envelope_t envelope;  // Envelope given to new notes
+    struct synth_voice voices[SYNTH_MAX_VOICES];
+    int32_t mix[SYNTH_CHUNK];
+};
+
+// Set up synth to render at sample_rate and return its audio source. The
+// source never runs out, it renders silence while no voice is playing.
+audio_source_t* synth_init(struct synth* synth, uint32_t sample_rate);
+
+// Envelope for notes started from now on
+void synth_set_envelope(struct synth* synth, const synth_envelope_t* envelope);
+
+// Start a note and return its voice, stealing the quietest or oldest voice
+// when all are busy. With duration_ms 0 the note is held until
+// synth_note_off(), otherwise it is released by itself.
+int synth_note_on(struct synth* synth, uint32_t frequency, uint32_t velocity,
+                  synth_waveform_t waveform, uint32_t duration_ms);
+
+// Move the voice into its release stage
+void synth_note_off(struct synth* synth, int voice);
+
+// Cut every voice off at once
+void synth_all_off(struct synth* synth);
+
+// Voices that are still sounding
+uint32_t synth_active_voices(const struct synth* synth);
+
+// Mix count samples from the voices into samples
+void synth_render(struct synth* synth, uint8_t* samples, uint32_t count);
+
+// Plays a Song on the synth: the melody on a square voice with a triangle
+// an octave below it. Notes overlap through their release tails.
+struct synth_song {
+    audio_source_t source;
+    struct synth synth;
+    song_cursor_t cursor;
+    bool done;                  // Every note has been started
+    uint32_t note_samples;      // Samples until the next note starts
+};
+
+audio_source_t* synth_song_init(struct synth_song* player, const Song* song, uint32_t sample_rate);
+
+#endif // SYNTH_H
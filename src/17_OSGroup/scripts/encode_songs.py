@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""Encode .song text files into the compact song format (include/song/song_format.h).
+
+A .song file lists notes as "<name> <milliseconds>" pairs, with '#' starting
+a comment. Names follow include/song/frequencies.h (C4, Cs4, A_SHARP4, ...),
+and R is a rest.
+
+  encode_songs.py --binary out.sng in.song     one encoded song, e.g. for a boot module
+  encode_songs.py --c out.c a.song b.song ...  C source with the built-in songs
+"""
+
+import argparse
+import os
+import re
+import sys
+
+MAGIC = b"SNG1"
+FIRST_INDEX = 57            # A4, where the delta coding starts
+NOTE_COUNT = 120            # C0 to B9
+
+KIND_NOTE = 0
+KIND_NOTE_DURATION = 1
+KIND_REST = 2
+KIND_REST_DURATION = 3
+
+SEMITONES = {"C": 0, "Cs": 1, "D": 2, "Ds": 3, "E": 4, "F": 5,
+             "Fs": 6, "G": 7, "Gs": 8, "A": 9, "As": 10, "B": 11}
+ALIASES = {"A_SHARP": "As", "G_SHARP": "Gs"}
+
+
+def note_index(name):
+    match = re.fullmatch(r"([A-G](?:s|_SHARP)?)(\d)", name)
+    if not match:
+        raise ValueError("unknown note " + name)
+    pitch = ALIASES.get(match.group(1), match.group(1))
+    return int(match.group(2)) * 12 + SEMITONES[pitch]
+
+
+def parse_song(path):
+    tokens = []
+    with open(path) as f:
+        for line in f:
+            tokens += line.split("#", 1)[0].split()
+    if len(tokens) % 2:
+        raise ValueError(path + ": note without a duration")
+    notes = []
+    for name, duration in zip(tokens[0::2], tokens[1::2]):
+        notes.append((None if name == "R" else note_index(name), int(duration)))
+    return notes
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return out
+
+
+def zigzag(value):
+    return value * 2 if value >= 0 else -value * 2 - 1
+
+
+def encode(notes):
+    out = bytearray(MAGIC)
+    out += varint(len(notes))
+    index = FIRST_INDEX
+    duration = 0
+    i = 0
+    while i < len(notes):
+        note, length = notes[i]
+        new_duration = length != duration
+        if note is None:
+            # Rests of one length are stored as a single run
+            run = 1
+            while i + run < len(notes) and notes[i + run] == (None, length):
+                run += 1
+            kind = KIND_REST_DURATION if new_duration else KIND_REST
+            out += varint(((run - 1) << 2) | kind)
+            i += run
+        else:
+            kind = KIND_NOTE_DURATION if new_duration else KIND_NOTE
+            out += varint((zigzag(note - index) << 2) | kind)
+            index = note
+            i += 1
+        if new_duration:
+            out += varint(length)
+            duration = length
+    return bytes(out)
+
+
+def c_source(songs, command):
+    lines = ["// Generated by scripts/encode_songs.py, do not edit. Regenerate with:",
+             "// " + command,
+             "",
+             '#include "song/library.h"',
+             ""]
+    for name, data, notes in songs:
+        lines.append("// %s: %d notes, %d bytes (%d as Note arrays)" % (name, len(notes), len(data), len(notes) * 8))
+        lines.append("static const uint8_t song_%s[] = {" % name)
+        for start in range(0, len(data), 12):
+            lines.append("    " + " ".join("0x%02x," % b for b in data[start:start + 12]))
+        lines.append("};")
+        lines.append("")
+    lines.append("const struct builtin_song builtin_songs[] = {")
+    for name, data, notes in songs:
+        lines.append('    { "%s", song_%s, sizeof(song_%s) },' % (name, name, name))
+    lines.append("};")
+    lines.append("")
+    lines.append("const uint32_t builtin_song_count = sizeof(builtin_songs) / sizeof(builtin_songs[0]);")
+    return "\n".join(lines) + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Encode songs into the compact song format")
+    group = parser.add_mutually_exclusive_group(required=True)
+    group.add_argument("--binary", metavar="OUT", help="write one encoded song")
+    group.add_argument("--c", metavar="OUT", help="write C source with every song")
+    parser.add_argument("songs", nargs="+")
+    args = parser.parse_args()
+
+    songs = []
+    for path in args.songs:
+        notes = parse_song(path)
+        name = os.path.splitext(os.path.basename(path))[0]
+        songs.append((name, encode(notes), notes))
+
+    if args.binary:
+        if len(songs) != 1:
+            sys.exit("--binary takes one song")
+        with open(args.binary, "wb") as f:
+            f.write(songs[0][1])
+    else:
+        with open(args.c, "w") as f:
+            command = " ".join(["scripts/encode_songs.py", "--c", args.c] + args.songs)
+            f.write(c_source(songs, command))
+
+
+if __name__ == "__main__":
+    main()
@@ -1,10 +1,20 @@
 #!/bin/bash
 KERNEL_PATH=$1
 DISK_PATH=$2
+# Where COM1 goes, e.g. "stdio" or "file:serial.log" to capture the kernel log
+SERIAL=${3:-pty}
+# How the FAT32 disk is attached: "ide" (primary slave, hdb) or "virtio" (vda)
+DISK_BUS=${4:-ide}
+
+if [ "$DISK_BUS" = "virtio" ]; then
+    DISK_ARGS="-drive file=$DISK_PATH,if=virtio,format=raw"
+else
+    DISK_ARGS="-hdb $DISK_PATH"
+fi
 
 # Start QEMU in the background
 echo "Starting QEMU"
-qemu-system-i386 -S -gdb tcp::1234 -boot d -hda $KERNEL_PATH -hdb $DISK_PATH -m 64 -audiodev sdl,id=sdl1,out.buffer-length=40000 -machine pcspk-audiodev=sdl1 -serial pty &
+qemu-system-i386 -S -gdb tcp::1234 -boot d -hda $KERNEL_PATH $DISK_ARGS -m 64 -audiodev sdl,id=sdl1,out.buffer-length=40000 -machine pcspk-audiodev=sdl1 -device sb16,audiodev=sdl1 -device AC97,audiodev=sdl1 -serial $SERIAL &
 QEMU_PID=$!
 
 # Function to check if gdb is running
@@ -0,0 +1,44 @@
+#include "bench/bench.h"
+#include "common.h"
+#include "pit.h"
+
+void bench_start(bench_timer_t* timer) {
+    // Wait for a tick edge so the millisecond count is not off by one
+    uint32_t ticks = pit_get_ticks();
+    while (pit_get_ticks() == ticks) {}
+
+    timer->start_ticks = pit_get_ticks();
+    timer->start_tsc = read_tsc();
+    timer->cycles = 0;
+    timer->ms = 0;
+}
+
+void bench_stop(bench_timer_t* timer) {
+    timer->cycles = read_tsc() - timer->start_tsc;
+    timer->ms = pit_get_ticks() - timer->start_ticks;
+}
+
+uint32_t bench_rate(const bench_timer_t* timer, uint32_t ops) {
+    uint32_t ms = timer->ms ? timer->ms : 1;
+    return (uint32_t)div64_32((uint64_t)ops * 1000, ms, NULL);
+}
+
+void bench_report(const char* name, const bench_timer_t* timer, uint32_t ops, const char* unit) {
+    uint32_t per_op = ops ? (uint32_t)div64_32(timer->cycles, ops, NULL) : 0;
+    printf("%s: %d %s in %d ms, %d cycles each, %d/s\n",
+           name, ops, unit, timer->ms, per_op, bench_rate(timer, ops));
+}
+
+void run_benchmarks() {
+    printf("Running benchmarks...\n");
+    bench_console();
+    bench_framebuffer();
+    bench_format();
+    bench_keymap();
+    bench_pcm();
+    bench_synth();
+    bench_sb16();
+    bench_song();
+    bench_disk();
+    printf("Benchmarks done.\n");
+}
@@ -0,0 +1,90 @@
+#include "bench/bench.h"
+#include "monitor.h"
+#include "fbcon.h"
+
+#define BENCH_CONSOLE_LINES 10000
+
+// The line every variant prints, with the line number appended
+static const char bench_line[] = "console benchmark line ";
+
+// Unbuffered reference: every character goes through monitor_put, which
+// scrolls and moves the hardware cursor each time, like printf used to
+static void print_line_per_char(int n) {
+    char number[12];
+    for (const char* c = bench_line; *c; c++)
+        monitor_put(*c);
+    for (const char* c = int32_to_str(number, n); *c; c++)
+        monitor_put(*c);
+    monitor_put('\n');
+}
+
+static void print_lines_buffered() {
+    for (int i = 0; i < BENCH_CONSOLE_LINES; i++)
+        printf("%s%d\n", bench_line, i);
+}
+
+void bench_console() {
+    bench_timer_t per_char, buffered, deferred;
+
+    // Every line scrolls the screen. The first two runs copy the shadow
+    // buffer to video memory after every write, the last one once per tick.
+    monitor_set_deferred(false);
+
+    bench_start(&per_char);
+    for (int i = 0; i < BENCH_CONSOLE_LINES; i++)
+        print_line_per_char(i);
+    bench_stop(&per_char);
+
+    bench_start(&buffered);
+    print_lines_buffered();
+    bench_stop(&buffered);
+
+    monitor_set_deferred(true);
+
+    bench_start(&deferred);
+    print_lines_buffered();
+    bench_stop(&deferred);
+
+    bench_report("console per-char", &per_char, BENCH_CONSOLE_LINES, "lines");
+    bench_report("console buffered", &buffered, BENCH_CONSOLE_LINES, "lines");
+    bench_report("console deferred", &deferred, BENCH_CONSOLE_LINES, "lines");
+}
+
+#define BENCH_CHARS_RUNS 2000
+
+// Characters per second through monitor_write, drawn on every write
+static void measure_chars(bench_timer_t* timer) {
+    static char text[100];
+    for (size_t i = 0; i < sizeof(text); i++)
+        text[i] = 'A' + i % 26;
+
+    monitor_set_deferred(false);
+
+    bench_start(timer);
+    for (int i = 0; i < BENCH_CHARS_RUNS; i++)
+        monitor_write(text, sizeof(text));
+    bench_stop(timer);
+
+    monitor_set_deferred(true);
+}
+
+void bench_framebuffer() {
+    bench_timer_t text_mode, framebuffer;
+    uint32_t chars = BENCH_CHARS_RUNS * 100;
+
+    if (!fbcon_active()) {
+        measure_chars(&text_mode);
+        bench_report("text mode console", &text_mode, chars, "chars");
+        return;
+    }
+
+    // Draw into the (invisible) VGA text buffer for the reference number
+    monitor_set_backend(NULL, 0, 0);
+    measure_chars(&text_mode);
+    fbcon_attach();
+
+    measure_chars(&framebuffer);
+
+    bench_report("text mode console", &text_mode, chars, "chars");
+    bench_report("framebuffer console", &framebuffer, chars, "chars");
+}
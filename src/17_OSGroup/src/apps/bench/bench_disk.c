@@ -0,0 +1,263 @@
+#include "bench/bench.h"
+#include "blockdev.h"
+#include "block.h"
+#include "bcache.h"
+#include "drivers/ata.h"
+#include "drivers/virtio_blk.h"
+#include "common.h"
+#include "pit.h"
+#include "memory/memory.h"
+
+#define DISK_BENCH_BYTES  (8 * 1024 * 1024)    // Read sequentially, at most
+#define DISK_BENCH_CHUNK  512                  // Sectors per sequential transfer, 256 KiB
+#define DISK_BENCH_BLOCK  8                    // Sectors per random read, 4 KiB
+#define DISK_BENCH_RANDOM 256                  // Random reads
+#define DISK_BENCH_WRITE  (2 * 1024 * 1024)    // Rewritten sequentially, at most
+#define DISK_BENCH_QUEUED (DISK_BENCH_CHUNK / DISK_BENCH_BLOCK)    // Shuffled reads, one buffer's worth
+
+static uint8_t buffer[DISK_BENCH_CHUNK * BLOCKDEV_SECTOR_SIZE] __attribute__((aligned(4096)));
+
+// Print a KiB/s rate as MB/s with two decimals
+static void print_throughput(uint32_t kib_per_second) {
+    printf("%lu.%02lu MB/s", kib_per_second / 1024, (kib_per_second % 1024) * 100 / 1024);
+}
+
+// Whether the disk holds anything we know: a boot signature (a partition
+// table or a FAT boot sector), an ext2/3/4 superblock or an ISO 9660
+// volume descriptor. A disk the kernel has mounted always has one of these.
+static bool bench_blockdev_in_use(blockdev_t* dev) {
+    if (!blockdev_read(dev, 0, 65, buffer))
+        return true;
+    if (buffer[510] == 0x55 && buffer[511] == 0xAA)
+        return true;
+    if (buffer[1024 + 56] == 0x53 && buffer[1024 + 57] == 0xEF)
+        return true;
+    return memcmp(buffer + 64 * BLOCKDEV_SECTOR_SIZE + 1, "CD001", 5) == 0;
+}
+
+// Sequential writes of what is already on the disk. Even so, a crash part
+// way would leave the disk torn, so only scratch disks, ones with no
+// partition table or filesystem, are written. Only the writes are timed.
+static void bench_blockdev_write(blockdev_t* dev, const char* mode, uint32_t sectors) {
+    if (dev->read_only)
+        return;
+    if (bench_blockdev_in_use(dev)) {
+        printf("%s%s%s sequential write: skipped, not a scratch disk\n", dev->name, mode[0] ? " " : "", mode);
+        return;
+    }
+    if (sectors > DISK_BENCH_WRITE / BLOCKDEV_SECTOR_SIZE)
+        sectors = DISK_BENCH_WRITE / BLOCKDEV_SECTOR_SIZE;
+
+    uint64_t cycles = 0;
+    for (uint32_t lba = 0; lba < sectors; lba += DISK_BENCH_CHUNK) {
+        if (!blockdev_read(dev, lba, DISK_BENCH_CHUNK, buffer)) {
+            printf("%s: read error at sector %lu\n", dev->name, lba);
+            return;
+        }
+        uint64_t start = read_tsc();
+        bool written = blockdev_write(dev, lba, DISK_BENCH_CHUNK, buffer);
+        cycles += read_tsc() - start;
+        if (!written) {
+            printf("%s: write error at sector %lu\n", dev->name, lba);
+            return;
+        }
+    }
+    uint64_t start = read_tsc();
+    blockdev_flush(dev);
+    cycles += read_tsc() - start;
+
+    uint32_t us = (uint32_t)div64_32(cycles * 1000, pit_tsc_per_ms(), NULL);
+    uint32_t kib = sectors / 2;
+    printf("%s%s%s sequential write: %lu KiB in %lu us, ", dev->name, mode[0] ? " " : "", mode, kib, us);
+    print_throughput((uint32_t)div64_32((uint64_t)kib * 1000000, us ? us : 1, NULL));
+    printf("\n");
+}
+
+// Sequential throughput in 256 KiB reads and writes, and random 4 KiB reads
+// per second
+void bench_blockdev(blockdev_t* dev, const char* mode) {
+    bench_timer_t timer;
+
+    // Too small for one sequential chunk also means too small for the
+    // random reads, which pick from dev->sectors / DISK_BENCH_BLOCK blocks
+    if (dev->sectors < DISK_BENCH_CHUNK) {
+        printf("%s: too small to measure\n", dev->name);
+        return;
+    }
+    uint32_t sectors = DISK_BENCH_BYTES / BLOCKDEV_SECTOR_SIZE;
+    if (sectors > dev->sectors)
+        sectors = dev->sectors - dev->sectors % DISK_BENCH_CHUNK;
+
+    bench_start(&timer);
+    for (uint32_t lba = 0; lba < sectors; lba += DISK_BENCH_CHUNK) {
+        if (!blockdev_read(dev, lba, DISK_BENCH_CHUNK, buffer)) {
+            printf("%s: read error at sector %lu\n", dev->name, lba);
+            return;
+        }
+    }
+    bench_stop(&timer);
+    uint32_t kib = sectors / 2;
+    printf("%s%s%s sequential: %lu KiB in %lu ms, ", dev->name, mode[0] ? " " : "", mode, kib, timer.ms);
+    print_throughput(bench_rate(&timer, kib));
+    printf("\n");
+
+    // Fixed seed, so every run and every driver reads the same blocks
+    uint32_t seed = 12345;
+    uint32_t blocks = dev->sectors / DISK_BENCH_BLOCK;
+    bench_start(&timer);
+    for (uint32_t i = 0; i < DISK_BENCH_RANDOM; i++) {
+        seed = seed * 1103515245 + 12345;
+        uint32_t lba = ((seed >> 8) % blocks) * DISK_BENCH_BLOCK;
+        if (!blockdev_read(dev, lba, DISK_BENCH_BLOCK, buffer)) {
+            printf("%s: read error at sector %lu\n", dev->name, lba);
+            return;
+        }
+    }
+    bench_stop(&timer);
+    printf("%s%s%s random 4 KiB: %lu reads in %lu ms, %lu IOPS, %lu cycles each\n",
+           dev->name, mode[0] ? " " : "", mode, (uint32_t)DISK_BENCH_RANDOM, timer.ms, bench_rate(&timer, DISK_BENCH_RANDOM),
+           (uint32_t)div64_32(timer.cycles, DISK_BENCH_RANDOM, NULL));
+
+    bench_blockdev_write(dev, mode, sectors);
+}
+
+// The same shuffled 4 KiB reads covering 256 KiB, once straight to the
+// driver and once submitted to the plugged request queue, which sorts and
+// merges them into a few large commands
+static void bench_blockdev_queued(blockdev_t* dev) {
+    static struct block_request requests[DISK_BENCH_QUEUED];
+    uint8_t order[DISK_BENCH_QUEUED];
+    bench_timer_t timer;
+
+    if (dev->sectors < DISK_BENCH_CHUNK)
+        return;
+
+    // Fisher-Yates with a fixed seed
+    uint32_t seed = 54321;
+    for (uint32_t i = 0; i < DISK_BENCH_QUEUED; i++)
+        order[i] = (uint8_t)i;
+    for (uint32_t i = DISK_BENCH_QUEUED - 1; i > 0; i--) {
+        seed = seed * 1103515245 + 12345;
+        uint32_t j = (seed >> 8) % (i + 1);
+        uint8_t t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+
+    bench_start(&timer);
+    for (uint32_t i = 0; i < DISK_BENCH_QUEUED; i++) {
+        uint32_t block = order[i];
+        if (!blockdev_read(dev, block * DISK_BENCH_BLOCK, DISK_BENCH_BLOCK,
+                           buffer + block * DISK_BENCH_BLOCK * BLOCKDEV_SECTOR_SIZE)) {
+            printf("%s: read error at sector %lu\n", dev->name, block * DISK_BENCH_BLOCK);
+            return;
+        }
+    }
+    bench_stop(&timer);
+    printf("%s direct 4 KiB: %lu reads in %lu us\n", dev->name, (uint32_t)DISK_BENCH_QUEUED,
+           (uint32_t)div64_32(timer.cycles * 1000, pit_tsc_per_ms(), NULL));
+
+    block_reset_stats(dev);
+    bench_start(&timer);
+    block_plug(dev);
+    for (uint32_t i = 0; i < DISK_BENCH_QUEUED; i++) {
+        uint32_t block = order[i];
+        block_request_init(&requests[i], dev, false, block * DISK_BENCH_BLOCK, DISK_BENCH_BLOCK,
+                           buffer + block * DISK_BENCH_BLOCK * BLOCKDEV_SECTOR_SIZE, NULL, NULL);
+        block_submit(&requests[i]);
+    }
+    block_unplug(dev);
+    uint32_t failed = 0;
+    for (uint32_t i = 0; i < DISK_BENCH_QUEUED; i++) {
+        if (!block_wait(&requests[i]))
+            failed++;
+    }
+    bench_stop(&timer);
+
+    struct block_queue_stats stats;
+    block_get_stats(dev, &stats);
+    printf("%s queued 4 KiB: %lu reads in %lu us, %lu commands, %lu failed\n", dev->name,
+           (uint32_t)DISK_BENCH_QUEUED, (uint32_t)div64_32(timer.cycles * 1000, pit_tsc_per_ms(), NULL),
+           stats.dispatched, failed);
+}
+
+// 256 KiB read in 4 KiB pieces through the buffer cache, first cold, with
+// only read-ahead to help, then again from the cache
+static void bench_blockdev_cached(blockdev_t* dev) {
+    bench_timer_t timer;
+    uint32_t blocks = DISK_BENCH_CHUNK / BCACHE_BLOCK_SECTORS;
+
+    if (dev->sectors < DISK_BENCH_CHUNK || !bcache_invalidate(dev))
+        return;
+
+    for (int pass = 0; pass < 2; pass++) {
+        bcache_reset_stats();
+        bench_start(&timer);
+        for (uint32_t i = 0; i < blocks; i++) {
+            if (!bcache_read(dev, i * BCACHE_BLOCK_SECTORS, BCACHE_BLOCK_SECTORS,
+                             buffer + i * BCACHE_BLOCK_SIZE)) {
+                printf("%s: read error at sector %lu\n", dev->name, i * BCACHE_BLOCK_SECTORS);
+                return;
+            }
+        }
+        bench_stop(&timer);
+
+        struct bcache_stats stats;
+        bcache_get_stats(&stats);
+        printf("%s cached 4 KiB %s: %lu reads in %lu us, %lu hits, %lu read ahead\n", dev->name,
+               pass == 0 ? "cold" : "warm", blocks, (uint32_t)div64_32(timer.cycles * 1000, pit_tsc_per_ms(), NULL),
+               stats.hits, stats.readahead);
+    }
+    bcache_invalidate(dev);
+}
+
+// Every disk through its driver's normal path, the block layer and the cache,
+// then the ATA disks again with DMA off to see what bus mastering buys,
+// and the virtio disks with completion polling instead of interrupts
+void bench_disk() {
+    if (blockdev_count() == 0) {
+        printf("disk: no block devices\n");
+        return;
+    }
+
+    ata_reset_stats();
+    virtio_blk_reset_stats();
+    for (uint32_t i = 0; i < blockdev_count(); i++)
+        bench_blockdev(blockdev_get(i), "");
+    for (uint32_t i = 0; i < blockdev_count(); i++)
+        bench_blockdev_queued(blockdev_get(i));
+    for (uint32_t i = 0; i < blockdev_count(); i++)
+        bench_blockdev_cached(blockdev_get(i));
+
+    if (ata_dma_available()) {
+        ata_set_dma(false);
+        for (uint32_t i = 0; i < blockdev_count(); i++) {
+            blockdev_t* dev = blockdev_get(i);
+            if (dev->name[0] == 'h' && dev->name[1] == 'd')
+                bench_blockdev(dev, "PIO");
+        }
+        ata_set_dma(true);
+    }
+
+    struct virtio_blk_stats virtio;
+    virtio_blk_get_stats(&virtio);
+    uint32_t interrupts = virtio.interrupts;
+    virtio_blk_set_polling(true);
+    for (uint32_t i = 0; i < blockdev_count(); i++) {
+        blockdev_t* dev = blockdev_get(i);
+        if (dev->name[0] == 'v' && dev->name[1] == 'd')
+            bench_blockdev(dev, "polled");
+    }
+    virtio_blk_set_polling(false);
+
+    struct ata_stats stats;
+    ata_get_stats(&stats);
+    printf("ata: %lu DMA and %lu PIO commands, %lu interrupts, %lu errors, %lu timeouts\n",
+           stats.dma_transfers, stats.pio_transfers, stats.interrupts, stats.errors, stats.timeouts);
+
+    virtio_blk_get_stats(&virtio);
+    if (virtio.requests > 0) {
+        printf("virtio-blk: %lu requests, %lu notifications, %lu interrupts (%lu while polling), %lu errors, %lu timeouts\n",
+               virtio.requests, virtio.kicks, virtio.interrupts, virtio.interrupts - interrupts, virtio.errors, virtio.timeouts);
+    }
+}
@@ -0,0 +1,35 @@
+#include "bench/bench.h"
+
+#define FORMAT_ITERATIONS 100000
+
+// Formatting throughput of snprintf, without any console output involved
+void bench_format() {
+    char buffer[128];
+    bench_timer_t timer;
+    uint32_t bytes = 0;
+
+    bench_start(&timer);
+    for (uint32_t i = 0; i < FORMAT_ITERATIONS; i++) {
+        bytes += snprintf(buffer, sizeof(buffer), "%d %s", (int)i, "note");
+    }
+    bench_stop(&timer);
+    bench_report("snprintf short", &timer, FORMAT_ITERATIONS, "calls");
+
+    bench_start(&timer);
+    for (uint32_t i = 0; i < FORMAT_ITERATIONS; i++) {
+        bytes += snprintf(buffer, sizeof(buffer), "[%5lu] %08lx %-10s %p %d",
+                          i, i * 2654435761u, "padded", &timer, -(int)i);
+    }
+    bench_stop(&timer);
+    bench_report("snprintf mixed", &timer, FORMAT_ITERATIONS, "calls");
+
+    bench_start(&timer);
+    for (uint32_t i = 0; i < FORMAT_ITERATIONS; i++) {
+        bytes += snprintf(buffer, sizeof(buffer), "%llu %llx",
+                          (uint64_t)i * 1000000007ull, (uint64_t)i << 40);
+    }
+    bench_stop(&timer);
+    bench_report("snprintf 64-bit", &timer, FORMAT_ITERATIONS, "calls");
+
+    printf("snprintf produced %lu bytes\n", bytes);
+}
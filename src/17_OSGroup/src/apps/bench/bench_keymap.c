@@ -0,0 +1,30 @@
+#include "bench/bench.h"
+#include "keymap.h"
+
+#define KEYMAP_ITERATIONS 2000
+
+// "Hello, World" typed with shift, as make and break codes
+static const uint8_t typing[] = {
+    0x2A, 0x23, 0xA3, 0xAA, 0x12, 0x92, 0x26, 0xA6, 0x26, 0xA6, 0x18, 0x98,
+    0x33, 0xB3, 0x39, 0xB9, 0x2A, 0x11, 0x91, 0xAA, 0x18, 0x98, 0x13, 0x93,
+    0x26, 0xA6, 0x20, 0xA0, 0x1C, 0x9C,
+};
+
+// Cost of turning one set 1 scancode into a key event with a character
+void bench_keymap() {
+    struct keymap_state state = {0};
+    key_event_t event;
+    uint32_t characters = 0;
+    bench_timer_t timer;
+
+    bench_start(&timer);
+    for (uint32_t i = 0; i < KEYMAP_ITERATIONS; i++) {
+        for (uint32_t j = 0; j < sizeof(typing); j++) {
+            keymap_decode_set1(&state, typing[j], 0, &event);
+            characters += event.ascii != 0;
+        }
+    }
+    bench_stop(&timer);
+    bench_report("keymap decode", &timer, KEYMAP_ITERATIONS * sizeof(typing), "events");
+    printf("keymap decode produced %lu characters\n", characters);
+}
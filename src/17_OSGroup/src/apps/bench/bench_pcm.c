@@ -0,0 +1,63 @@
+#include "bench/bench.h"
+#include "drivers/pcspeaker.h"
+#include "idle.h"
+#include "pit.h"
+
+#define PCM_BENCH_MS 1000
+
+// Endless 440 Hz square wave, cheap to produce so the measurements are
+// about the output path
+static uint32_t tone_read(audio_source_t* source, uint8_t* samples, uint32_t count) {
+    uint32_t* phase = source->ctx;
+    for (uint32_t i = 0; i < count; i++) {
+        samples[i] = (*phase & 0x80000000) ? AUDIO_SILENCE - 32 : AUDIO_SILENCE + 32;
+        *phase += (uint32_t)(((uint64_t)440 << 32) / PCSPK_PCM_RATE);
+    }
+    return count;
+}
+
+static void report_pcm(const char* name, uint32_t ms) {
+    struct pcspk_pcm_stats stats;
+    pcspk_pcm_get_stats(&stats);
+    uint32_t seconds_ms = ms ? ms : 1;
+    printf("%s: %lu samples played, %lu dropped (%lu/s), longest sample IRQ %lu cycles\n",
+           name, stats.played, stats.dropped, stats.dropped * 1000 / seconds_ms, stats.max_isr_cycles);
+}
+
+// Samples dropped per second while the kernel idles, and while it is kept
+// busy without calling idle(), which is when the blocks run dry
+void bench_pcm() {
+    uint32_t phase = 0;
+    audio_source_t tone = { tone_read, &phase };
+    if (!pcspk_pcm_start(&tone)) {
+        printf("pcm: playback already running\n");
+        return;
+    }
+
+    // Idle: the blocks are refilled whenever the CPU would halt
+    pcspk_pcm_reset_stats();
+    uint32_t start = pit_get_ticks();
+    while (pit_get_ticks() - start < PCM_BENCH_MS)
+        idle();
+    report_pcm("pcm idle", pit_get_ticks() - start);
+
+    // Busy: spin without giving the pump a chance
+    pcspk_pcm_reset_stats();
+    start = pit_get_ticks();
+    volatile uint32_t work = 0;
+    while (pit_get_ticks() - start < PCM_BENCH_MS)
+        work++;
+    report_pcm("pcm busy", pit_get_ticks() - start);
+
+    // Busy, but pumping every so often
+    pcspk_pcm_reset_stats();
+    start = pit_get_ticks();
+    while (pit_get_ticks() - start < PCM_BENCH_MS) {
+        for (uint32_t i = 0; i < 10000; i++)
+            work++;
+        pcspk_pcm_pump();
+    }
+    report_pcm("pcm busy+pump", pit_get_ticks() - start);
+
+    pcspk_pcm_stop();
+}
@@ -0,0 +1,57 @@
+#include "bench/bench.h"
+#include "drivers/sb16.h"
+#include "idle.h"
+#include "pit.h"
+
+#define SB16_BENCH_MS 2000
+
+// Endless 440 Hz square wave, cheap to produce so the measurements are
+// about the output path
+static uint32_t tone_read(audio_source_t* source, uint8_t* samples, uint32_t count) {
+    uint32_t* phase = source->ctx;
+    for (uint32_t i = 0; i < count; i++) {
+        samples[i] = (*phase & 0x80000000) ? AUDIO_SILENCE - 32 : AUDIO_SILENCE + 32;
+        *phase += (uint32_t)(((uint64_t)440 << 32) / SB16_RATE);
+    }
+    return count;
+}
+
+static void report_sb16(const char* name, uint32_t ms) {
+    struct sb16_stats stats;
+    sb16_get_stats(&stats);
+    if (ms == 0)
+        ms = 1;
+    printf("%s: %lu interrupts (%lu/s), %lu underruns, longest IRQ %lu cycles\n",
+           name, stats.interrupts, stats.interrupts * 1000 / ms, stats.underruns, stats.max_isr_cycles);
+}
+
+// Interrupt rate and underruns while the kernel idles, and while it is
+// kept busy without calling idle()
+void bench_sb16() {
+    if (!sb16_present()) {
+        printf("sb16: no card\n");
+        return;
+    }
+
+    uint32_t phase = 0;
+    audio_source_t tone = { tone_read, &phase };
+    if (!sb16_start(&tone)) {
+        printf("sb16: playback already running\n");
+        return;
+    }
+
+    sb16_reset_stats();
+    uint32_t start = pit_get_ticks();
+    while (pit_get_ticks() - start < SB16_BENCH_MS)
+        idle();
+    report_sb16("sb16 idle", pit_get_ticks() - start);
+
+    sb16_reset_stats();
+    start = pit_get_ticks();
+    volatile uint32_t work = 0;
+    while (pit_get_ticks() - start < SB16_BENCH_MS)
+        work++;
+    report_sb16("sb16 busy", pit_get_ticks() - start);
+
+    sb16_stop();
+}
@@ -0,0 +1,23 @@
+#include "bench/bench.h"
+#include "song/library.h"
+
+#define SONG_BENCH_ROUNDS 100
+
+// Cost of pulling notes out of the library, which for encoded songs is
+// the cost of the streaming decoder
+void bench_song() {
+    uint32_t notes = 0;
+    bench_timer_t timer;
+    bench_start(&timer);
+    for (uint32_t round = 0; round < SONG_BENCH_ROUNDS; round++) {
+        for (uint32_t i = 0; i < song_library_count(); i++) {
+            song_cursor_t cursor;
+            Note note;
+            song_cursor_init(&cursor, song_library_get(i));
+            while (song_cursor_next(&cursor, &note))
+                notes++;
+        }
+    }
+    bench_stop(&timer);
+    bench_report("song decode", &timer, notes, "notes");
+}
@@ -0,0 +1,41 @@
+#include "bench/bench.h"
+#include "song/synth.h"
+#include "drivers/pcspeaker.h"
+
+#define SYNTH_BENCH_BLOCK   1024
+#define SYNTH_BENCH_BLOCKS  36      // About two seconds of audio
+#define SYNTH_BENCH_SAMPLES (SYNTH_BENCH_BLOCK * SYNTH_BENCH_BLOCKS)
+
+static struct synth bench_synth_state;
+static uint8_t bench_synth_block[SYNTH_BENCH_BLOCK];
+
+// Render held notes of the given waveform on that many voices and report
+// how many voices one millisecond of CPU mixes at the PC speaker rate
+static void bench_synth_voices(const char* name, uint32_t voices, synth_waveform_t waveform) {
+    struct synth* synth = &bench_synth_state;
+    synth_init(synth, PCSPK_PCM_RATE);
+    for (uint32_t i = 0; i < voices; i++)
+        synth_note_on(synth, 220 + 110 * i, SYNTH_VELOCITY_MAX, waveform, 0);
+
+    bench_timer_t timer;
+    bench_start(&timer);
+    for (uint32_t i = 0; i < SYNTH_BENCH_BLOCKS; i++)
+        synth_render(synth, bench_synth_block, SYNTH_BENCH_BLOCK);
+    bench_stop(&timer);
+
+    uint32_t voice_samples = voices * SYNTH_BENCH_SAMPLES;
+    bench_report(name, &timer, voice_samples, "voice-samples");
+
+    // Mixing one voice for a millisecond of audio is a voice-ms, and the
+    // voice-ms mixed per ms of CPU is how many voices could play in real time
+    uint32_t voice_ms = voices * (SYNTH_BENCH_SAMPLES * 1000 / PCSPK_PCM_RATE);
+    uint32_t ms = timer.ms ? timer.ms : 1;
+    printf("%s: %lu voices mixed per ms of CPU\n", name, voice_ms / ms);
+}
+
+void bench_synth() {
+    bench_synth_voices("synth 1 square", 1, SYNTH_SQUARE);
+    bench_synth_voices("synth 8 square", 8, SYNTH_SQUARE);
+    bench_synth_voices("synth 8 triangle", 8, SYNTH_TRIANGLE);
+    bench_synth_voices("synth 8 noise", 8, SYNTH_NOISE);
+}
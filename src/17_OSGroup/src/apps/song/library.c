@@ -0,0 +1,76 @@
+#include "song/library.h"
+#include "song/song_format.h"
+#include "song/midi.h"
+#include "bootinfo.h"
+
+struct library_entry {
+    const char* name;
+    Song song;
+    union {
+        struct song_decoder decoder;
+        struct midi_file midi;
+    };
+};
+
+static struct library_entry library[SONG_LIBRARY_MAX];
+static uint32_t library_count = 0;
+
+bool song_library_add(const char* name, const void* data, uint32_t size) {
+    if (library_count == SONG_LIBRARY_MAX)
+        return false;
+
+    struct library_entry* entry = &library[library_count];
+    bool loaded;
+    if (midi_detect(data, size))
+        loaded = midi_init(&entry->midi, data, size, &entry->song);
+    else
+        loaded = song_decoder_init(&entry->decoder, data, size, &entry->song);
+    if (!loaded)
+        return false;
+    entry->song.duration = song_measure(&entry->song);
+    entry->name = name;
+    library_count++;
+    return true;
+}
+
+void init_song_library() {
+    uint32_t notes = 0;
+    uint32_t bytes = 0;
+    for (uint32_t i = 0; i < builtin_song_count; i++) {
+        if (song_library_add(builtin_songs[i].name, builtin_songs[i].data, builtin_songs[i].size)) {
+            notes += library[library_count - 1].song.length;
+            bytes += builtin_songs[i].size;
+        }
+    }
+    uint32_t builtin = library_count;
+
+    // Boot modules that hold an encoded song or a Standard MIDI File,
+    // named by their command line
+    uint32_t midi_files = 0;
+    struct multiboot_tag* tag = NULL;
+    while ((tag = bootinfo_find_tag(MULTIBOOT_TAG_TYPE_MODULE, tag)) != NULL) {
+        struct multiboot_tag_module* module = (struct multiboot_tag_module*)tag;
+        const void* data = (const void*)module->mod_start;
+        uint32_t size = module->mod_end - module->mod_start;
+        if (!song_format_detect(data, size) && !midi_detect(data, size))
+            continue;
+        if (song_library_add(module->cmdline[0] != '\0' ? module->cmdline : "module", data, size) &&
+            midi_detect(data, size))
+            midi_files++;
+    }
+
+    printf("Songs: %lu built in (%lu notes in %lu bytes, %lu as Note arrays), %lu from boot modules (%lu MIDI)\n",
+           builtin, notes, bytes, notes * (uint32_t)sizeof(Note), library_count - builtin, midi_files);
+}
+
+uint32_t song_library_count() {
+    return library_count;
+}
+
+Song* song_library_get(uint32_t index) {
+    return index < library_count ? &library[index].song : NULL;
+}
+
+const char* song_library_name(uint32_t index) {
+    return index < library_count ? library[index].name : NULL;
+}
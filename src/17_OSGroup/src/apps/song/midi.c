@@ -0,0 +1,344 @@
+#include "song/midi.h"
+#include "song/song_format.h"
+#include "memory/memory.h"
+#include "common.h"
+#include "pit.h"
+
+#define MIDI_HEADER_SIZE  14
+#define MIDI_CHUNK_HEADER 8
+
+// Status bytes
+#define MIDI_NOTE_OFF     0x80
+#define MIDI_NOTE_ON      0x90
+#define MIDI_PROGRAM      0xC0
+#define MIDI_PRESSURE     0xD0
+#define MIDI_SYSEX        0xF0
+#define MIDI_SYSEX_ESCAPE 0xF7
+#define MIDI_META         0xFF
+
+// Meta events
+#define MIDI_META_END_OF_TRACK 0x2F
+#define MIDI_META_TEMPO        0x51
+
+// MIDI key of C0, the first note of the frequencies.h table
+#define MIDI_KEY_C0 12
+
+#define MICROSECONDS_PER_PIT_TICK (1000000 / TARGET_FREQUENCY)
+
+static uint32_t read_be32(const uint8_t* data) {
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+}
+
+static uint16_t read_be16(const uint8_t* data) {
+    return (uint16_t)((data[0] << 8) | data[1]);
+}
+
+_Static_assert(sizeof(struct midi_state) <= SONG_STREAM_STATE_SIZE, "MIDI state does not fit a cursor");
+
+// Variable-length quantity: 7 bits per byte, high bits first, at most 4
+// bytes. Running off the end of the track ends it.
+static uint32_t track_read_vlq(const struct midi_track* track, struct midi_track_state* state) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        if (state->position >= track->size) {
+            state->done = true;
+            return 0;
+        }
+        uint8_t byte = track->data[state->position++];
+        value = (value << 7) | (byte & 0x7F);
+        if (!(byte & 0x80))
+            return value;
+    }
+    state->done = true;
+    return 0;
+}
+
+static uint8_t track_read_byte(const struct midi_track* track, struct midi_track_state* state) {
+    if (state->position >= track->size) {
+        state->done = true;
+        return 0;
+    }
+    return track->data[state->position++];
+}
+
+// Read the delta time in front of the next event
+static void track_advance(const struct midi_track* track, struct midi_track_state* state) {
+    uint32_t delta = track_read_vlq(track, state);
+    if (!state->done)
+        state->time += delta;
+}
+
+// Heap order: earlier events first, lower track numbers first at the same
+// time so a type 1 file's tempo track goes ahead of the notes
+static bool heap_before(const struct midi_state* state, uint8_t a, uint8_t b) {
+    if (state->tracks[a].time != state->tracks[b].time)
+        return state->tracks[a].time < state->tracks[b].time;
+    return a < b;
+}
+
+static void heap_sift_down(struct midi_state* state, uint32_t i) {
+    for (;;) {
+        uint32_t smallest = i;
+        uint32_t left = 2 * i + 1;
+        uint32_t right = left + 1;
+        if (left < state->heap_size && heap_before(state, state->heap[left], state->heap[smallest]))
+            smallest = left;
+        if (right < state->heap_size && heap_before(state, state->heap[right], state->heap[smallest]))
+            smallest = right;
+        if (smallest == i)
+            return;
+        uint8_t swap = state->heap[i];
+        state->heap[i] = state->heap[smallest];
+        state->heap[smallest] = swap;
+        i = smallest;
+    }
+}
+
+// Bring the PIT clock up to the given file time with the tempo in force.
+// The remainder is carried along so long files do not drift.
+static void midi_advance_time(const struct midi_file* midi, struct midi_state* state, uint32_t time) {
+    uint64_t total = (uint64_t)(time - state->file_time) * state->tempo + state->remainder;
+    uint32_t remainder;
+    state->pit_time += (uint32_t)div64_32(total, midi->unit, &remainder);
+    state->remainder = remainder;
+    state->file_time = time;
+}
+
+static void midi_key_down(struct midi_state* state, uint8_t key) {
+    if (state->held[key]++ == 0)
+        state->held_mask[key >> 5] |= 1UL << (key & 31);
+}
+
+static void midi_key_up(struct midi_state* state, uint8_t key) {
+    if (state->held[key] == 0)
+        return;
+    if (--state->held[key] == 0)
+        state->held_mask[key >> 5] &= ~(1UL << (key & 31));
+}
+
+// The highest key held down, -1 if none
+static int midi_top_key(const struct midi_state* state) {
+    for (int word = 3; word >= 0; word--) {
+        if (state->held_mask[word] != 0)
+            return word * 32 + 31 - __builtin_clz(state->held_mask[word]);
+    }
+    return -1;
+}
+
+// Handle the event at the front of track number index
+static void midi_track_event(const struct midi_file* midi, struct midi_state* state, uint32_t index) {
+    const struct midi_track* track = &midi->tracks[index];
+    struct midi_track_state* position = &state->tracks[index];
+    uint8_t status = track_read_byte(track, position);
+    if (status < 0x80) {
+        // Running status, the byte was the first data byte
+        if (position->status == 0) {
+            position->done = true;
+            return;
+        }
+        position->position--;
+        status = position->status;
+    }
+
+    if (status == MIDI_META) {
+        position->status = 0;
+        uint8_t type = track_read_byte(track, position);
+        uint32_t length = track_read_vlq(track, position);
+        if (position->done || length > track->size - position->position) {
+            position->done = true;
+            return;
+        }
+        const uint8_t* data = track->data + position->position;
+        position->position += length;
+
+        if (type == MIDI_META_END_OF_TRACK)
+            position->done = true;
+        else if (type == MIDI_META_TEMPO && length >= 3 && !midi->smpte)
+            state->tempo = ((uint32_t)data[0] << 16) | ((uint32_t)data[1] << 8) | data[2];
+        return;
+    }
+
+    if (status == MIDI_SYSEX || status == MIDI_SYSEX_ESCAPE) {
+        position->status = 0;
+        uint32_t length = track_read_vlq(track, position);
+        if (position->done || length > track->size - position->position)
+            position->done = true;
+        else
+            position->position += length;
+        return;
+    }
+
+    if (status >= MIDI_SYSEX) {
+        // System common and real-time messages do not belong in a file
+        position->done = true;
+        return;
+    }
+
+    position->status = status;
+    uint8_t kind = status & 0xF0;
+    uint8_t channel = status & 0x0F;
+    uint8_t key = track_read_byte(track, position) & 0x7F;
+    if (kind == MIDI_PROGRAM || kind == MIDI_PRESSURE)
+        return;
+    uint8_t velocity = track_read_byte(track, position) & 0x7F;
+    if (position->done || channel == MIDI_DRUM_CHANNEL)
+        return;
+
+    if (kind == MIDI_NOTE_ON && velocity != 0)
+        midi_key_down(state, key);
+    else if (kind == MIDI_NOTE_OFF || kind == MIDI_NOTE_ON)
+        midi_key_up(state, key);
+}
+
+static void midi_output(int key, uint32_t ticks, Note* note) {
+    note->frequency = key < MIDI_KEY_C0 ? R : song_note_frequency(key - MIDI_KEY_C0);
+    note->duration = ticks / TICKS_PER_MS;
+}
+
+// Run through events in time order until the melody changes, and produce
+// whatever played up to that point
+static bool midi_next(const note_stream_t* stream, void* cursor_state, Note* note) {
+    const struct midi_file* midi = stream->ctx;
+    struct midi_state* state = cursor_state;
+
+    while (state->heap_size > 0) {
+        uint8_t index = state->heap[0];
+        struct midi_track_state* track = &state->tracks[index];
+        midi_advance_time(midi, state, track->time);
+        midi_track_event(midi, state, index);
+        if (!track->done)
+            track_advance(&midi->tracks[index], track);
+        if (track->done)
+            state->heap[0] = state->heap[--state->heap_size];
+        heap_sift_down(state, 0);
+
+        int key = midi_top_key(state);
+        if (key == state->sounding)
+            continue;
+
+        int previous = state->sounding;
+        uint32_t ticks = state->pit_time - state->segment_start;
+        state->sounding = key;
+        state->segment_start = state->pit_time;
+        if (ticks / TICKS_PER_MS > 0) {
+            midi_output(previous, ticks, note);
+            return true;
+        }
+    }
+
+    // A note still held when the last track ended
+    if (state->sounding >= 0) {
+        uint32_t ticks = state->pit_time - state->segment_start;
+        int previous = state->sounding;
+        state->sounding = -1;
+        if (ticks / TICKS_PER_MS > 0) {
+            midi_output(previous, ticks, note);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void midi_rewind(const note_stream_t* stream, void* cursor_state) {
+    const struct midi_file* midi = stream->ctx;
+    struct midi_state* state = cursor_state;
+
+    state->heap_size = 0;
+    for (uint32_t i = 0; i < midi->track_count; i++) {
+        struct midi_track_state* track = &state->tracks[i];
+        track->position = 0;
+        track->time = 0;
+        track->status = 0;
+        track->done = false;
+        track_advance(&midi->tracks[i], track);
+        if (!track->done)
+            state->heap[state->heap_size++] = (uint8_t)i;
+    }
+    for (uint32_t i = state->heap_size / 2; i-- > 0;)
+        heap_sift_down(state, i);
+
+    // SMPTE files keep a fixed "tempo", see midi_init
+    state->tempo = midi->smpte ? 1000000 : MIDI_DEFAULT_TEMPO;
+    state->file_time = 0;
+    state->pit_time = 0;
+    state->remainder = 0;
+    memset(state->held, 0, sizeof(state->held));
+    memset(state->held_mask, 0, sizeof(state->held_mask));
+    state->sounding = -1;
+    state->segment_start = 0;
+}
+
+bool midi_detect(const void* data, uint32_t size) {
+    return size >= MIDI_HEADER_SIZE && memcmp(data, "MThd", 4) == 0;
+}
+
+bool midi_init(struct midi_file* midi, const void* data, uint32_t size, Song* song) {
+    const uint8_t* bytes = data;
+    if (!midi_detect(data, size) || read_be32(bytes + 4) < 6)
+        return false;
+
+    memset(midi, 0, sizeof(*midi));
+    midi->format = read_be16(bytes + 8);
+    uint16_t tracks = read_be16(bytes + 10);
+    midi->division = read_be16(bytes + 12);
+
+    // Type 2 files hold independent sequences, not one piece of music
+    if (midi->format > 1 || tracks == 0 || midi->division == 0)
+        return false;
+
+    if (midi->division & 0x8000) {
+        // SMPTE: frames per second (negated) and ticks per frame. Time is
+        // kept as if every "quarter note" were a second long. 29.97 fps
+        // drop-frame counts as 30.
+        int8_t frames = (int8_t)(midi->division >> 8);
+        uint32_t fps = frames == -29 ? 30 : (uint32_t)-frames;
+        uint32_t resolution = midi->division & 0xFF;
+        if (fps == 0 || resolution == 0)
+            return false;
+        midi->smpte = true;
+        midi->unit = fps * resolution * MICROSECONDS_PER_PIT_TICK;
+    } else {
+        midi->unit = (uint32_t)midi->division * MICROSECONDS_PER_PIT_TICK;
+    }
+
+    // Find the track chunks, skipping any chunk type we do not know. The
+    // lengths come from the file, so every sum is checked against size
+    // before it is made.
+    uint32_t header_length = read_be32(bytes + 4);
+    if (header_length > size - MIDI_CHUNK_HEADER)
+        return false;
+    uint32_t position = MIDI_CHUNK_HEADER + header_length;
+    while (position <= size - MIDI_CHUNK_HEADER && midi->track_count < tracks &&
+           midi->track_count < MIDI_MAX_TRACKS) {
+        uint32_t length = read_be32(bytes + position + 4);
+        uint32_t start = position + MIDI_CHUNK_HEADER;
+        if (length > size - start)
+            length = size - start;      // Truncated file, play what is there
+        if (memcmp(bytes + position, "MTrk", 4) == 0) {
+            midi->tracks[midi->track_count].data = bytes + start;
+            midi->tracks[midi->track_count].size = length;
+            midi->track_count++;
+        }
+        position = start + length;
+    }
+    if (midi->track_count == 0)
+        return false;
+
+    midi->stream.next = midi_next;
+    midi->stream.rewind = midi_rewind;
+    midi->stream.ctx = midi;
+
+    // Play the file through once to count its notes
+    static struct midi_state state;
+    uint32_t count = 0;
+    Note note;
+    midi_rewind(&midi->stream, &state);
+    while (midi_next(&midi->stream, &state, &note))
+        count++;
+
+    song->notes = NULL;
+    song->length = count;
+    song->duration = 0;
+    song->stream = &midi->stream;
+    return count > 0;
+}
@@ -0,0 +1,183 @@
+#include "song/sequencer.h"
+#include "interrupts.h"
+#include "common.h"
+#include "pit.h"
+#include "klog.h"
+
+// Songs waiting to be played
+static Song* queue[SEQUENCER_QUEUE_SIZE];
+static uint32_t queue_head = 0;
+static uint32_t queue_tail = 0;
+
+// The song being played, NULL when the sequencer is idle
+static Song* current = NULL;
+static uint32_t song_length = 0;    // Ticks
+static bool paused = false;
+
+static song_cursor_t cursor;        // Where the notes come from
+static Note note;                   // Note being played
+static uint32_t note_start = 0;     // Position the note started at
+static uint32_t position = 0;       // Ticks into the song
+
+static uint32_t note_ticks(const Note* note) {
+    return note->duration * TICKS_PER_MS;
+}
+
+// Sound the current note, or silence for a rest
+static void sequencer_sound_note() {
+    if (note.frequency == R) {
+        stop_sound();
+    } else {
+        play_sound(note.frequency);
+    }
+    klog(KLOG_DEBUG, "Note: %lu, Freq=%lu, Sleep=%lu\n", cursor.index - 1, note.frequency, note.duration);
+}
+
+// Go back to the first note of the current song
+static bool sequencer_rewind() {
+    song_cursor_init(&cursor, current);
+    note_start = 0;
+    return song_cursor_next(&cursor, &note);
+}
+
+// Take the next song off the queue, or go idle. Interrupts must be off.
+static void sequencer_start_next() {
+    stop_sound();
+    current = NULL;
+
+    // Skip empty songs, they have nothing to play
+    while (queue_tail != queue_head && current == NULL) {
+        Song* song = queue[queue_tail % SEQUENCER_QUEUE_SIZE];
+        queue_tail++;
+        if (song->length == 0)
+            continue;
+        current = song;
+        song_length = current->duration * TICKS_PER_MS;
+        if (!sequencer_rewind())
+            current = NULL;
+    }
+
+    if (current == NULL) {
+        disable_speaker();
+        return;
+    }
+
+    position = 0;
+    enable_speaker();
+    if (!paused)
+        sequencer_sound_note();
+}
+
+// Called on every PIT tick
+static int sequencer_tick(registers_t* regs, void* context) {
+    if (current == NULL || paused)
+        return IRQ_NONE;
+
+    position++;
+
+    // Zero-length notes are skipped over in the same tick
+    while (position - note_start >= note_ticks(&note)) {
+        note_start += note_ticks(&note);
+        if (!song_cursor_next(&cursor, &note)) {
+            sequencer_start_next();
+            return IRQ_NONE;
+        }
+        sequencer_sound_note();
+    }
+
+    // Shares IRQ0 with the PIT handler, which claims the interrupt
+    return IRQ_NONE;
+}
+
+void init_sequencer() {
+    register_irq_handler(IRQ0, sequencer_tick, NULL);
+}
+
+bool sequencer_queue(Song* song) {
+    uint32_t flags = interrupts_save();
+    bool queued = queue_head - queue_tail < SEQUENCER_QUEUE_SIZE;
+    if (queued) {
+        queue[queue_head % SEQUENCER_QUEUE_SIZE] = song;
+        queue_head++;
+        if (current == NULL)
+            sequencer_start_next();
+    }
+    interrupts_restore(flags);
+    return queued;
+}
+
+void sequencer_stop() {
+    uint32_t flags = interrupts_save();
+    queue_tail = queue_head;
+    paused = false;
+    sequencer_start_next();
+    interrupts_restore(flags);
+}
+
+void sequencer_pause() {
+    uint32_t flags = interrupts_save();
+    if (current != NULL && !paused) {
+        paused = true;
+        stop_sound();
+    }
+    interrupts_restore(flags);
+}
+
+void sequencer_resume() {
+    uint32_t flags = interrupts_save();
+    if (paused) {
+        paused = false;
+        if (current != NULL)
+            sequencer_sound_note();
+    }
+    interrupts_restore(flags);
+}
+
+void sequencer_next() {
+    uint32_t flags = interrupts_save();
+    if (current != NULL)
+        sequencer_start_next();
+    interrupts_restore(flags);
+}
+
+bool sequencer_seek(uint32_t target) {
+    uint32_t flags = interrupts_save();
+    if (current == NULL || target >= song_length) {
+        interrupts_restore(flags);
+        return false;
+    }
+
+    // Find the note that is playing at the target position
+    sequencer_rewind();
+    while (note_start + note_ticks(&note) <= target) {
+        note_start += note_ticks(&note);
+        if (!song_cursor_next(&cursor, &note))
+            break;
+    }
+    position = target;
+    if (!paused)
+        sequencer_sound_note();
+
+    interrupts_restore(flags);
+    return true;
+}
+
+uint32_t sequencer_position() {
+    return current != NULL ? position : 0;
+}
+
+uint32_t sequencer_length() {
+    return current != NULL ? song_length : 0;
+}
+
+bool sequencer_is_playing() {
+    return current != NULL && !paused;
+}
+
+bool sequencer_is_paused() {
+    return current != NULL && paused;
+}
+
+uint32_t sequencer_queued() {
+    return queue_head - queue_tail;
+}
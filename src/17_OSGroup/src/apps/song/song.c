@@ -2,6 +2,7 @@
 #include "pit.h"
 #include "common.h"
 #include "libc/stdio.h"
+#include "klog.h"
 
 // Function to enable the PC speaker
 void enable_speaker(){
@@ -62,15 +63,49 @@ void stop_sound(){
     outb(PC_SPEAKER_PORT, speaker_state & ~0x03);
 }
 
+void song_cursor_init(song_cursor_t* cursor, const Song* song) {
+    cursor->song = song;
+    cursor->index = 0;
+    if (song->stream != NULL)
+        song->stream->rewind(song->stream, cursor->state);
+}
+
+bool song_cursor_next(song_cursor_t* cursor, Note* note) {
+    const Song* song = cursor->song;
+    if (cursor->index >= song->length)
+        return false;
+
+    if (song->stream != NULL) {
+        if (!song->stream->next(song->stream, cursor->state, note))
+            return false;
+    } else {
+        *note = song->notes[cursor->index];
+    }
+    cursor->index++;
+    return true;
+}
+
+uint32_t song_measure(const Song* song) {
+    song_cursor_t cursor;
+    Note note;
+    uint32_t duration = 0;
+    song_cursor_init(&cursor, song);
+    while (song_cursor_next(&cursor, &note))
+        duration += note.duration;
+    return duration;
+}
+
 // Function to play a song by iterating through its notes
 void play_song_impl(Song *song) {
     // Enable the speaker before starting the song
     enable_speaker();
-    for (uint32_t i = 0; i < song->length; i++) {
-        Note* note = &song->notes[i]; // Get the current note
-        printf("Note: %d, Freq=%d, Sleep=%d\n", i, note->frequency, note->duration);
-        play_sound(note->frequency); // Play the note's frequency
-        sleep_interrupt(note->duration); // Delay for the note's duration
+    song_cursor_t cursor;
+    song_cursor_init(&cursor, song);
+    Note note;
+    while (song_cursor_next(&cursor, &note)) {
+        klog(KLOG_INFO, "Note: %d, Freq=%d, Sleep=%d\n", cursor.index - 1, note.frequency, note.duration);
+        play_sound(note.frequency); // Play the note's frequency
+        sleep_interrupt(note.duration); // Delay for the note's duration
         stop_sound(); // Stop the sound after the note's duration
     }
     // Disable the speaker after finishing the song
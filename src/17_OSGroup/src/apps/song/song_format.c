@@ -0,0 +1,112 @@
+#include "song/song_format.h"
+#include "song/frequencies.h"
+#include "memory/memory.h"
+
+// Every note of frequencies.h in index order
+static const uint16_t note_frequencies[SONG_FORMAT_NOTE_COUNT] = {
+    C0, Cs0, D0, Ds0, E0, F0, Fs0, G0, Gs0, A0, As0, B0,
+    C1, Cs1, D1, Ds1, E1, F1, Fs1, G1, Gs1, A1, As1, B1,
+    C2, Cs2, D2, Ds2, E2, F2, Fs2, G2, Gs2, A2, As2, B2,
+    C3, Cs3, D3, Ds3, E3, F3, Fs3, G3, Gs3, A3, As3, B3,
+    C4, Cs4, D4, Ds4, E4, F4, Fs4, G4, Gs4, A4, As4, B4,
+    C5, Cs5, D5, Ds5, E5, F5, Fs5, G5, Gs5, A5, As5, B5,
+    C6, Cs6, D6, Ds6, E6, F6, Fs6, G6, Gs6, A6, As6, B6,
+    C7, Cs7, D7, Ds7, E7, F7, Fs7, G7, Gs7, A7, As7, B7,
+    C8, Cs8, D8, Ds8, E8, F8, Fs8, G8, Gs8, A8, As8, B8,
+    C9, Cs9, D9, Ds9, E9, F9, Fs9, G9, Gs9, A9, As9, B9,
+};
+
+uint32_t song_note_frequency(uint32_t index) {
+    return index < SONG_FORMAT_NOTE_COUNT ? note_frequencies[index] : 0;
+}
+
+_Static_assert(sizeof(struct song_decoder_state) <= SONG_STREAM_STATE_SIZE, "decoder state does not fit a cursor");
+
+// Read a varint, flags the state as broken if it runs off the end or
+// does not fit in 32 bits
+static uint32_t read_varint(const struct song_decoder* decoder, struct song_decoder_state* state) {
+    uint32_t value = 0;
+    for (uint32_t shift = 0; shift < 32; shift += 7) {
+        if (state->position >= decoder->size)
+            break;
+        uint8_t byte = decoder->data[state->position++];
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+    state->error = true;
+    return 0;
+}
+
+static bool song_decoder_next(const note_stream_t* stream, void* position, Note* note) {
+    const struct song_decoder* decoder = stream->ctx;
+    struct song_decoder_state* state = position;
+    if (state->error)
+        return false;
+
+    // Still inside a run of rests
+    if (state->rests > 0) {
+        state->rests--;
+        note->frequency = R;
+        note->duration = state->duration;
+        return true;
+    }
+
+    uint32_t token = read_varint(decoder, state);
+    uint32_t kind = token & 3;
+    uint32_t argument = token >> 2;
+
+    if (kind == SONG_TOKEN_NOTE || kind == SONG_TOKEN_NOTE_DURATION) {
+        int32_t delta = (argument & 1) ? -(int32_t)(argument >> 1) - 1 : (int32_t)(argument >> 1);
+        state->index += delta;
+        if (state->index >= SONG_FORMAT_NOTE_COUNT)
+            state->error = true;
+        note->frequency = note_frequencies[state->index % SONG_FORMAT_NOTE_COUNT];
+    } else {
+        state->rests = argument;
+        note->frequency = R;
+    }
+
+    if (kind & 1)
+        state->duration = read_varint(decoder, state);
+    note->duration = state->duration;
+    return !state->error;
+}
+
+static void song_decoder_rewind(const note_stream_t* stream, void* position) {
+    const struct song_decoder* decoder = stream->ctx;
+    struct song_decoder_state* state = position;
+    state->position = decoder->body;
+    state->index = SONG_FORMAT_FIRST_INDEX;
+    state->duration = 0;
+    state->rests = 0;
+    state->error = false;
+}
+
+bool song_format_detect(const void* data, uint32_t size) {
+    return size >= SONG_FORMAT_MAGIC_SIZE && memcmp(data, SONG_FORMAT_MAGIC, SONG_FORMAT_MAGIC_SIZE) == 0;
+}
+
+bool song_decoder_init(struct song_decoder* decoder, const void* data, uint32_t size, Song* song) {
+    if (!song_format_detect(data, size))
+        return false;
+
+    decoder->stream.next = song_decoder_next;
+    decoder->stream.rewind = song_decoder_rewind;
+    decoder->stream.ctx = decoder;
+    decoder->data = data;
+    decoder->size = size;
+
+    // The header is read with a state of its own
+    struct song_decoder_state header = { SONG_FORMAT_MAGIC_SIZE, 0, 0, 0, false };
+    decoder->count = read_varint(decoder, &header);
+    if (header.error)
+        return false;
+    decoder->body = header.position;
+
+    song->notes = NULL;
+    song->length = decoder->count;
+    song->duration = 0;
+    song->stream = &decoder->stream;
+    return true;
+}
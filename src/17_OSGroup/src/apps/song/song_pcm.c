@@ -0,0 +1,61 @@
+#include "song/song_pcm.h"
+#include "common.h"
+#include "memory/memory.h"
+
+// Move on to the next note, or past the end of the song
+static void song_pcm_next_note(struct song_pcm* decoder) {
+    Note note;
+    if (!song_cursor_next(&decoder->cursor, &note)) {
+        decoder->done = true;
+        return;
+    }
+
+    decoder->note_samples = (uint32_t)div64_32((uint64_t)note.duration * decoder->sample_rate, 1000, NULL);
+    decoder->phase_step = (uint32_t)div64_32((uint64_t)note.frequency << 32, decoder->sample_rate, NULL);
+}
+
+static uint32_t song_pcm_read(audio_source_t* source, uint8_t* samples, uint32_t count) {
+    struct song_pcm* decoder = source->ctx;
+    uint32_t written = 0;
+
+    while (written < count && !decoder->done) {
+        if (decoder->note_samples == 0) {
+            song_pcm_next_note(decoder);
+            continue;
+        }
+
+        uint32_t run = count - written;
+        if (run > decoder->note_samples)
+            run = decoder->note_samples;
+
+        if (decoder->phase_step == 0) {
+            // A rest
+            memset(samples + written, AUDIO_SILENCE, run);
+        } else {
+            uint32_t phase = decoder->phase;
+            for (uint32_t i = 0; i < run; i++) {
+                samples[written + i] = (phase & 0x80000000) ? AUDIO_SILENCE - SONG_PCM_AMPLITUDE
+                                                            : AUDIO_SILENCE + SONG_PCM_AMPLITUDE;
+                phase += decoder->phase_step;
+            }
+            decoder->phase = phase;
+        }
+
+        written += run;
+        decoder->note_samples -= run;
+    }
+
+    return written;
+}
+
+audio_source_t* song_pcm_init(struct song_pcm* decoder, const Song* song, uint32_t sample_rate) {
+    decoder->source.read = song_pcm_read;
+    decoder->source.ctx = decoder;
+    decoder->sample_rate = sample_rate;
+    decoder->done = false;
+    decoder->phase = 0;
+    decoder->phase_step = 0;
+    decoder->note_samples = 0;
+    song_cursor_init(&decoder->cursor, song);
+    return &decoder->source;
+}
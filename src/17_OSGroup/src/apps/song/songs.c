@@ -0,0 +1,97 @@
+// Generated by scripts/encode_songs.py, do not edit. Regenerate with:
+// scripts/encode_songs.py --c src/apps/song/songs.c songs/battlefield_1942_theme.song songs/starwars_theme.song songs/music_1.song songs/music_6.song songs/music_5.song songs/music_4.song songs/music_3.song songs/music_2.song
+
+#include "song/library.h"
+
+// battlefield_1942_theme: 39 notes, 102 bytes (312 as Note arrays)
+static const uint8_t song_battlefield_1942_theme[] = {
+    0x53, 0x4e, 0x47, 0x31, 0x27, 0x25, 0xf4, 0x03, 0x18, 0x21, 0xac, 0x02,
+    0x29, 0xc8, 0x01, 0x0c, 0x15, 0xac, 0x02, 0x1d, 0xf4, 0x03, 0x21, 0xac,
+    0x02, 0x29, 0xc8, 0x01, 0x0c, 0x15, 0xac, 0x02, 0x1d, 0xf4, 0x03, 0x21,
+    0xac, 0x02, 0x29, 0xc8, 0x01, 0x18, 0x15, 0xac, 0x02, 0x0d, 0xc8, 0x01,
+    0x15, 0xac, 0x02, 0x1d, 0xf4, 0x03, 0x14, 0x18, 0x21, 0xac, 0x02, 0x29,
+    0xc8, 0x01, 0x0c, 0x15, 0xac, 0x02, 0x1d, 0xf4, 0x03, 0x21, 0xac, 0x02,
+    0x29, 0xc8, 0x01, 0x0c, 0x15, 0xac, 0x02, 0x1d, 0xf4, 0x03, 0x21, 0xac,
+    0x02, 0x29, 0xc8, 0x01, 0x18, 0x15, 0xac, 0x02, 0x0d, 0xc8, 0x01, 0x15,
+    0xac, 0x02, 0x1d, 0xf4, 0x03, 0x02,
+};
+
+// starwars_theme: 30 notes, 73 bytes (240 as Note arrays)
+static const uint8_t song_starwars_theme[] = {
+    0x53, 0x4e, 0x47, 0x31, 0x1e, 0x01, 0xf4, 0x03, 0x00, 0x00, 0x1d, 0xf7,
+    0x02, 0x39, 0x7d, 0x15, 0xf4, 0x03, 0x1d, 0xf7, 0x02, 0x39, 0x7d, 0x15,
+    0xe8, 0x07, 0x39, 0xf4, 0x03, 0x00, 0x00, 0x09, 0xf7, 0x02, 0x25, 0x7d,
+    0x25, 0xf4, 0x03, 0x0d, 0xf7, 0x02, 0x39, 0x7d, 0x15, 0xe8, 0x07, 0x61,
+    0xf4, 0x03, 0x5d, 0xf7, 0x02, 0x01, 0x7d, 0x61, 0xf4, 0x03, 0x0d, 0xf7,
+    0x02, 0x0d, 0x7d, 0x04, 0x0c, 0x0d, 0xfa, 0x01, 0x04, 0x0d, 0xf4, 0x03,
+    0x02,
+};
+
+// music_1: 60 notes, 77 bytes (480 as Note arrays)
+static const uint8_t song_music_1[] = {
+    0x53, 0x4e, 0x47, 0x31, 0x3c, 0x39, 0xfa, 0x01, 0x03, 0x7d, 0x00, 0x02,
+    0x00, 0x02, 0x1c, 0x20, 0x18, 0x02, 0x5c, 0x03, 0xfa, 0x01, 0x29, 0x7d,
+    0x03, 0xfa, 0x01, 0x25, 0x7d, 0x02, 0x14, 0x02, 0x28, 0x10, 0x02, 0x04,
+    0x04, 0x02, 0x0c, 0x48, 0x18, 0x10, 0x1c, 0x10, 0x02, 0x14, 0x1c, 0x10,
+    0x14, 0x02, 0x08, 0x03, 0xfa, 0x01, 0x25, 0x7d, 0x02, 0x14, 0x02, 0x28,
+    0x10, 0x02, 0x04, 0x04, 0x02, 0x0c, 0x48, 0x18, 0x10, 0x1c, 0x10, 0x02,
+    0x14, 0x1c, 0x10, 0x14, 0x02,
+};
+
+// music_6: 28 notes, 49 bytes (224 as Note arrays)
+static const uint8_t song_music_6[] = {
+    0x53, 0x4e, 0x47, 0x31, 0x1c, 0x1d, 0xfa, 0x01, 0x00, 0x00, 0x38, 0x0c,
+    0x0c, 0x15, 0xf4, 0x03, 0x01, 0xfa, 0x01, 0x00, 0x00, 0x38, 0x0c, 0x0c,
+    0x15, 0xf4, 0x03, 0x29, 0xfa, 0x01, 0x00, 0x00, 0x38, 0x14, 0x0c, 0x0d,
+    0xf4, 0x03, 0x01, 0xfa, 0x01, 0x00, 0x00, 0x38, 0x14, 0x0c, 0x0d, 0xf4,
+    0x03,
+};
+
+// music_5: 16 notes, 23 bytes (128 as Note arrays)
+static const uint8_t song_music_5[] = {
+    0x53, 0x4e, 0x47, 0x31, 0x10, 0x25, 0xf7, 0x02, 0x1c, 0x10, 0x24, 0x10,
+    0x18, 0x0c, 0x14, 0x38, 0x1c, 0x10, 0x24, 0x10, 0x18, 0x0c, 0x14,
+};
+
+// music_4: 32 notes, 59 bytes (256 as Note arrays)
+static const uint8_t song_music_4[] = {
+    0x53, 0x4e, 0x47, 0x31, 0x20, 0x45, 0xf4, 0x03, 0x10, 0x10, 0x1c, 0x00,
+    0x10, 0x10, 0x1c, 0x20, 0x08, 0x11, 0xe8, 0x07, 0x15, 0xf4, 0x03, 0x08,
+    0x11, 0xe8, 0x07, 0x01, 0xfa, 0x01, 0x10, 0x0c, 0x0c, 0x05, 0xf4, 0x03,
+    0x1c, 0x39, 0xfa, 0x01, 0x10, 0x0c, 0x0c, 0x05, 0xf4, 0x03, 0x1c, 0x00,
+    0x24, 0x29, 0xe8, 0x07, 0x01, 0xf4, 0x03, 0x24, 0x29, 0xe8, 0x07,
+};
+
+// music_3: 26 notes, 39 bytes (208 as Note arrays)
+static const uint8_t song_music_3[] = {
+    0x53, 0x4e, 0x47, 0x31, 0x1a, 0x25, 0xc8, 0x01, 0x00, 0x08, 0x10, 0x00,
+    0x0c, 0x04, 0x0c, 0x0c, 0x00, 0x10, 0x10, 0x01, 0x90, 0x03, 0x03, 0xc8,
+    0x01, 0x0c, 0x00, 0x10, 0x08, 0x00, 0x04, 0x0c, 0x0c, 0x48, 0x00, 0x00,
+    0x0d, 0x90, 0x03,
+};
+
+// music_2: 48 notes, 100 bytes (384 as Note arrays)
+static const uint8_t song_music_2[] = {
+    0x53, 0x4e, 0x47, 0x31, 0x30, 0x01, 0xc8, 0x01, 0x38, 0x28, 0x03, 0x64,
+    0x01, 0xc8, 0x01, 0x00, 0x04, 0x08, 0x03, 0x64, 0x25, 0xc8, 0x01, 0x03,
+    0x64, 0x01, 0xc8, 0x01, 0x03, 0x64, 0x01, 0xc8, 0x01, 0x03, 0x64, 0x01,
+    0xc8, 0x01, 0x34, 0x38, 0x28, 0x03, 0x64, 0x01, 0xc8, 0x01, 0x00, 0x04,
+    0x08, 0x03, 0x64, 0x25, 0xc8, 0x01, 0x03, 0x64, 0x01, 0xc8, 0x01, 0x03,
+    0x64, 0x01, 0xc8, 0x01, 0x03, 0x64, 0x01, 0xc8, 0x01, 0x34, 0x38, 0x28,
+    0x03, 0x64, 0x01, 0xc8, 0x01, 0x00, 0x04, 0x08, 0x03, 0x64, 0x25, 0xc8,
+    0x01, 0x03, 0x64, 0x01, 0xc8, 0x01, 0x03, 0x64, 0x01, 0xc8, 0x01, 0x03,
+    0x64, 0x01, 0xc8, 0x01,
+};
+
+const struct builtin_song builtin_songs[] = {
+    { "battlefield_1942_theme", song_battlefield_1942_theme, sizeof(song_battlefield_1942_theme) },
+    { "starwars_theme", song_starwars_theme, sizeof(song_starwars_theme) },
+    { "music_1", song_music_1, sizeof(song_music_1) },
+    { "music_6", song_music_6, sizeof(song_music_6) },
+    { "music_5", song_music_5, sizeof(song_music_5) },
+    { "music_4", song_music_4, sizeof(song_music_4) },
+    { "music_3", song_music_3, sizeof(song_music_3) },
+    { "music_2", song_music_2, sizeof(song_music_2) },
+};
+
+const uint32_t builtin_song_count = sizeof(builtin_songs) / sizeof(builtin_songs[0]);
@@ -0,0 +1,347 @@
+#include "song/synth.h"
+#include "common.h"
+#include "memory/memory.h"
+
+// Oscillators produce signed 16-bit values in [-SYNTH_PEAK, SYNTH_PEAK]
+#define SYNTH_PEAK 32767
+
+// Seed of the noise LFSR, anything but 0 works
+#define SYNTH_NOISE_SEED 0xACE1
+
+static uint32_t ms_to_samples(const struct synth* synth, uint32_t ms) {
+    return (uint32_t)div64_32((uint64_t)ms * synth->sample_rate, 1000, NULL);
+}
+
+static int32_t sustain_level(const struct synth_voice* voice) {
+    return (int32_t)voice->envelope.sustain * (SYNTH_LEVEL_MAX >> 8);
+}
+
+// Put the voice into a stage and set up the ramp towards its target level.
+// Stages of zero length are skipped straight away.
+static void voice_enter(struct synth* synth, struct synth_voice* voice, synth_stage_t stage) {
+    int32_t target;
+    uint32_t samples;
+
+    voice->stage = stage;
+    switch (stage) {
+    case SYNTH_STAGE_ATTACK:
+        target = SYNTH_LEVEL_MAX;
+        samples = ms_to_samples(synth, voice->envelope.attack_ms);
+        break;
+    case SYNTH_STAGE_DECAY:
+        target = sustain_level(voice);
+        samples = ms_to_samples(synth, voice->envelope.decay_ms);
+        break;
+    case SYNTH_STAGE_RELEASE:
+        target = 0;
+        samples = ms_to_samples(synth, voice->envelope.release_ms);
+        break;
+    case SYNTH_STAGE_SUSTAIN:
+        // Held until the gate closes or the note is switched off
+        voice->level = sustain_level(voice);
+        voice->level_step = 0;
+        voice->stage_samples = UINT32_MAX;
+        return;
+    default:
+        voice->level = 0;
+        voice->level_step = 0;
+        voice->stage_samples = 0;
+        voice->gate_samples = 0;
+        return;
+    }
+
+    if (samples == 0) {
+        voice->level = target;
+        voice->stage_samples = 0;
+    } else {
+        voice->level_step = (target - voice->level) / (int32_t)samples;
+        voice->stage_samples = samples;
+    }
+    if (voice->stage_samples == 0) {
+        voice_enter(synth, voice, stage == SYNTH_STAGE_RELEASE ? SYNTH_STAGE_OFF : stage + 1);
+    }
+}
+
+// A stage ran its course: land exactly on its target and move on
+static void voice_next_stage(struct synth* synth, struct synth_voice* voice) {
+    switch (voice->stage) {
+    case SYNTH_STAGE_ATTACK:
+        voice->level = SYNTH_LEVEL_MAX;
+        voice_enter(synth, voice, SYNTH_STAGE_DECAY);
+        break;
+    case SYNTH_STAGE_DECAY:
+        voice_enter(synth, voice, SYNTH_STAGE_SUSTAIN);
+        break;
+    case SYNTH_STAGE_RELEASE:
+        voice_enter(synth, voice, SYNTH_STAGE_OFF);
+        break;
+    default:
+        break;
+    }
+}
+
+// Add count samples of the voice to mix. The envelope is a straight line
+// over the run, so the loops only do adds, a multiply and a shift.
+static void voice_render(struct synth_voice* voice, int32_t* mix, uint32_t count) {
+    uint32_t phase = voice->phase;
+    uint32_t phase_step = voice->phase_step;
+    int32_t level = voice->level;
+    int32_t level_step = voice->level_step;
+    int32_t velocity = voice->velocity;
+
+    switch (voice->waveform) {
+    case SYNTH_SQUARE:
+        for (uint32_t i = 0; i < count; i++) {
+            int32_t amplitude = ((level >> (SYNTH_LEVEL_BITS - 15)) * velocity) >> 7;
+            mix[i] += (phase & 0x80000000) ? -amplitude : amplitude;
+            phase += phase_step;
+            level += level_step;
+        }
+        break;
+
+    case SYNTH_TRIANGLE:
+        for (uint32_t i = 0; i < count; i++) {
+            int32_t amplitude = ((level >> (SYNTH_LEVEL_BITS - 15)) * velocity) >> 7;
+            int32_t t = phase >> 16;
+            int32_t osc = (t < 0x8000 ? t : 0xFFFF - t) * 2 - SYNTH_PEAK;
+            mix[i] += (osc * amplitude) >> 15;
+            phase += phase_step;
+            level += level_step;
+        }
+        break;
+
+    case SYNTH_NOISE: {
+        // The LFSR is clocked once per oscillator cycle, so the frequency
+        // sets the colour of the noise
+        uint16_t noise = voice->noise;
+        for (uint32_t i = 0; i < count; i++) {
+            int32_t amplitude = ((level >> (SYNTH_LEVEL_BITS - 15)) * velocity) >> 7;
+            mix[i] += (noise & 1) ? amplitude : -amplitude;
+            uint32_t next = phase + phase_step;
+            if (next < phase)
+                noise = (noise >> 1) ^ ((noise & 1) ? 0xB400 : 0);
+            phase = next;
+            level += level_step;
+        }
+        voice->noise = noise;
+        break;
+    }
+    }
+
+    voice->phase = phase;
+    voice->level = level;
+}
+
+// Run the voice for count samples, splitting the work where the envelope
+// changes stage or the gate closes
+static void voice_advance(struct synth* synth, struct synth_voice* voice, int32_t* mix, uint32_t count) {
+    uint32_t done = 0;
+    while (done < count && voice->stage != SYNTH_STAGE_OFF) {
+        uint32_t run = count - done;
+        if (run > voice->stage_samples)
+            run = voice->stage_samples;
+        if (voice->gate_samples != 0 && run > voice->gate_samples)
+            run = voice->gate_samples;
+
+        voice_render(voice, mix + done, run);
+        done += run;
+
+        if (voice->stage != SYNTH_STAGE_SUSTAIN)
+            voice->stage_samples -= run;
+
+        if (voice->gate_samples != 0) {
+            voice->gate_samples -= run;
+            if (voice->gate_samples == 0) {
+                voice_enter(synth, voice, SYNTH_STAGE_RELEASE);
+                continue;
+            }
+        }
+        if (voice->stage_samples == 0)
+            voice_next_stage(synth, voice);
+    }
+}
+
+static uint32_t synth_read(audio_source_t* source, uint8_t* samples, uint32_t count) {
+    synth_render(source->ctx, samples, count);
+    return count;
+}
+
+audio_source_t* synth_init(struct synth* synth, uint32_t sample_rate) {
+    memset(synth, 0, sizeof(*synth));
+    synth->source.read = synth_read;
+    synth->source.ctx = synth;
+    synth->sample_rate = sample_rate;
+    synth->gain = SYNTH_DEFAULT_GAIN;
+
+    synth->envelope.attack_ms = 2;
+    synth->envelope.decay_ms = 50;
+    synth->envelope.sustain = 192;
+    synth->envelope.release_ms = 50;
+
+    for (int i = 0; i < SYNTH_MAX_VOICES; i++) {
+        synth->voices[i].stage = SYNTH_STAGE_OFF;
+        synth->voices[i].noise = SYNTH_NOISE_SEED;
+    }
+    return &synth->source;
+}
+
+void synth_set_envelope(struct synth* synth, const synth_envelope_t* envelope) {
+    synth->envelope = *envelope;
+}
+
+// A free voice if there is one, otherwise the quietest voice that is
+// already being released, otherwise the oldest one
+static int synth_pick_voice(const struct synth* synth) {
+    int best = -1;
+    for (int i = 0; i < SYNTH_MAX_VOICES; i++) {
+        const struct synth_voice* voice = &synth->voices[i];
+        if (voice->stage == SYNTH_STAGE_OFF)
+            return i;
+        if (voice->stage == SYNTH_STAGE_RELEASE &&
+            (best < 0 || voice->level < synth->voices[best].level))
+            best = i;
+    }
+    if (best >= 0)
+        return best;
+
+    best = 0;
+    for (int i = 1; i < SYNTH_MAX_VOICES; i++) {
+        if (synth->voices[i].age < synth->voices[best].age)
+            best = i;
+    }
+    return best;
+}
+
+int synth_note_on(struct synth* synth, uint32_t frequency, uint32_t velocity,
+                  synth_waveform_t waveform, uint32_t duration_ms) {
+    if (velocity > SYNTH_VELOCITY_MAX)
+        velocity = SYNTH_VELOCITY_MAX;
+
+    int index = synth_pick_voice(synth);
+    struct synth_voice* voice = &synth->voices[index];
+
+    // A stolen voice keeps its level, the new attack ramps up from there
+    // instead of clicking down to zero first
+    if (voice->stage == SYNTH_STAGE_OFF)
+        voice->level = 0;
+    voice->waveform = waveform;
+    voice->phase_step = (uint32_t)div64_32((uint64_t)frequency << 32, synth->sample_rate, NULL);
+    voice->velocity = velocity;
+    voice->envelope = synth->envelope;
+    voice->age = synth->started++;
+
+    voice->gate_samples = 0;
+    if (duration_ms != 0) {
+        voice->gate_samples = ms_to_samples(synth, duration_ms);
+        if (voice->gate_samples == 0)
+            voice->gate_samples = 1;
+    }
+
+    voice_enter(synth, voice, SYNTH_STAGE_ATTACK);
+    return index;
+}
+
+void synth_note_off(struct synth* synth, int voice) {
+    if (voice < 0 || voice >= SYNTH_MAX_VOICES)
+        return;
+    struct synth_voice* v = &synth->voices[voice];
+    if (v->stage == SYNTH_STAGE_OFF || v->stage == SYNTH_STAGE_RELEASE)
+        return;
+    v->gate_samples = 0;
+    voice_enter(synth, v, SYNTH_STAGE_RELEASE);
+}
+
+void synth_all_off(struct synth* synth) {
+    for (int i = 0; i < SYNTH_MAX_VOICES; i++)
+        voice_enter(synth, &synth->voices[i], SYNTH_STAGE_OFF);
+}
+
+uint32_t synth_active_voices(const struct synth* synth) {
+    uint32_t active = 0;
+    for (int i = 0; i < SYNTH_MAX_VOICES; i++) {
+        if (synth->voices[i].stage != SYNTH_STAGE_OFF)
+            active++;
+    }
+    return active;
+}
+
+void synth_render(struct synth* synth, uint8_t* samples, uint32_t count) {
+    while (count > 0) {
+        uint32_t chunk = count < SYNTH_CHUNK ? count : SYNTH_CHUNK;
+
+        memset(synth->mix, 0, chunk * sizeof(synth->mix[0]));
+        for (int i = 0; i < SYNTH_MAX_VOICES; i++) {
+            if (synth->voices[i].stage != SYNTH_STAGE_OFF)
+                voice_advance(synth, &synth->voices[i], synth->mix, chunk);
+        }
+
+        // Voices are 16-bit, the gain brings the sum down to 8 bits
+        for (uint32_t i = 0; i < chunk; i++) {
+            int32_t value = (synth->mix[i] * (int32_t)synth->gain) >> 16;
+            if (value > 127) {
+                value = 127;
+                synth->clipped++;
+            } else if (value < -128) {
+                value = -128;
+                synth->clipped++;
+            }
+            samples[i] = (uint8_t)(value + AUDIO_SILENCE);
+        }
+
+        samples += chunk;
+        count -= chunk;
+    }
+}
+
+static uint32_t synth_song_read(audio_source_t* source, uint8_t* samples, uint32_t count) {
+    struct synth_song* player = source->ctx;
+    struct synth* synth = &player->synth;
+    uint32_t written = 0;
+
+    while (written < count) {
+        Note note;
+        if (player->note_samples == 0 && !player->done) {
+            if (!song_cursor_next(&player->cursor, &note)) {
+                player->done = true;
+                continue;
+            }
+            player->note_samples = ms_to_samples(synth, note.duration);
+            if (note.frequency != R) {
+                synth_note_on(synth, note.frequency, 90, SYNTH_SQUARE, note.duration);
+                synth_note_on(synth, note.frequency / 2, 110, SYNTH_TRIANGLE, note.duration);
+            }
+            continue;
+        }
+
+        uint32_t run = count - written;
+        if (player->note_samples != 0) {
+            if (run > player->note_samples)
+                run = player->note_samples;
+            player->note_samples -= run;
+        } else if (synth_active_voices(synth) == 0) {
+            // Past the last note and every release tail has died out
+            break;
+        } else if (run > SYNTH_CHUNK) {
+            run = SYNTH_CHUNK;
+        }
+
+        synth_render(synth, samples + written, run);
+        written += run;
+    }
+
+    return written;
+}
+
+audio_source_t* synth_song_init(struct synth_song* player, const Song* song, uint32_t sample_rate) {
+    synth_init(&player->synth, sample_rate);
+
+    synth_envelope_t envelope = { 5, 60, 160, 80 };
+    synth_set_envelope(&player->synth, &envelope);
+
+    player->source.read = synth_song_read;
+    player->source.ctx = player;
+    song_cursor_init(&player->cursor, song);
+    player->done = false;
+    player->note_samples = 0;
+    return &player->source;
+}
@@ -0,0 +1,42 @@
+#include "audio.h"
+
+static audio_output_t* outputs[AUDIO_MAX_OUTPUTS];
+static uint32_t output_count = 0;
+static audio_output_t* current = NULL;
+
+int audio_register_output(audio_output_t* output) {
+    if (output_count == AUDIO_MAX_OUTPUTS)
+        return -1;
+    outputs[output_count++] = output;
+    current = output;
+    return 0;
+}
+
+audio_output_t* audio_current_output() {
+    return current;
+}
+
+bool audio_select_output(const char* name) {
+    for (uint32_t i = 0; i < output_count; i++) {
+        if (strcmp(outputs[i]->name, name) == 0) {
+            audio_stop();
+            current = outputs[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+audio_output_t* audio_get_output(uint32_t index) {
+    return index < output_count ? outputs[index] : NULL;
+}
+
+bool audio_play(audio_source_t* source) {
+    audio_stop();
+    return current != NULL && current->start(source);
+}
+
+void audio_stop() {
+    for (uint32_t i = 0; i < output_count; i++)
+        outputs[i]->stop();
+}
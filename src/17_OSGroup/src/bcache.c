@@ -0,0 +1,497 @@
+#include "bcache.h"
+#include "common.h"
+#include "idle.h"
+#include "pit.h"
+#include "memory/memory.h"
+
+// The lists a buffer can be on
+enum {
+    BCACHE_LIST_FREE,
+    BCACHE_LIST_A1IN,
+    BCACHE_LIST_AM,
+    BCACHE_LISTS,
+};
+
+struct bcache_list {
+    struct bcache_buffer* head;
+    struct bcache_buffer* tail;
+    uint32_t count;
+};
+
+// A block recently evicted from A1in
+struct bcache_ghost {
+    blockdev_t* dev;
+    uint32_t block;
+};
+
+// Sequential read detection, one per device
+struct bcache_stream {
+    blockdev_t* dev;
+    uint32_t last;              // Block read last
+    uint32_t run;               // Consecutive blocks read up to it
+    uint32_t window;            // Blocks to keep read ahead
+    uint32_t ahead;             // First block not read ahead yet
+};
+
+static struct bcache_buffer buffers[BCACHE_BUFFERS];
+static uint8_t buffer_data[BCACHE_BUFFERS][BCACHE_BLOCK_SIZE] __attribute__((aligned(4096)));
+static struct bcache_buffer* hash[BCACHE_HASH_SIZE];
+static struct bcache_list lists[BCACHE_LISTS];
+static struct bcache_ghost ghosts[BCACHE_GHOSTS];
+static uint32_t ghost_next = 0;
+static struct bcache_stream streams[BLOCKDEV_MAX_DEVICES];
+static struct bcache_stats stats;
+static uint32_t last_flush = 0;
+
+static uint32_t bcache_hash(const blockdev_t* dev, uint32_t block) {
+    uint32_t key = block ^ ((uint32_t)dev >> 4);
+    return (key * 2654435761u) >> 24 & (BCACHE_HASH_SIZE - 1);
+}
+
+static struct bcache_buffer* bcache_lookup(blockdev_t* dev, uint32_t block) {
+    struct bcache_buffer* buffer = hash[bcache_hash(dev, block)];
+    while (buffer != NULL && (buffer->dev != dev || buffer->block != block))
+        buffer = buffer->hash_next;
+    return buffer;
+}
+
+static void hash_remove(struct bcache_buffer* buffer) {
+    struct bcache_buffer** link = &hash[bcache_hash(buffer->dev, buffer->block)];
+    while (*link != buffer)
+        link = &(*link)->hash_next;
+    *link = buffer->hash_next;
+    buffer->hash_next = NULL;
+}
+
+static void list_remove(struct bcache_buffer* buffer) {
+    struct bcache_list* list = &lists[buffer->list];
+    if (buffer->prev != NULL)
+        buffer->prev->next = buffer->next;
+    else
+        list->head = buffer->next;
+    if (buffer->next != NULL)
+        buffer->next->prev = buffer->prev;
+    else
+        list->tail = buffer->prev;
+    buffer->prev = NULL;
+    buffer->next = NULL;
+    list->count--;
+}
+
+static void list_push(struct bcache_buffer* buffer, uint8_t index) {
+    struct bcache_list* list = &lists[index];
+    buffer->list = index;
+    buffer->prev = NULL;
+    buffer->next = list->head;
+    if (list->head != NULL)
+        list->head->prev = buffer;
+    else
+        list->tail = buffer;
+    list->head = buffer;
+    list->count++;
+}
+
+// Remember a block evicted from A1in, forgetting the oldest one
+static void ghost_add(blockdev_t* dev, uint32_t block) {
+    ghosts[ghost_next].dev = dev;
+    ghosts[ghost_next].block = block;
+    ghost_next = (ghost_next + 1) % BCACHE_GHOSTS;
+}
+
+// Whether the block is remembered, forgetting it. The ghosts are only
+// searched on a miss, which costs a disk access anyway.
+static bool ghost_take(blockdev_t* dev, uint32_t block) {
+    for (uint32_t i = 0; i < BCACHE_GHOSTS; i++) {
+        if (ghosts[i].dev == dev && ghosts[i].block == block) {
+            ghosts[i].dev = NULL;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void bcache_io_done(struct block_request* request) {
+    struct bcache_buffer* buffer = request->ctx;
+    buffer->flags &= ~BCACHE_BUSY;
+    if (!request->ok) {
+        buffer->flags &= ~BCACHE_READAHEAD;
+        stats.errors++;
+    } else if (request->write) {
+        buffer->flags &= ~BCACHE_DIRTY;
+        stats.dirty--;
+        stats.writebacks++;
+    } else {
+        buffer->flags |= BCACHE_VALID;
+    }
+}
+
+// Queue the buffer's block to be read or written, without waiting for it
+static bool bcache_submit(struct bcache_buffer* buffer, bool write) {
+    block_request_init(&buffer->request, buffer->dev, write, buffer->block * BCACHE_BLOCK_SECTORS,
+                       buffer->sectors, buffer->data, bcache_io_done, buffer);
+    buffer->flags |= BCACHE_BUSY;
+    if (!block_submit(&buffer->request)) {
+        buffer->flags &= ~BCACHE_BUSY;
+        stats.errors++;
+        return false;
+    }
+    return true;
+}
+
+// Wait for the buffer's I/O, if any
+static void bcache_wait(struct bcache_buffer* buffer) {
+    if (buffer->flags & BCACHE_BUSY)
+        block_wait(&buffer->request);
+}
+
+// Make room by evicting the oldest unused buffer of A1in, if A1in is over
+// its share, otherwise the least recently used one of Am. When that list
+// has nothing to give the other one is tried. Dirty blocks are written
+// back first.
+static struct bcache_buffer* bcache_evict() {
+    uint8_t order[2] = { BCACHE_LIST_AM, BCACHE_LIST_A1IN };
+    if (lists[BCACHE_LIST_A1IN].count > BCACHE_A1IN_BUFFERS) {
+        order[0] = BCACHE_LIST_A1IN;
+        order[1] = BCACHE_LIST_AM;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        for (struct bcache_buffer* buffer = lists[order[i]].tail; buffer != NULL; buffer = buffer->prev) {
+            if (buffer->refs != 0 || (buffer->flags & BCACHE_BUSY))
+                continue;
+            if (buffer->flags & BCACHE_DIRTY) {
+                bcache_submit(buffer, true);
+                bcache_wait(buffer);
+                if (buffer->flags & BCACHE_DIRTY)
+                    continue;
+            }
+
+            if (buffer->list == BCACHE_LIST_A1IN)
+                ghost_add(buffer->dev, buffer->block);
+            if (buffer->flags & BCACHE_READAHEAD)
+                stats.readahead_wasted++;
+            list_remove(buffer);
+            hash_remove(buffer);
+            stats.evictions++;
+            return buffer;
+        }
+    }
+    return NULL;
+}
+
+// A buffer for a block that is not cached, neither valid nor referenced.
+// Blocks that were evicted from A1in not long ago go straight to Am.
+static struct bcache_buffer* bcache_alloc(blockdev_t* dev, uint32_t block) {
+    struct bcache_buffer* buffer = lists[BCACHE_LIST_FREE].tail;
+    if (buffer != NULL)
+        list_remove(buffer);
+    else
+        buffer = bcache_evict();
+    if (buffer == NULL)
+        return NULL;
+
+    buffer->dev = dev;
+    buffer->block = block;
+    buffer->sectors = dev->sectors - block * BCACHE_BLOCK_SECTORS;
+    if (buffer->sectors > BCACHE_BLOCK_SECTORS)
+        buffer->sectors = BCACHE_BLOCK_SECTORS;
+    buffer->flags = 0;
+    buffer->refs = 0;
+
+    if (ghost_take(dev, block)) {
+        list_push(buffer, BCACHE_LIST_AM);
+        stats.promotions++;
+    } else {
+        list_push(buffer, BCACHE_LIST_A1IN);
+    }
+    uint32_t bucket = bcache_hash(dev, block);
+    buffer->hash_next = hash[bucket];
+    hash[bucket] = buffer;
+    return buffer;
+}
+
+static uint32_t bcache_blocks(const blockdev_t* dev) {
+    return (dev->sectors + BCACHE_BLOCK_SECTORS - 1) / BCACHE_BLOCK_SECTORS;
+}
+
+static struct bcache_stream* bcache_stream(blockdev_t* dev) {
+    for (int i = 0; i < BLOCKDEV_MAX_DEVICES; i++) {
+        if (streams[i].dev == dev)
+            return &streams[i];
+    }
+    for (int i = 0; i < BLOCKDEV_MAX_DEVICES; i++) {
+        if (streams[i].dev == NULL) {
+            streams[i].dev = dev;
+            return &streams[i];
+        }
+    }
+    return NULL;
+}
+
+// Follow the reads of the device. Once they have been sequential for a
+// while, queue the blocks after the one just read, and top the window up
+// again, twice as wide, whenever half of it has been used.
+static void bcache_readahead(blockdev_t* dev, uint32_t block) {
+    struct bcache_stream* stream = bcache_stream(dev);
+    if (stream == NULL)
+        return;
+
+    if (stream->run != 0 && block == stream->last + 1) {
+        stream->run++;
+    } else if (stream->run == 0 || block != stream->last) {
+        stream->run = 1;
+        stream->window = BCACHE_READAHEAD_MIN;
+        stream->ahead = block + 1;
+    }
+    stream->last = block;
+
+    if (stream->run < BCACHE_SEQUENTIAL)
+        return;
+    if (stream->ahead < block + 1)
+        stream->ahead = block + 1;
+    if (stream->ahead - (block + 1) > stream->window / 2)
+        return;
+
+    uint32_t end = block + 1 + stream->window;
+    if (end > bcache_blocks(dev))
+        end = bcache_blocks(dev);
+    for (; stream->ahead < end; stream->ahead++) {
+        if (bcache_lookup(dev, stream->ahead) != NULL)
+            continue;
+        struct bcache_buffer* buffer = bcache_alloc(dev, stream->ahead);
+        if (buffer == NULL)
+            break;
+        buffer->flags = BCACHE_READAHEAD;
+        if (!bcache_submit(buffer, false))
+            break;
+        stats.readahead++;
+    }
+    if (stream->window < BCACHE_READAHEAD_MAX)
+        stream->window *= 2;
+}
+
+struct bcache_buffer* bcache_get(blockdev_t* dev, uint32_t block) {
+    if (block >= bcache_blocks(dev))
+        return NULL;
+
+    stats.lookups++;
+    struct bcache_buffer* buffer = bcache_lookup(dev, block);
+    if (buffer != NULL) {
+        if (buffer->flags & (BCACHE_VALID | BCACHE_BUSY))
+            stats.hits++;
+        else
+            stats.misses++;
+        if (buffer->flags & BCACHE_READAHEAD) {
+            buffer->flags &= ~BCACHE_READAHEAD;
+            stats.readahead_hits++;
+        }
+        // Only Am is kept in recency order, a hit in A1in leaves the
+        // block to age out unless it comes back from the ghost list
+        if (buffer->list == BCACHE_LIST_AM) {
+            list_remove(buffer);
+            list_push(buffer, BCACHE_LIST_AM);
+        }
+    } else {
+        stats.misses++;
+        buffer = bcache_alloc(dev, block);
+        if (buffer == NULL) {
+            stats.errors++;
+            return NULL;
+        }
+    }
+    buffer->refs++;
+
+    // Submit the read before the read-ahead, so both can be merged into
+    // the same command when the queue runs
+    if (!(buffer->flags & (BCACHE_VALID | BCACHE_BUSY)))
+        bcache_submit(buffer, false);
+    bcache_readahead(dev, block);
+    bcache_wait(buffer);
+
+    if (!(buffer->flags & BCACHE_VALID)) {
+        buffer->refs--;
+        return NULL;
+    }
+    return buffer;
+}
+
+struct bcache_buffer* bcache_get_new(blockdev_t* dev, uint32_t block) {
+    if (block >= bcache_blocks(dev))
+        return NULL;
+
+    struct bcache_buffer* buffer = bcache_lookup(dev, block);
+    if (buffer == NULL) {
+        buffer = bcache_alloc(dev, block);
+        if (buffer == NULL) {
+            stats.errors++;
+            return NULL;
+        }
+    }
+    bcache_wait(buffer);
+    buffer->refs++;
+    if (!(buffer->flags & BCACHE_VALID)) {
+        memset(buffer->data, 0, BCACHE_BLOCK_SIZE);
+        buffer->flags = (buffer->flags & ~BCACHE_READAHEAD) | BCACHE_VALID;
+    }
+    return buffer;
+}
+
+void bcache_release(struct bcache_buffer* buffer) {
+    if (buffer->refs > 0)
+        buffer->refs--;
+}
+
+void bcache_mark_dirty(struct bcache_buffer* buffer) {
+    if (buffer->flags & BCACHE_DIRTY)
+        return;
+    buffer->flags |= BCACHE_DIRTY;
+    buffer->dirty_tick = pit_get_ticks();
+    stats.dirty++;
+}
+
+bool bcache_read(blockdev_t* dev, uint32_t lba, uint32_t count, void* buffer) {
+    uint8_t* bytes = buffer;
+    while (count > 0) {
+        uint32_t offset = lba % BCACHE_BLOCK_SECTORS;
+        uint32_t sectors = BCACHE_BLOCK_SECTORS - offset;
+        if (sectors > count)
+            sectors = count;
+
+        struct bcache_buffer* cached = bcache_get(dev, lba / BCACHE_BLOCK_SECTORS);
+        if (cached == NULL || offset + sectors > cached->sectors) {
+            if (cached != NULL)
+                bcache_release(cached);
+            return false;
+        }
+        memcpy(bytes, cached->data + offset * BLOCKDEV_SECTOR_SIZE, sectors * BLOCKDEV_SECTOR_SIZE);
+        bcache_release(cached);
+
+        lba += sectors;
+        count -= sectors;
+        bytes += sectors * BLOCKDEV_SECTOR_SIZE;
+    }
+    return true;
+}
+
+bool bcache_write(blockdev_t* dev, uint32_t lba, uint32_t count, const void* buffer) {
+    if (dev->read_only)
+        return false;
+
+    const uint8_t* bytes = buffer;
+    while (count > 0) {
+        uint32_t offset = lba % BCACHE_BLOCK_SECTORS;
+        uint32_t sectors = BCACHE_BLOCK_SECTORS - offset;
+        if (sectors > count)
+            sectors = count;
+
+        // A whole block is not worth reading first
+        uint32_t block = lba / BCACHE_BLOCK_SECTORS;
+        struct bcache_buffer* cached = sectors == BCACHE_BLOCK_SECTORS ? bcache_get_new(dev, block)
+                                                                       : bcache_get(dev, block);
+        if (cached == NULL || offset + sectors > cached->sectors) {
+            if (cached != NULL)
+                bcache_release(cached);
+            return false;
+        }
+        memcpy(cached->data + offset * BLOCKDEV_SECTOR_SIZE, bytes, sectors * BLOCKDEV_SECTOR_SIZE);
+        bcache_mark_dirty(cached);
+        bcache_release(cached);
+
+        lba += sectors;
+        count -= sectors;
+        bytes += sectors * BLOCKDEV_SECTOR_SIZE;
+    }
+    return true;
+}
+
+// Write back the blocks of dev that have been dirty for at least age
+// ticks. They are all queued under one plug, so the block layer sorts and
+// merges them, and waited for.
+static bool bcache_write_back(blockdev_t* dev, uint32_t age) {
+    uint32_t now = pit_get_ticks();
+    uint32_t errors = stats.errors;
+
+    block_plug(dev);
+    for (int i = 0; i < BCACHE_BUFFERS; i++) {
+        struct bcache_buffer* buffer = &buffers[i];
+        if (buffer->dev == dev && buffer->list != BCACHE_LIST_FREE &&
+            (buffer->flags & (BCACHE_DIRTY | BCACHE_BUSY)) == BCACHE_DIRTY &&
+            now - buffer->dirty_tick >= age)
+            bcache_submit(buffer, true);
+    }
+    block_unplug(dev);
+
+    for (int i = 0; i < BCACHE_BUFFERS; i++) {
+        if (buffers[i].dev == dev)
+            bcache_wait(&buffers[i]);
+    }
+    return stats.errors == errors;
+}
+
+bool bcache_sync(blockdev_t* dev) {
+    bool ok = true;
+    for (uint32_t i = 0; i < blockdev_count(); i++) {
+        blockdev_t* each = blockdev_get(i);
+        if (dev != NULL && each != dev)
+            continue;
+        if (!bcache_write_back(each, 0) || !blockdev_flush(each))
+            ok = false;
+    }
+    return ok;
+}
+
+bool bcache_invalidate(blockdev_t* dev) {
+    bool ok = bcache_sync(dev);
+
+    for (int i = 0; i < BCACHE_BUFFERS; i++) {
+        struct bcache_buffer* buffer = &buffers[i];
+        if (buffer->dev != dev || buffer->list == BCACHE_LIST_FREE)
+            continue;
+        bcache_wait(buffer);
+        if (buffer->refs != 0 || (buffer->flags & BCACHE_DIRTY)) {
+            ok = false;
+            continue;
+        }
+        list_remove(buffer);
+        hash_remove(buffer);
+        list_push(buffer, BCACHE_LIST_FREE);
+    }
+    for (int i = 0; i < BCACHE_GHOSTS; i++) {
+        if (ghosts[i].dev == dev)
+            ghosts[i].dev = NULL;
+    }
+    struct bcache_stream* stream = bcache_stream(dev);
+    if (stream != NULL)
+        stream->run = 0;
+    return ok;
+}
+
+// Every BCACHE_FLUSH_MS, write back what has been dirty long enough
+static void bcache_idle(void* ctx) {
+    (void)ctx;
+    uint32_t now = pit_get_ticks();
+    if (stats.dirty == 0 || now - last_flush < BCACHE_FLUSH_MS * TICKS_PER_MS)
+        return;
+    last_flush = now;
+
+    for (uint32_t i = 0; i < blockdev_count(); i++)
+        bcache_write_back(blockdev_get(i), BCACHE_WRITEBACK_MS * TICKS_PER_MS);
+}
+
+void init_bcache() {
+    for (int i = 0; i < BCACHE_BUFFERS; i++) {
+        buffers[i].data = buffer_data[i];
+        list_push(&buffers[i], BCACHE_LIST_FREE);
+    }
+    register_idle_handler(bcache_idle, NULL);
+}
+
+void bcache_get_stats(struct bcache_stats* out) {
+    *out = stats;
+}
+
+void bcache_reset_stats() {
+    uint32_t dirty = stats.dirty;
+    memset(&stats, 0, sizeof(stats));
+    stats.dirty = dirty;
+}
@@ -0,0 +1,417 @@
+#include "block.h"
+#include "common.h"
+#include "idle.h"
+#include "pit.h"
+#include "memory/memory.h"
+
+struct block_queue {
+    blockdev_t* dev;
+    struct block_request* sorted;       // Commands by first sector, each
+                                        // with its merged requests behind it
+    struct block_request* fifo_head[2]; // The same commands in submission order,
+    struct block_request* fifo_tail[2]; // reads and writes apart, by request->write
+    uint32_t position;                  // Sector after the last command, the elevator's head
+    uint32_t plugged;                   // Nesting count
+    uint32_t plug_tick;                 // When the outermost plug was taken
+    struct block_queue_stats stats;
+    uint64_t latency_total;             // TSC cycles over every completed request
+    uint64_t latency_max;
+};
+
+static struct block_queue queues[BLOCKDEV_MAX_DEVICES];
+static uint32_t queue_count = 0;
+
+// The device's queue, set up on first use
+static struct block_queue* block_queue(blockdev_t* dev) {
+    if (dev->queue != NULL)
+        return dev->queue;
+    if (queue_count == BLOCKDEV_MAX_DEVICES)
+        return NULL;
+
+    struct block_queue* queue = &queues[queue_count++];
+    memset(queue, 0, sizeof(*queue));
+    queue->dev = dev;
+    dev->queue = queue;
+    return queue;
+}
+
+void block_request_init(struct block_request* request, blockdev_t* dev, bool write, uint32_t lba,
+                        uint32_t count, void* buffer, block_callback_t done, void* ctx) {
+    memset(request, 0, sizeof(*request));
+    request->dev = dev;
+    request->write = write;
+    request->lba = lba;
+    request->count = count;
+    request->buffer = buffer;
+    request->done = done;
+    request->ctx = ctx;
+}
+
+// Put command in place of old in the submission order
+static void fifo_replace(struct block_queue* queue, struct block_request* old, struct block_request* command) {
+    struct block_request** link = &queue->fifo_head[old->write];
+    while (*link != old)
+        link = &(*link)->fifo;
+    command->fifo = old->fifo;
+    *link = command;
+    if (queue->fifo_tail[old->write] == old)
+        queue->fifo_tail[old->write] = command;
+}
+
+static void fifo_remove(struct block_queue* queue, struct block_request* command) {
+    struct block_request** link = &queue->fifo_head[command->write];
+    struct block_request* previous = NULL;
+    while (*link != command) {
+        previous = *link;
+        link = &(*link)->fifo;
+    }
+    *link = command->fifo;
+    if (queue->fifo_tail[command->write] == command)
+        queue->fifo_tail[command->write] = previous;
+}
+
+static void fifo_append(struct block_queue* queue, struct block_request* command) {
+    if (queue->fifo_tail[command->write] != NULL)
+        queue->fifo_tail[command->write]->fifo = command;
+    else
+        queue->fifo_head[command->write] = command;
+    queue->fifo_tail[command->write] = command;
+}
+
+// Whether second can ride along behind first in one command
+static bool block_mergeable(const blockdev_t* dev, const struct block_request* first,
+                            const struct block_request* second) {
+    return first->write == second->write && first->lba + first->sectors == second->lba &&
+           first->sectors + second->sectors <= dev->max_sectors &&
+           first->segments + second->segments <= dev->max_segments;
+}
+
+// Append the command second, which directly follows first in the sorted
+// list, to first. The result keeps the earlier deadline and the earlier
+// place in the submission order that goes with it.
+static void block_join(struct block_queue* queue, struct block_request* first, struct block_request* second) {
+    struct block_request* last = first;
+    while (last->merged != NULL)
+        last = last->merged;
+    last->merged = second;
+    first->sectors += second->sectors;
+    first->segments += second->segments;
+    if ((int32_t)(second->deadline - first->deadline) < 0) {
+        first->deadline = second->deadline;
+        fifo_remove(queue, first);
+        fifo_replace(queue, second, first);
+    } else {
+        fifo_remove(queue, second);
+    }
+
+    first->next = second->next;
+    queue->stats.merged++;
+}
+
+// Try to add the request to a queued command that it continues or
+// precedes, and close the gap to the neighbouring command if the request
+// was what separated them. Only devices with a scatter-gather hook can
+// take merged commands, and the result must still fit in one of them.
+static bool block_merge(struct block_queue* queue, struct block_request* request) {
+    blockdev_t* dev = queue->dev;
+    if (dev->transfer == NULL || dev->max_segments < 2 || request->count == 0)
+        return false;
+
+    struct block_request* previous = NULL;
+    for (struct block_request** link = &queue->sorted; *link != NULL; link = &(*link)->next) {
+        struct block_request* command = *link;
+
+        if (block_mergeable(dev, command, request)) {
+            // Back merge, the request goes last in the chain
+            struct block_request* last = command;
+            while (last->merged != NULL)
+                last = last->merged;
+            last->merged = request;
+            command->sectors += request->count;
+            command->segments++;
+
+            if (command->next != NULL && block_mergeable(dev, command, command->next))
+                block_join(queue, command, command->next);
+            return true;
+        }
+
+        if (block_mergeable(dev, request, command)) {
+            // Front merge, the request takes over the command, its deadline
+            // and its place in the submission order
+            request->merged = command;
+            request->sectors += command->sectors;
+            request->segments += command->segments;
+            request->deadline = command->deadline;
+            request->next = command->next;
+            *link = request;
+            fifo_replace(queue, command, request);
+
+            if (previous != NULL && block_mergeable(dev, previous, request))
+                block_join(queue, previous, request);
+            return true;
+        }
+        previous = command;
+    }
+    return false;
+}
+
+// Queue the request as a command of its own, in sector order
+static void block_insert(struct block_queue* queue, struct block_request* request) {
+    struct block_request** link = &queue->sorted;
+    while (*link != NULL && (*link)->lba <= request->lba)
+        link = &(*link)->next;
+    request->next = *link;
+    *link = request;
+    fifo_append(queue, request);
+}
+
+bool block_submit(struct block_request* request) {
+    blockdev_t* dev = request->dev;
+    if ((request->write && dev->read_only) || request->lba > dev->sectors ||
+        request->count > dev->sectors - request->lba)
+        return false;
+
+    struct block_queue* queue = block_queue(dev);
+    if (queue == NULL)
+        return false;
+
+    request->completed = false;
+    request->ok = false;
+    request->next = NULL;
+    request->fifo = NULL;
+    request->merged = NULL;
+    request->sectors = request->count;
+    request->segments = 1;
+    request->submitted = read_tsc();
+    request->deadline = pit_get_ticks() +
+        (request->write ? BLOCK_WRITE_DEADLINE_MS : BLOCK_READ_DEADLINE_MS) * TICKS_PER_MS;
+
+    uint32_t flags = interrupts_save();
+    queue->stats.submitted++;
+    if (++queue->stats.depth > queue->stats.max_depth)
+        queue->stats.max_depth = queue->stats.depth;
+    if (block_merge(queue, request))
+        queue->stats.merged++;
+    else
+        block_insert(queue, request);
+    interrupts_restore(flags);
+    return true;
+}
+
+// Take the next command off the queue: the oldest read or write if its
+// deadline has passed, otherwise the first one at or past the elevator's
+// position, wrapping around to the lowest sector. Reads and writes are
+// queued apart, so a read's short deadline is not stuck behind a write.
+static struct block_request* block_next(struct block_queue* queue) {
+    if (queue->sorted == NULL)
+        return NULL;
+
+    uint32_t now = pit_get_ticks();
+    struct block_request* command = NULL;
+    for (int write = 0; write < 2; write++) {
+        struct block_request* oldest = queue->fifo_head[write];
+        if (oldest != NULL && (int32_t)(now - oldest->deadline) >= 0 &&
+            (command == NULL || (int32_t)(oldest->deadline - command->deadline) < 0))
+            command = oldest;
+    }
+
+    if (command != NULL) {
+        queue->stats.expired++;
+    } else {
+        command = queue->sorted;
+        while (command != NULL && command->lba < queue->position)
+            command = command->next;
+        if (command == NULL)
+            command = queue->sorted;
+    }
+
+    struct block_request** link = &queue->sorted;
+    while (*link != command)
+        link = &(*link)->next;
+    *link = command->next;
+    fifo_remove(queue, command);
+
+    queue->position = command->lba + command->sectors;
+    return command;
+}
+
+// Hand one command to the driver and complete its requests
+static void block_dispatch(struct block_queue* queue, struct block_request* command) {
+    blockdev_t* dev = queue->dev;
+    bool ok;
+
+    if (command->merged == NULL) {
+        ok = command->write ? blockdev_write(dev, command->lba, command->count, command->buffer)
+                            : blockdev_read(dev, command->lba, command->count, command->buffer);
+    } else {
+        blockdev_segment_t segments[BLOCKDEV_MAX_SEGMENTS];
+        uint32_t count = 0;
+        for (struct block_request* r = command; r != NULL; r = r->merged) {
+            segments[count].buffer = r->buffer;
+            segments[count].sectors = r->count;
+            count++;
+        }
+        ok = blockdev_transfer(dev, command->write, command->lba, segments, count);
+    }
+
+    uint64_t now = read_tsc();
+    uint32_t flags = interrupts_save();
+    queue->stats.dispatched++;
+    interrupts_restore(flags);
+
+    struct block_request* next;
+    for (struct block_request* r = command; r != NULL; r = next) {
+        // The callback may reuse the request
+        next = r->merged;
+
+        uint64_t latency = now - r->submitted;
+        flags = interrupts_save();
+        queue->stats.completed++;
+        queue->stats.depth--;
+        if (!ok)
+            queue->stats.errors++;
+        queue->latency_total += latency;
+        if (latency > queue->latency_max)
+            queue->latency_max = latency;
+        interrupts_restore(flags);
+
+        r->ok = ok;
+        r->completed = true;
+        if (r->done != NULL)
+            r->done(r);
+    }
+}
+
+// Dispatch until the queue is empty, or until somebody plugs it (a
+// completion callback may) unless force is set
+static void block_run(struct block_queue* queue, bool force) {
+    for (;;) {
+        uint32_t flags = interrupts_save();
+        struct block_request* command = NULL;
+        if (force || queue->plugged == 0)
+            command = block_next(queue);
+        interrupts_restore(flags);
+
+        if (command == NULL)
+            break;
+        block_dispatch(queue, command);
+    }
+}
+
+void block_plug(blockdev_t* dev) {
+    struct block_queue* queue = block_queue(dev);
+    if (queue == NULL)
+        return;
+
+    uint32_t flags = interrupts_save();
+    if (queue->plugged++ == 0)
+        queue->plug_tick = pit_get_ticks();
+    interrupts_restore(flags);
+}
+
+void block_unplug(blockdev_t* dev) {
+    struct block_queue* queue = dev->queue;
+    if (queue == NULL)
+        return;
+
+    uint32_t flags = interrupts_save();
+    if (queue->plugged > 0)
+        queue->plugged--;
+    bool run = queue->plugged == 0;
+    interrupts_restore(flags);
+
+    if (run)
+        block_run(queue, false);
+}
+
+bool block_wait(struct block_request* request) {
+    struct block_queue* queue = request->dev->queue;
+    while (!request->completed) {
+        // Once the queue is empty the request can only have been lost to a
+        // failed submission
+        if (queue == NULL || queue->sorted == NULL)
+            return false;
+        block_run(queue, true);
+    }
+    return request->ok;
+}
+
+bool block_read(blockdev_t* dev, uint32_t lba, uint32_t count, void* buffer) {
+    struct block_request request;
+    block_request_init(&request, dev, false, lba, count, buffer, NULL, NULL);
+    return block_submit(&request) && block_wait(&request);
+}
+
+bool block_write(blockdev_t* dev, uint32_t lba, uint32_t count, const void* buffer) {
+    struct block_request request;
+    block_request_init(&request, dev, true, lba, count, (void*)buffer, NULL, NULL);
+    return block_submit(&request) && block_wait(&request);
+}
+
+void block_run_queue(blockdev_t* dev) {
+    if (dev->queue != NULL)
+        block_run(dev->queue, true);
+}
+
+// Run every unplugged queue, and unplug those held for too long: whoever
+// plugged them is evidently not coming back soon
+static void block_idle(void* ctx) {
+    (void)ctx;
+    uint32_t now = pit_get_ticks();
+    for (uint32_t i = 0; i < queue_count; i++) {
+        struct block_queue* queue = &queues[i];
+        if (queue->sorted == NULL)
+            continue;
+
+        uint32_t flags = interrupts_save();
+        if (queue->plugged > 0 && now - queue->plug_tick >= BLOCK_PLUG_MS * TICKS_PER_MS)
+            queue->plugged = 0;
+        interrupts_restore(flags);
+
+        block_run(queue, false);
+    }
+}
+
+void init_block() {
+    register_idle_handler(block_idle, NULL);
+}
+
+static uint32_t block_cycles_to_us(uint64_t cycles) {
+    uint32_t per_ms = pit_tsc_per_ms();
+    if (per_ms == 0)
+        return 0;
+    return (uint32_t)div64_32(cycles * 1000, per_ms, NULL);
+}
+
+void block_get_stats(blockdev_t* dev, struct block_queue_stats* stats) {
+    struct block_queue* queue = dev->queue;
+    if (queue == NULL) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    uint32_t flags = interrupts_save();
+    *stats = queue->stats;
+    uint64_t total = queue->latency_total;
+    uint64_t max = queue->latency_max;
+    interrupts_restore(flags);
+
+    stats->average_latency_us = stats->completed != 0
+        ? block_cycles_to_us(div64_32(total, stats->completed, NULL)) : 0;
+    stats->max_latency_us = block_cycles_to_us(max);
+}
+
+void block_reset_stats(blockdev_t* dev) {
+    struct block_queue* queue = dev->queue;
+    if (queue == NULL)
+        return;
+
+    uint32_t flags = interrupts_save();
+    uint32_t depth = queue->stats.depth;
+    memset(&queue->stats, 0, sizeof(queue->stats));
+    queue->stats.depth = depth;
+    queue->stats.max_depth = depth;
+    queue->latency_total = 0;
+    queue->latency_max = 0;
+    interrupts_restore(flags);
+}
@@ -0,0 +1,98 @@
+#include "blockdev.h"
+
+static blockdev_t* devices[BLOCKDEV_MAX_DEVICES];
+static uint32_t device_count = 0;
+
+int blockdev_register(blockdev_t* dev) {
+    if (device_count == BLOCKDEV_MAX_DEVICES)
+        return -1;
+    devices[device_count++] = dev;
+    return 0;
+}
+
+uint32_t blockdev_count() {
+    return device_count;
+}
+
+blockdev_t* blockdev_get(uint32_t index) {
+    return index < device_count ? devices[index] : NULL;
+}
+
+blockdev_t* blockdev_find(const char* name) {
+    for (uint32_t i = 0; i < device_count; i++) {
+        if (strcmp(devices[i]->name, name) == 0)
+            return devices[i];
+    }
+    return NULL;
+}
+
+static bool blockdev_in_range(const blockdev_t* dev, uint32_t lba, uint32_t count) {
+    return lba <= dev->sectors && count <= dev->sectors - lba;
+}
+
+bool blockdev_read(blockdev_t* dev, uint32_t lba, uint32_t count, void* buffer) {
+    if (!blockdev_in_range(dev, lba, count))
+        return false;
+
+    uint8_t* bytes = buffer;
+    while (count > 0) {
+        uint32_t chunk = count < dev->max_sectors ? count : dev->max_sectors;
+        if (!dev->read(dev, lba, chunk, bytes)) {
+            dev->errors++;
+            return false;
+        }
+        dev->reads++;
+        dev->sectors_read += chunk;
+        lba += chunk;
+        count -= chunk;
+        bytes += chunk * BLOCKDEV_SECTOR_SIZE;
+    }
+    return true;
+}
+
+bool blockdev_write(blockdev_t* dev, uint32_t lba, uint32_t count, const void* buffer) {
+    if (dev->read_only || !blockdev_in_range(dev, lba, count))
+        return false;
+
+    const uint8_t* bytes = buffer;
+    while (count > 0) {
+        uint32_t chunk = count < dev->max_sectors ? count : dev->max_sectors;
+        if (!dev->write(dev, lba, chunk, bytes)) {
+            dev->errors++;
+            return false;
+        }
+        dev->writes++;
+        dev->sectors_written += chunk;
+        lba += chunk;
+        count -= chunk;
+        bytes += chunk * BLOCKDEV_SECTOR_SIZE;
+    }
+    return true;
+}
+
+bool blockdev_flush(blockdev_t* dev) {
+    return dev->flush == NULL || dev->flush(dev);
+}
+
+bool blockdev_transfer(blockdev_t* dev, bool write, uint32_t lba,
+                       const blockdev_segment_t* segments, uint32_t count) {
+    uint32_t sectors = 0;
+    for (uint32_t i = 0; i < count; i++)
+        sectors += segments[i].sectors;
+    if ((write && dev->read_only) || !blockdev_in_range(dev, lba, sectors) ||
+        sectors > dev->max_sectors || count > dev->max_segments)
+        return false;
+
+    if (!dev->transfer(dev, write, lba, segments, count)) {
+        dev->errors++;
+        return false;
+    }
+    if (write) {
+        dev->writes++;
+        dev->sectors_written += sectors;
+    } else {
+        dev->reads++;
+        dev->sectors_read += sectors;
+    }
+    return true;
+}
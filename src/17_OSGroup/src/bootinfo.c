@@ -0,0 +1,69 @@
+#include "bootinfo.h"
+#include "memory/memory.h"
+
+// Copy of the multiboot2 information: total size, reserved, then the tags
+static uint8_t bootinfo[BOOTINFO_MAX_SIZE] __attribute__((aligned(MULTIBOOT_TAG_ALIGN)));
+static bool bootinfo_valid = false;
+
+// Copies of the boot modules
+static uint8_t bootinfo_modules[BOOTINFO_MODULE_SPACE] __attribute__((aligned(16)));
+
+// Move every module into the kernel image, where paging will not hide it
+static void bootinfo_copy_modules()
+{
+    uint32_t used = 0;
+    struct multiboot_tag* tag = NULL;
+    while ((tag = bootinfo_find_tag(MULTIBOOT_TAG_TYPE_MODULE, tag)) != NULL) {
+        struct multiboot_tag_module* module = (struct multiboot_tag_module*)tag;
+        uint32_t size = module->mod_end - module->mod_start;
+        if (module->mod_end < module->mod_start || size > BOOTINFO_MODULE_SPACE - used) {
+            module->mod_start = 0;
+            module->mod_end = 0;
+            continue;
+        }
+
+        memcpy(bootinfo_modules + used, (const void*)module->mod_start, size);
+        module->mod_start = (uint32_t)(bootinfo_modules + used);
+        module->mod_end = module->mod_start + size;
+        used = (used + size + 15) & ~15;
+    }
+}
+
+bool bootinfo_init(uint32_t magic, const void* info)
+{
+    if (magic != MULTIBOOT2_BOOTLOADER_MAGIC || info == NULL)
+        return false;
+
+    uint32_t size = *(const uint32_t*)info;
+    if (size > BOOTINFO_MAX_SIZE)
+        return false;
+
+    memcpy(bootinfo, info, size);
+    bootinfo_valid = true;
+    bootinfo_copy_modules();
+    return true;
+}
+
+struct multiboot_tag* bootinfo_find_tag(uint32_t type, struct multiboot_tag* after)
+{
+    if (!bootinfo_valid)
+        return NULL;
+
+    uint8_t* end = bootinfo + *(uint32_t*)bootinfo;
+    uint8_t* next;
+    if (after == NULL)
+        next = bootinfo + 8;
+    else
+        next = (uint8_t*)after + ((after->size + MULTIBOOT_TAG_ALIGN - 1) & ~(MULTIBOOT_TAG_ALIGN - 1));
+
+    // Tags are padded to 8 bytes and the list ends with an END tag
+    while (next + sizeof(struct multiboot_tag) <= end) {
+        struct multiboot_tag* tag = (struct multiboot_tag*)next;
+        if (tag->type == MULTIBOOT_TAG_TYPE_END)
+            break;
+        if (tag->type == type)
+            return tag;
+        next += (tag->size + MULTIBOOT_TAG_ALIGN - 1) & ~(MULTIBOOT_TAG_ALIGN - 1);
+    }
+    return NULL;
+}
@@ -18,4 +18,43 @@ uint16_t inw(uint16_t port)
    uint16_t ret;
    asm volatile ("inw %1, %0" : "=a" (ret) : "dN" (port));
    return ret;
-}
\ No newline at end of file
+}
+
+void outw(uint16_t port, uint16_t value)
+{
+    asm volatile ("outw %1, %0" : : "dN" (port), "a" (value));
+}
+
+void outl(uint16_t port, uint32_t value)
+{
+    asm volatile ("outl %1, %0" : : "dN" (port), "a" (value));
+}
+
+uint32_t inl(uint16_t port)
+{
+   uint32_t ret;
+   asm volatile ("inl %1, %0" : "=a" (ret) : "dN" (port));
+   return ret;
+}
+
+void insw(uint16_t port, void* buffer, uint32_t count)
+{
+   asm volatile ("rep insw" : "+D" (buffer), "+c" (count) : "d" (port) : "memory");
+}
+
+void outsw(uint16_t port, const void* buffer, uint32_t count)
+{
+   asm volatile ("rep outsw" : "+S" (buffer), "+c" (count) : "d" (port) : "memory");
+}
+
+uint32_t interrupts_save()
+{
+   uint32_t flags;
+   asm volatile ("pushf; pop %0; cli" : "=r" (flags) : : "memory");
+   return flags;
+}
+
+void interrupts_restore(uint32_t flags)
+{
+   asm volatile ("push %0; popf" : : "r" (flags) : "memory", "cc");
+}
@@ -0,0 +1,55 @@
+#include "console.h"
+#include "common.h"
+#include "monitor.h"
+#include "drivers/serial.h"
+
+static char console_buffer[CONSOLE_BUFFER_SIZE];
+static size_t console_length = 0;
+static bool serial_mirror = false;
+
+// Hand the buffered text to the monitor. Must be called with interrupts off.
+static void console_flush_locked()
+{
+    if (console_length == 0)
+        return;
+    monitor_write(console_buffer, console_length);
+    // Only queued here, the UART interrupt sends it
+    if (serial_mirror)
+        serial_write(console_buffer, console_length);
+    console_length = 0;
+}
+
+void console_putc(char c)
+{
+    console_write(&c, 1);
+}
+
+void console_write(const char* data, size_t size)
+{
+    // Output can come from interrupt handlers as well, keep them out while
+    // the buffer is being modified
+    uint32_t flags = interrupts_save();
+
+    for (size_t i = 0; i < size; i++) {
+        if (console_length == CONSOLE_BUFFER_SIZE)
+            console_flush_locked();
+        console_buffer[console_length++] = data[i];
+        if (data[i] == '\n')
+            console_flush_locked();
+    }
+
+    interrupts_restore(flags);
+}
+
+void console_flush()
+{
+    uint32_t flags = interrupts_save();
+    console_flush_locked();
+    interrupts_restore(flags);
+}
+
+void console_set_serial_mirror(bool enabled)
+{
+    console_flush();
+    serial_mirror = enabled && serial_present();
+}
@@ -0,0 +1,271 @@
+#include "drivers/ac97.h"
+#include "drivers/pci.h"
+#include "memory/memory.h"
+#include "interrupts.h"
+#include "common.h"
+#include "idle.h"
+#include "pit.h"
+
+// Mixer registers (NAM, BAR0)
+#define NAM_RESET          0x00
+#define NAM_MASTER_VOLUME  0x02
+#define NAM_PCM_VOLUME     0x18
+#define NAM_EXT_ID         0x28
+#define NAM_EXT_CONTROL    0x2A
+#define NAM_FRONT_RATE     0x2C
+
+#define EXT_VRA            0x0001   // Variable rate audio
+
+// Bus master registers (NABM, BAR1). PCM out is the box at 0x10.
+#define NABM_PO_BDBAR      0x10
+#define NABM_PO_CIV        0x14     // Current index value
+#define NABM_PO_LVI        0x15     // Last valid index
+#define NABM_PO_SR         0x16
+#define NABM_PO_CR         0x1B
+#define NABM_GLOB_CNT      0x2C
+
+#define GLOB_CNT_COLD_RESET 0x02    // Set to take the codec out of reset
+
+#define SR_DCH             0x01     // DMA halted
+#define SR_LVBCI           0x04     // Last valid buffer completed
+#define SR_BCIS            0x08     // Buffer completed (IOC)
+#define SR_FIFOE           0x10     // FIFO error
+#define SR_CLEAR           (SR_LVBCI | SR_BCIS | SR_FIFOE)
+
+#define CR_RPBM            0x01     // Run
+#define CR_RR              0x02     // Reset the box registers
+#define CR_LVBIE           0x04
+#define CR_FEIE            0x08
+#define CR_IOCE            0x10
+
+// The BDL always has 32 entries, indexes wrap around
+#define BDL_ENTRIES        32
+#define BDL_IOC            0x8000   // Interrupt when this buffer completes
+
+#define AC97_TIMEOUT       100000
+
+struct bdl_entry {
+    uint32_t address;
+    uint16_t samples;       // 16-bit samples, so two per stereo frame
+    uint16_t flags;
+} __attribute__((packed));
+
+// Kernel memory is identity mapped, so these addresses are physical too
+static struct bdl_entry bdl[BDL_ENTRIES] __attribute__((aligned(8)));
+static int16_t buffers[AC97_BUFFERS][AC97_BUFFER_FRAMES * 2] __attribute__((aligned(4)));
+
+static bool present = false;
+static uint16_t nam = 0;
+static uint16_t nabm = 0;
+static uint32_t sample_rate = AC97_FIXED_RATE;
+
+static audio_source_t* source = NULL;
+static volatile bool active = false;
+static bool running = false;
+static volatile bool source_done = false;
+
+// Next BDL entry to render, one past the last valid index
+static uint32_t head = 0;
+
+static volatile struct ac97_stats stats;
+
+static int ac97_irq(registers_t* regs, void* ctx) {
+    uint16_t status = inw(nabm + NABM_PO_SR);
+    if (!(status & SR_CLEAR))
+        return IRQ_NONE;
+
+    // Write-one-to-clear. The refill itself happens in ac97_pump(), which
+    // idle() runs as soon as this interrupt has woken the CPU.
+    outw(nabm + NABM_PO_SR, status & SR_CLEAR);
+    stats.interrupts++;
+    if ((status & SR_LVBCI) && !source_done)
+        stats.underruns++;
+    return IRQ_HANDLED;
+}
+
+// Render the buffer behind a BDL entry. The source writes 8-bit mono into
+// the last quarter of the buffer, which is then widened to 16-bit stereo
+// front to back: output frame i ends at byte 4i+3, never past input byte
+// 3N+i, so nothing is overwritten before it has been read.
+static bool ac97_render(uint32_t entry) {
+    uint8_t* bytes = (uint8_t*)buffers[entry % AC97_BUFFERS];
+    uint8_t* in = bytes + AC97_BUFFER_FRAMES * 3;
+    int16_t* out = (int16_t*)bytes;
+
+    uint32_t count = source->read(source, in, AC97_BUFFER_FRAMES);
+    if (count == 0)
+        return false;
+    if (count < AC97_BUFFER_FRAMES)
+        memset(in + count, AUDIO_SILENCE, AC97_BUFFER_FRAMES - count);
+
+    for (uint32_t i = 0; i < AC97_BUFFER_FRAMES; i++) {
+        int16_t value = (int16_t)((in[i] - AUDIO_SILENCE) << 8);
+        out[2 * i] = value;
+        out[2 * i + 1] = value;
+    }
+    stats.buffers++;
+    return true;
+}
+
+void ac97_pump() {
+    if (!active)
+        return;
+
+    // Entries from the current index up to head are queued or playing,
+    // the rest of the ring is free
+    while (!source_done) {
+        uint32_t current = inb(nabm + NABM_PO_CIV);
+        if (((head - current) & (BDL_ENTRIES - 1)) >= AC97_BUFFERS)
+            break;
+        if (!ac97_render(head)) {
+            source_done = true;
+            break;
+        }
+
+        // A halted DMA picks up again once the last valid index moves
+        outb(nabm + NABM_PO_LVI, head);
+        head = (head + 1) & (BDL_ENTRIES - 1);
+    }
+
+    // Once the source is drained the DMA stops at the last valid entry
+    if (source_done && running && (inw(nabm + NABM_PO_SR) & SR_DCH))
+        ac97_stop();
+}
+
+static void ac97_idle(void* ctx) {
+    ac97_pump();
+}
+
+// Stop the PCM out box and reset its registers
+static void ac97_reset_box() {
+    outb(nabm + NABM_PO_CR, 0);
+    outb(nabm + NABM_PO_CR, CR_RR);
+    for (int i = 0; i < AC97_TIMEOUT && (inb(nabm + NABM_PO_CR) & CR_RR); i++) {}
+    outw(nabm + NABM_PO_SR, SR_CLEAR);
+}
+
+static audio_output_t ac97_output = {
+    "ac97", AC97_FIXED_RATE, ac97_start, ac97_stop, ac97_active
+};
+
+static bool ac97_probe(struct pci_device* device) {
+    // Both register blocks must be I/O BARs
+    if (present || !device->bars[0].io || !device->bars[1].io ||
+        device->interrupt_line == PCI_INTERRUPT_NONE)
+        return false;
+
+    pci_enable(device->address, PCI_COMMAND_IO | PCI_COMMAND_BUS_MASTER);
+    nam = device->bars[0].base;
+    nabm = device->bars[1].base;
+    uint8_t irq = device->interrupt_line;
+
+    // Take the codec out of reset, then reset the mixer to its defaults
+    outl(nabm + NABM_GLOB_CNT, GLOB_CNT_COLD_RESET);
+    sleep_busy(1);
+    outw(nam + NAM_RESET, 1);
+
+    // Full master volume, PCM a little below unity gain, both unmuted
+    outw(nam + NAM_MASTER_VOLUME, 0x0000);
+    outw(nam + NAM_PCM_VOLUME, 0x0808);
+
+    if (inw(nam + NAM_EXT_ID) & EXT_VRA) {
+        outw(nam + NAM_EXT_CONTROL, inw(nam + NAM_EXT_CONTROL) | EXT_VRA);
+        outw(nam + NAM_FRONT_RATE, AC97_RATE);
+        sample_rate = inw(nam + NAM_FRONT_RATE);
+    } else {
+        sample_rate = AC97_FIXED_RATE;
+    }
+
+    // Every entry points at its buffer in the ring and interrupts when done
+    for (int i = 0; i < BDL_ENTRIES; i++) {
+        bdl[i].address = (uint32_t)buffers[i % AC97_BUFFERS];
+        bdl[i].samples = AC97_BUFFER_FRAMES * 2;
+        bdl[i].flags = BDL_IOC;
+    }
+    ac97_reset_box();
+
+    if (register_irq_handler(irq, ac97_irq, NULL) != 0)
+        return false;
+
+    present = true;
+    ac97_output.sample_rate = sample_rate;
+    audio_register_output(&ac97_output);
+    return true;
+}
+
+static const struct pci_device_id ac97_ids[] = {
+    { AC97_VENDOR_ID, AC97_DEVICE_ID, PCI_ANY_CLASS, PCI_ANY_CLASS },
+    { 0 },
+};
+
+static const struct pci_driver ac97_driver = { "ac97", ac97_ids, ac97_probe };
+
+bool init_ac97() {
+    pci_register_driver(&ac97_driver);
+    return present;
+}
+
+bool ac97_present() {
+    return present;
+}
+
+uint32_t ac97_sample_rate() {
+    return sample_rate;
+}
+
+bool ac97_start(audio_source_t* new_source) {
+    if (!present || active)
+        return false;
+
+    ac97_reset_box();
+    outl(nabm + NABM_PO_BDBAR, (uint32_t)bdl);
+
+    source = new_source;
+    source_done = false;
+    head = 0;
+    active = true;
+
+    // Queue the whole ring before the DMA starts
+    running = false;
+    ac97_pump();
+    if (head == 0) {
+        // Nothing to play at all
+        active = false;
+        return false;
+    }
+
+    running = true;
+    outb(nabm + NABM_PO_CR, CR_RPBM | CR_IOCE | CR_LVBIE | CR_FEIE);
+    register_idle_handler(ac97_idle, NULL);
+    return true;
+}
+
+void ac97_stop() {
+    if (!active)
+        return;
+
+    ac97_reset_box();
+    running = false;
+    active = false;
+    unregister_idle_handler(ac97_idle, NULL);
+}
+
+bool ac97_active() {
+    return active;
+}
+
+void ac97_get_stats(struct ac97_stats* out) {
+    uint32_t flags = interrupts_save();
+    out->interrupts = stats.interrupts;
+    out->buffers = stats.buffers;
+    out->underruns = stats.underruns;
+    interrupts_restore(flags);
+}
+
+void ac97_reset_stats() {
+    uint32_t flags = interrupts_save();
+    stats.interrupts = 0;
+    stats.buffers = 0;
+    stats.underruns = 0;
+    interrupts_restore(flags);
+}
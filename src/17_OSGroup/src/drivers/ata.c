@@ -0,0 +1,555 @@
+#include "drivers/ata.h"
+#include "drivers/pci.h"
+#include "interrupts.h"
+#include "common.h"
+#include "pit.h"
+#include "memory/memory.h"
+
+// Command block registers, offsets from the channel's I/O base
+#define ATA_REG_DATA     0
+#define ATA_REG_ERROR    1
+#define ATA_REG_COUNT    2
+#define ATA_REG_LBA0     3
+#define ATA_REG_LBA1     4
+#define ATA_REG_LBA2     5
+#define ATA_REG_DRIVE    6
+#define ATA_REG_STATUS   7      // Reading it acknowledges the interrupt
+#define ATA_REG_COMMAND  7
+
+// Control block: alternate status when read, device control when written
+#define ATA_CTRL_NIEN    0x02   // Keep the drive from raising interrupts
+#define ATA_CTRL_SRST    0x04   // Software reset of both drives on the channel
+
+#define ATA_STATUS_ERR   0x01
+#define ATA_STATUS_DRQ   0x08
+#define ATA_STATUS_DF    0x20
+#define ATA_STATUS_DRDY  0x40
+#define ATA_STATUS_BSY   0x80
+
+#define ATA_DRIVE_LBA    0xE0   // LBA addressing, plus bit 4 for the slave
+#define ATA_DRIVE_SLAVE  0x10
+
+#define ATA_CMD_READ_PIO      0x20
+#define ATA_CMD_READ_PIO_EXT  0x24
+#define ATA_CMD_READ_DMA_EXT  0x25
+#define ATA_CMD_WRITE_PIO     0x30
+#define ATA_CMD_WRITE_PIO_EXT 0x34
+#define ATA_CMD_WRITE_DMA_EXT 0x35
+#define ATA_CMD_READ_DMA      0xC8
+#define ATA_CMD_WRITE_DMA     0xCA
+#define ATA_CMD_FLUSH         0xE7
+#define ATA_CMD_FLUSH_EXT     0xEA
+#define ATA_CMD_IDENTIFY      0xEC
+
+// IDENTIFY data, in 16-bit words
+#define ATA_ID_MODEL         27     // 40 characters, bytes swapped
+#define ATA_ID_CAPABILITIES  49
+#define ATA_ID_SECTORS       60     // LBA28 capacity, two words
+#define ATA_ID_COMMAND_SETS  83
+#define ATA_ID_SECTORS_EXT   100    // LBA48 capacity, four words
+
+#define ATA_CAP_DMA          0x0100
+#define ATA_CAP_LBA          0x0200
+#define ATA_SET_LBA48        0x0400
+
+// Bus master IDE registers, per channel (the secondary is 8 bytes up)
+#define BM_REG_COMMAND   0
+#define BM_REG_STATUS    2
+#define BM_REG_PRDT      4
+#define BM_CHANNEL_SIZE  8
+
+#define BM_CMD_START     0x01
+#define BM_CMD_READ      0x08   // Device to memory
+
+#define BM_STATUS_ACTIVE 0x01
+#define BM_STATUS_ERROR  0x02
+#define BM_STATUS_IRQ    0x04
+#define BM_STATUS_KEEP   0x60   // Drive DMA capable bits, written back as read
+
+// PCI programming interface bits of an IDE controller
+#define IDE_PRIMARY_NATIVE   0x01
+#define IDE_SECONDARY_NATIVE 0x04
+#define IDE_BUS_MASTER       0x80
+#define IDE_BAR_BUS_MASTER   4
+
+// A PRD entry describes one piece of the buffer, which must not cross a
+// 64 KiB boundary. A byte count of 0 means 64 KiB.
+#define PRD_END_OF_TABLE 0x8000
+#define PRD_ENTRIES      32     // Enough for BLOCKDEV_MAX_SEGMENTS pieces
+#define PRD_BOUNDARY     0x10000
+
+// Status polls before a PIO wait is given up
+#define ATA_POLL_LIMIT   1000000
+
+// ata_delay() calls covering the 2 ms a drive may take to raise BSY after
+// a software reset
+#define ATA_RESET_DELAYS 5000
+
+#define LBA28_LIMIT      0x10000000
+
+struct ata_prd {
+    uint32_t address;
+    uint16_t bytes;
+    uint16_t flags;
+} __attribute__((packed));
+
+struct ata_channel {
+    uint16_t io;
+    uint16_t ctrl;
+    uint16_t bus_master;        // 0 if the channel cannot do DMA
+    uint8_t irq;
+    uint8_t selected;           // Last value written to the drive register
+    volatile bool done;         // Set by the interrupt handler
+    volatile uint8_t status;    // Drive status read by the interrupt handler
+    volatile uint8_t bm_status; // Bus master status read by the interrupt handler
+    bool stuck;                 // Still busy after a reset, takes no more commands
+    // Aligned to its size so it cannot cross a 64 KiB boundary either
+    struct ata_prd prd[PRD_ENTRIES] __attribute__((aligned(PRD_ENTRIES * 8)));
+};
+
+struct ata_drive {
+    struct ata_channel* channel;
+    bool slave;
+    bool present;
+    bool lba48;
+    bool dma;                   // The drive and channel can do DMA
+    uint32_t sectors;
+    char model[41];
+    blockdev_t dev;
+};
+
+static struct ata_channel channels[ATA_CHANNELS];
+static struct ata_drive drives[ATA_DRIVES];
+static bool controller_found = false;
+static bool dma_enabled = true;
+static struct ata_stats stats;
+
+// About 400 ns for the drive to put up a valid status after a select
+static void ata_delay(struct ata_channel* channel) {
+    for (int i = 0; i < 4; i++)
+        inb(channel->ctrl);
+}
+
+// Wait until the drive is no longer busy, returns its status
+static uint8_t ata_wait_ready(struct ata_channel* channel) {
+    uint8_t status = ATA_STATUS_BSY;
+    for (int i = 0; i < ATA_POLL_LIMIT && (status & ATA_STATUS_BSY); i++)
+        status = inb(channel->io + ATA_REG_STATUS);
+    return status;
+}
+
+// Wait for the drive to ask for or offer the next sector
+static bool ata_wait_drq(struct ata_channel* channel) {
+    for (int i = 0; i < ATA_POLL_LIMIT; i++) {
+        uint8_t status = inb(channel->io + ATA_REG_STATUS);
+        if (status & (ATA_STATUS_ERR | ATA_STATUS_DF))
+            return false;
+        if (!(status & ATA_STATUS_BSY) && (status & ATA_STATUS_DRQ))
+            return true;
+    }
+    return false;
+}
+
+static void ata_select(struct ata_drive* drive, uint8_t lba_high) {
+    struct ata_channel* channel = drive->channel;
+    uint8_t value = ATA_DRIVE_LBA | (drive->slave ? ATA_DRIVE_SLAVE : 0) | (lba_high & 0x0F);
+    if (value != channel->selected) {
+        outb(channel->io + ATA_REG_DRIVE, value);
+        channel->selected = value;
+        ata_delay(channel);
+    }
+}
+
+// Load the address registers. The 48-bit form writes every register twice,
+// high order bytes first.
+static void ata_set_address(struct ata_drive* drive, uint32_t lba, uint32_t count, bool lba48) {
+    struct ata_channel* channel = drive->channel;
+    ata_select(drive, lba48 ? 0 : lba >> 24);
+    ata_wait_ready(channel);
+
+    if (lba48) {
+        outb(channel->io + ATA_REG_COUNT, count >> 8);
+        outb(channel->io + ATA_REG_LBA0, lba >> 24);
+        outb(channel->io + ATA_REG_LBA1, 0);
+        outb(channel->io + ATA_REG_LBA2, 0);
+    }
+    outb(channel->io + ATA_REG_COUNT, count & 0xFF);   // 0 means 256 in LBA28
+    outb(channel->io + ATA_REG_LBA0, lba & 0xFF);
+    outb(channel->io + ATA_REG_LBA1, (lba >> 8) & 0xFF);
+    outb(channel->io + ATA_REG_LBA2, (lba >> 16) & 0xFF);
+}
+
+static bool ata_needs_lba48(uint32_t lba, uint32_t count) {
+    return lba >= LBA28_LIMIT || count > LBA28_LIMIT - lba;
+}
+
+static bool ata_pio(struct ata_drive* drive, uint32_t lba, const blockdev_segment_t* segments,
+                    uint32_t segment_count, uint32_t count, bool write) {
+    struct ata_channel* channel = drive->channel;
+    bool lba48 = ata_needs_lba48(lba, count);
+    uint8_t command = write ? (lba48 ? ATA_CMD_WRITE_PIO_EXT : ATA_CMD_WRITE_PIO)
+                            : (lba48 ? ATA_CMD_READ_PIO_EXT : ATA_CMD_READ_PIO);
+
+    // Sectors are polled for, so keep the drive quiet
+    outb(channel->ctrl, ATA_CTRL_NIEN);
+    ata_set_address(drive, lba, count, lba48);
+    outb(channel->io + ATA_REG_COMMAND, command);
+
+    for (uint32_t s = 0; s < segment_count; s++) {
+        uint16_t* words = segments[s].buffer;
+        for (uint32_t i = 0; i < segments[s].sectors; i++) {
+            if (!ata_wait_drq(channel)) {
+                stats.errors++;
+                return false;
+            }
+            if (write)
+                outsw(channel->io + ATA_REG_DATA, words, BLOCKDEV_SECTOR_SIZE / 2);
+            else
+                insw(channel->io + ATA_REG_DATA, words, BLOCKDEV_SECTOR_SIZE / 2);
+            words += BLOCKDEV_SECTOR_SIZE / 2;
+        }
+    }
+
+    uint8_t status = ata_wait_ready(channel);
+    stats.pio_transfers++;
+    if (status & (ATA_STATUS_ERR | ATA_STATUS_DF | ATA_STATUS_BSY)) {
+        stats.errors++;
+        return false;
+    }
+    return true;
+}
+
+// Describe the segments to the bus master, split at 64 KiB boundaries. The
+// kernel is identity mapped, so buffer addresses are physical addresses.
+// Fails if a buffer is not word aligned or the table is too small.
+static bool ata_build_prd(struct ata_channel* channel, const blockdev_segment_t* segments, uint32_t segment_count) {
+    uint32_t entry = 0;
+    for (uint32_t s = 0; s < segment_count; s++) {
+        uint32_t address = (uint32_t)segments[s].buffer;
+        uint32_t bytes = segments[s].sectors * BLOCKDEV_SECTOR_SIZE;
+        if (address & 1)
+            return false;
+        while (bytes > 0) {
+            if (entry == PRD_ENTRIES)
+                return false;
+            uint32_t chunk = PRD_BOUNDARY - (address & (PRD_BOUNDARY - 1));
+            if (chunk > bytes)
+                chunk = bytes;
+            channel->prd[entry].address = address;
+            channel->prd[entry].bytes = chunk & 0xFFFF;
+            channel->prd[entry].flags = 0;
+            address += chunk;
+            bytes -= chunk;
+            entry++;
+        }
+    }
+    if (entry == 0)
+        return false;
+    channel->prd[entry - 1].flags = PRD_END_OF_TABLE;
+    return true;
+}
+
+// Wait for the completion interrupt. sti; hlt cannot lose a wakeup, the
+// interrupt is only taken after the hlt has started. With interrupts off
+// (early boot) the bus master status is polled instead.
+static bool ata_wait_dma(struct ata_channel* channel) {
+    uint32_t flags = interrupts_save();
+    if (!(flags & 0x200)) {
+        for (int i = 0; i < ATA_POLL_LIMIT * 10; i++) {
+            uint8_t bm_status = inb(channel->bus_master + BM_REG_STATUS);
+            if (bm_status & BM_STATUS_IRQ) {
+                outb(channel->bus_master + BM_REG_STATUS, (bm_status & BM_STATUS_KEEP) | BM_STATUS_IRQ | BM_STATUS_ERROR);
+                channel->bm_status = bm_status;
+                channel->status = inb(channel->io + ATA_REG_STATUS);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint32_t start = pit_get_ticks();
+    while (!channel->done) {
+        if (pit_get_ticks() - start >= ATA_TIMEOUT_MS * TICKS_PER_MS) {
+            interrupts_restore(flags);
+            return false;
+        }
+        asm volatile("sti; hlt; cli");
+    }
+    interrupts_restore(flags);
+    return true;
+}
+
+// Abort whatever the drives on the channel are doing. A DMA command that
+// timed out is still running in the drive, which leaves BSY set and
+// ignores anything else written to the command block until it is reset.
+static void ata_reset(struct ata_channel* channel) {
+    outb(channel->bus_master + BM_REG_COMMAND, 0);
+    outb(channel->ctrl, ATA_CTRL_SRST | ATA_CTRL_NIEN);
+    ata_delay(channel);
+    outb(channel->ctrl, ATA_CTRL_NIEN);
+    for (int i = 0; i < ATA_RESET_DELAYS; i++)
+        ata_delay(channel);
+
+    channel->selected = 0;
+    channel->stuck = (ata_wait_ready(channel) & ATA_STATUS_BSY) != 0;
+    if (channel->stuck)
+        printf("ata: channel at 0x%x still busy after a reset, giving up on it\n", channel->io);
+}
+
+static bool ata_dma(struct ata_drive* drive, uint32_t lba, const blockdev_segment_t* segments,
+                    uint32_t segment_count, uint32_t count, bool write) {
+    struct ata_channel* channel = drive->channel;
+    uint16_t bm = channel->bus_master;
+    if (!ata_build_prd(channel, segments, segment_count))
+        return false;
+
+    bool lba48 = ata_needs_lba48(lba, count);
+    uint8_t command = write ? (lba48 ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_WRITE_DMA)
+                            : (lba48 ? ATA_CMD_READ_DMA_EXT : ATA_CMD_READ_DMA);
+    uint8_t direction = write ? 0 : BM_CMD_READ;
+
+    // Stop the engine, point it at the table and clear old status
+    outb(bm + BM_REG_COMMAND, 0);
+    outl(bm + BM_REG_PRDT, (uint32_t)channel->prd);
+    outb(bm + BM_REG_STATUS, (inb(bm + BM_REG_STATUS) & BM_STATUS_KEEP) | BM_STATUS_IRQ | BM_STATUS_ERROR);
+    outb(bm + BM_REG_COMMAND, direction);
+
+    channel->done = false;
+    outb(channel->ctrl, 0);
+    ata_set_address(drive, lba, count, lba48);
+    outb(channel->io + ATA_REG_COMMAND, command);
+    outb(bm + BM_REG_COMMAND, direction | BM_CMD_START);
+
+    bool completed = ata_wait_dma(channel);
+    outb(bm + BM_REG_COMMAND, direction);
+
+    if (!completed) {
+        stats.timeouts++;
+        ata_reset(channel);
+        return false;
+    }
+    stats.dma_transfers++;
+    if ((channel->status & (ATA_STATUS_ERR | ATA_STATUS_DF)) || (channel->bm_status & BM_STATUS_ERROR)) {
+        stats.errors++;
+        return false;
+    }
+    return true;
+}
+
+static bool ata_transfer(blockdev_t* dev, bool write, uint32_t lba,
+                         const blockdev_segment_t* segments, uint32_t segment_count) {
+    struct ata_drive* drive = dev->ctx;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < segment_count; i++)
+        count += segments[i].sectors;
+
+    // Anything DMA cannot describe goes by PIO, as does a retry once a
+    // timed out DMA command has been reset away
+    if (drive->channel->stuck)
+        return false;
+    if (dma_enabled && drive->dma && ata_dma(drive, lba, segments, segment_count, count, write))
+        return true;
+    if (drive->channel->stuck)
+        return false;
+    return ata_pio(drive, lba, segments, segment_count, count, write);
+}
+
+static bool ata_read(blockdev_t* dev, uint32_t lba, uint32_t count, void* buffer) {
+    blockdev_segment_t segment = { buffer, count };
+    return ata_transfer(dev, false, lba, &segment, 1);
+}
+
+static bool ata_write(blockdev_t* dev, uint32_t lba, uint32_t count, const void* buffer) {
+    blockdev_segment_t segment = { (void*)buffer, count };
+    return ata_transfer(dev, true, lba, &segment, 1);
+}
+
+static bool ata_flush(blockdev_t* dev) {
+    struct ata_drive* drive = dev->ctx;
+    struct ata_channel* channel = drive->channel;
+    if (channel->stuck)
+        return false;
+
+    outb(channel->ctrl, ATA_CTRL_NIEN);
+    ata_select(drive, 0);
+    ata_wait_ready(channel);
+    outb(channel->io + ATA_REG_COMMAND, drive->lba48 ? ATA_CMD_FLUSH_EXT : ATA_CMD_FLUSH);
+    return !(ata_wait_ready(channel) & (ATA_STATUS_ERR | ATA_STATUS_DF | ATA_STATUS_BSY));
+}
+
+static int ata_irq(registers_t* regs, void* ctx) {
+    struct ata_channel* channel = ctx;
+
+    uint8_t bm_status = inb(channel->bus_master + BM_REG_STATUS);
+    if (!(bm_status & BM_STATUS_IRQ))
+        return IRQ_NONE;
+
+    // Reading the status register makes the drive drop its interrupt
+    channel->status = inb(channel->io + ATA_REG_STATUS);
+    outb(channel->bus_master + BM_REG_STATUS, (bm_status & BM_STATUS_KEEP) | BM_STATUS_IRQ | BM_STATUS_ERROR);
+    channel->bm_status = bm_status;
+    channel->done = true;
+    stats.interrupts++;
+    return IRQ_HANDLED;
+}
+
+// IDENTIFY the drive and fill in what it reports. ATAPI and SATA devices
+// abort the command and are left alone.
+static bool ata_identify(struct ata_drive* drive) {
+    struct ata_channel* channel = drive->channel;
+    uint16_t id[256];
+
+    outb(channel->ctrl, ATA_CTRL_NIEN);
+    channel->selected = 0;
+    ata_select(drive, 0);
+    outb(channel->io + ATA_REG_COUNT, 0);
+    outb(channel->io + ATA_REG_LBA0, 0);
+    outb(channel->io + ATA_REG_LBA1, 0);
+    outb(channel->io + ATA_REG_LBA2, 0);
+    outb(channel->io + ATA_REG_COMMAND, ATA_CMD_IDENTIFY);
+
+    // No drive, or no channel at all (a floating bus reads 0xFF)
+    uint8_t status = inb(channel->io + ATA_REG_STATUS);
+    if (status == 0 || status == 0xFF)
+        return false;
+
+    status = ata_wait_ready(channel);
+    if ((status & ATA_STATUS_BSY) || inb(channel->io + ATA_REG_LBA1) != 0 || inb(channel->io + ATA_REG_LBA2) != 0)
+        return false;
+    if (!ata_wait_drq(channel))
+        return false;
+    insw(channel->io + ATA_REG_DATA, id, 256);
+
+    if (!(id[ATA_ID_CAPABILITIES] & ATA_CAP_LBA))
+        return false;
+
+    drive->lba48 = (id[ATA_ID_COMMAND_SETS] & ATA_SET_LBA48) != 0;
+    drive->sectors = id[ATA_ID_SECTORS] | ((uint32_t)id[ATA_ID_SECTORS + 1] << 16);
+    if (drive->lba48) {
+        // More than 2 TiB does not fit the 32-bit sector numbers used here
+        uint32_t high = id[ATA_ID_SECTORS_EXT + 2] | ((uint32_t)id[ATA_ID_SECTORS_EXT + 3] << 16);
+        drive->sectors = high != 0 ? 0xFFFFFFFF :
+                         id[ATA_ID_SECTORS_EXT] | ((uint32_t)id[ATA_ID_SECTORS_EXT + 1] << 16);
+    }
+    drive->dma = channel->bus_master != 0 && (id[ATA_ID_CAPABILITIES] & ATA_CAP_DMA);
+
+    // The model string has the bytes of every word swapped and is padded
+    // with spaces
+    for (int i = 0; i < 20; i++) {
+        drive->model[i * 2] = id[ATA_ID_MODEL + i] >> 8;
+        drive->model[i * 2 + 1] = id[ATA_ID_MODEL + i] & 0xFF;
+    }
+    int length = 40;
+    while (length > 0 && drive->model[length - 1] == ' ')
+        length--;
+    drive->model[length] = '\0';
+    return true;
+}
+
+static void ata_setup_channel(int index, uint16_t io, uint16_t ctrl, uint16_t bus_master, uint8_t irq) {
+    struct ata_channel* channel = &channels[index];
+    channel->io = io;
+    channel->ctrl = ctrl;
+    channel->bus_master = bus_master;
+    channel->irq = irq;
+    channel->selected = 0;
+    channel->stuck = false;
+}
+
+static bool ata_probe(struct pci_device* device) {
+    if (controller_found)
+        return false;
+
+    // Channels in native mode have their ports in BARs 0-3 and share the
+    // PCI interrupt; in compatibility mode they sit at the ISA addresses
+    uint16_t bus_master = 0;
+    if ((device->prog_if & IDE_BUS_MASTER) && device->bars[IDE_BAR_BUS_MASTER].io)
+        bus_master = device->bars[IDE_BAR_BUS_MASTER].base;
+
+    if (device->prog_if & IDE_PRIMARY_NATIVE)
+        ata_setup_channel(0, device->bars[0].base, device->bars[1].base + 2, bus_master, device->interrupt_line);
+    else
+        ata_setup_channel(0, ATA_PRIMARY_IO, ATA_PRIMARY_CTRL, bus_master, ATA_PRIMARY_IRQ);
+
+    uint16_t secondary_bm = bus_master ? bus_master + BM_CHANNEL_SIZE : 0;
+    if (device->prog_if & IDE_SECONDARY_NATIVE)
+        ata_setup_channel(1, device->bars[2].base, device->bars[3].base + 2, secondary_bm, device->interrupt_line);
+    else
+        ata_setup_channel(1, ATA_SECONDARY_IO, ATA_SECONDARY_CTRL, secondary_bm, ATA_SECONDARY_IRQ);
+
+    pci_enable(device->address, PCI_COMMAND_IO | (bus_master ? PCI_COMMAND_BUS_MASTER : 0));
+    controller_found = true;
+    return true;
+}
+
+static const struct pci_device_id ata_ids[] = {
+    { PCI_ANY_ID, PCI_ANY_ID, PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE },
+    { 0 },
+};
+
+static const struct pci_driver ata_driver = { "ata", ata_ids, ata_probe };
+
+uint32_t init_ata() {
+    pci_register_driver(&ata_driver);
+    if (!controller_found) {
+        // An ISA style controller: legacy ports, PIO only
+        ata_setup_channel(0, ATA_PRIMARY_IO, ATA_PRIMARY_CTRL, 0, ATA_PRIMARY_IRQ);
+        ata_setup_channel(1, ATA_SECONDARY_IO, ATA_SECONDARY_CTRL, 0, ATA_SECONDARY_IRQ);
+    }
+
+    uint32_t found = 0;
+    for (int i = 0; i < ATA_DRIVES; i++) {
+        struct ata_drive* drive = &drives[i];
+        drive->channel = &channels[i / 2];
+        drive->slave = i % 2;
+        if (!ata_identify(drive))
+            continue;
+
+        drive->present = true;
+        drive->dev.name[0] = 'h';
+        drive->dev.name[1] = 'd';
+        drive->dev.name[2] = 'a' + i;
+        drive->dev.name[3] = '\0';
+        drive->dev.sectors = drive->sectors;
+        drive->dev.max_sectors = ATA_MAX_SECTORS;
+        drive->dev.read = ata_read;
+        drive->dev.write = ata_write;
+        drive->dev.flush = ata_flush;
+        drive->dev.transfer = ata_transfer;
+        drive->dev.max_segments = BLOCKDEV_MAX_SEGMENTS;
+        drive->dev.ctx = drive;
+        blockdev_register(&drive->dev);
+        found++;
+
+        printf("ATA %s: %s, %lu MiB, %s%s\n", drive->dev.name, drive->model,
+               drive->sectors / (1024 * 1024 / BLOCKDEV_SECTOR_SIZE),
+               drive->lba48 ? "LBA48, " : "", drive->dma ? "DMA" : "PIO");
+    }
+
+    // Completion interrupts are only needed for DMA
+    for (int i = 0; i < ATA_CHANNELS; i++) {
+        if (channels[i].bus_master != 0 && (drives[i * 2].dma || drives[i * 2 + 1].dma))
+            register_irq_handler(channels[i].irq, ata_irq, &channels[i]);
+    }
+    return found;
+}
+
+bool ata_dma_available() {
+    for (int i = 0; i < ATA_DRIVES; i++) {
+        if (drives[i].present && drives[i].dma)
+            return true;
+    }
+    return false;
+}
+
+void ata_set_dma(bool enabled) {
+    dma_enabled = enabled;
+}
+
+void ata_get_stats(struct ata_stats* out) {
+    *out = stats;
+}
+
+void ata_reset_stats() {
+    memset(&stats, 0, sizeof(stats));
+}
@@ -0,0 +1,86 @@
+#include "drivers/isa_dma.h"
+#include "common.h"
+
+// Per-channel ports. The 16-bit controller spaces its registers two ports
+// apart.
+static const uint8_t address_ports[8] = { 0x00, 0x02, 0x04, 0x06, 0xC0, 0xC4, 0xC8, 0xCC };
+static const uint8_t count_ports[8]   = { 0x01, 0x03, 0x05, 0x07, 0xC2, 0xC6, 0xCA, 0xCE };
+static const uint8_t page_ports[8]    = { 0x87, 0x83, 0x81, 0x82, 0x8F, 0x8B, 0x89, 0x8A };
+
+// Controller-wide registers, 8-bit controller first
+#define DMA_MASK_PORT(ch)       ((ch) < 4 ? 0x0A : 0xD4)
+#define DMA_MODE_PORT(ch)       ((ch) < 4 ? 0x0B : 0xD6)
+#define DMA_FLIP_FLOP_PORT(ch)  ((ch) < 4 ? 0x0C : 0xD8)
+
+#define DMA_MASK_SET 0x04
+
+static bool is_word_channel(uint8_t channel) {
+    return channel >= 4;
+}
+
+void isa_dma_mask(uint8_t channel) {
+    if (channel >= 8)
+        return;
+    outb(DMA_MASK_PORT(channel), DMA_MASK_SET | (channel & 3));
+}
+
+void isa_dma_unmask(uint8_t channel) {
+    if (channel >= 8)
+        return;
+    outb(DMA_MASK_PORT(channel), channel & 3);
+}
+
+bool isa_dma_setup(uint8_t channel, uint32_t phys, uint32_t length, uint8_t mode) {
+    if (channel >= 8 || channel == 4 || length == 0)
+        return false;
+    if (phys + length > ISA_DMA_LIMIT)
+        return false;
+
+    // Word channels count words and address memory in words
+    uint32_t address = phys;
+    uint32_t count = length;
+    uint32_t boundary = 0x10000;
+    if (is_word_channel(channel)) {
+        if ((phys | length) & 1)
+            return false;
+        address = (phys >> 1) & 0xFFFF;
+        count = length >> 1;
+        boundary = 0x20000;
+    }
+    if (count > 0x10000 || phys / boundary != (phys + length - 1) / boundary)
+        return false;
+
+    uint32_t flags = interrupts_save();
+    isa_dma_mask(channel);
+
+    // The flip-flop picks the low or high byte of the 16-bit registers
+    outb(DMA_FLIP_FLOP_PORT(channel), 0xFF);
+    outb(address_ports[channel], address & 0xFF);
+    outb(address_ports[channel], (address >> 8) & 0xFF);
+    outb(page_ports[channel], is_word_channel(channel) ? (phys >> 16) & 0xFE : (phys >> 16) & 0xFF);
+
+    outb(DMA_FLIP_FLOP_PORT(channel), 0xFF);
+    outb(count_ports[channel], (count - 1) & 0xFF);
+    outb(count_ports[channel], ((count - 1) >> 8) & 0xFF);
+
+    outb(DMA_MODE_PORT(channel), mode | (channel & 3));
+    isa_dma_unmask(channel);
+    interrupts_restore(flags);
+    return true;
+}
+
+uint32_t isa_dma_residue(uint8_t channel) {
+    if (channel >= 8)
+        return 0;
+
+    uint32_t flags = interrupts_save();
+    outb(DMA_FLIP_FLOP_PORT(channel), 0xFF);
+    uint32_t count = inb(count_ports[channel]);
+    count |= inb(count_ports[channel]) << 8;
+    interrupts_restore(flags);
+
+    // The register holds transfers left minus one, and wraps to 0xFFFF at
+    // the very end of a cycle
+    count = (count + 1) & 0xFFFF;
+    return is_word_channel(channel) ? count << 1 : count;
+}
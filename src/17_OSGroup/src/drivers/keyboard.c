@@ -0,0 +1,169 @@
+#include "drivers/keyboard.h"
+#include "interrupts.h"
+#include "common.h"
+#include "keymap.h"
+#include "idle.h"
+
+// BIOS data area keyboard flags, bit 5 is Num Lock as the BIOS left it
+#define BDA_KEYBOARD_FLAGS ((const volatile uint8_t*)0x417)
+#define BDA_NUM_LOCK       0x20
+
+#define STATUS_OUTPUT_FULL 0x01
+#define STATUS_AUX_DATA    0x20   // The byte is from the mouse
+
+// Set 1 prefixes and replies that are not key codes
+#define SCANCODE_EXTENDED  0xE0
+#define SCANCODE_PAUSE     0xE1   // Followed by five more bytes, no break code
+#define SCANCODE_ACK       0xFA
+#define SCANCODE_RESEND    0xFE
+#define SCANCODE_ERROR     0xFF
+
+// Scancodes, filled by the interrupt handler
+static uint8_t scancodes[KEYBOARD_SCANCODE_BUFFER];
+static volatile uint32_t scancode_head = 0;
+static volatile uint32_t scancode_tail = 0;
+
+// Decoded key events
+static key_event_t events[KEYBOARD_EVENT_BUFFER];
+static uint32_t event_head = 0;
+static uint32_t event_tail = 0;
+
+static volatile uint32_t dropped = 0;
+
+// Decoder state
+static bool extended = false;
+static int pause_bytes = 0;
+static struct keymap_state keymap_state;
+
+static int keyboard_irq_handler(registers_t* regs, void* context) {
+    // Mouse bytes are left for the IRQ12 handler
+    uint8_t status = inb(KEYBOARD_STATUS_PORT);
+    if (!(status & STATUS_OUTPUT_FULL) || (status & STATUS_AUX_DATA))
+        return IRQ_NONE;
+
+    uint8_t scancode = inb(KEYBOARD_DATA_PORT);
+    if (scancode_head - scancode_tail < KEYBOARD_SCANCODE_BUFFER) {
+        scancodes[scancode_head & (KEYBOARD_SCANCODE_BUFFER - 1)] = scancode;
+        scancode_head++;
+    } else {
+        dropped++;
+    }
+    return IRQ_HANDLED;
+}
+
+void init_keyboard() {
+    // Throw away anything that arrived before we were listening
+    while (inb(KEYBOARD_STATUS_PORT) & STATUS_OUTPUT_FULL)
+        inb(KEYBOARD_DATA_PORT);
+
+    // Start with Num Lock where the BIOS put it, which is what its LED shows
+    if (*BDA_KEYBOARD_FLAGS & BDA_NUM_LOCK)
+        keymap_state.locks |= KEY_LOCK_NUM;
+
+    register_irq_handler(KEYBOARD_IRQ, keyboard_irq_handler, NULL);
+}
+
+// Turn one scancode into a key event, or just update the decoder state
+static void keyboard_decode(uint8_t scancode) {
+    if (pause_bytes > 0) {
+        pause_bytes--;
+        return;
+    }
+
+    switch (scancode) {
+    case SCANCODE_EXTENDED:
+        extended = true;
+        return;
+    case SCANCODE_PAUSE:
+        pause_bytes = 5;
+        return;
+    case SCANCODE_ACK:
+    case SCANCODE_RESEND:
+    case SCANCODE_ERROR:
+    case 0x00:
+        return;
+    }
+
+    key_event_t event;
+    keymap_decode_set1(&keymap_state, scancode, extended, &event);
+    extended = false;
+
+    // Not a key, e.g. the fake shifts around Print Screen
+    if (event.keycode == KEY_NONE)
+        return;
+
+    if (event_head - event_tail == KEYBOARD_EVENT_BUFFER) {
+        dropped++;
+        return;
+    }
+    events[event_head & (KEYBOARD_EVENT_BUFFER - 1)] = event;
+    event_head++;
+}
+
+void keyboard_process() {
+    // Only the interrupt handler moves the head, and only we move the tail
+    while (scancode_tail != scancode_head) {
+        keyboard_decode(scancodes[scancode_tail & (KEYBOARD_SCANCODE_BUFFER - 1)]);
+        scancode_tail++;
+    }
+}
+
+bool keyboard_read_event(key_event_t* event) {
+    keyboard_process();
+    if (event_tail == event_head)
+        return false;
+    *event = events[event_tail & (KEYBOARD_EVENT_BUFFER - 1)];
+    event_tail++;
+    return true;
+}
+
+char keyboard_getc() {
+    key_event_t event;
+    while (true) {
+        if (!keyboard_read_event(&event)) {
+            // Do background work and sleep until the next interrupt, a key
+            // or at the latest the timer
+            idle();
+            continue;
+        }
+        if (event.ascii != 0)
+            return event.ascii;
+    }
+}
+
+size_t read_line(char* buffer, size_t size) {
+    size_t length = 0;
+    if (size == 0)
+        return 0;
+
+    while (true) {
+        char c = keyboard_getc();
+
+        if (c == '\n') {
+            putchar('\n');
+            break;
+        }
+
+        if (c == '\b') {
+            if (length > 0) {
+                length--;
+                print("\b \b", 3);
+            }
+            continue;
+        }
+
+        // Keep room for the terminator, ignore other control characters
+        if ((unsigned char)c < ' ' || length + 1 >= size)
+            continue;
+
+        buffer[length++] = c;
+        putchar(c);
+    }
+
+    buffer[length] = '\0';
+    return length;
+}
+
+uint32_t keyboard_dropped() {
+    return dropped;
+}
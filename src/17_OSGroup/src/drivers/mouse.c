@@ -0,0 +1,236 @@
+#include "drivers/mouse.h"
+#include "drivers/keyboard.h"
+#include "interrupts.h"
+#include "common.h"
+#include "pit.h"
+
+// Controller status bits
+#define STATUS_OUTPUT_FULL 0x01
+#define STATUS_INPUT_FULL  0x02
+#define STATUS_AUX_DATA    0x20
+
+// Controller commands
+#define CONTROLLER_READ_CONFIG  0x20
+#define CONTROLLER_WRITE_CONFIG 0x60
+#define CONTROLLER_ENABLE_AUX   0xA8
+#define CONTROLLER_WRITE_AUX    0xD4
+
+// Controller configuration byte
+#define CONFIG_AUX_IRQ          0x02
+#define CONFIG_AUX_CLOCK_OFF    0x20
+
+// Mouse commands and replies
+#define MOUSE_GET_ID            0xF2
+#define MOUSE_SET_SAMPLE_RATE   0xF3
+#define MOUSE_ENABLE_REPORTING  0xF4
+#define MOUSE_SET_DEFAULTS      0xF6
+#define MOUSE_ACK               0xFA
+
+// Device ID of an IntelliMouse, which adds a wheel byte to every packet
+#define MOUSE_ID_WHEEL          0x03
+
+// First packet byte
+#define PACKET_BUTTONS          0x07
+#define PACKET_ALWAYS_ONE       0x08
+#define PACKET_X_SIGN           0x10
+#define PACKET_Y_SIGN           0x20
+#define PACKET_OVERFLOW         0xC0
+
+// Polling loops during setup give up after this many status reads
+#define CONTROLLER_TIMEOUT      100000
+
+static bool present = false;
+static bool wheel = false;
+static uint8_t packet_size = 3;
+
+// Packet being assembled by the interrupt handler
+static uint8_t packet[4];
+static uint8_t packet_length = 0;
+static uint32_t packet_ticks = 0;
+
+// Events, written by the interrupt handler and read by mouse_read_event()
+static mouse_event_t events[MOUSE_EVENT_BUFFER];
+static volatile uint32_t event_head = 0;
+static volatile uint32_t event_tail = 0;
+
+static uint32_t resyncs = 0;
+static uint32_t dropped = 0;
+
+static bool controller_wait_write() {
+    for (int i = 0; i < CONTROLLER_TIMEOUT; i++) {
+        if (!(inb(KEYBOARD_STATUS_PORT) & STATUS_INPUT_FULL))
+            return true;
+    }
+    return false;
+}
+
+static bool controller_wait_read() {
+    for (int i = 0; i < CONTROLLER_TIMEOUT; i++) {
+        if (inb(KEYBOARD_STATUS_PORT) & STATUS_OUTPUT_FULL)
+            return true;
+    }
+    return false;
+}
+
+static void controller_command(uint8_t command) {
+    controller_wait_write();
+    outb(KEYBOARD_STATUS_PORT, command);
+}
+
+// Send a byte to the mouse and wait for its acknowledgement
+static bool mouse_command(uint8_t command) {
+    controller_command(CONTROLLER_WRITE_AUX);
+    if (!controller_wait_write())
+        return false;
+    outb(KEYBOARD_DATA_PORT, command);
+    return controller_wait_read() && inb(KEYBOARD_DATA_PORT) == MOUSE_ACK;
+}
+
+static bool mouse_set_sample_rate(uint8_t rate) {
+    return mouse_command(MOUSE_SET_SAMPLE_RATE) && mouse_command(rate);
+}
+
+// Queue a motion event. Motion with the same buttons is merged into the
+// newest queued event, unless that one is the only event in the queue: the
+// reader may be in the middle of copying it.
+static void mouse_publish(const mouse_event_t* event) {
+    uint32_t queued = event_head - event_tail;
+    if (queued >= 2) {
+        mouse_event_t* last = &events[(event_head - 1) & (MOUSE_EVENT_BUFFER - 1)];
+        if (last->buttons == event->buttons) {
+            last->dx += event->dx;
+            last->dy += event->dy;
+            last->wheel += event->wheel;
+            return;
+        }
+    }
+
+    if (queued == MOUSE_EVENT_BUFFER) {
+        dropped++;
+        return;
+    }
+    events[event_head & (MOUSE_EVENT_BUFFER - 1)] = *event;
+    // The event must be complete before the reader can see it
+    asm volatile ("" ::: "memory");
+    event_head++;
+}
+
+static void mouse_decode_packet() {
+    mouse_event_t event;
+    uint8_t flags = packet[0];
+
+    // Bytes 1 and 2 are the low 8 bits of 9-bit two's complement values
+    event.dx = (int32_t)packet[1] - ((flags & PACKET_X_SIGN) ? 256 : 0);
+    event.dy = (int32_t)packet[2] - ((flags & PACKET_Y_SIGN) ? 256 : 0);
+    event.wheel = wheel ? (int8_t)packet[3] : 0;
+    event.buttons = flags & PACKET_BUTTONS;
+
+    // Overflowed deltas are garbage, keep the buttons only
+    if (flags & PACKET_OVERFLOW) {
+        event.dx = 0;
+        event.dy = 0;
+    }
+
+    mouse_publish(&event);
+}
+
+static int mouse_irq_handler(registers_t* regs, void* context) {
+    uint8_t status = inb(KEYBOARD_STATUS_PORT);
+    if ((status & (STATUS_OUTPUT_FULL | STATUS_AUX_DATA)) != (STATUS_OUTPUT_FULL | STATUS_AUX_DATA))
+        return IRQ_NONE;
+
+    uint8_t data = inb(KEYBOARD_DATA_PORT);
+
+    // A packet that stalled halfway will never complete, start over
+    uint32_t now = pit_get_ticks();
+    if (packet_length > 0 && now - packet_ticks > MOUSE_PACKET_TIMEOUT_MS) {
+        packet_length = 0;
+        resyncs++;
+    }
+    packet_ticks = now;
+
+    // The first byte always has bit 3 set. If it does not, we are out of
+    // step with the mouse; drop bytes until something looks like a start.
+    if (packet_length == 0 && !(data & PACKET_ALWAYS_ONE)) {
+        resyncs++;
+        return IRQ_HANDLED;
+    }
+
+    packet[packet_length++] = data;
+    if (packet_length == packet_size) {
+        packet_length = 0;
+        mouse_decode_packet();
+    }
+    return IRQ_HANDLED;
+}
+
+bool init_mouse() {
+    // Keep both interrupt handlers away from the data port while we talk
+    // to the controller by polling
+    uint32_t flags = interrupts_save();
+
+    controller_command(CONTROLLER_ENABLE_AUX);
+
+    // Turn on the auxiliary clock and interrupt
+    controller_command(CONTROLLER_READ_CONFIG);
+    if (!controller_wait_read()) {
+        interrupts_restore(flags);
+        return false;
+    }
+    uint8_t config = inb(KEYBOARD_DATA_PORT);
+    config |= CONFIG_AUX_IRQ;
+    config &= ~CONFIG_AUX_CLOCK_OFF;
+    controller_command(CONTROLLER_WRITE_CONFIG);
+    controller_wait_write();
+    outb(KEYBOARD_DATA_PORT, config);
+
+    if (!mouse_command(MOUSE_SET_DEFAULTS)) {
+        interrupts_restore(flags);
+        return false;
+    }
+
+    // The magic sample rate sequence 200, 100, 80 switches an IntelliMouse
+    // into wheel mode, which it then reports in its device ID
+    uint8_t id = 0;
+    if (mouse_set_sample_rate(200) && mouse_set_sample_rate(100) && mouse_set_sample_rate(80)
+        && mouse_command(MOUSE_GET_ID) && controller_wait_read()) {
+        id = inb(KEYBOARD_DATA_PORT);
+    }
+    wheel = id == MOUSE_ID_WHEEL;
+    packet_size = wheel ? 4 : 3;
+
+    mouse_set_sample_rate(100);
+    bool enabled = mouse_command(MOUSE_ENABLE_REPORTING);
+
+    interrupts_restore(flags);
+
+    if (!enabled)
+        return false;
+
+    register_irq_handler(MOUSE_IRQ, mouse_irq_handler, NULL);
+    present = true;
+    return true;
+}
+
+bool mouse_read_event(mouse_event_t* event) {
+    // The interrupt handler never touches the event at the tail while it is
+    // the only one queued, so it can be copied without locking
+    if (event_tail == event_head)
+        return false;
+    *event = events[event_tail & (MOUSE_EVENT_BUFFER - 1)];
+    asm volatile ("" ::: "memory");
+    event_tail++;
+    return true;
+}
+
+bool mouse_has_wheel() {
+    return wheel;
+}
+
+uint32_t mouse_resyncs() {
+    return resyncs;
+}
+
+uint32_t mouse_dropped() {
+    return dropped;
+}
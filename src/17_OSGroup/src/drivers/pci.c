@@ -0,0 +1,258 @@
+#include "drivers/pci.h"
+#include "interrupts.h"
+#include "common.h"
+#include "pit.h"
+
+#define PCI_MAX_BUSES     256
+#define PCI_MAX_SLOTS     32
+#define PCI_MAX_FUNCTIONS 8
+
+static struct pci_device devices[PCI_MAX_DEVICES];
+static uint32_t device_count = 0;
+static uint32_t devices_dropped = 0;    // Found after the table was full
+
+static const struct pci_driver* drivers[PCI_MAX_DRIVERS];
+static uint32_t driver_count = 0;
+
+// Enumeration statistics
+static uint32_t config_reads = 0;
+static uint32_t buses_scanned = 0;
+static uint32_t bus_seen[PCI_MAX_BUSES / 32];   // Guards against bridge loops
+
+// Address port layout: enable bit, bus, slot, function, dword offset
+static uint32_t pci_config_address(pci_address_t address, uint8_t offset) {
+    return 0x80000000 | ((uint32_t)address.bus << 16) | ((uint32_t)address.slot << 11) |
+           ((uint32_t)address.function << 8) | (offset & 0xFC);
+}
+
+uint32_t pci_config_read32(pci_address_t address, uint8_t offset) {
+    uint32_t flags = interrupts_save();
+    outl(PCI_CONFIG_ADDRESS, pci_config_address(address, offset));
+    uint32_t value = inl(PCI_CONFIG_DATA);
+    config_reads++;
+    interrupts_restore(flags);
+    return value;
+}
+
+uint16_t pci_config_read16(pci_address_t address, uint8_t offset) {
+    return pci_config_read32(address, offset) >> ((offset & 2) * 8);
+}
+
+uint8_t pci_config_read8(pci_address_t address, uint8_t offset) {
+    return pci_config_read32(address, offset) >> ((offset & 3) * 8);
+}
+
+void pci_config_write32(pci_address_t address, uint8_t offset, uint32_t value) {
+    uint32_t flags = interrupts_save();
+    outl(PCI_CONFIG_ADDRESS, pci_config_address(address, offset));
+    outl(PCI_CONFIG_DATA, value);
+    interrupts_restore(flags);
+}
+
+void pci_config_write16(pci_address_t address, uint8_t offset, uint16_t value) {
+    uint32_t flags = interrupts_save();
+    outl(PCI_CONFIG_ADDRESS, pci_config_address(address, offset));
+    outw(PCI_CONFIG_DATA + (offset & 2), value);
+    interrupts_restore(flags);
+}
+
+// Size the BARs by writing all ones and reading back which bits stick.
+// Decoding is off meanwhile so the device does not answer at a bogus
+// address, and so are interrupts, as a handler could touch the device in
+// the gap. The host bridge and display devices are never sized: turning
+// off the one cuts off memory on some chipsets, and the other is the
+// console. Their BARs keep a size of 0. 64-bit BARs above 4 GiB cannot be
+// reached and are left at 0.
+static void pci_read_bars(struct pci_device* device) {
+    pci_address_t address = device->address;
+    uint32_t count = device->header_type == PCI_HEADER_GENERAL ? 6 :
+                     device->header_type == PCI_HEADER_BRIDGE ? 2 : 0;
+    bool sizing = device->class_code != PCI_CLASS_DISPLAY &&
+                  !(device->class_code == PCI_CLASS_BRIDGE && device->subclass == PCI_SUBCLASS_HOST_BRIDGE);
+
+    uint32_t flags = interrupts_save();
+    uint16_t command = pci_config_read16(address, PCI_COMMAND);
+    if (sizing)
+        pci_config_write16(address, PCI_COMMAND, command & ~(PCI_COMMAND_IO | PCI_COMMAND_MEMORY));
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t offset = PCI_BAR0 + i * 4;
+        uint32_t value = pci_config_read32(address, offset);
+        uint32_t mask = value;
+        if (sizing) {
+            pci_config_write32(address, offset, 0xFFFFFFFF);
+            mask = pci_config_read32(address, offset);
+            pci_config_write32(address, offset, value);
+        }
+        if (mask == 0)
+            continue;
+
+        pci_bar_t* bar = &device->bars[i];
+        if (value & PCI_BAR_IO) {
+            bar->io = true;
+            bar->base = value & PCI_BAR_IO_MASK;
+            bar->size = sizing ? (~(mask & PCI_BAR_IO_MASK) + 1) & 0xFFFF : 0;
+            continue;
+        }
+
+        bar->base = value & PCI_BAR_MEM_MASK;
+        bar->size = sizing ? ~(mask & PCI_BAR_MEM_MASK) + 1 : 0;
+        bar->prefetchable = (value & PCI_BAR_PREFETCHABLE) != 0;
+        if ((value & PCI_BAR_MEM_TYPE) == PCI_BAR_MEM_64 && i + 1 < count) {
+            // The next BAR holds the upper half
+            i++;
+            if (pci_config_read32(address, PCI_BAR0 + i * 4) != 0)
+                bar->base = 0;
+        }
+    }
+
+    if (sizing)
+        pci_config_write16(address, PCI_COMMAND, command);
+    interrupts_restore(flags);
+}
+
+static void pci_scan_bus(uint8_t bus);
+
+static void pci_add_function(pci_address_t address) {
+    uint32_t id = pci_config_read32(address, PCI_VENDOR_ID);
+    uint32_t class_info = pci_config_read32(address, PCI_REVISION);
+    uint8_t header_type = pci_config_read8(address, PCI_HEADER_TYPE) & ~PCI_HEADER_MULTIFUNCTION;
+
+    if (device_count < PCI_MAX_DEVICES) {
+        struct pci_device* device = &devices[device_count++];
+        device->address = address;
+        device->vendor = id & 0xFFFF;
+        device->device = id >> 16;
+        device->revision = class_info & 0xFF;
+        device->prog_if = (class_info >> 8) & 0xFF;
+        device->subclass = (class_info >> 16) & 0xFF;
+        device->class_code = class_info >> 24;
+        device->header_type = header_type;
+        device->interrupt_line = pci_config_read8(address, PCI_INTERRUPT_LINE);
+        device->interrupt_pin = pci_config_read8(address, PCI_INTERRUPT_PIN);
+        pci_read_bars(device);
+    } else {
+        devices_dropped++;
+    }
+
+    // Everything behind a PCI-to-PCI bridge hangs off its secondary bus
+    if (header_type == PCI_HEADER_BRIDGE && (class_info >> 24) == PCI_CLASS_BRIDGE &&
+        ((class_info >> 16) & 0xFF) == PCI_SUBCLASS_PCI_BRIDGE)
+        pci_scan_bus(pci_config_read8(address, PCI_SECONDARY_BUS));
+}
+
+static void pci_scan_bus(uint8_t bus) {
+    if (bus_seen[bus / 32] & (1UL << (bus % 32)))
+        return;
+    bus_seen[bus / 32] |= 1UL << (bus % 32);
+    buses_scanned++;
+
+    for (uint8_t slot = 0; slot < PCI_MAX_SLOTS; slot++) {
+        pci_address_t address = { bus, slot, 0 };
+        if (pci_config_read16(address, PCI_VENDOR_ID) == PCI_VENDOR_NONE)
+            continue;
+
+        uint8_t functions = (pci_config_read8(address, PCI_HEADER_TYPE) & PCI_HEADER_MULTIFUNCTION) ? PCI_MAX_FUNCTIONS : 1;
+        for (uint8_t function = 0; function < functions; function++) {
+            address.function = function;
+            if (pci_config_read16(address, PCI_VENDOR_ID) != PCI_VENDOR_NONE)
+                pci_add_function(address);
+        }
+    }
+}
+
+static bool pci_id_matches(const struct pci_device_id* id, const struct pci_device* device) {
+    return (id->vendor == PCI_ANY_ID || id->vendor == device->vendor) &&
+           (id->device == PCI_ANY_ID || id->device == device->device) &&
+           (id->class_code == PCI_ANY_CLASS || id->class_code == device->class_code) &&
+           (id->subclass == PCI_ANY_CLASS || id->subclass == device->subclass);
+}
+
+// Offer the device to the driver if nobody has claimed it yet
+static void pci_bind(const struct pci_driver* driver, struct pci_device* device) {
+    if (device->driver != NULL)
+        return;
+    for (const struct pci_device_id* id = driver->ids; id->vendor != 0; id++) {
+        if (pci_id_matches(id, device)) {
+            if (driver->probe(device))
+                device->driver = driver;
+            return;
+        }
+    }
+}
+
+void init_pci() {
+    uint64_t start = read_tsc();
+
+    // A multifunction host bridge means one host controller per function,
+    // each with its own root bus
+    pci_address_t host = { 0, 0, 0 };
+    if (pci_config_read8(host, PCI_HEADER_TYPE) & PCI_HEADER_MULTIFUNCTION) {
+        for (uint8_t function = 0; function < PCI_MAX_FUNCTIONS; function++) {
+            host.function = function;
+            if (pci_config_read16(host, PCI_VENDOR_ID) != PCI_VENDOR_NONE)
+                pci_scan_bus(function);
+        }
+    } else {
+        pci_scan_bus(0);
+    }
+
+    uint32_t cycles = (uint32_t)(read_tsc() - start);
+    uint32_t cycles_per_ms = pit_tsc_per_ms();
+    uint32_t us = cycles_per_ms ? (uint32_t)div64_32((uint64_t)cycles * 1000, cycles_per_ms, NULL) : 0;
+    printf("PCI: %lu functions on %lu buses in %lu us (%lu config reads)\n",
+           device_count + devices_dropped, buses_scanned, us, config_reads);
+    if (devices_dropped > 0)
+        printf("PCI: device table full, %lu functions ignored\n", devices_dropped);
+
+    for (uint32_t i = 0; i < driver_count; i++) {
+        for (uint32_t j = 0; j < device_count; j++)
+            pci_bind(drivers[i], &devices[j]);
+    }
+}
+
+bool pci_register_driver(const struct pci_driver* driver) {
+    if (driver_count == PCI_MAX_DRIVERS)
+        return false;
+    drivers[driver_count++] = driver;
+    for (uint32_t i = 0; i < device_count; i++)
+        pci_bind(driver, &devices[i]);
+    return true;
+}
+
+uint32_t pci_device_count() {
+    return device_count;
+}
+
+struct pci_device* pci_get_device(uint32_t index) {
+    return index < device_count ? &devices[index] : NULL;
+}
+
+struct pci_device* pci_find(uint16_t vendor, uint16_t device) {
+    for (uint32_t i = 0; i < device_count; i++) {
+        if (devices[i].vendor == vendor && devices[i].device == device)
+            return &devices[i];
+    }
+    return NULL;
+}
+
+bool pci_find_device(uint16_t vendor, uint16_t device, pci_address_t* address) {
+    struct pci_device* found = pci_find(vendor, device);
+    if (found == NULL)
+        return false;
+    *address = found->address;
+    return true;
+}
+
+const char* pci_class_name(uint8_t class_code) {
+    static const char* const names[] = {
+        "unclassified", "storage", "network", "display", "multimedia", "memory",
+        "bridge", "communication", "system", "input", "docking", "processor",
+        "serial bus",
+    };
+    return class_code < sizeof(names) / sizeof(names[0]) ? names[class_code] : "other";
+}
+
+void pci_enable(pci_address_t address, uint16_t command) {
+    pci_config_write16(address, PCI_COMMAND, pci_config_read16(address, PCI_COMMAND) | command);
+}
@@ -0,0 +1,177 @@
+#include "drivers/pcspeaker.h"
+#include "interrupts.h"
+#include "common.h"
+#include "idle.h"
+#include "pit.h"
+
+// Channel 2, low byte only, mode 0 (one-shot). With the low byte as the
+// only access, each sample costs a single write to the channel port.
+#define PIT_CH2_ONESHOT_LOBYTE 0x90
+
+// Speaker gate and data bits in port 0x61
+#define SPEAKER_GATE 0x01
+#define SPEAKER_DATA 0x02
+
+static uint8_t blocks[2][PCSPK_PCM_BLOCK_SIZE];
+
+// Samples in each block, 0 while it waits to be filled. Set by the pump
+// once a block is full, cleared by the interrupt once it has been played.
+static volatile uint32_t block_length[2];
+static volatile uint32_t playing = 0;   // Block the interrupt plays from
+static uint32_t play_position = 0;      // Next sample in that block
+
+// One-shot length for every sample value
+static uint8_t pwm_counts[256];
+
+static audio_source_t* source = NULL;
+static volatile bool active = false;
+static volatile bool source_done = false;
+
+// PIT input clocks (times 1000) since the last 1 ms tick
+static uint32_t tick_accumulator = 0;
+
+static volatile struct pcspk_pcm_stats stats;
+
+static int pcspk_pcm_irq(registers_t* regs) {
+    uint64_t start = read_tsc();
+
+    // Get the sample out first, the time to this point is the jitter
+    uint32_t block = playing;
+    uint32_t length = block_length[block];
+    if (length != 0) {
+        outb(PIT_CHANNEL2_PORT, pwm_counts[blocks[block][play_position]]);
+        stats.played++;
+        if (++play_position == length) {
+            // Hand the block back to the pump and move to the other one
+            play_position = 0;
+            block_length[block] = 0;
+            playing = block ^ 1;
+        }
+    } else {
+        outb(PIT_CHANNEL2_PORT, pwm_counts[AUDIO_SILENCE]);
+        if (!source_done)
+            stats.dropped++;
+    }
+
+    uint32_t cycles = (uint32_t)(read_tsc() - start);
+    if (cycles > stats.max_isr_cycles)
+        stats.max_isr_cycles = cycles;
+
+    // Let the regular IRQ0 chain (and so the 1 ms tick) run whenever a
+    // millisecond worth of PIT clocks has gone by
+    tick_accumulator += PCSPK_PCM_DIVISOR * 1000;
+    if (tick_accumulator >= PIT_BASE_FREQUENCY) {
+        tick_accumulator -= PIT_BASE_FREQUENCY;
+        return IRQ_NONE;
+    }
+    return IRQ_HANDLED;
+}
+
+static void pcspk_pcm_fill(uint32_t block) {
+    if (block_length[block] != 0 || source_done)
+        return;
+
+    uint32_t count = source->read(source, blocks[block], PCSPK_PCM_BLOCK_SIZE);
+    if (count == 0) {
+        source_done = true;
+        return;
+    }
+
+    // The samples must be in place before the interrupt sees the length
+    asm volatile ("" ::: "memory");
+    block_length[block] = count;
+}
+
+void pcspk_pcm_pump() {
+    if (!active)
+        return;
+
+    // The block being played (or waited for) first, then the next one
+    uint32_t block = playing;
+    pcspk_pcm_fill(block);
+    pcspk_pcm_fill(block ^ 1);
+
+    // Once the source is drained and both blocks have played, we are done
+    if (source_done && block_length[0] == 0 && block_length[1] == 0)
+        pcspk_pcm_stop();
+}
+
+static void pcspk_pcm_idle(void* ctx) {
+    pcspk_pcm_pump();
+}
+
+bool pcspk_pcm_start(audio_source_t* new_source) {
+    if (active)
+        return false;
+
+    // Spread the sample values over the PWM period, never 0 (which would
+    // be a full period) and never the full period itself
+    for (int i = 0; i < 256; i++)
+        pwm_counts[i] = 1 + i * (PCSPK_PCM_DIVISOR - 2) / 255;
+
+    source = new_source;
+    source_done = false;
+    block_length[0] = 0;
+    block_length[1] = 0;
+    playing = 0;
+    play_position = 0;
+    tick_accumulator = 0;
+    active = true;
+
+    // Have both blocks ready before the first sample interrupt
+    pcspk_pcm_fill(0);
+    pcspk_pcm_fill(1);
+
+    uint32_t flags = interrupts_save();
+    outb(PIT_CMD_PORT, PIT_CH2_ONESHOT_LOBYTE);
+    outb(PIT_CHANNEL2_PORT, pwm_counts[AUDIO_SILENCE]);
+    outb(PC_SPEAKER_PORT, inb(PC_SPEAKER_PORT) | SPEAKER_GATE | SPEAKER_DATA);
+    irq_set_fast_handler(IRQ0, pcspk_pcm_irq);
+    pit_set_divisor(PCSPK_PCM_DIVISOR);
+    interrupts_restore(flags);
+
+    register_idle_handler(pcspk_pcm_idle, NULL);
+    return true;
+}
+
+void pcspk_pcm_stop() {
+    if (!active)
+        return;
+
+    uint32_t flags = interrupts_save();
+    pit_reset_divisor();
+    irq_set_fast_handler(IRQ0, NULL);
+    outb(PC_SPEAKER_PORT, inb(PC_SPEAKER_PORT) & ~(SPEAKER_GATE | SPEAKER_DATA));
+    active = false;
+    interrupts_restore(flags);
+
+    unregister_idle_handler(pcspk_pcm_idle, NULL);
+}
+
+bool pcspk_pcm_active() {
+    return active;
+}
+
+void pcspk_pcm_get_stats(struct pcspk_pcm_stats* out) {
+    uint32_t flags = interrupts_save();
+    out->played = stats.played;
+    out->dropped = stats.dropped;
+    out->max_isr_cycles = stats.max_isr_cycles;
+    interrupts_restore(flags);
+}
+
+void pcspk_pcm_reset_stats() {
+    uint32_t flags = interrupts_save();
+    stats.played = 0;
+    stats.dropped = 0;
+    stats.max_isr_cycles = 0;
+    interrupts_restore(flags);
+}
+
+static audio_output_t pcspk_output = {
+    "pcspk", PCSPK_PCM_RATE, pcspk_pcm_start, pcspk_pcm_stop, pcspk_pcm_active
+};
+
+void init_pcspk_pcm() {
+    audio_register_output(&pcspk_output);
+}
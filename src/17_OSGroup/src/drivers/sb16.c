@@ -0,0 +1,279 @@
+#include "drivers/sb16.h"
+#include "drivers/isa_dma.h"
+#include "memory/memory.h"
+#include "interrupts.h"
+#include "common.h"
+#include "idle.h"
+#include "pit.h"
+
+// DSP and mixer ports, relative to the base port
+#define SB16_MIXER_INDEX  0x4
+#define SB16_MIXER_DATA   0x5
+#define SB16_DSP_RESET    0x6
+#define SB16_DSP_READ     0xA
+#define SB16_DSP_WRITE    0xC   // Bit 7 set while the DSP is busy
+#define SB16_DSP_STATUS   0xE   // Bit 7 set when data can be read, reading acks 8-bit IRQs
+
+#define DSP_RESET_READY   0xAA
+
+// DSP commands
+#define DSP_SET_OUTPUT_RATE 0x41
+#define DSP_PLAY_8BIT_AUTO  0xC6    // 8-bit, output, auto-init, FIFO on
+#define DSP_PAUSE_8BIT      0xD0
+#define DSP_SPEAKER_ON      0xD1
+#define DSP_SPEAKER_OFF     0xD3
+#define DSP_EXIT_AUTO_8BIT  0xDA
+#define DSP_GET_VERSION     0xE1
+
+#define DSP_MODE_MONO_UNSIGNED 0x00
+
+// Mixer registers holding the IRQ and DMA setup, and which source raised
+// the interrupt
+#define MIXER_IRQ_SELECT  0x80
+#define MIXER_DMA_SELECT  0x81
+#define MIXER_IRQ_STATUS  0x82
+#define MIXER_IRQ_8BIT    0x01
+
+// The card is strapped to IRQ 5 and 8-bit DMA channel 1
+#define SB16_IRQ          5
+#define SB16_IRQ_SELECT   0x02
+#define SB16_DMA          1
+#define SB16_DMA_SELECT   0x02
+
+// Polling loops give up after this many status reads
+#define DSP_TIMEOUT       100000
+
+// The DMA buffer. Kernel memory is identity mapped and well below 16 MiB,
+// and aligning to the size keeps it clear of a 64 KiB boundary.
+static uint8_t dma_buffer[SB16_BUFFER_SIZE] __attribute__((aligned(SB16_BUFFER_SIZE)));
+
+static bool present = false;
+static uint16_t version = 0;
+
+static audio_source_t* source = NULL;
+static volatile bool active = false;
+static volatile bool running = false;   // DMA is going
+static volatile bool source_done = false;
+
+// Half the DSP is playing, and which halves hold rendered samples that
+// have not been played yet
+static volatile uint32_t playing = 0;
+static volatile bool filled[2];
+
+static volatile struct sb16_stats stats;
+
+static bool dsp_write(uint8_t value) {
+    for (int i = 0; i < DSP_TIMEOUT; i++) {
+        if (!(inb(SB16_BASE_PORT + SB16_DSP_WRITE) & 0x80)) {
+            outb(SB16_BASE_PORT + SB16_DSP_WRITE, value);
+            return true;
+        }
+    }
+    return false;
+}
+
+static int dsp_read() {
+    for (int i = 0; i < DSP_TIMEOUT; i++) {
+        if (inb(SB16_BASE_PORT + SB16_DSP_STATUS) & 0x80)
+            return inb(SB16_BASE_PORT + SB16_DSP_READ);
+    }
+    return -1;
+}
+
+static void mixer_write(uint8_t index, uint8_t value) {
+    outb(SB16_BASE_PORT + SB16_MIXER_INDEX, index);
+    outb(SB16_BASE_PORT + SB16_MIXER_DATA, value);
+}
+
+static uint8_t mixer_read(uint8_t index) {
+    outb(SB16_BASE_PORT + SB16_MIXER_INDEX, index);
+    return inb(SB16_BASE_PORT + SB16_MIXER_DATA);
+}
+
+static bool dsp_reset() {
+    outb(SB16_BASE_PORT + SB16_DSP_RESET, 1);
+    // The reset line has to stay up for at least 3 microseconds
+    sleep_busy(1);
+    outb(SB16_BASE_PORT + SB16_DSP_RESET, 0);
+    return dsp_read() == DSP_RESET_READY;
+}
+
+static int sb16_irq(registers_t* regs, void* ctx) {
+    if (!(mixer_read(MIXER_IRQ_STATUS) & MIXER_IRQ_8BIT))
+        return IRQ_NONE;
+
+    uint64_t start = read_tsc();
+    inb(SB16_BASE_PORT + SB16_DSP_STATUS);
+    stats.interrupts++;
+
+    // The half that just played is free again, and the DMA has moved on to
+    // the other one. If that was never rendered it would repeat old audio,
+    // so it gets silence instead. That is an underrun unless the source has
+    // simply run out.
+    uint32_t finished = playing;
+    filled[finished] = false;
+    playing = finished ^ 1;
+    if (!filled[playing]) {
+        memset(dma_buffer + playing * SB16_HALF_SIZE, AUDIO_SILENCE, SB16_HALF_SIZE);
+        if (!source_done)
+            stats.underruns++;
+    }
+
+    uint32_t cycles = (uint32_t)(read_tsc() - start);
+    if (cycles > stats.max_isr_cycles)
+        stats.max_isr_cycles = cycles;
+    return IRQ_HANDLED;
+}
+
+// Have the source render straight into a half of the DMA buffer
+static void sb16_fill(uint32_t half) {
+    if (filled[half] || source_done)
+        return;
+
+    uint8_t* samples = dma_buffer + half * SB16_HALF_SIZE;
+    uint32_t count = source->read(source, samples, SB16_HALF_SIZE);
+    if (count == 0) {
+        source_done = true;
+        return;
+    }
+    if (count < SB16_HALF_SIZE)
+        memset(samples + count, AUDIO_SILENCE, SB16_HALF_SIZE - count);
+
+    // Too late if the DSP has moved on to this half while it was rendered.
+    // The interrupt has already counted the underrun.
+    uint32_t flags = interrupts_save();
+    if (!running || playing != half)
+        filled[half] = true;
+    interrupts_restore(flags);
+}
+
+void sb16_pump() {
+    if (!active)
+        return;
+
+    sb16_fill(playing ^ 1);
+
+    // Once the source is drained and the last rendered half has played,
+    // we are done
+    if (source_done && !filled[0] && !filled[1])
+        sb16_stop();
+}
+
+static void sb16_idle(void* ctx) {
+    sb16_pump();
+}
+
+static audio_output_t sb16_output = {
+    "sb16", SB16_RATE, sb16_start, sb16_stop, sb16_active
+};
+
+bool init_sb16() {
+    if (!dsp_reset())
+        return false;
+
+    if (!dsp_write(DSP_GET_VERSION))
+        return false;
+    int major = dsp_read();
+    int minor = dsp_read();
+    if (major < 0 || minor < 0)
+        return false;
+    version = (major << 8) | minor;
+
+    // Anything older than a Sound Blaster 16 (DSP 4.xx) lacks the commands
+    // used here
+    if (major < 4)
+        return false;
+
+    mixer_write(MIXER_IRQ_SELECT, SB16_IRQ_SELECT);
+    mixer_write(MIXER_DMA_SELECT, SB16_DMA_SELECT);
+    if (mixer_read(MIXER_IRQ_SELECT) != SB16_IRQ_SELECT ||
+        !(mixer_read(MIXER_DMA_SELECT) & SB16_DMA_SELECT))
+        return false;
+
+    if (register_irq_handler(SB16_IRQ, sb16_irq, NULL) != 0)
+        return false;
+
+    present = true;
+    audio_register_output(&sb16_output);
+    return true;
+}
+
+bool sb16_present() {
+    return present;
+}
+
+uint16_t sb16_version() {
+    return version;
+}
+
+bool sb16_start(audio_source_t* new_source) {
+    if (!present || active)
+        return false;
+
+    source = new_source;
+    source_done = false;
+    filled[0] = false;
+    filled[1] = false;
+    playing = 0;
+    running = false;
+    active = true;
+
+    // Both halves are rendered before the DSP starts
+    sb16_fill(0);
+    sb16_fill(1);
+
+    if (!isa_dma_setup(SB16_DMA, (uint32_t)dma_buffer, SB16_BUFFER_SIZE,
+                       ISA_DMA_MODE_SINGLE | ISA_DMA_MODE_AUTO_INIT | ISA_DMA_MODE_READ)) {
+        active = false;
+        return false;
+    }
+
+    running = true;
+    dsp_write(DSP_SPEAKER_ON);
+    dsp_write(DSP_SET_OUTPUT_RATE);
+    dsp_write(SB16_RATE >> 8);
+    dsp_write(SB16_RATE & 0xFF);
+
+    // The block length is what the DSP counts down between interrupts
+    dsp_write(DSP_PLAY_8BIT_AUTO);
+    dsp_write(DSP_MODE_MONO_UNSIGNED);
+    dsp_write((SB16_HALF_SIZE - 1) & 0xFF);
+    dsp_write((SB16_HALF_SIZE - 1) >> 8);
+
+    register_idle_handler(sb16_idle, NULL);
+    return true;
+}
+
+void sb16_stop() {
+    if (!active)
+        return;
+
+    dsp_write(DSP_PAUSE_8BIT);
+    dsp_write(DSP_EXIT_AUTO_8BIT);
+    dsp_write(DSP_SPEAKER_OFF);
+    isa_dma_mask(SB16_DMA);
+
+    running = false;
+    active = false;
+    unregister_idle_handler(sb16_idle, NULL);
+}
+
+bool sb16_active() {
+    return active;
+}
+
+void sb16_get_stats(struct sb16_stats* out) {
+    uint32_t flags = interrupts_save();
+    out->interrupts = stats.interrupts;
+    out->underruns = stats.underruns;
+    out->max_isr_cycles = stats.max_isr_cycles;
+    interrupts_restore(flags);
+}
+
+void sb16_reset_stats() {
+    uint32_t flags = interrupts_save();
+    stats.interrupts = 0;
+    stats.underruns = 0;
+    stats.max_isr_cycles = 0;
+    interrupts_restore(flags);
+}
@@ -0,0 +1,228 @@
+#include "drivers/serial.h"
+#include "interrupts.h"
+#include "common.h"
+
+// UART registers, relative to the base port
+#define UART_DATA        0   // Receive buffer / transmit holding (DLAB=0)
+#define UART_IER         1   // Interrupt enable (DLAB=0)
+#define UART_DIVISOR_LOW 0   // Divisor latch low byte (DLAB=1)
+#define UART_DIVISOR_HIGH 1  // Divisor latch high byte (DLAB=1)
+#define UART_IIR         2   // Interrupt identification (read)
+#define UART_FCR         2   // FIFO control (write)
+#define UART_LCR         3   // Line control
+#define UART_MCR         4   // Modem control
+#define UART_LSR         5   // Line status
+#define UART_MSR         6   // Modem status
+
+#define IER_RX_AVAILABLE 0x01
+#define IER_TX_EMPTY     0x02
+#define IER_LINE_STATUS  0x04
+
+#define IIR_NO_INTERRUPT 0x01
+#define IIR_CAUSE_MASK   0x0E
+#define IIR_MODEM_STATUS 0x00
+#define IIR_TX_EMPTY     0x02
+#define IIR_RX_AVAILABLE 0x04
+#define IIR_LINE_STATUS  0x06
+#define IIR_RX_TIMEOUT   0x0C
+
+#define LSR_DATA_READY   0x01
+#define LSR_TX_EMPTY     0x20
+
+#define LCR_8N1          0x03
+#define LCR_DLAB         0x80
+
+// Enable and clear both FIFOs, interrupt at 14 received bytes
+#define FCR_ENABLE_14    0xC7
+
+#define MCR_DTR_RTS_OUT2 0x0B   // OUT2 gates the UART's interrupt line
+#define MCR_LOOPBACK     0x1E
+
+// The transmit FIFO of a 16550 holds 16 bytes
+#define UART_FIFO_SIZE   16
+
+static const uint16_t port = SERIAL_COM1_PORT;
+static bool present = false;
+
+// Transmit ring, filled by serial_write() and drained by the interrupt
+static char tx_buffer[SERIAL_TX_BUFFER_SIZE];
+static volatile uint32_t tx_head = 0;   // Next byte to write into
+static volatile uint32_t tx_tail = 0;   // Next byte to send
+static bool tx_running = false;         // TX empty interrupt is enabled
+static uint32_t tx_dropped = 0;
+
+// Receive ring, filled by the interrupt
+static char rx_buffer[SERIAL_RX_BUFFER_SIZE];
+static volatile uint32_t rx_head = 0;
+static volatile uint32_t rx_tail = 0;
+
+static uint8_t ier = IER_RX_AVAILABLE | IER_LINE_STATUS;
+
+// Turn the TX empty interrupt on or off
+static void tx_set_running(bool running)
+{
+    if (running != tx_running) {
+        tx_running = running;
+        if (running)
+            ier |= IER_TX_EMPTY;
+        else
+            ier &= ~IER_TX_EMPTY;
+        outb(port + UART_IER, ier);
+    }
+}
+
+// Move up to one FIFO worth of queued bytes into the UART.
+// Must be called with interrupts off and the transmitter empty.
+static void tx_fill_fifo()
+{
+    int sent = 0;
+    for (; sent < UART_FIFO_SIZE && tx_tail != tx_head; sent++) {
+        outb(port + UART_DATA, tx_buffer[tx_tail & (SERIAL_TX_BUFFER_SIZE - 1)]);
+        tx_tail++;
+    }
+
+    // The interrupt stays on while the FIFO drains, bytes queued meanwhile
+    // are picked up when it fires. It goes off once it finds nothing to send.
+    tx_set_running(sent > 0);
+}
+
+static void rx_drain_fifo()
+{
+    while (inb(port + UART_LSR) & LSR_DATA_READY) {
+        char c = inb(port + UART_DATA);
+        // Drop the byte if nobody read the ring in time
+        if (rx_head - rx_tail < SERIAL_RX_BUFFER_SIZE) {
+            rx_buffer[rx_head & (SERIAL_RX_BUFFER_SIZE - 1)] = c;
+            rx_head++;
+        }
+    }
+}
+
+static int serial_irq_handler(registers_t* regs, void* context)
+{
+    int handled = IRQ_NONE;
+
+    // Several causes can be pending, keep going until the UART is quiet
+    uint8_t iir;
+    while (!((iir = inb(port + UART_IIR)) & IIR_NO_INTERRUPT)) {
+        handled = IRQ_HANDLED;
+        switch (iir & IIR_CAUSE_MASK) {
+        case IIR_TX_EMPTY:
+            tx_fill_fifo();
+            break;
+        case IIR_RX_AVAILABLE:
+        case IIR_RX_TIMEOUT:
+            rx_drain_fifo();
+            break;
+        case IIR_LINE_STATUS:
+            inb(port + UART_LSR);
+            break;
+        case IIR_MODEM_STATUS:
+            inb(port + UART_MSR);
+            break;
+        }
+    }
+
+    return handled;
+}
+
+bool init_serial()
+{
+    outb(port + UART_IER, 0x00);                // Disable all interrupts
+    outb(port + UART_LCR, LCR_DLAB);            // Enable DLAB (set baud rate divisor)
+    uint16_t divisor = 115200 / SERIAL_BAUD_RATE;
+    outb(port + UART_DIVISOR_LOW, divisor & 0xFF);
+    outb(port + UART_DIVISOR_HIGH, (divisor >> 8) & 0xFF);
+    outb(port + UART_LCR, LCR_8N1);             // 8 bits, no parity, one stop bit
+    outb(port + UART_FCR, FCR_ENABLE_14);       // Enable FIFO, clear them, with 14-byte threshold
+
+    // Check that a UART is there by sending a byte to ourselves in loopback mode
+    outb(port + UART_MCR, MCR_LOOPBACK);
+    outb(port + UART_DATA, 0xAE);
+    if (inb(port + UART_DATA) != 0xAE)
+        return false;
+
+    // Normal operation with the interrupt line enabled
+    outb(port + UART_MCR, MCR_DTR_RTS_OUT2);
+
+    if (register_irq_handler(SERIAL_COM1_IRQ, serial_irq_handler, NULL) != 0)
+        return false;
+
+    outb(port + UART_IER, ier);
+    present = true;
+    return true;
+}
+
+bool serial_present()
+{
+    return present;
+}
+
+void serial_write(const char* data, size_t size)
+{
+    if (!present)
+        return;
+
+    uint32_t flags = interrupts_save();
+
+    for (size_t i = 0; i < size; i++) {
+        // Terminals expect a carriage return before the line feed
+        int needed = data[i] == '\n' ? 2 : 1;
+        if (tx_head - tx_tail + needed > SERIAL_TX_BUFFER_SIZE) {
+            tx_dropped++;
+            continue;
+        }
+        if (data[i] == '\n') {
+            tx_buffer[tx_head & (SERIAL_TX_BUFFER_SIZE - 1)] = '\r';
+            tx_head++;
+        }
+        tx_buffer[tx_head & (SERIAL_TX_BUFFER_SIZE - 1)] = data[i];
+        tx_head++;
+    }
+
+    // Start the transmitter if it is idle, the interrupt keeps it going.
+    // Should the FIFO still be busy, the interrupt comes when it is empty.
+    if (!tx_running && tx_tail != tx_head) {
+        if (inb(port + UART_LSR) & LSR_TX_EMPTY)
+            tx_fill_fifo();
+        else
+            tx_set_running(true);
+    }
+
+    interrupts_restore(flags);
+}
+
+size_t serial_read(char* data, size_t size)
+{
+    size_t count = 0;
+    while (count < size && rx_tail != rx_head) {
+        data[count++] = rx_buffer[rx_tail & (SERIAL_RX_BUFFER_SIZE - 1)];
+        rx_tail++;
+    }
+    return count;
+}
+
+int serial_getc()
+{
+    char c;
+    if (serial_read(&c, 1) == 0)
+        return -1;
+    return (unsigned char)c;
+}
+
+void serial_drain()
+{
+    if (!present)
+        return;
+
+    while (tx_tail != tx_head) {
+        while (!(inb(port + UART_LSR) & LSR_TX_EMPTY)) {}
+        outb(port + UART_DATA, tx_buffer[tx_tail & (SERIAL_TX_BUFFER_SIZE - 1)]);
+        tx_tail++;
+    }
+}
+
+uint32_t serial_dropped()
+{
+    return tx_dropped;
+}
@@ -0,0 +1,84 @@
+#include "drivers/virtio.h"
+#include "common.h"
+#include "memory/memory.h"
+
+// Keep the compiler from moving ring accesses across this point. x86 does
+// not reorder stores with other stores, so that is all the device needs.
+#define barrier() asm volatile("" ::: "memory")
+
+uint32_t virtio_negotiate(uint16_t io, uint32_t wanted) {
+    outb(io + VIRTIO_REG_DEVICE_STATUS, 0);
+    outb(io + VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_ACKNOWLEDGE);
+    outb(io + VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+
+    uint32_t features = inl(io + VIRTIO_REG_DEVICE_FEATURES) & wanted;
+    outl(io + VIRTIO_REG_GUEST_FEATURES, features);
+    return features;
+}
+
+bool virtq_init(struct virtq* vq, uint16_t io, uint16_t queue, void* memory, uint32_t memory_size) {
+    outw(io + VIRTIO_REG_QUEUE_SELECT, queue);
+    uint16_t size = inw(io + VIRTIO_REG_QUEUE_SIZE);
+    if (size == 0 || size > VIRTQ_MAX_SIZE || VIRTQ_MEMORY_SIZE(size) > memory_size)
+        return false;
+
+    memset(memory, 0, VIRTQ_MEMORY_SIZE(size));
+    vq->io = io;
+    vq->queue = queue;
+    vq->size = size;
+    vq->last_used = 0;
+    vq->added = 0;
+    vq->kicks = 0;
+    vq->desc = memory;
+    vq->avail = (struct virtq_avail*)((uint8_t*)memory + 16 * size);
+    vq->used = (struct virtq_used*)((uint8_t*)memory + VIRTQ_ALIGN_UP(16 * size + 6 + 2 * size));
+
+    outl(io + VIRTIO_REG_QUEUE_ADDRESS, (uint32_t)memory / VIRTQ_ALIGN);
+    return true;
+}
+
+void virtio_driver_ok(uint16_t io) {
+    outb(io + VIRTIO_REG_DEVICE_STATUS, inb(io + VIRTIO_REG_DEVICE_STATUS) | VIRTIO_STATUS_DRIVER_OK);
+}
+
+void virtq_submit(struct virtq* vq, uint16_t head) {
+    vq->avail->ring[(vq->avail->index + vq->added) % vq->size] = head;
+    vq->added++;
+}
+
+void virtq_kick(struct virtq* vq) {
+    if (vq->added == 0)
+        return;
+
+    // The ring entries must be visible before the index that covers them
+    barrier();
+    vq->avail->index += vq->added;
+    vq->added = 0;
+    barrier();
+
+    outw(vq->io + VIRTIO_REG_QUEUE_NOTIFY, vq->queue);
+    vq->kicks++;
+}
+
+bool virtq_next_used(struct virtq* vq, uint32_t* head, uint32_t* length) {
+    if (vq->last_used == vq->used->index)
+        return false;
+    barrier();
+
+    volatile struct virtq_used_elem* elem = &vq->used->ring[vq->last_used % vq->size];
+    *head = elem->id;
+    *length = elem->length;
+    vq->last_used++;
+    return true;
+}
+
+void virtq_suppress_interrupts(struct virtq* vq, bool suppress) {
+    if (suppress)
+        vq->avail->flags |= VIRTQ_AVAIL_F_NO_INTERRUPT;
+    else
+        vq->avail->flags &= ~VIRTQ_AVAIL_F_NO_INTERRUPT;
+}
+
+uint8_t virtio_ack_interrupt(uint16_t io) {
+    return inb(io + VIRTIO_REG_ISR_STATUS);
+}
@@ -0,0 +1,360 @@
+#include "drivers/virtio_blk.h"
+#include "drivers/virtio.h"
+#include "drivers/pci.h"
+#include "interrupts.h"
+#include "common.h"
+#include "pit.h"
+#include "memory/memory.h"
+
+// Device features
+#define VIRTIO_BLK_F_SIZE_MAX (1UL << 1)    // size_max in the config space is valid
+#define VIRTIO_BLK_F_RO       (1UL << 5)
+#define VIRTIO_BLK_F_FLUSH    (1UL << 9)
+
+// Device configuration, after the common registers
+#define VIRTIO_BLK_CONFIG_CAPACITY (VIRTIO_REG_CONFIG + 0)  // 64-bit sector count
+#define VIRTIO_BLK_CONFIG_SIZE_MAX (VIRTIO_REG_CONFIG + 8)  // Largest data segment
+
+#define VIRTIO_BLK_T_IN    0
+#define VIRTIO_BLK_T_OUT   1
+#define VIRTIO_BLK_T_FLUSH 4
+
+#define VIRTIO_BLK_S_OK      0
+#define VIRTIO_BLK_S_PENDING 0xFF   // Not a device status, set before submitting
+
+// Header, data segments and status. Without indirect descriptors a
+// request takes this many entries of the ring itself.
+#define VIRTIO_BLK_DESCS (2 + BLOCKDEV_MAX_SEGMENTS)
+
+#define VIRTIO_BLK_TIMEOUT_MS 5000
+#define VIRTIO_BLK_POLL_LIMIT 100000000     // Spins when the timer cannot be used
+
+struct virtio_blk_header {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+} __attribute__((packed));
+
+struct virtio_blk_request {
+    struct virtq_desc table[VIRTIO_BLK_DESCS] __attribute__((aligned(16)));
+    struct virtio_blk_header header;
+    volatile uint8_t status;    // Written by the device
+    volatile bool done;         // Came back on the used ring
+};
+
+struct virtio_blk {
+    uint16_t io;
+    uint8_t irq;
+    bool has_irq;
+    bool indirect;              // Requests are one indirect descriptor each
+    bool failed;                // Did not come back from a reset, takes no more requests
+    uint32_t features;          // Negotiated at probe time
+    uint32_t slots;             // Requests that fit on the ring at once
+    uint32_t request_sectors;   // Largest request the device takes
+    struct virtq vq;
+    blockdev_t dev;
+    struct virtio_blk_request requests[VIRTIO_BLK_SLOTS];
+};
+
+static struct virtio_blk disks[VIRTIO_BLK_MAX_DEVICES];
+static uint32_t disk_count = 0;
+static uint8_t queue_memory[VIRTIO_BLK_MAX_DEVICES][VIRTQ_MEMORY_SIZE(VIRTQ_MAX_SIZE)] __attribute__((aligned(VIRTQ_ALIGN)));
+static bool polling = false;
+static struct virtio_blk_stats stats;
+
+static void virtio_blk_set_desc(struct virtq_desc* desc, const volatile void* address, uint32_t length,
+                                uint16_t flags, uint16_t next) {
+    desc->address = (uint32_t)address;
+    desc->length = length;
+    desc->flags = flags;
+    desc->next = next;
+}
+
+// Fill in request slot and put it on the available ring
+static void virtio_blk_submit(struct virtio_blk* blk, uint32_t slot, uint32_t type, uint32_t lba,
+                              const blockdev_segment_t* segments, uint32_t segment_count) {
+    struct virtio_blk_request* request = &blk->requests[slot];
+    request->header.type = type;
+    request->header.reserved = 0;
+    request->header.sector = lba;
+    request->status = VIRTIO_BLK_S_PENDING;
+    request->done = false;
+
+    // Chain indexes are relative to the table they are in
+    uint16_t base = blk->indirect ? 0 : slot * VIRTIO_BLK_DESCS;
+    struct virtq_desc* desc = blk->indirect ? request->table : &blk->vq.desc[base];
+    uint16_t count = 0;
+
+    virtio_blk_set_desc(&desc[count], &request->header, sizeof(request->header), VIRTQ_DESC_F_NEXT, base + count + 1);
+    count++;
+    uint16_t flags = VIRTQ_DESC_F_NEXT | (type == VIRTIO_BLK_T_IN ? VIRTQ_DESC_F_WRITE : 0);
+    for (uint32_t i = 0; i < segment_count; i++) {
+        virtio_blk_set_desc(&desc[count], segments[i].buffer, segments[i].sectors * BLOCKDEV_SECTOR_SIZE,
+                            flags, base + count + 1);
+        count++;
+    }
+    virtio_blk_set_desc(&desc[count], &request->status, 1, VIRTQ_DESC_F_WRITE, 0);
+    count++;
+
+    if (blk->indirect) {
+        virtio_blk_set_desc(&blk->vq.desc[slot], request->table, count * sizeof(struct virtq_desc),
+                            VIRTQ_DESC_F_INDIRECT, 0);
+        virtq_submit(&blk->vq, slot);
+    } else {
+        virtq_submit(&blk->vq, base);
+    }
+}
+
+// Mark every request the device has given back as done
+static void virtio_blk_reap(struct virtio_blk* blk) {
+    uint32_t head, length;
+    while (virtq_next_used(&blk->vq, &head, &length)) {
+        uint32_t slot = blk->indirect ? head : head / VIRTIO_BLK_DESCS;
+        if (slot < blk->slots) {
+            blk->requests[slot].done = true;
+            stats.requests++;
+        }
+    }
+}
+
+static bool virtio_blk_all_done(struct virtio_blk* blk, uint32_t slots) {
+    for (uint32_t i = 0; i < slots; i++) {
+        if (!blk->requests[i].done)
+            return false;
+    }
+    return true;
+}
+
+// Wait for the first slots requests. Interrupt driven, the CPU sleeps with
+// sti; hlt, which cannot miss the wakeup. Polling spins on the used ring.
+static bool virtio_blk_wait(struct virtio_blk* blk, uint32_t slots) {
+    uint32_t start = pit_get_ticks();
+    for (uint32_t spins = 0; spins < VIRTIO_BLK_POLL_LIMIT; spins++) {
+        uint32_t flags = interrupts_save();
+        virtio_blk_reap(blk);
+        if (virtio_blk_all_done(blk, slots)) {
+            interrupts_restore(flags);
+            return true;
+        }
+
+        bool interrupts_on = (flags & 0x200) != 0;
+        if (interrupts_on && pit_get_ticks() - start >= VIRTIO_BLK_TIMEOUT_MS * TICKS_PER_MS) {
+            interrupts_restore(flags);
+            return false;
+        }
+        if (interrupts_on && !polling && blk->has_irq) {
+            asm volatile("sti; hlt");
+        } else {
+            interrupts_restore(flags);
+            asm volatile("rep; nop");
+        }
+    }
+    return false;
+}
+
+// A wait timed out with requests still in flight. The device could yet
+// complete stale heads and write into buffers the caller has given up on,
+// so the ring cannot be reused as it is. A reset stops the device and
+// drops whatever it was doing, then the queue is set up afresh. A device
+// that does not come back takes no more requests.
+static void virtio_blk_reset(struct virtio_blk* blk) {
+    uint32_t flags = interrupts_save();
+    uint32_t kicks = blk->vq.kicks;
+    uint16_t size = blk->vq.size;
+    uint32_t number = blk - disks;
+    if (virtio_negotiate(blk->io, blk->features) != blk->features ||
+        !virtq_init(&blk->vq, blk->io, 0, queue_memory[number], sizeof(queue_memory[number])) ||
+        blk->vq.size != size) {
+        outb(blk->io + VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_FAILED);
+        blk->failed = true;
+        printf("virtio-blk %s: no response after a reset, giving up on it\n", blk->dev.name);
+    } else {
+        blk->vq.kicks = kicks;
+        virtq_suppress_interrupts(&blk->vq, polling || !blk->has_irq);
+        virtio_driver_ok(blk->io);
+    }
+    interrupts_restore(flags);
+}
+
+// Cut the transfer into requests, submit as many as fit on the ring with a
+// single notification, and wait for them before going on with the rest
+static bool virtio_blk_transfer(struct virtio_blk* blk, uint32_t type, uint32_t lba,
+                                const blockdev_segment_t* segments, uint32_t segment_count) {
+    uint32_t segment = 0;       // Position in the segments: which one,
+    uint32_t offset = 0;        // and how many of its sectors are done
+    bool ok = true;
+    if (blk->failed)
+        return false;
+
+    do {
+        uint32_t used = 0;
+        do {
+            // Fill a request with up to request_sectors, splitting segments
+            // that do not fit
+            blockdev_segment_t parts[BLOCKDEV_MAX_SEGMENTS];
+            uint32_t part_count = 0;
+            uint32_t sectors = 0;
+            while (segment < segment_count && part_count < BLOCKDEV_MAX_SEGMENTS &&
+                   sectors < blk->request_sectors) {
+                uint32_t take = segments[segment].sectors - offset;
+                if (take > blk->request_sectors - sectors)
+                    take = blk->request_sectors - sectors;
+                parts[part_count].buffer = (uint8_t*)segments[segment].buffer + offset * BLOCKDEV_SECTOR_SIZE;
+                parts[part_count].sectors = take;
+                part_count++;
+                sectors += take;
+                offset += take;
+                if (offset == segments[segment].sectors) {
+                    segment++;
+                    offset = 0;
+                }
+            }
+            virtio_blk_submit(blk, used++, type, lba, parts, part_count);
+            lba += sectors;
+        } while (segment < segment_count && used < blk->slots);
+
+        virtq_kick(&blk->vq);
+        if (!virtio_blk_wait(blk, used)) {
+            stats.timeouts++;
+            virtio_blk_reset(blk);
+            return false;
+        }
+
+        for (uint32_t i = 0; i < used; i++) {
+            if (blk->requests[i].status != VIRTIO_BLK_S_OK) {
+                stats.errors++;
+                ok = false;
+            }
+        }
+    } while (segment < segment_count);
+
+    return ok;
+}
+
+static bool virtio_blk_transfer_segments(blockdev_t* dev, bool write, uint32_t lba,
+                                         const blockdev_segment_t* segments, uint32_t count) {
+    return virtio_blk_transfer(dev->ctx, write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN, lba, segments, count);
+}
+
+static bool virtio_blk_read(blockdev_t* dev, uint32_t lba, uint32_t count, void* buffer) {
+    blockdev_segment_t segment = { buffer, count };
+    return virtio_blk_transfer(dev->ctx, VIRTIO_BLK_T_IN, lba, &segment, 1);
+}
+
+static bool virtio_blk_write(blockdev_t* dev, uint32_t lba, uint32_t count, const void* buffer) {
+    blockdev_segment_t segment = { (void*)buffer, count };
+    return virtio_blk_transfer(dev->ctx, VIRTIO_BLK_T_OUT, lba, &segment, 1);
+}
+
+static bool virtio_blk_flush(blockdev_t* dev) {
+    return virtio_blk_transfer(dev->ctx, VIRTIO_BLK_T_FLUSH, 0, NULL, 0);
+}
+
+static int virtio_blk_irq(registers_t* regs, void* ctx) {
+    struct virtio_blk* blk = ctx;
+    uint8_t isr = virtio_ack_interrupt(blk->io);
+    if (isr == 0)
+        return IRQ_NONE;
+
+    stats.interrupts++;
+    if (isr & VIRTIO_ISR_QUEUE)
+        virtio_blk_reap(blk);
+    return IRQ_HANDLED;
+}
+
+static bool virtio_blk_probe(struct pci_device* device) {
+    if (disk_count == VIRTIO_BLK_MAX_DEVICES || !device->bars[0].io)
+        return false;
+
+    struct virtio_blk* blk = &disks[disk_count];
+    uint16_t io = device->bars[0].base;
+    pci_enable(device->address, PCI_COMMAND_IO | PCI_COMMAND_BUS_MASTER);
+
+    uint32_t features = virtio_negotiate(io, VIRTIO_BLK_F_SIZE_MAX | VIRTIO_BLK_F_RO |
+                                             VIRTIO_BLK_F_FLUSH | VIRTIO_F_RING_INDIRECT_DESC);
+    if (!virtq_init(&blk->vq, io, 0, queue_memory[disk_count], sizeof(queue_memory[0]))) {
+        outb(io + VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_FAILED);
+        return false;
+    }
+
+    blk->io = io;
+    blk->features = features;
+    blk->failed = false;
+    blk->indirect = (features & VIRTIO_F_RING_INDIRECT_DESC) != 0;
+    blk->slots = blk->indirect ? blk->vq.size : blk->vq.size / VIRTIO_BLK_DESCS;
+    if (blk->slots > VIRTIO_BLK_SLOTS)
+        blk->slots = VIRTIO_BLK_SLOTS;
+    if (blk->slots == 0) {
+        outb(io + VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_FAILED);
+        return false;
+    }
+
+    blk->request_sectors = VIRTIO_BLK_REQUEST_SECTORS;
+    if (features & VIRTIO_BLK_F_SIZE_MAX) {
+        uint32_t size_max = inl(io + VIRTIO_BLK_CONFIG_SIZE_MAX) / BLOCKDEV_SECTOR_SIZE;
+        if (size_max > 0 && size_max < blk->request_sectors)
+            blk->request_sectors = size_max;
+    }
+
+    // Disks beyond 2 TiB are cut down to what 32-bit sector numbers reach
+    uint32_t capacity = inl(io + VIRTIO_BLK_CONFIG_CAPACITY);
+    if (inl(io + VIRTIO_BLK_CONFIG_CAPACITY + 4) != 0)
+        capacity = 0xFFFFFFFF;
+
+    blk->dev.name[0] = 'v';
+    blk->dev.name[1] = 'd';
+    blk->dev.name[2] = 'a' + disk_count;
+    blk->dev.name[3] = '\0';
+    blk->dev.sectors = capacity;
+    blk->dev.max_sectors = VIRTIO_BLK_MAX_SECTORS;
+    blk->dev.read_only = (features & VIRTIO_BLK_F_RO) != 0;
+    blk->dev.read = virtio_blk_read;
+    blk->dev.write = virtio_blk_write;
+    blk->dev.flush = (features & VIRTIO_BLK_F_FLUSH) ? virtio_blk_flush : NULL;
+    blk->dev.transfer = virtio_blk_transfer_segments;
+    blk->dev.max_segments = BLOCKDEV_MAX_SEGMENTS;
+    blk->dev.ctx = blk;
+
+    blk->irq = device->interrupt_line;
+    blk->has_irq = blk->irq != PCI_INTERRUPT_NONE && register_irq_handler(blk->irq, virtio_blk_irq, blk) == 0;
+    virtq_suppress_interrupts(&blk->vq, polling || !blk->has_irq);
+    virtio_driver_ok(io);
+
+    blockdev_register(&blk->dev);
+    disk_count++;
+    printf("virtio-blk %s: %lu MiB, %u entry queue, %s descriptors%s\n", blk->dev.name,
+           capacity / (1024 * 1024 / BLOCKDEV_SECTOR_SIZE), blk->vq.size,
+           blk->indirect ? "indirect" : "chained", blk->dev.read_only ? ", read-only" : "");
+    return true;
+}
+
+static const struct pci_device_id virtio_blk_ids[] = {
+    { VIRTIO_VENDOR_ID, VIRTIO_BLK_DEVICE_ID, PCI_ANY_CLASS, PCI_ANY_CLASS },
+    { 0 },
+};
+
+static const struct pci_driver virtio_blk_driver = { "virtio-blk", virtio_blk_ids, virtio_blk_probe };
+
+uint32_t init_virtio_blk() {
+    pci_register_driver(&virtio_blk_driver);
+    return disk_count;
+}
+
+void virtio_blk_set_polling(bool enabled) {
+    polling = enabled;
+    for (uint32_t i = 0; i < disk_count; i++)
+        virtq_suppress_interrupts(&disks[i].vq, polling || !disks[i].has_irq);
+}
+
+void virtio_blk_get_stats(struct virtio_blk_stats* out) {
+    *out = stats;
+    out->kicks = 0;
+    for (uint32_t i = 0; i < disk_count; i++)
+        out->kicks += disks[i].vq.kicks;
+}
+
+void virtio_blk_reset_stats() {
+    memset(&stats, 0, sizeof(stats));
+    for (uint32_t i = 0; i < disk_count; i++)
+        disks[i].vq.kicks = 0;
+}
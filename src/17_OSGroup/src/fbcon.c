@@ -0,0 +1,174 @@
+#include "fbcon.h"
+#include "monitor.h"
+#include "memory/memory.h"
+
+// Framebuffer geometry
+static uint8_t* fb = NULL;
+static uint32_t fb_pitch;
+static uint32_t fb_width;
+static uint32_t fb_height;
+static size_t fb_cols;
+static size_t fb_rows;
+
+// The 16 VGA text mode colours, converted to the framebuffer's pixel format
+static uint32_t palette[16];
+
+static const uint8_t vga_palette_rgb[16][3] = {
+    {0x00, 0x00, 0x00}, {0x00, 0x00, 0xAA}, {0x00, 0xAA, 0x00}, {0x00, 0xAA, 0xAA},
+    {0xAA, 0x00, 0x00}, {0xAA, 0x00, 0xAA}, {0xAA, 0x55, 0x00}, {0xAA, 0xAA, 0xAA},
+    {0x55, 0x55, 0x55}, {0x55, 0x55, 0xFF}, {0x55, 0xFF, 0x55}, {0x55, 0xFF, 0xFF},
+    {0xFF, 0x55, 0x55}, {0xFF, 0x55, 0xFF}, {0xFF, 0xFF, 0x55}, {0xFF, 0xFF, 0xFF},
+};
+
+// Every possible 8-pixel glyph row, pre-rendered for one colour pair, so a
+// glyph row is drawn by copying 8 words from the table
+struct glyph_cache {
+    bool valid;
+    uint8_t attr;                       // VGA attribute (background << 4 | foreground)
+    uint32_t rows[256][FONT_WIDTH];     // Pixels for every glyph row bit pattern
+};
+
+static struct glyph_cache glyph_caches[FBCON_CACHE_SLOTS];
+static struct glyph_cache* last_cache = NULL;
+static size_t next_cache_slot = 0;
+
+// Scale an 8-bit colour channel into a field of the pixel
+static uint32_t channel(uint8_t value, uint8_t position, uint8_t size)
+{
+    return ((uint32_t)value >> (8 - size)) << position;
+}
+
+// Pre-rendered rows for the given attribute, rendering them on a miss
+static const struct glyph_cache* glyph_cache_for(uint8_t attr)
+{
+    if (last_cache != NULL && last_cache->attr == attr)
+        return last_cache;
+
+    for (size_t i = 0; i < FBCON_CACHE_SLOTS; i++) {
+        if (glyph_caches[i].valid && glyph_caches[i].attr == attr) {
+            last_cache = &glyph_caches[i];
+            return last_cache;
+        }
+    }
+
+    // Replace the slots round robin
+    struct glyph_cache* cache = &glyph_caches[next_cache_slot];
+    next_cache_slot = (next_cache_slot + 1) % FBCON_CACHE_SLOTS;
+
+    uint32_t fg = palette[attr & 0x0F];
+    uint32_t bg = palette[(attr >> 4) & 0x0F];
+    for (int bits = 0; bits < 256; bits++) {
+        for (int px = 0; px < FONT_WIDTH; px++)
+            cache->rows[bits][px] = (bits & (0x80 >> px)) ? fg : bg;
+    }
+    cache->attr = attr;
+    cache->valid = true;
+
+    last_cache = cache;
+    return cache;
+}
+
+static void fbcon_draw_row(size_t y, const uint16_t* cells, size_t cols)
+{
+    uint8_t* line = fb + y * FONT_HEIGHT * fb_pitch;
+
+    for (size_t x = 0; x < cols; x++) {
+        uint16_t cell = cells[x];
+        const struct glyph_cache* cache = glyph_cache_for(cell >> 8);
+        const uint8_t* glyph = font8x16[cell & 0xFF];
+
+        uint8_t* dst = line + x * FONT_WIDTH * sizeof(uint32_t);
+        for (int gy = 0; gy < FONT_HEIGHT; gy++) {
+            const uint32_t* src = cache->rows[glyph[gy]];
+            uint32_t* pixels = (uint32_t*)dst;
+            pixels[0] = src[0];
+            pixels[1] = src[1];
+            pixels[2] = src[2];
+            pixels[3] = src[3];
+            pixels[4] = src[4];
+            pixels[5] = src[5];
+            pixels[6] = src[6];
+            pixels[7] = src[7];
+            dst += fb_pitch;
+        }
+    }
+}
+
+// Move the whole text area up, the monitor redraws the rows that came in
+static void fbcon_scroll(size_t lines)
+{
+    size_t row_bytes = FONT_HEIGHT * fb_pitch;
+    memmove(fb, fb + lines * row_bytes, (fb_rows - lines) * row_bytes);
+}
+
+// Underline the cell the cursor is in
+static void fbcon_set_cursor(size_t x, size_t y)
+{
+    if (x >= fb_cols || y >= fb_rows)
+        return;
+
+    uint8_t* dst = fb + (y * FONT_HEIGHT + FONT_HEIGHT - 2) * fb_pitch + x * FONT_WIDTH * sizeof(uint32_t);
+    for (int line = 0; line < 2; line++) {
+        uint32_t* pixels = (uint32_t*)dst;
+        for (int px = 0; px < FONT_WIDTH; px++)
+            pixels[px] = palette[7];
+        dst += fb_pitch;
+    }
+}
+
+static const struct monitor_backend fbcon_backend = {
+    .draw_row = fbcon_draw_row,
+    .scroll = fbcon_scroll,
+    .set_cursor = fbcon_set_cursor,
+    .soft_cursor = true,
+};
+
+bool fbcon_init(struct multiboot_tag_framebuffer* tag)
+{
+    struct multiboot_tag_framebuffer_common* common = &tag->common;
+    if (common->framebuffer_type != MULTIBOOT_FRAMEBUFFER_TYPE_RGB || common->framebuffer_bpp != 32)
+        return false;
+    if (common->framebuffer_addr >= 0x100000000ULL)
+        return false;
+
+    uint32_t addr = (uint32_t)common->framebuffer_addr;
+    uint32_t size = common->framebuffer_pitch * common->framebuffer_height;
+
+    // Identity map the framebuffer, paging works in 4 MB page tables
+    for (uint32_t page = addr & ~0x3FFFFF; page < addr + size; page += 0x400000)
+        paging_map_virtual_to_phys(page, page);
+
+    fb = (uint8_t*)addr;
+    fb_pitch = common->framebuffer_pitch;
+    fb_width = common->framebuffer_width;
+    fb_height = common->framebuffer_height;
+    fb_cols = fb_width / FONT_WIDTH;
+    fb_rows = fb_height / FONT_HEIGHT;
+    if (fb_cols > MONITOR_MAX_COLS)
+        fb_cols = MONITOR_MAX_COLS;
+    if (fb_rows > MONITOR_MAX_ROWS)
+        fb_rows = MONITOR_MAX_ROWS;
+
+    for (int i = 0; i < 16; i++) {
+        palette[i] = channel(vga_palette_rgb[i][0], tag->framebuffer_red_field_position, tag->framebuffer_red_mask_size)
+                   | channel(vga_palette_rgb[i][1], tag->framebuffer_green_field_position, tag->framebuffer_green_mask_size)
+                   | channel(vga_palette_rgb[i][2], tag->framebuffer_blue_field_position, tag->framebuffer_blue_mask_size);
+    }
+
+    // Clear the whole framebuffer, including the margins outside the grid
+    memset(fb, 0, size);
+
+    fbcon_attach();
+    return true;
+}
+
+bool fbcon_active()
+{
+    return fb != NULL;
+}
+
+void fbcon_attach()
+{
+    if (fb != NULL)
+        monitor_set_backend(&fbcon_backend, fb_cols, fb_rows);
+}
@@ -0,0 +1,1222 @@
+#include "fs/fat32.h"
+#include "bcache.h"
+#include "memory/memory.h"
+
+// FAT entry values
+#define FAT32_MASK        0x0FFFFFFF    // The top 4 bits are reserved
+#define FAT32_FREE        0
+#define FAT32_BAD         0x0FFFFFF7
+#define FAT32_END         0x0FFFFFF8    // This and above end a chain
+#define FAT32_END_MARK    0x0FFFFFFF
+#define FAT32_FAT_SECTORS_MAX 0x200000  // One FAT copy for 2^28 clusters
+
+#define FAT32_ENTRY_SIZE  32
+#define FAT32_ENTRY_END   0x00          // First byte of the entry after the last one
+#define FAT32_ENTRY_FREE  0xE5          // First byte of a deleted entry
+#define FAT32_ENTRY_KANJI 0x05          // Stands for a leading 0xE5
+#define FAT32_LFN_LAST    0x40          // Order of the long name entry stored first
+#define FAT32_LFN_CHARS   13            // Characters per long name entry
+#define FAT32_NT_LOWER_BASE 0x08        // Short name base is lower case
+#define FAT32_NT_LOWER_EXT  0x10        // Short name extension is lower case
+
+// The date every entry gets: 2024-01-01
+#define FAT32_DATE ((2024 - 1980) << 9 | 1 << 5 | 1)
+
+#define FAT32_FSINFO_LEAD   0x41615252
+#define FAT32_FSINFO_STRUCT 0x61417272
+#define FAT32_FSINFO_UNKNOWN 0xFFFFFFFF
+
+// Directory entry fields
+#define DIR_NAME         0
+#define DIR_ATTR         11
+#define DIR_NTRES        12
+#define DIR_CRT_DATE     16
+#define DIR_ACC_DATE     18
+#define DIR_CLUSTER_HIGH 20
+#define DIR_WRT_DATE     24
+#define DIR_CLUSTER_LOW  26
+#define DIR_SIZE         28
+#define LFN_CHECKSUM     13
+
+static uint16_t le16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t le32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put16(uint8_t* p, uint16_t value) {
+    p[0] = value;
+    p[1] = value >> 8;
+}
+
+static void put32(uint8_t* p, uint32_t value) {
+    put16(p, value);
+    put16(p + 2, value >> 16);
+}
+
+static char fat32_upper(char c) {
+    return c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c;
+}
+
+static char fat32_lower(char c) {
+    return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+static bool fat32_name_equal(const char* a, const char* b) {
+    while (*a != '\0' && fat32_upper(*a) == fat32_upper(*b)) {
+        a++;
+        b++;
+    }
+    return fat32_upper(*a) == fat32_upper(*b);
+}
+
+// Copy bytes in or out of the volume through the buffer cache, starting
+// offset bytes into sector lba
+static bool fat32_io(fat32_fs_t* fs, uint32_t lba, uint32_t offset, void* data, uint32_t size, bool write) {
+    uint8_t* bytes = data;
+    while (size > 0) {
+        lba += offset / BLOCKDEV_SECTOR_SIZE;
+        offset %= BLOCKDEV_SECTOR_SIZE;
+
+        uint32_t block = lba / BCACHE_BLOCK_SECTORS;
+        uint32_t within = (lba % BCACHE_BLOCK_SECTORS) * BLOCKDEV_SECTOR_SIZE + offset;
+        uint32_t count = BCACHE_BLOCK_SIZE - within;
+        if (count > size)
+            count = size;
+
+        struct bcache_buffer* buffer = write && count == BCACHE_BLOCK_SIZE ? bcache_get_new(fs->dev, block)
+                                                                           : bcache_get(fs->dev, block);
+        if (buffer == NULL)
+            return false;
+        if (within + count > buffer->sectors * BLOCKDEV_SECTOR_SIZE) {
+            bcache_release(buffer);
+            return false;
+        }
+        if (write) {
+            memcpy(buffer->data + within, bytes, count);
+            bcache_mark_dirty(buffer);
+        } else {
+            memcpy(bytes, buffer->data + within, count);
+        }
+        bcache_release(buffer);
+
+        offset += count;
+        bytes += count;
+        size -= count;
+    }
+    return true;
+}
+
+static uint32_t fat32_cluster_lba(const fat32_fs_t* fs, uint32_t cluster) {
+    return fs->data_start + (cluster - 2) * fs->sectors_per_cluster;
+}
+
+static bool fat32_valid_cluster(const fat32_fs_t* fs, uint32_t cluster) {
+    return cluster >= 2 && cluster - 2 < fs->clusters;
+}
+
+static bool fat32_zero_cluster(fat32_fs_t* fs, uint32_t cluster) {
+    static const uint8_t zeros[BLOCKDEV_SECTOR_SIZE];
+    uint32_t lba = fat32_cluster_lba(fs, cluster);
+    for (uint32_t i = 0; i < fs->sectors_per_cluster; i++) {
+        if (!fat32_io(fs, lba + i, 0, (void*)zeros, BLOCKDEV_SECTOR_SIZE, true))
+            return false;
+    }
+    return true;
+}
+
+static uint32_t fat32_get(fat32_fs_t* fs, uint32_t cluster) {
+    if (fs->fat != NULL)
+        return fs->fat[cluster] & FAT32_MASK;
+
+    uint8_t entry[4];
+    if (!fat32_io(fs, fs->fat_start + fs->active_fat * fs->fat_sectors, cluster * 4, entry, 4, false))
+        return FAT32_BAD;
+    return le32(entry) & FAT32_MASK;
+}
+
+// Change an entry, keeping its reserved bits. Every copy is written
+// through the buffer cache right away, so the FAT reaches the disk on the
+// cache's write-back schedule, no later than the directory entries that
+// point into it. The in-memory FAT only saves the reads.
+static bool fat32_set(fat32_fs_t* fs, uint32_t cluster, uint32_t value) {
+    uint8_t entry[4];
+    if (fs->fat != NULL) {
+        put32(entry, fs->fat[cluster]);
+    } else if (!fat32_io(fs, fs->fat_start + fs->active_fat * fs->fat_sectors, cluster * 4, entry, 4, false)) {
+        return false;
+    }
+    put32(entry, (le32(entry) & ~FAT32_MASK) | (value & FAT32_MASK));
+
+    for (uint32_t i = 0; i < fs->fat_count; i++) {
+        if (!fs->mirrored && i != fs->active_fat)
+            continue;
+        if (!fat32_io(fs, fs->fat_start + i * fs->fat_sectors, cluster * 4, entry, 4, true))
+            return false;
+    }
+    if (fs->fat != NULL)
+        fs->fat[cluster] = le32(entry);
+    return true;
+}
+
+// Take a free cluster, searching from hint on, and end a chain with it.
+// Returns 0 if the volume is full.
+static uint32_t fat32_alloc(fat32_fs_t* fs, uint32_t hint) {
+    if (!fat32_valid_cluster(fs, hint))
+        hint = fat32_valid_cluster(fs, fs->next_free) ? fs->next_free : 2;
+
+    for (uint32_t i = 0; i < fs->clusters; i++) {
+        uint32_t cluster = 2 + (hint - 2 + i) % fs->clusters;
+        if (fat32_get(fs, cluster) != FAT32_FREE)
+            continue;
+        if (!fat32_set(fs, cluster, FAT32_END_MARK))
+            return 0;
+        fs->free_clusters--;
+        fs->next_free = cluster + 1;
+        return cluster;
+    }
+    return 0;
+}
+
+static bool fat32_free_chain(fat32_fs_t* fs, uint32_t cluster) {
+    for (uint32_t i = 0; i < fs->clusters && fat32_valid_cluster(fs, cluster); i++) {
+        uint32_t next = fat32_get(fs, cluster);
+        if (!fat32_set(fs, cluster, FAT32_FREE))
+            return false;
+        fs->free_clusters++;
+        if (next >= FAT32_END)
+            break;
+        cluster = next;
+    }
+    return true;
+}
+
+// Add cluster to the end of the file's runs
+static bool fat32_extent_append(fat32_file_t* file, uint32_t cluster) {
+    if (file->extent_count > 0) {
+        struct fat32_extent* last = &file->extents[file->extent_count - 1];
+        if (last->cluster + last->count == cluster) {
+            last->count++;
+            file->chain++;
+            return true;
+        }
+    }
+
+    if (file->extent_count == file->extent_capacity) {
+        uint32_t capacity = file->extent_capacity ? file->extent_capacity * 2 : 4;
+        struct fat32_extent* extents = malloc(capacity * sizeof(*extents));
+        if (extents == NULL)
+            return false;
+        if (file->extents != NULL) {
+            memcpy(extents, file->extents, file->extent_count * sizeof(*extents));
+            free(file->extents);
+        }
+        file->extents = extents;
+        file->extent_capacity = capacity;
+    }
+
+    struct fat32_extent* extent = &file->extents[file->extent_count++];
+    extent->index = file->chain;
+    extent->cluster = cluster;
+    extent->count = 1;
+    file->chain++;
+    return true;
+}
+
+static void fat32_drop_extents(fat32_file_t* file) {
+    if (file->extents != NULL)
+        free(file->extents);
+    file->extents = NULL;
+    file->extent_count = 0;
+    file->extent_capacity = 0;
+}
+
+// Set up a file on its chain, read into runs once here so that seeking
+// never has to follow the FAT. Directories are as long as their chain.
+static bool fat32_file_init(fat32_fs_t* fs, fat32_file_t* file, uint32_t cluster, uint32_t size,
+                            uint8_t attr, uint32_t dir, uint32_t offset) {
+    memset(file, 0, sizeof(*file));
+    file->fs = fs;
+    file->dir = dir;
+    file->offset = offset;
+    file->cluster = cluster;
+    file->size = size;
+    file->attr = attr;
+
+    for (uint32_t i = 0; i < fs->clusters && fat32_valid_cluster(fs, cluster); i++) {
+        if (!fat32_extent_append(file, cluster))
+            break;
+        cluster = fat32_get(fs, cluster);
+        if (cluster >= FAT32_END)
+            break;
+    }
+    if (cluster < FAT32_END && file->cluster != 0) {
+        // A chain that runs into a free or bad cluster, or loops
+        fat32_drop_extents(file);
+        return false;
+    }
+
+    uint32_t allocated = file->chain * fs->cluster_size;
+    if ((attr & FAT32_ATTR_DIRECTORY) || file->size > allocated)
+        file->size = allocated;
+    return true;
+}
+
+// Disk cluster of the file's cluster number index, and how many clusters
+// follow it contiguously. The run used last and the one after it are
+// tried first, which is what sequential access needs.
+static bool fat32_map(fat32_file_t* file, uint32_t index, uint32_t* cluster, uint32_t* run) {
+    file->fs->stats.seeks++;
+    if (index >= file->chain)
+        return false;
+
+    uint32_t hint = file->hint;
+    struct fat32_extent* extent = &file->extents[hint];
+    if (index < extent->index || index >= extent->index + extent->count) {
+        if (hint + 1 < file->extent_count && index >= file->extents[hint + 1].index &&
+            index < file->extents[hint + 1].index + file->extents[hint + 1].count) {
+            hint++;
+        } else {
+            file->fs->stats.searches++;
+            uint32_t low = 0;
+            uint32_t high = file->extent_count - 1;
+            while (low < high) {
+                uint32_t middle = (low + high + 1) / 2;
+                if (file->extents[middle].index <= index)
+                    low = middle;
+                else
+                    high = middle - 1;
+            }
+            hint = low;
+        }
+        file->hint = hint;
+        extent = &file->extents[hint];
+    }
+
+    *cluster = extent->cluster + index - extent->index;
+    *run = extent->count - (index - extent->index);
+    return true;
+}
+
+// Append a cluster to the file. Directories get it zeroed, so the new
+// entries read as the end of the directory.
+static bool fat32_extend(fat32_file_t* file) {
+    fat32_fs_t* fs = file->fs;
+    uint32_t last = 0;
+    if (file->extent_count > 0) {
+        struct fat32_extent* extent = &file->extents[file->extent_count - 1];
+        last = extent->cluster + extent->count - 1;
+    }
+
+    uint32_t cluster = fat32_alloc(fs, last + 1);
+    if (cluster == 0)
+        return false;
+    if (last != 0) {
+        if (!fat32_set(fs, last, cluster))
+            return false;
+    } else {
+        file->cluster = cluster;
+        file->dirty = true;
+    }
+    if (!fat32_extent_append(file, cluster))
+        return false;
+
+    if (file->attr & FAT32_ATTR_DIRECTORY) {
+        if (!fat32_zero_cluster(fs, cluster))
+            return false;
+        file->size = file->chain * fs->cluster_size;
+    }
+    return true;
+}
+
+// Transfer size bytes at position, in pieces as long as the contiguous
+// runs allow. Writes grow the file as needed, reads stop at its end.
+static int32_t fat32_file_io(fat32_file_t* file, uint32_t position, void* data, uint32_t size, bool write) {
+    fat32_fs_t* fs = file->fs;
+    uint8_t* bytes = data;
+    uint32_t done = 0;
+
+    if (!write) {
+        if (position >= file->size)
+            return 0;
+        if (size > file->size - position)
+            size = file->size - position;
+    }
+
+    while (done < size) {
+        uint32_t index = position / fs->cluster_size;
+        uint32_t within = position % fs->cluster_size;
+        while (write && index >= file->chain) {
+            if (!fat32_extend(file))
+                return done > 0 ? (int32_t)done : -1;
+        }
+
+        uint32_t cluster, run;
+        if (!fat32_map(file, index, &cluster, &run))
+            return -1;
+        uint32_t count = run * fs->cluster_size - within;
+        if (count > size - done)
+            count = size - done;
+
+        if (!fat32_io(fs, fat32_cluster_lba(fs, cluster), within, bytes + done, count, write))
+            return -1;
+        done += count;
+        position += count;
+        if (write && position > file->size) {
+            file->size = position;
+            file->dirty = true;
+        }
+    }
+    return (int32_t)done;
+}
+
+// The short name as it is shown: "NAME.EXT", in lower case where the
+// entry's NT flags say so
+static void fat32_short_to_name(const char* short_name, uint8_t ntres, char* name) {
+    int length = 0;
+    for (int i = 0; i < 8 && short_name[i] != ' '; i++) {
+        char c = (i == 0 && (uint8_t)short_name[i] == FAT32_ENTRY_KANJI) ? (char)FAT32_ENTRY_FREE : short_name[i];
+        name[length++] = (ntres & FAT32_NT_LOWER_BASE) ? fat32_lower(c) : c;
+    }
+    if (short_name[8] != ' ') {
+        name[length++] = '.';
+        for (int i = 8; i < 11 && short_name[i] != ' '; i++)
+            name[length++] = (ntres & FAT32_NT_LOWER_EXT) ? fat32_lower(short_name[i]) : short_name[i];
+    }
+    name[length] = '\0';
+}
+
+static uint8_t fat32_checksum(const char* short_name) {
+    uint8_t sum = 0;
+    for (int i = 0; i < 11; i++)
+        sum = ((sum & 1) ? 0x80 : 0) + (sum >> 1) + (uint8_t)short_name[i];
+    return sum;
+}
+
+// Walks the entries of a directory a sector at a time, putting long names
+// together with their short entries
+struct fat32_scan {
+    fat32_file_t* dir;
+    uint32_t offset;
+    uint32_t loaded;                    // Directory offset of sector, UINT32_MAX if none
+    uint8_t sector[BLOCKDEV_SECTOR_SIZE];
+};
+
+static void fat32_scan_init(struct fat32_scan* scan, fat32_file_t* dir, uint32_t offset) {
+    scan->dir = dir;
+    scan->offset = offset;
+    scan->loaded = UINT32_MAX;
+}
+
+// The raw entry at the scan's offset, NULL past the end or on an error
+static uint8_t* fat32_scan_raw(struct fat32_scan* scan) {
+    if (scan->offset + FAT32_ENTRY_SIZE > scan->dir->size)
+        return NULL;
+    uint32_t sector = scan->offset - scan->offset % BLOCKDEV_SECTOR_SIZE;
+    if (sector != scan->loaded) {
+        if (fat32_file_io(scan->dir, sector, scan->sector, BLOCKDEV_SECTOR_SIZE, false) != BLOCKDEV_SECTOR_SIZE)
+            return NULL;
+        scan->loaded = sector;
+    }
+    return scan->sector + scan->offset % BLOCKDEV_SECTOR_SIZE;
+}
+
+// The next entry that is in use, volume labels left out. Long name
+// entries that do not belong to the short entry after them (wrong order,
+// wrong checksum) are ignored, as the specification says.
+static bool fat32_scan_next(struct fat32_scan* scan, struct fat32_entry* entry) {
+    bool long_name = false;
+    uint8_t expect = 0;
+    uint8_t checksum = 0;
+    uint8_t slots = 0;
+    uint8_t* raw;
+
+    while ((raw = fat32_scan_raw(scan)) != NULL) {
+        scan->offset += FAT32_ENTRY_SIZE;
+        if (raw[DIR_NAME] == FAT32_ENTRY_END)
+            return false;
+        if (raw[DIR_NAME] == FAT32_ENTRY_FREE) {
+            long_name = false;
+            continue;
+        }
+
+        uint8_t attr = raw[DIR_ATTR];
+        if ((attr & 0x3F) == FAT32_ATTR_LONG_NAME) {
+            uint8_t order = raw[0] & 0x1F;
+            if (raw[0] & FAT32_LFN_LAST) {
+                long_name = order != 0 && order * FAT32_LFN_CHARS <= FAT32_NAME_MAX + FAT32_LFN_CHARS;
+                slots = order;
+                expect = order;
+                checksum = raw[LFN_CHECKSUM];
+                uint32_t end = order * FAT32_LFN_CHARS;
+                entry->name[end < FAT32_NAME_MAX ? end : FAT32_NAME_MAX] = '\0';
+            } else if (!long_name || order != expect || raw[LFN_CHECKSUM] != checksum) {
+                long_name = false;
+            }
+            if (!long_name)
+                continue;
+
+            // Characters sit at bytes 1-10, 14-25 and 28-31, UCS-2
+            static const uint8_t positions[FAT32_LFN_CHARS] = { 1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30 };
+            for (int i = 0; i < FAT32_LFN_CHARS; i++) {
+                uint32_t index = (order - 1) * FAT32_LFN_CHARS + i;
+                uint16_t c = le16(raw + positions[i]);
+                if (index >= FAT32_NAME_MAX)
+                    break;
+                if (c == 0x0000 || c == 0xFFFF) {
+                    entry->name[index] = '\0';
+                    break;
+                }
+                entry->name[index] = c < 0x80 ? (char)c : '?';
+            }
+            expect--;
+            continue;
+        }
+        if (attr & FAT32_ATTR_VOLUME_ID) {
+            long_name = false;
+            continue;
+        }
+
+        memcpy(entry->short_name, raw, 11);
+        entry->attr = attr;
+        entry->cluster = ((uint32_t)le16(raw + DIR_CLUSTER_HIGH) << 16) | le16(raw + DIR_CLUSTER_LOW);
+        entry->size = le32(raw + DIR_SIZE);
+        entry->dir = scan->dir->cluster;
+        entry->offset = scan->offset - FAT32_ENTRY_SIZE;
+        // ".." of a directory in the root says cluster 0
+        if ((attr & FAT32_ATTR_DIRECTORY) && entry->cluster == 0)
+            entry->cluster = scan->dir->fs->root;
+
+        if (long_name && expect == 0 && checksum == fat32_checksum(entry->short_name)) {
+            entry->slots = slots;
+        } else {
+            entry->slots = 0;
+            fat32_short_to_name((const char*)raw, raw[DIR_NTRES], entry->name);
+        }
+        return true;
+    }
+    return false;
+}
+
+static uint32_t fat32_name_hash(uint32_t dir, const char* name) {
+    uint32_t hash = 2166136261u ^ dir;
+    for (; *name != '\0'; name++)
+        hash = (hash ^ (uint8_t)fat32_upper(*name)) * 16777619u;
+    return hash;
+}
+
+static struct fat32_dentry* fat32_dcache_find(fat32_fs_t* fs, uint32_t dir, const char* name, uint32_t hash) {
+    struct fat32_dentry* dentry = fs->hash[hash & (FAT32_NAME_HASH - 1)];
+    for (; dentry != NULL; dentry = dentry->next) {
+        if (dentry->hash == hash && dentry->dir == dir && fat32_name_equal(dentry->name, name))
+            return dentry;
+    }
+    return NULL;
+}
+
+static bool fat32_dcache_add(fat32_fs_t* fs, const struct fat32_entry* entry) {
+    struct fat32_dentry* dentry = fs->free_dentries;
+    if (dentry == NULL)
+        return false;
+    fs->free_dentries = dentry->next;
+
+    dentry->dir = entry->dir;
+    dentry->hash = fat32_name_hash(entry->dir, entry->name);
+    dentry->cluster = entry->cluster;
+    dentry->size = entry->size;
+    dentry->offset = entry->offset;
+    dentry->slots = entry->slots;
+    dentry->attr = entry->attr;
+    memcpy(dentry->short_name, entry->short_name, 11);
+    strcpy(dentry->name, entry->name);
+
+    struct fat32_dentry** bucket = &fs->hash[dentry->hash & (FAT32_NAME_HASH - 1)];
+    dentry->next = *bucket;
+    *bucket = dentry;
+    return true;
+}
+
+// Forget the names of dir, or only the one at offset unless that is
+// UINT32_MAX
+static void fat32_dcache_drop(fat32_fs_t* fs, uint32_t dir, uint32_t offset) {
+    for (int i = 0; i < FAT32_NAME_HASH; i++) {
+        struct fat32_dentry** link = &fs->hash[i];
+        while (*link != NULL) {
+            struct fat32_dentry* dentry = *link;
+            if (dentry->dir == dir && (offset == UINT32_MAX || dentry->offset == offset)) {
+                *link = dentry->next;
+                dentry->dir = 0;
+                dentry->next = fs->free_dentries;
+                fs->free_dentries = dentry;
+            } else {
+                link = &dentry->next;
+            }
+        }
+    }
+}
+
+static void fat32_dcache_update(fat32_fs_t* fs, uint32_t dir, uint32_t offset, uint32_t cluster, uint32_t size) {
+    for (int i = 0; i < FAT32_DENTRIES; i++) {
+        struct fat32_dentry* dentry = &fs->dentries[i];
+        if (dentry->dir == dir && dentry->offset == offset) {
+            dentry->cluster = cluster;
+            dentry->size = size;
+        }
+    }
+}
+
+static struct fat32_dir_state* fat32_dir_find(fat32_fs_t* fs, uint32_t dir) {
+    for (int i = 0; i < FAT32_DIRS; i++) {
+        if (fs->dirs[i].cluster == dir)
+            return &fs->dirs[i];
+    }
+    return NULL;
+}
+
+// Make room for one more directory's names by forgetting the least
+// recently used one other than keep
+static bool fat32_dir_evict(fat32_fs_t* fs, struct fat32_dir_state* keep) {
+    struct fat32_dir_state* oldest = NULL;
+    for (int i = 0; i < FAT32_DIRS; i++) {
+        struct fat32_dir_state* state = &fs->dirs[i];
+        if (state->cluster != 0 && state != keep && (oldest == NULL || state->used < oldest->used))
+            oldest = state;
+    }
+    if (oldest == NULL)
+        return false;
+    fat32_dcache_drop(fs, oldest->cluster, UINT32_MAX);
+    oldest->cluster = 0;
+    return true;
+}
+
+static bool fat32_open_dir(fat32_fs_t* fs, uint32_t cluster, fat32_file_t* dir) {
+    return fat32_file_init(fs, dir, cluster, 0, FAT32_ATTR_DIRECTORY, 0, 0);
+}
+
+// Read the whole directory into the name hash. If the names do not all
+// fit, even after forgetting other directories, the rest are left out and
+// lookups that miss the hash read the directory again.
+static struct fat32_dir_state* fat32_dir_load(fat32_fs_t* fs, uint32_t cluster) {
+    struct fat32_dir_state* state = NULL;
+    for (int i = 0; i < FAT32_DIRS && state == NULL; i++) {
+        if (fs->dirs[i].cluster == 0)
+            state = &fs->dirs[i];
+    }
+    if (state == NULL) {
+        fat32_dir_evict(fs, NULL);
+        state = fat32_dir_find(fs, 0);
+    }
+
+    fat32_file_t dir;
+    if (!fat32_open_dir(fs, cluster, &dir))
+        return NULL;
+    fs->stats.scans++;
+
+    state->cluster = cluster;
+    state->complete = true;
+    struct fat32_scan scan;
+    static struct fat32_entry entry;
+    fat32_scan_init(&scan, &dir, 0);
+    while (fat32_scan_next(&scan, &entry)) {
+        while (!fat32_dcache_add(fs, &entry)) {
+            if (!fat32_dir_evict(fs, state)) {
+                state->complete = false;
+                break;
+            }
+        }
+        if (!state->complete)
+            break;
+    }
+    fat32_drop_extents(&dir);
+    return state;
+}
+
+// Find name in directory dir: in the hash if the directory has been read,
+// otherwise by reading it first. Short aliases ("LONGNA~1.TXT") are not
+// hashed and need a scan.
+static bool fat32_lookup(fat32_fs_t* fs, uint32_t dir, const char* name, struct fat32_entry* entry) {
+    fs->stats.lookups++;
+    struct fat32_dir_state* state = fat32_dir_find(fs, dir);
+    if (state == NULL && (state = fat32_dir_load(fs, dir)) == NULL)
+        return false;
+    state->used = ++fs->dir_clock;
+
+    uint32_t hash = fat32_name_hash(dir, name);
+    struct fat32_dentry* dentry = fat32_dcache_find(fs, dir, name, hash);
+    if (dentry != NULL) {
+        fs->stats.hashed++;
+        strcpy(entry->name, dentry->name);
+        memcpy(entry->short_name, dentry->short_name, 11);
+        entry->attr = dentry->attr;
+        entry->cluster = dentry->cluster;
+        entry->size = dentry->size;
+        entry->dir = dir;
+        entry->offset = dentry->offset;
+        entry->slots = dentry->slots;
+        return true;
+    }
+    if (state->complete && strchr(name, '~') == NULL)
+        return false;
+
+    fat32_file_t file;
+    if (!fat32_open_dir(fs, dir, &file))
+        return false;
+    struct fat32_scan scan;
+    char alias[13];
+    bool found = false;
+    fat32_scan_init(&scan, &file, 0);
+    while (!found && fat32_scan_next(&scan, entry)) {
+        fat32_short_to_name(entry->short_name, 0, alias);
+        found = fat32_name_equal(entry->name, name) || fat32_name_equal(alias, name);
+    }
+    fat32_drop_extents(&file);
+    return found;
+}
+
+// Follow path down from the root. The last count components are left
+// over, *rest points at them.
+static bool fat32_walk(fat32_fs_t* fs, const char* path, uint32_t leave, struct fat32_entry* entry, const char** rest) {
+    static char component[FAT32_NAME_MAX + 1];
+
+    memset(entry, 0, sizeof(*entry));
+    entry->cluster = fs->root;
+    entry->attr = FAT32_ATTR_DIRECTORY;
+
+    // Count the components first, to know where to stop
+    uint32_t components = 0;
+    for (const char* p = path; *p != '\0'; p++) {
+        if (*p != '/' && (p == path || p[-1] == '/'))
+            components++;
+    }
+    if (components < leave)
+        return false;
+
+    for (uint32_t i = 0; i < components - leave; i++) {
+        while (*path == '/')
+            path++;
+        uint32_t length = 0;
+        while (path[length] != '/' && path[length] != '\0')
+            length++;
+        if (length > FAT32_NAME_MAX)
+            return false;
+        memcpy(component, path, length);
+        component[length] = '\0';
+        path += length;
+
+        if (!(entry->attr & FAT32_ATTR_DIRECTORY) || !fat32_lookup(fs, entry->cluster, component, entry))
+            return false;
+    }
+    while (*path == '/')
+        path++;
+    if (rest != NULL)
+        *rest = path;
+    return true;
+}
+
+// Split off the last component of path into name and find the directory
+// it belongs in
+static bool fat32_walk_parent(fat32_fs_t* fs, const char* path, struct fat32_entry* parent, char* name) {
+    const char* rest;
+    if (!fat32_walk(fs, path, 1, parent, &rest) || !(parent->attr & FAT32_ATTR_DIRECTORY))
+        return false;
+
+    uint32_t length = 0;
+    while (rest[length] != '/' && rest[length] != '\0')
+        length++;
+    if (length == 0 || length > FAT32_NAME_MAX)
+        return false;
+    memcpy(name, rest, length);
+    name[length] = '\0';
+    return true;
+}
+
+static bool fat32_valid_name(const char* name) {
+    uint32_t length = strlen(name);
+    if (length == 0 || length > FAT32_NAME_MAX || strcmp(name, ".") == 0 || strcmp(name, "..") == 0 ||
+        name[length - 1] == '.' || name[length - 1] == ' ')
+        return false;
+    for (const char* p = name; *p != '\0'; p++) {
+        if ((uint8_t)*p < 0x20 || (uint8_t)*p >= 0x7F || strchr("\"*/:<>?\\|", *p) != NULL)
+            return false;
+    }
+    return true;
+}
+
+static bool fat32_short_char(char c) {
+    return (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || (c != '\0' && strchr("!#$%&'()-@^_`{}~", c) != NULL);
+}
+
+// Whether name can be stored as a short entry alone: upper case 8.3
+static bool fat32_short_form(const char* name, char* short_name) {
+    memset(short_name, ' ', 11);
+    const char* dot = strchr(name, '.');
+    uint32_t base = dot != NULL ? (uint32_t)(dot - name) : strlen(name);
+    uint32_t ext = dot != NULL ? strlen(dot + 1) : 0;
+    if (base == 0 || base > 8 || ext > 3 || (dot != NULL && (ext == 0 || strchr(dot + 1, '.') != NULL)))
+        return false;
+
+    for (uint32_t i = 0; i < base; i++) {
+        if (!fat32_short_char(name[i]))
+            return false;
+        short_name[i] = name[i];
+    }
+    for (uint32_t i = 0; i < ext; i++) {
+        if (!fat32_short_char(dot[1 + i]))
+            return false;
+        short_name[8 + i] = dot[1 + i];
+    }
+    return (uint8_t)short_name[0] != FAT32_ENTRY_FREE;
+}
+
+// Short alias "BASIS~N.EXT" for a long name
+static void fat32_short_alias(const char* name, uint32_t number, char* short_name) {
+    memset(short_name, ' ', 11);
+    const char* dot = strrchr(name, '.');
+    if (dot == name)
+        dot = NULL;
+
+    char tail[8];
+    uint32_t digits = 0;
+    for (uint32_t n = number; n != 0 && digits < 6; n /= 10)
+        tail[digits++] = '0' + n % 10;
+
+    uint32_t base = 0;
+    for (const char* p = name; *p != '\0' && p != dot && base < 8 - digits - 1; p++) {
+        char c = fat32_upper(*p);
+        if (c == ' ' || c == '.')
+            continue;
+        short_name[base++] = fat32_short_char(c) ? c : '_';
+    }
+    if (base == 0)
+        short_name[base++] = '_';
+    short_name[base++] = '~';
+    while (digits > 0)
+        short_name[base++] = tail[--digits];
+
+    if (dot != NULL) {
+        uint32_t ext = 0;
+        for (const char* p = dot + 1; *p != '\0' && ext < 3; p++) {
+            char c = fat32_upper(*p);
+            if (c != ' ')
+                short_name[8 + ext++] = fat32_short_char(c) ? c : '_';
+        }
+    }
+}
+
+static bool fat32_short_exists(fat32_file_t* dir, const char* short_name) {
+    struct fat32_scan scan;
+    static struct fat32_entry entry;
+    fat32_scan_init(&scan, dir, 0);
+    while (fat32_scan_next(&scan, &entry)) {
+        if (memcmp(entry.short_name, short_name, 11) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Write a new entry for name into directory cluster dir, with long name
+// entries in front of it unless the name is a plain 8.3 one. Reuses the
+// first run of free entries that is long enough, or grows the directory.
+static bool fat32_add_entry(fat32_fs_t* fs, uint32_t dir, const char* name, uint8_t attr,
+                            uint32_t cluster, struct fat32_entry* entry) {
+    fat32_file_t file;
+    if (!fat32_open_dir(fs, dir, &file))
+        return false;
+
+    char short_name[11];
+    uint32_t slots = 0;
+    if (!fat32_short_form(name, short_name)) {
+        slots = (strlen(name) + FAT32_LFN_CHARS - 1) / FAT32_LFN_CHARS;
+        uint32_t number = 1;
+        do {
+            fat32_short_alias(name, number++, short_name);
+        } while (fat32_short_exists(&file, short_name) && number < 1000000);
+    }
+
+    // Free run of slots + 1 entries
+    uint32_t needed = (slots + 1) * FAT32_ENTRY_SIZE;
+    uint32_t start = 0;
+    uint32_t run = 0;
+    struct fat32_scan scan;
+    fat32_scan_init(&scan, &file, 0);
+    for (uint8_t* existing; run < needed && (existing = fat32_scan_raw(&scan)) != NULL; scan.offset += FAT32_ENTRY_SIZE) {
+        if (existing[DIR_NAME] == FAT32_ENTRY_END || existing[DIR_NAME] == FAT32_ENTRY_FREE) {
+            if (run == 0)
+                start = scan.offset;
+            run += FAT32_ENTRY_SIZE;
+        } else {
+            run = 0;
+        }
+    }
+    if (run < needed) {
+        if (run == 0)
+            start = file.size;
+        while (file.size - start < needed) {
+            if (!fat32_extend(&file)) {
+                fat32_drop_extents(&file);
+                return false;
+            }
+        }
+    }
+
+    uint8_t raw[FAT32_ENTRY_SIZE];
+    uint8_t checksum = fat32_checksum(short_name);
+    uint32_t length = strlen(name);
+    bool ok = true;
+    for (uint32_t slot = slots; slot >= 1 && ok; slot--) {
+        static const uint8_t positions[FAT32_LFN_CHARS] = { 1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30 };
+        memset(raw, 0, sizeof(raw));
+        raw[0] = slot | (slot == slots ? FAT32_LFN_LAST : 0);
+        raw[DIR_ATTR] = FAT32_ATTR_LONG_NAME;
+        raw[LFN_CHECKSUM] = checksum;
+        for (uint32_t i = 0; i < FAT32_LFN_CHARS; i++) {
+            uint32_t index = (slot - 1) * FAT32_LFN_CHARS + i;
+            uint16_t c = index < length ? (uint8_t)name[index] : index == length ? 0x0000 : 0xFFFF;
+            put16(raw + positions[i], c);
+        }
+        ok = fat32_file_io(&file, start + (slots - slot) * FAT32_ENTRY_SIZE, raw, FAT32_ENTRY_SIZE, true) == FAT32_ENTRY_SIZE;
+    }
+
+    memset(raw, 0, sizeof(raw));
+    memcpy(raw, short_name, 11);
+    raw[DIR_ATTR] = attr;
+    put16(raw + DIR_CRT_DATE, FAT32_DATE);
+    put16(raw + DIR_ACC_DATE, FAT32_DATE);
+    put16(raw + DIR_WRT_DATE, FAT32_DATE);
+    put16(raw + DIR_CLUSTER_HIGH, cluster >> 16);
+    put16(raw + DIR_CLUSTER_LOW, cluster);
+    uint32_t offset = start + slots * FAT32_ENTRY_SIZE;
+    if (ok)
+        ok = fat32_file_io(&file, offset, raw, FAT32_ENTRY_SIZE, true) == FAT32_ENTRY_SIZE;
+    fat32_drop_extents(&file);
+    if (!ok)
+        return false;
+
+    strcpy(entry->name, name);
+    memcpy(entry->short_name, short_name, 11);
+    entry->attr = attr;
+    entry->cluster = cluster;
+    entry->size = 0;
+    entry->dir = dir;
+    entry->offset = offset;
+    entry->slots = slots;
+
+    // Keep a fully hashed directory that way
+    struct fat32_dir_state* state = fat32_dir_find(fs, dir);
+    if (state != NULL && state->complete && !fat32_dcache_add(fs, entry))
+        state->complete = false;
+    return true;
+}
+
+// Rewrite the first cluster and size of the short entry at offset in dir
+static bool fat32_update_entry(fat32_fs_t* fs, uint32_t dir, uint32_t offset, uint32_t cluster, uint32_t size) {
+    fat32_file_t file;
+    uint8_t raw[FAT32_ENTRY_SIZE];
+    if (!fat32_open_dir(fs, dir, &file))
+        return false;
+
+    bool ok = fat32_file_io(&file, offset, raw, FAT32_ENTRY_SIZE, false) == FAT32_ENTRY_SIZE;
+    if (ok) {
+        put16(raw + DIR_CLUSTER_HIGH, cluster >> 16);
+        put16(raw + DIR_CLUSTER_LOW, cluster);
+        put32(raw + DIR_SIZE, size);
+        put16(raw + DIR_WRT_DATE, FAT32_DATE);
+        ok = fat32_file_io(&file, offset, raw, FAT32_ENTRY_SIZE, true) == FAT32_ENTRY_SIZE;
+    }
+    fat32_drop_extents(&file);
+    fat32_dcache_update(fs, dir, offset, cluster, size);
+    return ok;
+}
+
+static void fat32_free_fat(fat32_fs_t* fs) {
+    if (fs->fat != NULL)
+        free(fs->fat);
+    fs->fat = NULL;
+}
+
+static bool fat32_is_bpb(const uint8_t* sector) {
+    uint8_t per_cluster = sector[13];
+    return sector[510] == 0x55 && sector[511] == 0xAA && le16(sector + 11) == BLOCKDEV_SECTOR_SIZE &&
+           per_cluster != 0 && (per_cluster & (per_cluster - 1)) == 0 && le16(sector + 14) != 0 &&
+           sector[16] != 0 && le16(sector + 17) == 0 && le16(sector + 22) == 0 && le32(sector + 36) != 0;
+}
+
+bool fat32_mount(fat32_fs_t* fs, blockdev_t* dev) {
+    uint8_t sector[BLOCKDEV_SECTOR_SIZE];
+
+    memset(fs, 0, sizeof(*fs));
+    fs->dev = dev;
+    if (!bcache_read(dev, 0, 1, sector))
+        return false;
+
+    // A whole-disk filesystem, or the first FAT32 partition of an MBR
+    if (!fat32_is_bpb(sector)) {
+        if (sector[510] != 0x55 || sector[511] != 0xAA)
+            return false;
+        for (int i = 0; i < 4 && fs->start == 0; i++) {
+            const uint8_t* partition = sector + 0x1BE + i * 16;
+            if (partition[4] == 0x0B || partition[4] == 0x0C)
+                fs->start = le32(partition + 8);
+        }
+        if (fs->start == 0 || !bcache_read(dev, fs->start, 1, sector) || !fat32_is_bpb(sector))
+            return false;
+    }
+
+    // The FAT type follows from the BPB, not from the cluster count:
+    // mkfs.fat -F 32 on the 32 MB image makes fewer clusters than the
+    // specification's FAT32 minimum
+    uint16_t flags = le16(sector + 40);
+    fs->sectors = le16(sector + 19) != 0 ? le16(sector + 19) : le32(sector + 32);
+    fs->sectors_per_cluster = sector[13];
+    fs->cluster_size = fs->sectors_per_cluster * BLOCKDEV_SECTOR_SIZE;
+    fs->fat_start = fs->start + le16(sector + 14);
+    fs->fat_count = sector[16];
+    fs->fat_sectors = le32(sector + 36);
+    fs->mirrored = !(flags & 0x80);
+    fs->active_fat = fs->mirrored ? 0 : flags & 0x0F;
+    fs->root = le32(sector + 44);
+    fs->fsinfo = le16(sector + 48);
+    if (fs->fsinfo == 0xFFFF)
+        fs->fsinfo = 0;
+
+    // The BPB comes off the disk. With the FAT size bounded nothing below
+    // overflows 32 bits once the reserved and FAT areas, summed in 64 bits,
+    // are known to fit in the filesystem.
+    uint64_t metadata = le16(sector + 14) + (uint64_t)fs->fat_count * fs->fat_sectors;
+    if (fs->fat_sectors > FAT32_FAT_SECTORS_MAX || fs->active_fat >= fs->fat_count ||
+        fs->start >= dev->sectors || fs->sectors > dev->sectors - fs->start || metadata >= fs->sectors)
+        return false;
+    fs->data_start = fs->start + (uint32_t)metadata;
+    fs->clusters = (fs->sectors - (fs->data_start - fs->start)) / fs->sectors_per_cluster;
+    if (fs->clusters > fs->fat_sectors * (BLOCKDEV_SECTOR_SIZE / 4) - 2)
+        fs->clusters = fs->fat_sectors * (BLOCKDEV_SECTOR_SIZE / 4) - 2;
+    if (!fat32_valid_cluster(fs, fs->root))
+        return false;
+
+    memcpy(fs->label, sector + 71, 11);
+    for (int i = 10; i >= 0 && fs->label[i] == ' '; i--)
+        fs->label[i] = '\0';
+
+    // The FAT is read past the buffer cache, which it would only flood
+    if (fs->fat_sectors * BLOCKDEV_SECTOR_SIZE <= FAT32_FAT_CACHE_MAX) {
+        fs->fat = malloc(fs->fat_sectors * BLOCKDEV_SECTOR_SIZE);
+        if (!bcache_sync(dev) ||
+            !block_read(dev, fs->fat_start + fs->active_fat * fs->fat_sectors, fs->fat_sectors, fs->fat)) {
+            fat32_free_fat(fs);
+            return false;
+        }
+    }
+
+    fs->free_clusters = FAT32_FSINFO_UNKNOWN;
+    fs->next_free = 2;
+    if (fs->fsinfo != 0 && bcache_read(dev, fs->start + fs->fsinfo, 1, sector) &&
+        le32(sector) == FAT32_FSINFO_LEAD && le32(sector + 484) == FAT32_FSINFO_STRUCT) {
+        fs->free_clusters = le32(sector + 488);
+        fs->next_free = le32(sector + 492);
+    }
+    if (fs->free_clusters > fs->clusters) {
+        fs->free_clusters = 0;
+        for (uint32_t cluster = 2; cluster < fs->clusters + 2; cluster++) {
+            if (fat32_get(fs, cluster) == FAT32_FREE)
+                fs->free_clusters++;
+        }
+    }
+
+    for (int i = FAT32_DENTRIES - 1; i >= 0; i--) {
+        fs->dentries[i].next = fs->free_dentries;
+        fs->free_dentries = &fs->dentries[i];
+    }
+    return true;
+}
+
+bool fat32_sync(fat32_fs_t* fs) {
+    bool ok = true;
+    if (fs->fsinfo != 0) {
+        uint8_t counts[8];
+        put32(counts, fs->free_clusters);
+        put32(counts + 4, fs->next_free);
+        if (!fat32_io(fs, fs->start + fs->fsinfo, 488, counts, sizeof(counts), true))
+            ok = false;
+    }
+    return bcache_sync(fs->dev) && ok;
+}
+
+bool fat32_unmount(fat32_fs_t* fs) {
+    bool ok = fat32_sync(fs);
+    fat32_free_fat(fs);
+    fs->dev = NULL;
+    return ok;
+}
+
+bool fat32_open(fat32_fs_t* fs, const char* path, fat32_file_t* file) {
+    static struct fat32_entry entry;
+    if (!fat32_walk(fs, path, 0, &entry, NULL))
+        return false;
+    return fat32_file_init(fs, file, entry.cluster, entry.size, entry.attr, entry.dir, entry.offset);
+}
+
+bool fat32_create(fat32_fs_t* fs, const char* path, fat32_file_t* file) {
+    static struct fat32_entry parent;
+    static struct fat32_entry entry;
+    static char name[FAT32_NAME_MAX + 1];
+
+    if (!fat32_walk_parent(fs, path, &parent, name) || !fat32_valid_name(name))
+        return false;
+
+    if (fat32_lookup(fs, parent.cluster, name, &entry)) {
+        if (entry.attr & (FAT32_ATTR_DIRECTORY | FAT32_ATTR_READ_ONLY))
+            return false;
+        if (entry.cluster != 0 && !fat32_free_chain(fs, entry.cluster))
+            return false;
+        entry.cluster = 0;
+        entry.size = 0;
+        if (!fat32_update_entry(fs, entry.dir, entry.offset, 0, 0))
+            return false;
+    } else if (!fat32_add_entry(fs, parent.cluster, name, FAT32_ATTR_ARCHIVE, 0, &entry)) {
+        return false;
+    }
+    return fat32_file_init(fs, file, 0, 0, entry.attr, entry.dir, entry.offset);
+}
+
+bool fat32_close(fat32_file_t* file) {
+    bool ok = true;
+    if (file->dirty && !(file->attr & FAT32_ATTR_DIRECTORY) && file->dir != 0)
+        ok = fat32_update_entry(file->fs, file->dir, file->offset, file->cluster, file->size);
+    fat32_drop_extents(file);
+    return ok;
+}
+
+int32_t fat32_read(fat32_file_t* file, void* buffer, uint32_t size) {
+    int32_t done = fat32_file_io(file, file->position, buffer, size, false);
+    if (done > 0)
+        file->position += done;
+    return done;
+}
+
+int32_t fat32_write(fat32_file_t* file, const void* buffer, uint32_t size) {
+    if (file->attr & (FAT32_ATTR_DIRECTORY | FAT32_ATTR_READ_ONLY))
+        return -1;
+    int32_t done = fat32_file_io(file, file->position, (void*)buffer, size, true);
+    if (done > 0)
+        file->position += done;
+    return done;
+}
+
+bool fat32_seek(fat32_file_t* file, uint32_t position) {
+    if (position > file->size)
+        return false;
+    file->position = position;
+    return true;
+}
+
+bool fat32_remove(fat32_fs_t* fs, const char* path) {
+    static struct fat32_entry parent;
+    static struct fat32_entry entry;
+    static char name[FAT32_NAME_MAX + 1];
+
+    if (!fat32_walk_parent(fs, path, &parent, name) || !fat32_lookup(fs, parent.cluster, name, &entry) ||
+        strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+        return false;
+
+    if (entry.attr & FAT32_ATTR_DIRECTORY) {
+        fat32_dir_t listing;
+        static struct fat32_entry child;
+        if (!fat32_open_dir(fs, entry.cluster, &listing.file))
+            return false;
+        listing.offset = 0;
+        bool empty = !fat32_readdir(&listing, &child);
+        fat32_closedir(&listing);
+        if (!empty)
+            return false;
+
+        struct fat32_dir_state* state = fat32_dir_find(fs, entry.cluster);
+        if (state != NULL) {
+            fat32_dcache_drop(fs, entry.cluster, UINT32_MAX);
+            state->cluster = 0;
+        }
+    }
+
+    // Mark the long name entries and the short entry deleted
+    fat32_file_t dir;
+    if (!fat32_open_dir(fs, parent.cluster, &dir))
+        return false;
+    bool ok = true;
+    uint8_t deleted = FAT32_ENTRY_FREE;
+    for (uint32_t i = 0; i <= entry.slots && ok; i++)
+        ok = fat32_file_io(&dir, entry.offset - (entry.slots - i) * FAT32_ENTRY_SIZE, &deleted, 1, true) == 1;
+    fat32_drop_extents(&dir);
+    fat32_dcache_drop(fs, parent.cluster, entry.offset);
+
+    if (ok && entry.cluster != 0)
+        ok = fat32_free_chain(fs, entry.cluster);
+    return ok;
+}
+
+bool fat32_mkdir(fat32_fs_t* fs, const char* path) {
+    static struct fat32_entry parent;
+    static struct fat32_entry entry;
+    static char name[FAT32_NAME_MAX + 1];
+
+    if (!fat32_walk_parent(fs, path, &parent, name) || !fat32_valid_name(name) ||
+        fat32_lookup(fs, parent.cluster, name, &entry))
+        return false;
+
+    uint32_t cluster = fat32_alloc(fs, 0);
+    if (cluster == 0)
+        return false;
+    if (!fat32_zero_cluster(fs, cluster)) {
+        fat32_free_chain(fs, cluster);
+        return false;
+    }
+
+    // "." and "..", the root is cluster 0 in ".."
+    uint8_t raw[2 * FAT32_ENTRY_SIZE];
+    uint32_t up = parent.cluster == fs->root ? 0 : parent.cluster;
+    memset(raw, 0, sizeof(raw));
+    memcpy(raw, ".          ", 11);
+    memcpy(raw + FAT32_ENTRY_SIZE, "..         ", 11);
+    for (int i = 0; i < 2; i++) {
+        uint8_t* dot = raw + i * FAT32_ENTRY_SIZE;
+        uint32_t target = i == 0 ? cluster : up;
+        dot[DIR_ATTR] = FAT32_ATTR_DIRECTORY;
+        put16(dot + DIR_CRT_DATE, FAT32_DATE);
+        put16(dot + DIR_WRT_DATE, FAT32_DATE);
+        put16(dot + DIR_CLUSTER_HIGH, target >> 16);
+        put16(dot + DIR_CLUSTER_LOW, target);
+    }
+    if (!fat32_io(fs, fat32_cluster_lba(fs, cluster), 0, raw, sizeof(raw), true) ||
+        !fat32_add_entry(fs, parent.cluster, name, FAT32_ATTR_DIRECTORY, cluster, &entry)) {
+        fat32_free_chain(fs, cluster);
+        return false;
+    }
+    return true;
+}
+
+bool fat32_opendir(fat32_fs_t* fs, const char* path, fat32_dir_t* dir) {
+    if (!fat32_open(fs, path, &dir->file))
+        return false;
+    if (!(dir->file.attr & FAT32_ATTR_DIRECTORY)) {
+        fat32_close(&dir->file);
+        return false;
+    }
+    dir->offset = 0;
+    return true;
+}
+
+bool fat32_readdir(fat32_dir_t* dir, struct fat32_entry* entry) {
+    struct fat32_scan scan;
+    fat32_scan_init(&scan, &dir->file, dir->offset);
+    while (fat32_scan_next(&scan, entry)) {
+        dir->offset = scan.offset;
+        if (strcmp(entry->name, ".") != 0 && strcmp(entry->name, "..") != 0)
+            return true;
+    }
+    dir->offset = scan.offset;
+    return false;
+}
+
+void fat32_closedir(fat32_dir_t* dir) {
+    fat32_close(&dir->file);
+}
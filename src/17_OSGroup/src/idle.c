@@ -0,0 +1,54 @@
+#include "idle.h"
+#include "common.h"
+
+struct idle_action {
+    idle_handler_t handler;
+    void* ctx;
+};
+
+static struct idle_action idle_actions[IDLE_MAX_HANDLERS];
+
+// Set while the handlers run, so a handler that waits does not recurse
+static bool idle_running = false;
+
+int register_idle_handler(idle_handler_t handler, void* ctx) {
+    uint32_t flags = interrupts_save();
+    for (int i = 0; i < IDLE_MAX_HANDLERS; i++) {
+        if (idle_actions[i].handler == NULL) {
+            idle_actions[i].handler = handler;
+            idle_actions[i].ctx = ctx;
+            interrupts_restore(flags);
+            return 0;
+        }
+    }
+    interrupts_restore(flags);
+    return -1;
+}
+
+void unregister_idle_handler(idle_handler_t handler, void* ctx) {
+    uint32_t flags = interrupts_save();
+    for (int i = 0; i < IDLE_MAX_HANDLERS; i++) {
+        if (idle_actions[i].handler == handler && idle_actions[i].ctx == ctx) {
+            idle_actions[i].handler = NULL;
+            idle_actions[i].ctx = NULL;
+        }
+    }
+    interrupts_restore(flags);
+}
+
+void idle_poll() {
+    if (idle_running)
+        return;
+    idle_running = true;
+    for (int i = 0; i < IDLE_MAX_HANDLERS; i++) {
+        idle_handler_t handler = idle_actions[i].handler;
+        if (handler != NULL)
+            handler(idle_actions[i].ctx);
+    }
+    idle_running = false;
+}
+
+void idle() {
+    idle_poll();
+    asm volatile("hlt");
+}
@@ -56,8 +56,10 @@ void init_interrupts(){
     outb(0xA1, 0x02);
     outb(0x21, 0x01);
     outb(0xA1, 0x01);
-    outb(0x21, 0x0);
-    outb(0xA1, 0x0);
+    // Mask every line except the cascade (IRQ2), lines are unmasked one by
+    // one as handlers get registered in irq.c
+    outb(0x21, 0xFB);
+    outb(0xA1, 0xFF);
 
     idt_set_gate( 0, (uint32_t)isr0 , 0x08, 0x8E);
     idt_set_gate( 1, (uint32_t)isr1 , 0x08, 0x8E);
@@ -1,39 +1,319 @@
 #include "interrupts.h"
 #include "common.h"
+#include "irqstats.h"
+
+// 8259 PIC ports and commands
+#define PIC1_COMMAND 0x20
+#define PIC1_DATA    0x21
+#define PIC2_COMMAND 0xA0
+#define PIC2_DATA    0xA1
+#define PIC_CMD_EOI      0x20
+#define PIC_CMD_READ_ISR 0x0B
+
+// The slave PIC is cascaded through IRQ2 on the master, which must stay unmasked
+#define PIC_CASCADE_IRQ 2
+
+// Head of the handler chain for every IRQ line
+static struct irq_action_t* irq_chains[IRQ_COUNT];
+
+// Pool the chain entries are taken from (no heap is available this early)
+static struct irq_action_t irq_actions[IRQ_MAX_ACTIONS];
+
+// Currently masked lines, bit n = IRQn (master in the low byte)
+static uint16_t irq_mask = 0xFFFF & ~(1 << PIC_CASCADE_IRQ);
+
+// Optional handler that runs ahead of the chain, see irq_set_fast_handler()
+static volatile irq_fast_handler_t irq_fast_handlers[IRQ_COUNT];
+
+static uint32_t spurious_irqs = 0;
+
+// Interrupts that no handler on the line claimed
+static uint32_t unhandled_irqs[IRQ_COUNT];
+
+// Lines whose handlers may run with interrupts enabled (bit n = IRQn)
+static uint16_t nestable_lines = 0;
+
+// How many IRQ handlers are currently active on this CPU. Also read by
+// irq_common_stub to decide whether to switch to the interrupt stack.
+volatile uint32_t irq_nesting_depth = 0;
+static uint32_t irq_nesting_peak = 0;
+
+// Bottom of the dedicated interrupt stack, IRQ_STACK_SIZE bytes defined in
+// isr_asm.asm
+extern uint8_t irq_stack_bottom[];
+
+// Fixed 8259 priority order: IRQ0 is the highest, then IRQ1, then the slave
+// lines IRQ8-15 (cascaded through IRQ2), and IRQ3-7 last. Lower is higher.
+static const uint8_t irq_priority[IRQ_COUNT] = {
+  0, 1, 2, 11, 12, 13, 14, 15, 3, 4, 5, 6, 7, 8, 9, 10
+};
+
+// Lines to hold back while a nested handler for the given line runs: the
+// line itself and every line with a lower priority. The cascade stays open.
+static uint16_t irq_priority_mask(int line) {
+  uint16_t mask = 0;
+  for (int i = 0; i < IRQ_COUNT; i++) {
+    if (i != PIC_CASCADE_IRQ && irq_priority[i] >= irq_priority[line])
+      mask |= (1 << i);
+  }
+  return mask;
+}
+
+// Accept both a raw line number (0-15) and a remapped vector (IRQ0-IRQ15)
+static int irq_line(int irq) {
+  if (irq >= IRQ0)
+    irq -= IRQ0;
+  if (irq < 0 || irq >= IRQ_COUNT)
+    return -1;
+  return irq;
+}
+
+// Write the cached mask to both PICs
+static void pic_write_mask() {
+  outb(PIC1_DATA, irq_mask & 0xFF);
+  outb(PIC2_DATA, (irq_mask >> 8) & 0xFF);
+}
+
+// Read the combined in-service register of both PICs
+static uint16_t pic_read_isr() {
+  outb(PIC1_COMMAND, PIC_CMD_READ_ISR);
+  outb(PIC2_COMMAND, PIC_CMD_READ_ISR);
+  return (inb(PIC2_COMMAND) << 8) | inb(PIC1_COMMAND);
+}
 
 // Initialize IRQ handlers
 void init_irq() {
   for (int i = 0; i < IRQ_COUNT; i++) {
-    irq_handlers[i].data = NULL;
-    irq_handlers[i].handler = NULL;
-    irq_handlers[i].num = i;
+    irq_chains[i] = NULL;
+  }
+  for (int i = 0; i < IRQ_MAX_ACTIONS; i++) {
+    irq_actions[i].handler = NULL;
+    irq_actions[i].data = NULL;
+    irq_actions[i].next = NULL;
   }
+
+  // Every line stays masked until somebody registers a handler for it
+  irq_mask = 0xFFFF & ~(1 << PIC_CASCADE_IRQ);
+  pic_write_mask();
+}
+
+void irq_enable_line(int irq) {
+  int line = irq_line(irq);
+  if (line < 0)
+    return;
+
+  uint32_t flags = interrupts_save();
+  irq_mask &= ~(1 << line);
+  pic_write_mask();
+  interrupts_restore(flags);
+}
+
+void irq_disable_line(int irq) {
+  int line = irq_line(irq);
+  if (line < 0 || line == PIC_CASCADE_IRQ)
+    return;
+
+  uint32_t flags = interrupts_save();
+  irq_mask |= (1 << line);
+  pic_write_mask();
+  interrupts_restore(flags);
 }
 
 // Register an IRQ handler
-void register_irq_handler(int irq, isr_t handler, void* ctx) {
-  irq_handlers[irq].handler = handler;
-  irq_handlers[irq].data = ctx;
+int register_irq_handler(int irq, irq_handler_t handler, void* ctx) {
+  int line = irq_line(irq);
+  if (line < 0 || handler == NULL)
+    return -1;
+
+  uint32_t flags = interrupts_save();
+
+  // Find a free slot in the pool
+  struct irq_action_t* action = NULL;
+  for (int i = 0; i < IRQ_MAX_ACTIONS; i++) {
+    if (irq_actions[i].handler == NULL) {
+      action = &irq_actions[i];
+      break;
+    }
+  }
+  if (action == NULL) {
+    interrupts_restore(flags);
+    return -1;
+  }
+
+  action->handler = handler;
+  action->data = ctx;
+  action->next = NULL;
+
+  // Append to the end of the chain so handlers run in registration order
+  struct irq_action_t** link = &irq_chains[line];
+  while (*link != NULL)
+    link = &(*link)->next;
+  *link = action;
+
+  interrupts_restore(flags);
+
+  irq_enable_line(line);
+  return 0;
+}
+
+// Unregister an IRQ handler
+void unregister_irq_handler(int irq, irq_handler_t handler, void* ctx) {
+  int line = irq_line(irq);
+  if (line < 0)
+    return;
+
+  uint32_t flags = interrupts_save();
+
+  struct irq_action_t** link = &irq_chains[line];
+  while (*link != NULL) {
+    struct irq_action_t* action = *link;
+    if (action->handler == handler && action->data == ctx) {
+      *link = action->next;
+      action->handler = NULL;
+      action->data = NULL;
+      action->next = NULL;
+      break;
+    }
+    link = &action->next;
+  }
+
+  bool empty = irq_chains[line] == NULL;
+  interrupts_restore(flags);
+
+  // Nobody listens anymore, so stop taking interrupts for this line
+  if (empty)
+    irq_disable_line(line);
+}
+
+void irq_set_fast_handler(int irq, irq_fast_handler_t handler) {
+  int line = irq_line(irq);
+  if (line < 0)
+    return;
+  irq_fast_handlers[line] = handler;
+}
+
+void irq_set_nestable(int irq, bool nestable) {
+  int line = irq_line(irq);
+  if (line < 0)
+    return;
+
+  uint32_t flags = interrupts_save();
+  if (nestable)
+    nestable_lines |= (1 << line);
+  else
+    nestable_lines &= ~(1 << line);
+  interrupts_restore(flags);
+}
+
+uint32_t irq_nesting_max() {
+  return irq_nesting_peak;
+}
+
+uint32_t irq_spurious_count() {
+  return spurious_irqs;
+}
+
+uint32_t irq_unhandled_count(int irq) {
+  int line = irq_line(irq);
+  if (line < 0)
+    return 0;
+  return unhandled_irqs[line];
+}
+
+// Whether the current handler may let other interrupts in. Nesting is
+// refused once the depth limit is hit, the interrupt stack runs low, or
+// the handler is not on the interrupt stack at all.
+static bool irq_may_nest(int line) {
+  if (!(nestable_lines & (1 << line)))
+    return false;
+  if (irq_nesting_depth >= IRQ_MAX_NESTING)
+    return false;
+
+  uint32_t esp;
+  asm volatile ("mov %%esp, %0" : "=r" (esp));
+  uint32_t room = esp - (uint32_t)irq_stack_bottom;
+  return room <= IRQ_STACK_SIZE && room >= IRQ_STACK_MIN_FREE;
 }
 
 // The main IRQ handler
-// This gets called from our ASM interrupt handler stub.
-void irq_handler(registers_t regs)
+// This gets called from our ASM interrupt handler stub, on the interrupt
+// stack, with a pointer to the register frame saved on the interrupted stack.
+void irq_handler(registers_t* regs)
 {
+    int line = regs->int_no - IRQ0;
+    if (line < 0 || line >= IRQ_COUNT)
+        return;
+
+    // IRQ7 and IRQ15 can be raised spuriously by the PICs, in which case the
+    // matching in-service bit is not set. A spurious IRQ7 must not be
+    // acknowledged at all, and a spurious IRQ15 only on the master (which
+    // did see a real interrupt on the cascade line).
+    if (line == 7 && !(pic_read_isr() & (1 << 7))) {
+        spurious_irqs++;
+        return;
+    }
+    if (line == 15 && !(pic_read_isr() & (1 << 15))) {
+        spurious_irqs++;
+        outb(PIC1_COMMAND, PIC_CMD_EOI);
+        return;
+    }
+
     // Send an EOI (end of interrupt) signal to the PICs.
     // If this interrupt involved the slave.
-    if (regs.int_no >= 40)
+    if (line >= 8)
     {
         // Send reset signal to slave.
-        outb(0xA0, 0x20);
+        outb(PIC2_COMMAND, PIC_CMD_EOI);
     }
     // Send reset signal to master. (As well as slave, if necessary).
-    outb(0x20, 0x20);
+    outb(PIC1_COMMAND, PIC_CMD_EOI);
+
+    // The fast handler may take care of the interrupt all by itself
+    irq_fast_handler_t fast = irq_fast_handlers[line];
+    if (fast != NULL && fast(regs) == IRQ_HANDLED)
+    {
+        return;
+    }
+
+    if (++irq_nesting_depth > irq_nesting_peak)
+    {
+        irq_nesting_peak = irq_nesting_depth;
+    }
 
-    struct int_handler_t intrpt = irq_handlers[regs.int_no];
-    if (intrpt.handler != 0)
+    // Low-priority lines may be preempted. The EOI has already been sent, so
+    // the PIC would deliver anything now; mask this line and every line below
+    // it in priority, then let higher-priority interrupts in.
+    bool nested = irq_may_nest(line);
+    uint16_t held_back = 0;
+    if (nested)
     {
-        intrpt.handler(&regs, intrpt.data);
+        held_back = irq_priority_mask(line) & ~irq_mask;
+        irq_mask |= held_back;
+        pic_write_mask();
+        asm volatile("sti");
     }
 
-}
\ No newline at end of file
+    // Walk the chain, every handler on a shared line gets a look at it
+    IRQ_STATS_BEGIN(start);
+    int handled = IRQ_NONE;
+    for (struct irq_action_t* action = irq_chains[line]; action != NULL; action = action->next)
+    {
+        handled |= action->handler(regs, action->data);
+    }
+    IRQ_STATS_END(regs->int_no, start);
+
+    if (nested)
+    {
+        // Only drop the bits we set, a handler may have changed others
+        asm volatile("cli");
+        irq_mask &= ~held_back;
+        pic_write_mask();
+    }
+
+    irq_nesting_depth--;
+
+    if (handled == IRQ_NONE)
+    {
+        unhandled_irqs[line]++;
+    }
+}
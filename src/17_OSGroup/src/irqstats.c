@@ -0,0 +1,47 @@
+#include "irqstats.h"
+#include "libc/system.h"
+#include "memory/memory.h"
+
+#ifdef CONFIG_IRQ_STATS
+
+struct irq_stats_t irq_stats[IDT_ENTRIES];
+
+static uint32_t average_cycles(const struct irq_stats_t* s)
+{
+    if (s->count == 0)
+        return 0;
+    return (uint32_t)div64_32(s->total_cycles, s->count, NULL);
+}
+
+void irq_stats_dump()
+{
+    printf("\nInterrupt statistics (TSC cycles):\n");
+    for (int v = 0; v < IDT_ENTRIES; v++) {
+        struct irq_stats_t* s = &irq_stats[v];
+        if (s->count == 0)
+            continue;
+
+        printf("vec %d: count=%d avg=%d max=%d\n  ",
+               v, s->count, average_cycles(s), s->max_cycles);
+
+        // Histogram, one "<2^n:count" entry per non-empty bucket
+        for (int b = 0; b < IRQ_STATS_BUCKETS; b++) {
+            if (s->histogram[b] == 0)
+                continue;
+            if (b == IRQ_STATS_BUCKETS - 1)
+                printf(">=2^%d:%d ", b + IRQ_STATS_MIN_SHIFT, s->histogram[b]);
+            else
+                printf("<2^%d:%d ", b + IRQ_STATS_MIN_SHIFT + 1, s->histogram[b]);
+        }
+        printf("\n");
+    }
+}
+
+void irq_stats_reset()
+{
+    uint32_t flags = interrupts_save();
+    memset(irq_stats, 0, sizeof(irq_stats));
+    interrupts_restore(flags);
+}
+
+#endif // CONFIG_IRQ_STATS
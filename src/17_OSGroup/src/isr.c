@@ -1,4 +1,5 @@
 #include "interrupts.h"
+#include "irqstats.h"
 #include "libc/stdint.h"
 #include "libc/stddef.h"
 
@@ -20,7 +21,9 @@ void isr_handler_function(registers_t regs)
     if (intrpt.handler != 0)
     {
         // Call the registered handler if it exists.
+        IRQ_STATS_BEGIN(start);
         intrpt.handler(&regs, intrpt.data);
+        IRQ_STATS_END(int_no, start);
     }
     else
     {
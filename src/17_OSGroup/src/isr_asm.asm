@@ -116,12 +116,13 @@ isr_common_stub:
     sti
     iret           ; pops 5 things at once: CS, EIP, EFLAGS, SS, and ESP
 
-; In isr.c
+; In irq.c
 extern irq_handler
+extern irq_nesting_depth
 
 ; This is our common IRQ stub. It saves the processor state, sets
-; up for kernel mode segments, calls the C-level fault handler,
-; and finally restores the stack frame.
+; up for kernel mode segments, switches to the interrupt stack,
+; calls the C-level IRQ handler, and finally restores the stack frame.
 irq_common_stub:
     pusha                    ; Pushes edi,esi,ebp,esp,ebx,edx,ecx,eax
 
@@ -134,8 +135,20 @@ irq_common_stub:
     mov fs, ax
     mov gs, ax
 
+    mov ebx, esp   ; ebx = saved register frame (callee-saved in C)
+
+    ; Only the outermost IRQ switches stacks, a nested one is already
+    ; running on the interrupt stack.
+    cmp dword [irq_nesting_depth], 0
+    jne .on_irq_stack
+    mov esp, irq_stack_top
+.on_irq_stack:
+
+    push ebx       ; irq_handler(registers_t* regs)
     call irq_handler
 
+    mov esp, ebx   ; back to the interrupted stack
+
     pop ebx        ; reload the original data segment descriptor
     mov ds, bx
     mov es, bx
@@ -147,4 +160,16 @@ irq_common_stub:
 
     iret           ; pops 5 things at once: CS, EIP, EFLAGS, SS, and ESP
 
-
+; Dedicated stack for IRQ handlers, so nested interrupts do not grow
+; whatever stack was interrupted. CONFIG_IRQ_STACK_SIZE comes from the
+; build, which gives the C side (IRQ_STACK_SIZE) the same value. There is
+; only one CPU, so there is only one stack.
+%ifndef CONFIG_IRQ_STACK_SIZE
+%error "CONFIG_IRQ_STACK_SIZE must be set by the build"
+%endif
+global irq_stack_bottom
+section .bss
+align 16
+irq_stack_bottom:
+    resb CONFIG_IRQ_STACK_SIZE
+irq_stack_top:
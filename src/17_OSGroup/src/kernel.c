@@ -11,6 +11,11 @@
 #include "interrupts.h"
 #include "monitor.h"
 #include "memory/memory.h"
+#include "bootinfo.h"
+#include "fbcon.h"
+#include "console.h"
+#include "drivers/serial.h"
+#include "klog.h"
 
 // Structure to hold multiboot information provided by the bootloader
 struct multiboot_info {
@@ -22,7 +27,8 @@ struct multiboot_info {
 // Forward declaration for the C++ kernel main function
 int kernel_main();
 
-// End of the kernel image, defined elsewhere
+// Start and end of the kernel image, defined in the linker script
+extern uint32_t kernel_start;
 extern uint32_t end;
 
 // Main entry point for the kernel, called from boot code
@@ -31,6 +37,11 @@ extern uint32_t end;
 int kernel_main_c(uint32_t magic, struct multiboot_info* mb_info_addr) {
     // Initialize the monitor for screen output
     monitor_initialize();
+
+    // Keep a copy of the boot information before paging hides it
+    if (!bootinfo_init(magic, mb_info_addr)) {
+        printf("No usable multiboot2 information\n");
+    }
   
     // Set up the Global Descriptor Table (GDT) for segment management
     init_gdt();
@@ -41,18 +52,38 @@ int kernel_main_c(uint32_t magic, struct multiboot_info* mb_info_addr) {
     // Enable hardware interrupt handling
     init_irq();
 
+    // Mirror the console to COM1 so boot logs can be captured from the host
+    if (init_serial()) {
+        console_set_serial_mirror(true);
+    }
+
     // Initialize the kernel's memory manager, using the end address of the kernel image
     init_kernel_memory(&end);
 
     // Set up paging for memory management
     init_paging();
 
+#ifdef CONFIG_FRAMEBUFFER
+    // Move the console to the framebuffer if the bootloader set one up
+    struct multiboot_tag* fb_tag = bootinfo_find_tag(MULTIBOOT_TAG_TYPE_FRAMEBUFFER, NULL);
+    if (fb_tag != NULL && fbcon_init((struct multiboot_tag_framebuffer*)fb_tag)) {
+        printf("Framebuffer console enabled\n");
+    }
+#endif
+
     // Print the memory layout to the monitor for debugging
     print_memory_layout();
+    printf("Kernel image: %lu KiB\n", ((uint32_t)&end - (uint32_t)&kernel_start) / 1024);
 
     // Initialize the Programmable Interval Timer (PIT) for system timing
     init_pit();
 
+    // Write the kernel log to the console from the timer tick
+    init_klog();
+
+    // From now on the screen is updated from the timer tick
+    monitor_set_deferred(true);
+
     // Print a hello world message to the monitor
     printf("Hello World!\n");
     
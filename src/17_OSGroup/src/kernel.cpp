@@ -3,8 +3,25 @@ extern "C"{
     #include "memory/memory.h"
     #include "common.h"
     #include "interrupts.h"
-    #include "input.h"
+    #include "drivers/keyboard.h"
+    #include "drivers/mouse.h"
     #include "song/song.h"
+    #include "song/sequencer.h"
+    #include "song/song_pcm.h"
+    #include "song/synth.h"
+    #include "song/library.h"
+    #include "drivers/pcspeaker.h"
+    #include "drivers/sb16.h"
+    #include "drivers/ac97.h"
+    #include "drivers/pci.h"
+    #include "drivers/ata.h"
+    #include "drivers/virtio_blk.h"
+    #include "blockdev.h"
+    #include "block.h"
+    #include "bcache.h"
+    #include "fs/fat32.h"
+    #include "bench/bench.h"
+    #include "pit.h"
 }
 
 
@@ -42,10 +59,81 @@ void operator delete[](void* ptr, size_t size) noexcept {
 
 SongPlayer* create_song_player() {
     auto* player = new SongPlayer();
-    player->play_song = play_song_impl;
+    // Songs are handed to the sequencer and play in the background
+    player->play_song = [](Song* song) {
+        if (!sequencer_queue(song)) {
+            printf("Song queue is full\n");
+        }
+    };
+    return player;
+}
+
+// Songs rendered by the synth and streamed to the current audio output,
+// whichever sound device that is
+SongPlayer* create_pcm_song_player() {
+    auto* player = new SongPlayer();
+    player->play_song = [](Song* song) {
+        static struct synth_song renderer;
+        audio_output_t* output = audio_current_output();
+        if (output == NULL || !audio_play(synth_song_init(&renderer, song, output->sample_rate))) {
+            printf("No audio output\n");
+        }
+    };
     return player;
 }
 
+// Parse a decimal number, returns false if there is none
+static bool parse_number(const char* text, uint32_t* value) {
+    if (*text < '0' || *text > '9')
+        return false;
+    *value = 0;
+    while (*text >= '0' && *text <= '9')
+        *value = *value * 10 + (*text++ - '0');
+    return *text == '\0';
+}
+
+// The FAT32 disk, if one was found
+static fat32_fs_t disk_fs;
+static bool disk_mounted = false;
+
+// Mount the first block device that holds a FAT32 filesystem
+static void mount_disk() {
+    for (uint32_t i = 0; i < blockdev_count() && !disk_mounted; i++) {
+        blockdev_t* dev = blockdev_get(i);
+        if (fat32_mount(&disk_fs, dev)) {
+            disk_mounted = true;
+            uint32_t clusters_per_mib = 1024 * 1024 / disk_fs.cluster_size;
+            printf("FAT32 on %s: %lu MiB, %lu MiB free, label %s%s\n", dev->name,
+                   disk_fs.clusters / clusters_per_mib, disk_fs.free_clusters / clusters_per_mib,
+                   disk_fs.label, disk_fs.fat != NULL ? "" : " (FAT not cached)");
+        }
+    }
+}
+
+// Largest file read into memory whole. malloc panics when the heap runs
+// out, and songs are far smaller than this.
+#define DISK_FILE_MAX (256 * 1024)
+
+// Read a whole file into memory, NULL if it cannot be read or is too big
+static uint8_t* read_disk_file(const char* path, uint32_t* size) {
+    fat32_file_t file;
+    if (!disk_mounted || !fat32_open(&disk_fs, path, &file))
+        return nullptr;
+    uint8_t* data = nullptr;
+    if (!(file.attr & FAT32_ATTR_DIRECTORY) && file.size <= DISK_FILE_MAX) {
+        data = (uint8_t*)malloc(file.size + 1);
+        if ((uint32_t)fat32_read(&file, data, file.size) != file.size) {
+            free(data);
+            data = nullptr;
+        } else {
+            data[file.size] = '\0';
+            *size = file.size;
+        }
+    }
+    fat32_close(&file);
+    return data;
+}
+
 extern "C" int kernel_main(void);
 int kernel_main(){
 
@@ -92,44 +180,257 @@ int kernel_main(){
     // Enable interrupts
     asm volatile("sti");
 
-    // We register the IRQ handler for the keyboard (IRQ1)
-    register_irq_handler(IRQ1, [](registers_t*, void*) {
-        // This will read it from keyboard
-        unsigned char scan_code = inb(0x60);
-        char f = scancode_to_ascii(&scan_code);
+    // Keystrokes are queued by IRQ1 and decoded when somebody reads them
+    init_keyboard();
 
-        printf("%c", f);
+    // Motion is assembled into events by IRQ12, for whoever wants them
+    if (init_mouse()) {
+        printf("PS/2 mouse enabled%s\n", mouse_has_wheel() ? " (with wheel)" : "");
+    }
 
-        // Disable
-        asm volatile("cli");
-    }, NULL);
+    // Find what is on the PCI buses, drivers claim their devices as they register
+    init_pci();
 
+    // Hard disks, the FAT32 image is the primary slave (hdb) or, when QEMU
+    // attaches it with if=virtio, the first virtio disk (vda)
+    init_ata();
+    init_virtio_blk();
+    init_block();
+    init_bcache();
+    mount_disk();
 
-    Song* songs[] = {
+    // Sampled audio outputs, the last one found is used: the PC speaker
+    // always works, the sound cards stream by DMA
+    init_pcspk_pcm();
+    if (init_sb16()) {
+        printf("Sound Blaster 16 found (DSP %d.%02d)\n", sb16_version() >> 8, sb16_version() & 0xFF);
+    }
+    if (init_ac97()) {
+        printf("AC'97 audio found (%lu Hz)\n", ac97_sample_rate());
+    }
 
-        new Song({battlefield_1942_theme, sizeof(battlefield_1942_theme) / sizeof(Note)}),
-        new Song({starwars_theme, sizeof(starwars_theme) / sizeof(Note)}),
-        new Song({music_1, sizeof(music_1) / sizeof(Note)}),
-        new Song({music_6, sizeof(music_6) / sizeof(Note)}),
-        new Song({music_5, sizeof(music_5) / sizeof(Note)}),
-        new Song({music_4, sizeof(music_4) / sizeof(Note)}),
-        new Song({music_3, sizeof(music_3) / sizeof(Note)}),
-        new Song({music_2, sizeof(music_2) / sizeof(Note)})
-    };
-    uint32_t n_songs = sizeof(songs) / sizeof(Song*);
+    // Built-in songs and any that came as boot modules
+    init_song_library();
+    uint32_t n_songs = song_library_count();
 
-    // Create a song player and play each song
+#ifdef CONFIG_BENCHMARKS
+    run_benchmarks();
+#endif
+
+    // Create a song player and queue each song, they play from the timer tick
+    init_sequencer();
     SongPlayer* player = create_song_player();
     for(uint32_t i = 0; i < n_songs; i++) {
-        printf("Playing Song...\n");
-        player->play_song(songs[i]);
-        printf("Finished playing the song.\n");
+        player->play_song(song_library_get(i));
     }
+    printf("Playing %d songs in the background\n", (int)n_songs);
+    SongPlayer* pcm_player = create_pcm_song_player();
 
     // Main loop
     printf("Kernel main loop\n");
+    char line[128];
     while(true) {
         // Kernel main tasks
+        printf("> ");
+        read_line(line, sizeof(line));
+
+        // "keymap <name>" switches the keyboard layout
+        if (strncmp(line, "keymap ", 7) == 0) {
+            const keymap_layout_t* layout = keymap_find_layout(line + 7);
+            if (layout != NULL) {
+                keymap_set_layout(layout);
+                printf("Keyboard layout: %s\n", keymap_layout_name(layout));
+            } else {
+                printf("Unknown keyboard layout: %s (try us or no)\n", line + 7);
+            }
+            continue;
+        }
+
+        // Song playback control
+        uint32_t number;
+        if (strcmp(line, "play") == 0) {
+            for(uint32_t i = 0; i < n_songs; i++) {
+                player->play_song(song_library_get(i));
+            }
+        } else if (strcmp(line, "stop") == 0) {
+            sequencer_stop();
+            audio_stop();
+        } else if (strncmp(line, "pcm ", 4) == 0 && parse_number(line + 4, &number)) {
+            // Sampled playback of one song as plain square waves
+            static struct song_pcm decoder;
+            if (number >= n_songs) {
+                printf("There are %d songs\n", (int)n_songs);
+            } else if (audio_current_output() != NULL) {
+                sequencer_stop();
+                audio_play(song_pcm_init(&decoder, song_library_get(number), audio_current_output()->sample_rate));
+            }
+        } else if (strncmp(line, "synth ", 6) == 0 && parse_number(line + 6, &number)) {
+            // Same, but through the polyphonic synth
+            if (number >= n_songs) {
+                printf("There are %d songs\n", (int)n_songs);
+            } else {
+                sequencer_stop();
+                pcm_player->play_song(song_library_get(number));
+            }
+        } else if (strcmp(line, "output") == 0) {
+            for (uint32_t i = 0; audio_get_output(i) != NULL; i++) {
+                audio_output_t* output = audio_get_output(i);
+                printf("%c %s (%lu Hz)\n", output == audio_current_output() ? '*' : ' ',
+                       output->name, output->sample_rate);
+            }
+        } else if (strncmp(line, "output ", 7) == 0) {
+            if (!audio_select_output(line + 7)) {
+                printf("Unknown audio output: %s\n", line + 7);
+            }
+        } else if (strcmp(line, "pci") == 0) {
+            for (uint32_t i = 0; i < pci_device_count(); i++) {
+                struct pci_device* device = pci_get_device(i);
+                printf("%02x:%02x.%d %04x:%04x %s (%02x.%02x.%02x)",
+                       device->address.bus, device->address.slot, device->address.function,
+                       device->vendor, device->device, pci_class_name(device->class_code),
+                       device->class_code, device->subclass, device->prog_if);
+                if (device->interrupt_line != PCI_INTERRUPT_NONE && device->interrupt_pin != 0) {
+                    printf(" irq %d", device->interrupt_line);
+                }
+                if (device->driver != NULL) {
+                    printf(" [%s]", device->driver->name);
+                }
+                printf("\n");
+                for (int bar = 0; bar < PCI_MAX_BARS; bar++) {
+                    if (device->bars[bar].size != 0) {
+                        printf("    BAR%d %s %08lx, %lu bytes\n", bar, device->bars[bar].io ? "io " : "mem",
+                               device->bars[bar].base, device->bars[bar].size);
+                    } else if (device->bars[bar].base != 0) {
+                        printf("    BAR%d %s %08lx\n", bar, device->bars[bar].io ? "io " : "mem",
+                               device->bars[bar].base);
+                    }
+                }
+            }
+        } else if (strcmp(line, "disks") == 0) {
+            for (uint32_t i = 0; i < blockdev_count(); i++) {
+                blockdev_t* dev = blockdev_get(i);
+                printf("%s: %lu sectors (%lu MiB), %lu reads, %lu writes, %lu errors\n", dev->name,
+                       dev->sectors, dev->sectors / (1024 * 1024 / BLOCKDEV_SECTOR_SIZE), dev->reads, dev->writes, dev->errors);
+            }
+        } else if (strcmp(line, "iostat") == 0) {
+            for (uint32_t i = 0; i < blockdev_count(); i++) {
+                blockdev_t* dev = blockdev_get(i);
+                struct block_queue_stats stats;
+                block_get_stats(dev, &stats);
+                printf("%s: %lu requests, %lu merged, %lu commands, %lu expired, %lu errors\n", dev->name,
+                       stats.submitted, stats.merged, stats.dispatched, stats.expired, stats.errors);
+                printf("    depth %lu (max %lu), latency %lu us average, %lu us max\n",
+                       stats.depth, stats.max_depth, stats.average_latency_us, stats.max_latency_us);
+            }
+        } else if (strcmp(line, "cache") == 0) {
+            struct bcache_stats stats;
+            bcache_get_stats(&stats);
+            printf("%lu lookups, %lu hits (%lu%%), %lu misses, %lu promoted, %lu evicted\n",
+                   stats.lookups, stats.hits, stats.lookups ? stats.hits * 100 / stats.lookups : 0,
+                   stats.misses, stats.promotions, stats.evictions);
+            printf("%lu read ahead, %lu used, %lu wasted; %lu dirty, %lu written back, %lu errors\n",
+                   stats.readahead, stats.readahead_hits, stats.readahead_wasted,
+                   stats.dirty, stats.writebacks, stats.errors);
+        } else if (strcmp(line, "ls") == 0 || strncmp(line, "ls ", 3) == 0) {
+            // Files on the FAT32 disk
+            fat32_dir_t dir;
+            static struct fat32_entry entry;
+            if (!disk_mounted || !fat32_opendir(&disk_fs, line[2] != '\0' ? line + 3 : "/", &dir)) {
+                printf("No such directory\n");
+                continue;
+            }
+            while (fat32_readdir(&dir, &entry)) {
+                if (entry.attr & FAT32_ATTR_DIRECTORY) {
+                    printf("%10s %s/\n", "", entry.name);
+                } else {
+                    printf("%10lu %s\n", entry.size, entry.name);
+                }
+            }
+            fat32_closedir(&dir);
+        } else if (strncmp(line, "cat ", 4) == 0) {
+            // Printed a piece at a time, the file may be bigger than the heap
+            static char chunk[512];
+            fat32_file_t file;
+            if (!disk_mounted || !fat32_open(&disk_fs, line + 4, &file)) {
+                printf("Cannot read %s\n", line + 4);
+                continue;
+            }
+            int32_t count = 0;
+            while (!(file.attr & FAT32_ATTR_DIRECTORY) && (count = fat32_read(&file, chunk, sizeof(chunk))) > 0) {
+                print(chunk, count);
+            }
+            if (count < 0) {
+                printf("Read error\n");
+            }
+            fat32_close(&file);
+        } else if (strncmp(line, "load ", 5) == 0) {
+            // A song or MIDI file from the disk joins the library for good
+            uint32_t size;
+            uint8_t* data = read_disk_file(line + 5, &size);
+            char* name = (char*)malloc(strlen(line + 5) + 1);
+            strcpy(name, line + 5);
+            if (data == NULL || !song_library_add(name, data, size)) {
+                printf("Cannot load %s as a song (at most %d KiB)\n", line + 5, DISK_FILE_MAX / 1024);
+                if (data != NULL) {
+                    free(data);
+                }
+                free(name);
+                continue;
+            }
+            n_songs = song_library_count();
+            printf("Song %lu: %s (%lu notes)\n", n_songs - 1, name, song_library_get(n_songs - 1)->length);
+        } else if (strncmp(line, "write ", 6) == 0) {
+            // "write <path> <text>" replaces the file with one line of text
+            char* text = strchr(line + 6, ' ');
+            fat32_file_t file;
+            if (text == NULL) {
+                printf("Usage: write <path> <text>\n");
+                continue;
+            }
+            *text++ = '\0';
+            uint32_t length = strlen(text);
+            if (!disk_mounted || !fat32_create(&disk_fs, line + 6, &file)) {
+                printf("Cannot create %s\n", line + 6);
+                continue;
+            }
+            if ((uint32_t)fat32_write(&file, text, length) != length || fat32_write(&file, "\n", 1) != 1) {
+                printf("Write failed\n");
+            }
+            fat32_close(&file);
+        } else if (strncmp(line, "mkdir ", 6) == 0) {
+            if (!disk_mounted || !fat32_mkdir(&disk_fs, line + 6)) {
+                printf("Cannot create %s\n", line + 6);
+            }
+        } else if (strncmp(line, "rm ", 3) == 0) {
+            if (!disk_mounted || !fat32_remove(&disk_fs, line + 3)) {
+                printf("Cannot remove %s\n", line + 3);
+            }
+        } else if (strcmp(line, "sync") == 0) {
+            if ((disk_mounted && !fat32_sync(&disk_fs)) || !bcache_sync(nullptr)) {
+                printf("Sync failed\n");
+            }
+        } else if (strcmp(line, "songs") == 0) {
+            for (uint32_t i = 0; i < n_songs; i++) {
+                printf("%2lu %s (%lu notes)\n", i, song_library_name(i), song_library_get(i)->length);
+            }
+        } else if (strcmp(line, "pause") == 0) {
+            sequencer_pause();
+        } else if (strcmp(line, "resume") == 0) {
+            sequencer_resume();
+        } else if (strcmp(line, "next") == 0) {
+            sequencer_next();
+        } else if (strncmp(line, "seek ", 5) == 0 && parse_number(line + 5, &number)) {
+            if (!sequencer_seek(number * TICKS_PER_MS)) {
+                printf("Cannot seek there\n");
+            }
+        } else if (strcmp(line, "status") == 0) {
+            printf("%s at %lu/%lu ms, %lu songs queued\n",
+                   sequencer_is_paused() ? "Paused" : sequencer_is_playing() ? "Playing" : "Stopped",
+                   sequencer_position() / TICKS_PER_MS, sequencer_length() / TICKS_PER_MS,
+                   sequencer_queued());
+        } else {
+            printf("You typed: %s\n", line);
+        }
     }
 
     // This part will not be reached
@@ -0,0 +1,331 @@
+extern "C"{
+    #include "keymap.h"
+    #include "libc/string.h"
+}
+
+// Everything in here is generated at compile time from the two lists below:
+// where each key sits in scancode sets 1 and 2, and which characters each
+// layout puts on it. The kernel runs no global constructors, so every table
+// has to be constant-initialized, which constexpr guarantees.
+
+namespace {
+
+// Position of a key in both scancode sets
+struct key_position {
+    uint8_t keycode;
+    uint8_t set1;
+    uint8_t set2;
+    bool extended;      // Sent with an 0xE0 prefix (the same keys in both sets)
+};
+
+constexpr key_position positions[] = {
+    {KEY_ESC, 0x01, 0x76, false},        {KEY_1, 0x02, 0x16, false},
+    {KEY_2, 0x03, 0x1E, false},          {KEY_3, 0x04, 0x26, false},
+    {KEY_4, 0x05, 0x25, false},          {KEY_5, 0x06, 0x2E, false},
+    {KEY_6, 0x07, 0x36, false},          {KEY_7, 0x08, 0x3D, false},
+    {KEY_8, 0x09, 0x3E, false},          {KEY_9, 0x0A, 0x46, false},
+    {KEY_0, 0x0B, 0x45, false},          {KEY_MINUS, 0x0C, 0x4E, false},
+    {KEY_EQUAL, 0x0D, 0x55, false},      {KEY_BACKSPACE, 0x0E, 0x66, false},
+    {KEY_TAB, 0x0F, 0x0D, false},        {KEY_Q, 0x10, 0x15, false},
+    {KEY_W, 0x11, 0x1D, false},          {KEY_E, 0x12, 0x24, false},
+    {KEY_R, 0x13, 0x2D, false},          {KEY_T, 0x14, 0x2C, false},
+    {KEY_Y, 0x15, 0x35, false},          {KEY_U, 0x16, 0x3C, false},
+    {KEY_I, 0x17, 0x43, false},          {KEY_O, 0x18, 0x44, false},
+    {KEY_P, 0x19, 0x4D, false},          {KEY_LEFTBRACE, 0x1A, 0x54, false},
+    {KEY_RIGHTBRACE, 0x1B, 0x5B, false}, {KEY_ENTER, 0x1C, 0x5A, false},
+    {KEY_LEFTCTRL, 0x1D, 0x14, false},   {KEY_A, 0x1E, 0x1C, false},
+    {KEY_S, 0x1F, 0x1B, false},          {KEY_D, 0x20, 0x23, false},
+    {KEY_F, 0x21, 0x2B, false},          {KEY_G, 0x22, 0x34, false},
+    {KEY_H, 0x23, 0x33, false},          {KEY_J, 0x24, 0x3B, false},
+    {KEY_K, 0x25, 0x42, false},          {KEY_L, 0x26, 0x4B, false},
+    {KEY_SEMICOLON, 0x27, 0x4C, false},  {KEY_APOSTROPHE, 0x28, 0x52, false},
+    {KEY_GRAVE, 0x29, 0x0E, false},      {KEY_LEFTSHIFT, 0x2A, 0x12, false},
+    {KEY_BACKSLASH, 0x2B, 0x5D, false},  {KEY_Z, 0x2C, 0x1A, false},
+    {KEY_X, 0x2D, 0x22, false},          {KEY_C, 0x2E, 0x21, false},
+    {KEY_V, 0x2F, 0x2A, false},          {KEY_B, 0x30, 0x32, false},
+    {KEY_N, 0x31, 0x31, false},          {KEY_M, 0x32, 0x3A, false},
+    {KEY_COMMA, 0x33, 0x41, false},      {KEY_DOT, 0x34, 0x49, false},
+    {KEY_SLASH, 0x35, 0x4A, false},      {KEY_RIGHTSHIFT, 0x36, 0x59, false},
+    {KEY_KPASTERISK, 0x37, 0x7C, false}, {KEY_LEFTALT, 0x38, 0x11, false},
+    {KEY_SPACE, 0x39, 0x29, false},      {KEY_CAPSLOCK, 0x3A, 0x58, false},
+    {KEY_F1, 0x3B, 0x05, false},         {KEY_F2, 0x3C, 0x06, false},
+    {KEY_F3, 0x3D, 0x04, false},         {KEY_F4, 0x3E, 0x0C, false},
+    {KEY_F5, 0x3F, 0x03, false},         {KEY_F6, 0x40, 0x0B, false},
+    {KEY_F7, 0x41, 0x83, false},         {KEY_F8, 0x42, 0x0A, false},
+    {KEY_F9, 0x43, 0x01, false},         {KEY_F10, 0x44, 0x09, false},
+    {KEY_NUMLOCK, 0x45, 0x77, false},    {KEY_SCROLLLOCK, 0x46, 0x7E, false},
+    {KEY_KP7, 0x47, 0x6C, false},        {KEY_KP8, 0x48, 0x75, false},
+    {KEY_KP9, 0x49, 0x7D, false},        {KEY_KPMINUS, 0x4A, 0x7B, false},
+    {KEY_KP4, 0x4B, 0x6B, false},        {KEY_KP5, 0x4C, 0x73, false},
+    {KEY_KP6, 0x4D, 0x74, false},        {KEY_KPPLUS, 0x4E, 0x79, false},
+    {KEY_KP1, 0x4F, 0x69, false},        {KEY_KP2, 0x50, 0x72, false},
+    {KEY_KP3, 0x51, 0x7A, false},        {KEY_KP0, 0x52, 0x70, false},
+    {KEY_KPDOT, 0x53, 0x71, false},      {KEY_102ND, 0x56, 0x61, false},
+    {KEY_F11, 0x57, 0x78, false},        {KEY_F12, 0x58, 0x07, false},
+
+    {KEY_KPENTER, 0x1C, 0x5A, true},     {KEY_RIGHTCTRL, 0x1D, 0x14, true},
+    {KEY_KPSLASH, 0x35, 0x4A, true},     {KEY_SYSRQ, 0x37, 0x7C, true},
+    {KEY_RIGHTALT, 0x38, 0x11, true},    {KEY_HOME, 0x47, 0x6C, true},
+    {KEY_UP, 0x48, 0x75, true},          {KEY_PAGEUP, 0x49, 0x7D, true},
+    {KEY_LEFT, 0x4B, 0x6B, true},        {KEY_RIGHT, 0x4D, 0x74, true},
+    {KEY_END, 0x4F, 0x69, true},         {KEY_DOWN, 0x50, 0x72, true},
+    {KEY_PAGEDOWN, 0x51, 0x7A, true},    {KEY_INSERT, 0x52, 0x70, true},
+    {KEY_DELETE, 0x53, 0x71, true},      {KEY_LEFTMETA, 0x5B, 0x1F, true},
+    {KEY_RIGHTMETA, 0x5C, 0x27, true},   {KEY_COMPOSE, 0x5D, 0x2F, true},
+};
+
+// Set 1 is indexed by the make code with bit 7 set for extended keys, set 2
+// by the code with bit 8 set for extended keys
+struct set1_table { uint8_t keys[256]; };
+struct set2_table { uint8_t keys[512]; };
+
+constexpr set1_table make_set1_table() {
+    set1_table table{};
+    for (const key_position& p : positions)
+        table.keys[(p.extended ? 0x80 : 0) | p.set1] = p.keycode;
+    // The fake shifts wrapped around Print Screen are not keys. Left at
+    // KEY_NONE here, set explicitly to make that obvious.
+    table.keys[0x80 | 0x2A] = KEY_NONE;
+    table.keys[0x80 | 0x36] = KEY_NONE;
+    return table;
+}
+
+constexpr set2_table make_set2_table() {
+    set2_table table{};
+    for (const key_position& p : positions)
+        table.keys[(p.extended ? 0x100 : 0) | p.set2] = p.keycode;
+    return table;
+}
+
+constexpr set1_table set1 = make_set1_table();
+constexpr set2_table set2 = make_set2_table();
+
+// Held modifier keys, keymap_state.held
+constexpr uint32_t HELD_LEFTSHIFT  = 0x01;
+constexpr uint32_t HELD_RIGHTSHIFT = 0x02;
+constexpr uint32_t HELD_LEFTCTRL   = 0x04;
+constexpr uint32_t HELD_RIGHTCTRL  = 0x08;
+constexpr uint32_t HELD_LEFTALT    = 0x10;
+constexpr uint32_t HELD_RIGHTALT   = 0x20;
+
+struct modifier_table {
+    uint8_t held[KEYCODE_COUNT];
+    uint8_t locks[KEYCODE_COUNT];
+    uint8_t keypad[KEYCODE_COUNT];  // Navigation key of a keypad key that needs Num Lock
+};
+
+constexpr modifier_table make_modifier_table() {
+    modifier_table table{};
+    table.held[KEY_LEFTSHIFT] = HELD_LEFTSHIFT;
+    table.held[KEY_RIGHTSHIFT] = HELD_RIGHTSHIFT;
+    table.held[KEY_LEFTCTRL] = HELD_LEFTCTRL;
+    table.held[KEY_RIGHTCTRL] = HELD_RIGHTCTRL;
+    table.held[KEY_LEFTALT] = HELD_LEFTALT;
+    table.held[KEY_RIGHTALT] = HELD_RIGHTALT;
+    table.locks[KEY_CAPSLOCK] = KEY_LOCK_CAPS;
+    table.locks[KEY_NUMLOCK] = KEY_LOCK_NUM;
+    table.locks[KEY_SCROLLLOCK] = KEY_LOCK_SCROLL;
+    // The 5 has nothing printed under it and stays itself
+    table.keypad[KEY_KP7] = KEY_HOME;
+    table.keypad[KEY_KP8] = KEY_UP;
+    table.keypad[KEY_KP9] = KEY_PAGEUP;
+    table.keypad[KEY_KP4] = KEY_LEFT;
+    table.keypad[KEY_KP5] = KEY_KP5;
+    table.keypad[KEY_KP6] = KEY_RIGHT;
+    table.keypad[KEY_KP1] = KEY_END;
+    table.keypad[KEY_KP2] = KEY_DOWN;
+    table.keypad[KEY_KP3] = KEY_PAGEDOWN;
+    table.keypad[KEY_KP0] = KEY_INSERT;
+    table.keypad[KEY_KPDOT] = KEY_DELETE;
+    return table;
+}
+
+constexpr modifier_table modifiers = make_modifier_table();
+
+// Characters on a key: plain, with shift, with AltGr, with shift and AltGr.
+// Levels left at 0 for AltGr fall back to the ones without it.
+struct key_chars {
+    uint8_t keycode;
+    uint8_t levels[4];
+};
+
+// Letters outside ASCII, in code page 865 (Nordic). The glyphs for ae and
+// a-ring are the same in the VGA BIOS font (code page 437), o-slash shows
+// up as the cent sign there.
+constexpr uint8_t CP865_ae_small   = 0x91;
+constexpr uint8_t CP865_AE_capital = 0x92;
+constexpr uint8_t CP865_o_slash    = 0x9B;
+constexpr uint8_t CP865_O_slash    = 0x9D;
+constexpr uint8_t CP865_a_ring     = 0x86;
+constexpr uint8_t CP865_A_ring     = 0x8F;
+constexpr uint8_t CP865_pound      = 0x9C;
+constexpr uint8_t CP865_currency   = 0xAF;
+constexpr uint8_t CP865_section    = 0x15;
+constexpr uint8_t CP865_micro      = 0xE6;
+
+// Keys that are the same in every layout
+constexpr key_chars common_keys[] = {
+    {KEY_A, {'a', 'A'}}, {KEY_B, {'b', 'B'}}, {KEY_C, {'c', 'C'}},
+    {KEY_D, {'d', 'D'}}, {KEY_E, {'e', 'E'}}, {KEY_F, {'f', 'F'}},
+    {KEY_G, {'g', 'G'}}, {KEY_H, {'h', 'H'}}, {KEY_I, {'i', 'I'}},
+    {KEY_J, {'j', 'J'}}, {KEY_K, {'k', 'K'}}, {KEY_L, {'l', 'L'}},
+    {KEY_M, {'m', 'M'}}, {KEY_N, {'n', 'N'}}, {KEY_O, {'o', 'O'}},
+    {KEY_P, {'p', 'P'}}, {KEY_Q, {'q', 'Q'}}, {KEY_R, {'r', 'R'}},
+    {KEY_S, {'s', 'S'}}, {KEY_T, {'t', 'T'}}, {KEY_U, {'u', 'U'}},
+    {KEY_V, {'v', 'V'}}, {KEY_W, {'w', 'W'}}, {KEY_X, {'x', 'X'}},
+    {KEY_Y, {'y', 'Y'}}, {KEY_Z, {'z', 'Z'}},
+    {KEY_ENTER, {'\n', '\n'}}, {KEY_KPENTER, {'\n', '\n'}},
+    {KEY_BACKSPACE, {'\b', '\b'}}, {KEY_TAB, {'\t', '\t'}},
+    {KEY_SPACE, {' ', ' '}}, {KEY_ESC, {0x1B, 0x1B}},
+    {KEY_KPSLASH, {'/', '/'}}, {KEY_KPASTERISK, {'*', '*'}},
+    {KEY_KPMINUS, {'-', '-'}}, {KEY_KPPLUS, {'+', '+'}},
+    {KEY_KP0, {'0', '0'}}, {KEY_KP1, {'1', '1'}}, {KEY_KP2, {'2', '2'}},
+    {KEY_KP3, {'3', '3'}}, {KEY_KP4, {'4', '4'}}, {KEY_KP5, {'5', '5'}},
+    {KEY_KP6, {'6', '6'}}, {KEY_KP7, {'7', '7'}}, {KEY_KP8, {'8', '8'}},
+    {KEY_KP9, {'9', '9'}},
+};
+
+constexpr key_chars us_keys[] = {
+    {KEY_1, {'1', '!'}}, {KEY_2, {'2', '@'}}, {KEY_3, {'3', '#'}},
+    {KEY_4, {'4', '$'}}, {KEY_5, {'5', '%'}}, {KEY_6, {'6', '^'}},
+    {KEY_7, {'7', '&'}}, {KEY_8, {'8', '*'}}, {KEY_9, {'9', '('}},
+    {KEY_0, {'0', ')'}}, {KEY_MINUS, {'-', '_'}}, {KEY_EQUAL, {'=', '+'}},
+    {KEY_LEFTBRACE, {'[', '{'}}, {KEY_RIGHTBRACE, {']', '}'}},
+    {KEY_SEMICOLON, {';', ':'}}, {KEY_APOSTROPHE, {'\'', '"'}},
+    {KEY_GRAVE, {'`', '~'}}, {KEY_BACKSLASH, {'\\', '|'}},
+    {KEY_COMMA, {',', '<'}}, {KEY_DOT, {'.', '>'}}, {KEY_SLASH, {'/', '?'}},
+    {KEY_102ND, {'\\', '|'}}, {KEY_KPDOT, {'.', '.'}},
+};
+
+// The dead keys (diaeresis/circumflex/tilde and acute/grave) produce their
+// spacing characters where ASCII has them
+constexpr key_chars no_keys[] = {
+    {KEY_1, {'1', '!'}}, {KEY_2, {'2', '"', '@'}},
+    {KEY_3, {'3', '#', CP865_pound}}, {KEY_4, {'4', CP865_currency, '$'}},
+    {KEY_5, {'5', '%'}}, {KEY_6, {'6', '&'}}, {KEY_7, {'7', '/', '{'}},
+    {KEY_8, {'8', '(', '['}}, {KEY_9, {'9', ')', ']'}},
+    {KEY_0, {'0', '=', '}'}}, {KEY_MINUS, {'+', '?'}},
+    {KEY_EQUAL, {'\\', '`'}},
+    {KEY_LEFTBRACE, {CP865_a_ring, CP865_A_ring}},
+    {KEY_RIGHTBRACE, {0, '^', '~'}},
+    {KEY_SEMICOLON, {CP865_o_slash, CP865_O_slash}},
+    {KEY_APOSTROPHE, {CP865_ae_small, CP865_AE_capital}},
+    {KEY_GRAVE, {'|', CP865_section}}, {KEY_BACKSLASH, {'\'', '*'}},
+    {KEY_COMMA, {',', ';'}}, {KEY_DOT, {'.', ':'}}, {KEY_SLASH, {'-', '_'}},
+    {KEY_102ND, {'<', '>'}}, {KEY_M, {'m', 'M', CP865_micro}},
+    {KEY_KPDOT, {',', ','}},
+};
+
+constexpr bool is_letter(uint8_t c) {
+    return (c >= 'a' && c <= 'z') || c == CP865_ae_small || c == CP865_o_slash || c == CP865_a_ring;
+}
+
+} // namespace
+
+struct keymap_layout {
+    const char* name;
+    uint8_t chars[KEYCODE_COUNT][4];
+    uint8_t caps[KEYCODE_COUNT];    // 1 if caps lock works like shift on the key
+};
+
+namespace {
+
+template <size_t N>
+constexpr keymap_layout make_layout(const char* name, const key_chars (&keys)[N]) {
+    keymap_layout layout{};
+    layout.name = name;
+
+    auto apply = [&layout](const key_chars& key) {
+        for (int level = 0; level < 4; level++)
+            layout.chars[key.keycode][level] = key.levels[level];
+        // AltGr falls back to the plain and shifted characters
+        if (layout.chars[key.keycode][2] == 0)
+            layout.chars[key.keycode][2] = key.levels[0];
+        if (layout.chars[key.keycode][3] == 0)
+            layout.chars[key.keycode][3] = key.levels[1];
+        layout.caps[key.keycode] = is_letter(key.levels[0]) ? 1 : 0;
+    };
+    for (const key_chars& key : common_keys)
+        apply(key);
+    for (const key_chars& key : keys)
+        apply(key);
+    return layout;
+}
+
+constexpr keymap_layout us_layout = make_layout("us", us_keys);
+constexpr keymap_layout no_layout = make_layout("no", no_keys);
+
+constexpr const keymap_layout* layouts[] = { &us_layout, &no_layout };
+
+const keymap_layout* current_layout = &us_layout;
+
+} // namespace
+
+uint8_t keymap_set1_keycode(uint8_t scancode, int extended) {
+    return set1.keys[((extended & 1) << 7) | (scancode & 0x7F)];
+}
+
+uint8_t keymap_set2_keycode(uint8_t scancode, int extended) {
+    return set2.keys[((extended & 1) << 8) | scancode];
+}
+
+void keymap_decode_set1(struct keymap_state* state, uint8_t scancode, int extended, key_event_t* event) {
+    // All ones for a make code, all zeros for a break code
+    uint32_t released = scancode >> 7;
+    uint32_t press_mask = released - 1;
+
+    uint8_t keycode = set1.keys[((extended & 1) << 7) | (scancode & 0x7F)];
+
+    // A make code for a key that is already down is a typematic repeat
+    uint32_t& down = state->keys_down[keycode >> 5];
+    uint32_t bit = 1u << (keycode & 31);
+    uint32_t repeat = ((down & bit) >> (keycode & 31)) & ~released;
+    down = (down & ~bit) | (bit & press_mask);
+
+    // Modifier keys follow the key state, lock keys toggle on the first press
+    uint32_t held_bit = modifiers.held[keycode];
+    state->held = (state->held & ~held_bit) | (held_bit & press_mask);
+    state->locks ^= modifiers.locks[keycode] & press_mask & (repeat - 1);
+
+    uint32_t held = state->held;
+    uint32_t shift = ((held & (HELD_LEFTSHIFT | HELD_RIGHTSHIFT)) + 3) >> 2;
+    uint32_t ctrl = ((held & (HELD_LEFTCTRL | HELD_RIGHTCTRL)) + 0xC) >> 4;
+    uint32_t alt = (held & HELD_LEFTALT) >> 4;
+    uint32_t altgr = (held & HELD_RIGHTALT) >> 5;
+    uint32_t caps = state->locks & KEY_LOCK_CAPS;
+    uint32_t num = (state->locks & KEY_LOCK_NUM) >> 1;
+
+    const keymap_layout* layout = current_layout;
+    uint32_t level = (shift ^ (caps & layout->caps[keycode])) | (altgr << 1);
+
+    // Keypad digits type with Num Lock on, shift inverting it, and are the
+    // navigation keys printed under them otherwise. All ones if navigating.
+    uint32_t keypad = modifiers.keypad[keycode];
+    uint32_t navigate = 0u - (((keypad + 0xFF) >> 8) & ~(num ^ shift) & 1);
+
+    event->keycode = keycode ^ ((keycode ^ keypad) & navigate);
+    event->modifiers = shift | (ctrl << 1) | (alt << 2) | (caps << 3) | (altgr << 4) | (num << 5);
+    event->flags = released | (repeat << 1);
+    event->ascii = layout->chars[keycode][level] & press_mask & ~navigate;
+}
+
+const keymap_layout_t* keymap_find_layout(const char* name) {
+    for (const keymap_layout* layout : layouts) {
+        if (strcmp(layout->name, name) == 0)
+            return layout;
+    }
+    return nullptr;
+}
+
+const char* keymap_layout_name(const keymap_layout_t* layout) {
+    return layout->name;
+}
+
+void keymap_set_layout(const keymap_layout_t* layout) {
+    if (layout != nullptr)
+        current_layout = layout;
+}
+
+const keymap_layout_t* keymap_current_layout() {
+    return current_layout;
+}
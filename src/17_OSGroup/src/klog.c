@@ -0,0 +1,162 @@
+#include "klog.h"
+#include "common.h"
+#include "console.h"
+#include "interrupts.h"
+#include "pit.h"
+#include "memory/memory.h"
+
+#ifndef CONFIG_KLOG_LEVEL
+#define CONFIG_KLOG_LEVEL KLOG_INFO
+#endif
+
+static struct klog_record klog_ring[KLOG_RECORDS];
+
+// Sequence number of the next record to be written. Starts at 1 so that a
+// sequence number of 0 can mark a record that is still being written.
+static volatile uint32_t klog_next = 1;
+
+// Next record to be drained to the console
+static uint32_t klog_drained = 1;
+static uint32_t klog_lost_records = 0;
+static int console_level = CONFIG_KLOG_LEVEL;
+
+static const char* const level_names[] = {
+    "emerg", "alert", "crit", "err", "warn", "notice", "info", "debug"
+};
+
+// The kernel only runs on one processor so far
+static uint8_t current_cpu() {
+    return 0;
+}
+
+struct klog_text {
+    char* text;
+    uint16_t length;
+};
+
+// Copy formatted output into the record, cutting it off when full
+static void klog_sink(void* ctx, const char* data, size_t length) {
+    struct klog_text* out = ctx;
+    size_t space = KLOG_TEXT_SIZE - out->length;
+    if (length > space)
+        length = space;
+    memcpy(out->text + out->length, data, length);
+    out->length += length;
+}
+
+void klog(int level, const char* __restrict__ format, ...) {
+    // Claiming a slot and marking it as being written is the only part that
+    // has to be atomic. With a single processor that just means no
+    // interrupt handler may claim it or drain it in between, the record
+    // itself is filled in with interrupts enabled.
+    uint32_t flags = interrupts_save();
+    uint32_t seq = klog_next++;
+    struct klog_record* record = &klog_ring[seq & (KLOG_RECORDS - 1)];
+    record->seq = 0;
+    interrupts_restore(flags);
+
+    record->timestamp = pit_get_ticks();
+    record->level = level;
+    record->cpu = current_cpu();
+
+    struct klog_text out = { record->text, 0 };
+    va_list parameters;
+    va_start(parameters, format);
+    vformat(klog_sink, &out, format, parameters);
+    va_end(parameters);
+    record->length = out.length;
+
+    // Publish the record only once it is complete
+    asm volatile ("" ::: "memory");
+    record->seq = seq;
+}
+
+// Copy a record out of the ring. Fails if the record is still being written,
+// or was overwritten while it was being copied.
+static bool klog_read(uint32_t seq, struct klog_record* copy) {
+    struct klog_record* record = &klog_ring[seq & (KLOG_RECORDS - 1)];
+    if (record->seq != seq)
+        return false;
+    asm volatile ("" ::: "memory");
+    memcpy(copy, record, sizeof(*copy));
+    asm volatile ("" ::: "memory");
+    return record->seq == seq;
+}
+
+// Write "[    12.345] level: text\n" through the console
+static void klog_print(const struct klog_record* record) {
+    char prefix[32];
+    int length = snprintf(prefix, sizeof(prefix), "[%5lu.%03lu] %s: ",
+                          record->timestamp / 1000, record->timestamp % 1000,
+                          level_names[record->level & 7]);
+    console_write(prefix, length);
+    console_write(record->text, record->length);
+    if (record->length == 0 || record->text[record->length - 1] != '\n')
+        console_putc('\n');
+}
+
+uint32_t klog_drain(uint32_t max) {
+    uint32_t written = 0;
+    struct klog_record copy;
+
+    while (written < max && klog_drained != klog_next) {
+        // Records the writers lapped are gone
+        if (klog_next - klog_drained > KLOG_RECORDS) {
+            uint32_t oldest = klog_next - KLOG_RECORDS;
+            klog_lost_records += oldest - klog_drained;
+            klog_drained = oldest;
+        }
+
+        if (!klog_read(klog_drained, &copy)) {
+            // Still being written by the code we interrupted, try again later
+            if (klog_ring[klog_drained & (KLOG_RECORDS - 1)].seq == 0)
+                break;
+            // Overwritten under us
+            klog_lost_records++;
+            klog_drained++;
+            continue;
+        }
+        klog_drained++;
+
+        if (copy.level <= console_level) {
+            klog_print(&copy);
+            written++;
+        }
+    }
+
+    return written;
+}
+
+static int klog_tick(registers_t* regs, void* context) {
+    klog_drain(KLOG_DRAIN_BUDGET);
+    // Shares the line with the PIT handler, which claims the interrupt
+    return IRQ_NONE;
+}
+
+void init_klog() {
+    register_irq_handler(IRQ0, klog_tick, NULL);
+}
+
+void klog_set_console_level(int level) {
+    console_level = level;
+}
+
+void klog_print_tail(uint32_t count) {
+    uint32_t end = klog_next;
+    uint32_t available = end - 1;
+    if (available > KLOG_RECORDS)
+        available = KLOG_RECORDS;
+    if (count > available)
+        count = available;
+
+    struct klog_record copy;
+    for (uint32_t seq = end - count; seq != end; seq++) {
+        if (klog_read(seq, &copy))
+            klog_print(&copy);
+    }
+    console_flush();
+}
+
+uint32_t klog_lost() {
+    return klog_lost_records;
+}
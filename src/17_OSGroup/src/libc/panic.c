@@ -1,5 +1,9 @@
 #include "libc/system.h"
 #include "libc/stdarg.h"
+#include "irqstats.h"
+#include "monitor.h"
+#include "drivers/serial.h"
+#include "klog.h"
 
 
 // less risky when the stack is blown out
@@ -11,10 +15,10 @@ static char buffer[4096];
 
 static void print_trace(const int N, const void* ra)
 {
-  printf(buffer, sizeof(buffer),
-          "[%d] %p\n",
-          N, ra);
-  printf(buffer);
+  snprintf(buffer, sizeof(buffer),
+           "[%d] %p\n",
+           N, ra);
+  print(buffer, strlen(buffer));
 }
 
 
@@ -37,12 +41,25 @@ void print_backtrace()
 __attribute__((noreturn))
 void panic(const char* reason)
 {
+	// The timer may never tick again, draw everything right away
+	monitor_set_deferred(false);
+
 	printf("\n\n!!! PANIC !!!\n%s\n", reason);
 
 	print_backtrace();
 
+	// The last things the kernel logged, including what never reached the screen
+	printf("\nKernel log:\n");
+	klog_print_tail(KLOG_PANIC_TAIL);
+
+	// Show which interrupts were firing, and how slow they were
+	irq_stats_dump();
+
 	// the end
 	printf("\nKernel halting...\n");
+
+	// The UART interrupt is gone with interrupts off, push the rest out by hand
+	serial_drain();
 	while (1) asm("cli; hlt");
 	__builtin_unreachable();
 }
@@ -1,139 +1,406 @@
 #include "libc/system.h"
 #include "libc/stdarg.h"
+#include "common.h"
+#include "memory/memory.h"
+#include "console.h"
 
-extern void monitor_put(char c);
+// Formatted output is collected in a buffer and handed to the sink in runs,
+// instead of character by character. printf uses a small buffer on the stack
+// and flushes it to the console; snprintf formats straight into the caller's
+// buffer and has no sink, anything that does not fit is cut off.
+#define FORMAT_CHUNK_SIZE 128
 
-int putchar(int ic) {
-    char c = (char) ic;
-    monitor_put(c);
-	return ic;
+struct format_out {
+	char* buffer;
+	size_t capacity;
+	size_t length;
+	size_t total;           // Everything produced, including what was cut off
+	format_sink_t sink;
+	void* ctx;
+};
+
+static void format_flush(struct format_out* out) {
+	if (out->sink == NULL)
+		return;
+	if (out->length > 0)
+		out->sink(out->ctx, out->buffer, out->length);
+	out->length = 0;
 }
 
+static void format_put(struct format_out* out, const char* data, size_t length) {
+	out->total += length;
+	while (length > 0) {
+		if (out->length == out->capacity) {
+			if (out->sink == NULL)
+				return;
+			format_flush(out);
+		}
+		size_t amount = out->capacity - out->length;
+		if (amount > length)
+			amount = length;
+		memcpy(out->buffer + out->length, data, amount);
+		out->length += amount;
+		data += amount;
+		length -= amount;
+	}
+}
 
+static void format_pad(struct format_out* out, char c, int count) {
+	char pad[16];
+	memset(pad, c, sizeof(pad));
+	while (count > 0) {
+		int amount = count < (int)sizeof(pad) ? count : (int)sizeof(pad);
+		format_put(out, pad, amount);
+		count -= amount;
+	}
+}
 
-bool print(const char* data, size_t length) {
-	const unsigned char* bytes = (const unsigned char*) data;
-	for (size_t i = 0; i < length; i++)
-		if (putchar(bytes[i]) == EOF)
-			return false;
-	return true;
+// Conversion flags
+#define FLAG_LEFT  0x01     // '-': pad on the right
+#define FLAG_ZERO  0x02     // '0': pad numbers with zeros
+#define FLAG_PLUS  0x04     // '+': always print a sign
+#define FLAG_SPACE 0x08     // ' ': space in place of a plus sign
+#define FLAG_ALT   0x10     // '#': 0x prefix for hex, leading 0 for octal
+#define FLAG_POINTER 0x20   // %p: 0x prefix even for zero
+
+// Length modifiers
+#define LENGTH_CHAR  0      // hh
+#define LENGTH_SHORT 1      // h
+#define LENGTH_INT   2
+#define LENGTH_LONG  3      // l, z (both 32 bits wide here)
+#define LENGTH_LLONG 4      // ll
+
+struct format_spec {
+	int flags;
+	int width;
+	int precision;          // -1 when not given
+	int length;
+};
+
+// Emit prefix (sign, 0x) and body, padded to the field width
+static void format_field(struct format_out* out, const struct format_spec* spec,
+                         const char* prefix, int prefix_length, int zeros,
+                         const char* body, int body_length) {
+	int padding = spec->width - prefix_length - zeros - body_length;
+	if (padding < 0)
+		padding = 0;
+
+	if (!(spec->flags & FLAG_LEFT) && !(spec->flags & FLAG_ZERO))
+		format_pad(out, ' ', padding);
+	format_put(out, prefix, prefix_length);
+	if (!(spec->flags & FLAG_LEFT) && (spec->flags & FLAG_ZERO))
+		format_pad(out, '0', padding);
+	format_pad(out, '0', zeros);
+	format_put(out, body, body_length);
+	if (spec->flags & FLAG_LEFT)
+		format_pad(out, ' ', padding);
 }
- int printf(const char* __restrict__ format, ...) {
-    // TODO %d and alot of formatting is missing!
-    // This you can implement yourtself!
-	va_list parameters;
-	va_start(parameters, format);
- 
-	int written = 0;
- 
+
+static const char lower_digits[] = "0123456789abcdef";
+static const char upper_digits[] = "0123456789ABCDEF";
+
+// Write the digits of value backwards, ending just before end. Returns the
+// first digit. Values that fit in 32 bits take the plain 32-bit path;
+// larger ones are divided with div64_32 since there is no libgcc.
+static char* format_digits(char* end, uint64_t value, uint32_t base, const char* digits) {
+	char* p = end;
+	if (base == 16 || base == 8) {
+		int shift = base == 16 ? 4 : 3;
+		do {
+			*--p = digits[value & (base - 1)];
+			value >>= shift;
+		} while (value != 0);
+		return p;
+	}
+
+	while (value >> 32) {
+		uint32_t rem;
+		value = div64_32(value, base, &rem);
+		*--p = digits[rem];
+	}
+	uint32_t low = (uint32_t)value;
+	do {
+		*--p = digits[low % base];
+		low /= base;
+	} while (low != 0);
+	return p;
+}
+
+static void format_integer(struct format_out* out, struct format_spec* spec,
+                           uint64_t value, bool negative, uint32_t base, bool upper) {
+	// 64-bit octal is the longest at 22 digits
+	char buffer[24];
+	char* end = buffer + sizeof(buffer);
+	char* start = end;
+
+	// An explicit zero precision prints nothing for zero
+	if (value != 0 || spec->precision != 0)
+		start = format_digits(end, value, base, upper ? upper_digits : lower_digits);
+	int length = end - start;
+
+	char prefix[2];
+	int prefix_length = 0;
+	if (negative)
+		prefix[prefix_length++] = '-';
+	else if (spec->flags & FLAG_PLUS)
+		prefix[prefix_length++] = '+';
+	else if (spec->flags & FLAG_SPACE)
+		prefix[prefix_length++] = ' ';
+
+	if (((spec->flags & FLAG_ALT) && base == 16 && value != 0) || (spec->flags & FLAG_POINTER)) {
+		prefix[prefix_length++] = '0';
+		prefix[prefix_length++] = upper ? 'X' : 'x';
+	}
+
+	int zeros = 0;
+	if (spec->precision >= 0) {
+		// A precision turns off zero padding for the field width
+		spec->flags &= ~FLAG_ZERO;
+		if (spec->precision > length)
+			zeros = spec->precision - length;
+	}
+	if ((spec->flags & FLAG_ALT) && base == 8 && zeros == 0 && (length == 0 || *start != '0'))
+		zeros = 1;
+
+	format_field(out, spec, prefix, prefix_length, zeros, start, length);
+}
+
+// Read a signed integer argument of the given length
+static int64_t format_signed_arg(va_list* parameters, int length) {
+	switch (length) {
+	case LENGTH_CHAR:  return (signed char)va_arg(*parameters, int);
+	case LENGTH_SHORT: return (short)va_arg(*parameters, int);
+	case LENGTH_LONG:  return va_arg(*parameters, long);
+	case LENGTH_LLONG: return va_arg(*parameters, long long);
+	default:           return va_arg(*parameters, int);
+	}
+}
+
+// Read an unsigned integer argument of the given length
+static uint64_t format_unsigned_arg(va_list* parameters, int length) {
+	switch (length) {
+	case LENGTH_CHAR:  return (unsigned char)va_arg(*parameters, unsigned int);
+	case LENGTH_SHORT: return (unsigned short)va_arg(*parameters, unsigned int);
+	case LENGTH_LONG:  return va_arg(*parameters, unsigned long);
+	case LENGTH_LLONG: return va_arg(*parameters, unsigned long long);
+	default:           return va_arg(*parameters, unsigned int);
+	}
+}
+
+static int format_engine(struct format_out* out, const char* __restrict__ format, va_list parameters) {
+	va_list args;
+	va_copy(args, parameters);
+
 	while (*format != '\0') {
-		size_t maxrem = INT_MAX - written;
- 
-		if (format[0] != '%' || format[1] == '%') {
-			if (format[0] == '%')
-				format++;
+		// Copy plain text up to the next conversion in one run
+		if (*format != '%') {
 			size_t amount = 1;
 			while (format[amount] && format[amount] != '%')
 				amount++;
-			if (maxrem < amount) {
-				// TODO: Set errno to EOVERFLOW.
-				return -1;
-			}
-			if (!print(format, amount))
-				return -1;
+			format_put(out, format, amount);
 			format += amount;
-			written += amount;
 			continue;
 		}
- 
+
 		const char* format_begun_at = format++;
- 
-		if (*format == 'c') {
+
+		struct format_spec spec;
+		spec.flags = 0;
+		spec.width = 0;
+		spec.precision = -1;
+		spec.length = LENGTH_INT;
+
+		// Flags
+		for (;; format++) {
+			if (*format == '-')
+				spec.flags |= FLAG_LEFT;
+			else if (*format == '0')
+				spec.flags |= FLAG_ZERO;
+			else if (*format == '+')
+				spec.flags |= FLAG_PLUS;
+			else if (*format == ' ')
+				spec.flags |= FLAG_SPACE;
+			else if (*format == '#')
+				spec.flags |= FLAG_ALT;
+			else
+				break;
+		}
+
+		// Field width
+		if (*format == '*') {
+			format++;
+			spec.width = va_arg(args, int);
+			if (spec.width < 0) {
+				spec.flags |= FLAG_LEFT;
+				spec.width = -spec.width;
+			}
+		} else {
+			while (*format >= '0' && *format <= '9')
+				spec.width = spec.width * 10 + (*format++ - '0');
+		}
+
+		// Precision
+		if (*format == '.') {
 			format++;
-			char c = (char) va_arg(parameters, int /* char promotes to int */);
-			if (!maxrem) {
-				// TODO: Set errno to EOVERFLOW.
-				return -1;
+			spec.precision = 0;
+			if (*format == '*') {
+				format++;
+				spec.precision = va_arg(args, int);
+				if (spec.precision < 0)
+					spec.precision = -1;
+			} else {
+				while (*format >= '0' && *format <= '9')
+					spec.precision = spec.precision * 10 + (*format++ - '0');
 			}
-			if (!print(&c, sizeof(c)))
-				return -1;
-			written++;
-		} else if (*format == 's') {
+		}
+
+		// Length modifier
+		if (*format == 'h') {
 			format++;
-			const char* str = va_arg(parameters, const char*);
-			size_t len = strlen(str);
-			if (maxrem < len) {
-				// TODO: Set errno to EOVERFLOW.
-				return -1;
+			spec.length = LENGTH_SHORT;
+			if (*format == 'h') {
+				format++;
+				spec.length = LENGTH_CHAR;
 			}
-			if (!print(str, len))
-				return -1;
-			written += len;
-		} else if (*format == 'd') {
-            format++;
-            int num = va_arg(parameters, int);
-            char buffer[20];
-            int i = 0;
-            if (num == 0) {
-                buffer[i++] = '0';
-            } else if (num < 0) {
-                buffer[i++] = '-';
-                num = -num;
-            }
-            while (num != 0) {
-                buffer[i++] = num % 10 + '0';
-                num /= 10;
-            }
-            while (i > 0) {
-                if (maxrem < 1) {
-                    // TODO: Set errno to EOVERFLOW.
-                    return -1;
-                }
-                if (!print(&buffer[--i], 1))
-                    return -1;
-                written++;
-            }
-        } else if (*format == 'x') {
-            format++;
-            unsigned int num = va_arg(parameters, unsigned int);
-            char buffer[20];
-            int i = 0;
-            if (num == 0) {
-                buffer[i++] = '0';
-            }
-            while (num != 0) {
-                int rem = num % 16;
-                if (rem < 10) {
-                    buffer[i++] = rem + '0';
-                } else {
-                    buffer[i++] = rem - 10 + 'a';
-                }
-                num /= 16;
-            }
-            while (i > 0) {
-                if (maxrem    < 1) {
-                // TODO: Set errno to EOVERFLOW.
-                return -1;
-            }
-            if (!print(&buffer[--i], 1))
-                return -1;
-            written++;
+		} else if (*format == 'l') {
+			format++;
+			spec.length = LENGTH_LONG;
+			if (*format == 'l') {
+				format++;
+				spec.length = LENGTH_LLONG;
 			}
+		} else if (*format == 'z') {
+			format++;
+			spec.length = LENGTH_LONG;
+		}
 
-		} else {
-			format = format_begun_at;
-			size_t len = strlen(format);
-			if (maxrem < len) {
-				// TODO: Set errno to EOVERFLOW.
-				return -1;
-			}
-			if (!print(format, len))
-				return -1;
-			written += len;
-			format += len;
+		char conversion = *format;
+		if (conversion != '\0')
+			format++;
+
+		switch (conversion) {
+		case '%':
+			format_put(out, "%", 1);
+			break;
+		case 'c': {
+			char c = (char) va_arg(args, int /* char promotes to int */);
+			spec.flags &= ~FLAG_ZERO;
+			format_field(out, &spec, NULL, 0, 0, &c, 1);
+			break;
+		}
+		case 's': {
+			const char* str = va_arg(args, const char*);
+			if (str == NULL)
+				str = "(null)";
+			// Only look as far as the precision allows, the string may not
+			// be terminated
+			size_t len = 0;
+			while (str[len] && (spec.precision < 0 || len < (size_t)spec.precision))
+				len++;
+			spec.flags &= ~FLAG_ZERO;
+			format_field(out, &spec, NULL, 0, 0, str, len);
+			break;
+		}
+		case 'd':
+		case 'i': {
+			int64_t value = format_signed_arg(&args, spec.length);
+			bool negative = value < 0;
+			format_integer(out, &spec, negative ? -(uint64_t)value : (uint64_t)value, negative, 10, false);
+			break;
+		}
+		case 'u':
+			format_integer(out, &spec, format_unsigned_arg(&args, spec.length), false, 10, false);
+			break;
+		case 'x':
+		case 'X':
+			format_integer(out, &spec, format_unsigned_arg(&args, spec.length), false, 16, conversion == 'X');
+			break;
+		case 'o':
+			format_integer(out, &spec, format_unsigned_arg(&args, spec.length), false, 8, false);
+			break;
+		case 'p':
+			// Pointers always print as 0x followed by all eight digits
+			spec.flags = (spec.flags & FLAG_LEFT) | FLAG_POINTER;
+			spec.precision = sizeof(void*) * 2;
+			format_integer(out, &spec, (uintptr_t) va_arg(args, void*), false, 16, false);
+			break;
+		default:
+			// Unknown conversion, print it as it was written
+			format_put(out, format_begun_at, format - format_begun_at);
+			break;
 		}
 	}
- 
+
+	va_end(args);
+
+	format_flush(out);
+	return out->total > INT_MAX ? INT_MAX : (int)out->total;
+}
+
+int vformat(format_sink_t sink, void* ctx, const char* __restrict__ format, va_list parameters) {
+	char chunk[FORMAT_CHUNK_SIZE];
+	struct format_out out;
+	out.buffer = chunk;
+	out.capacity = sizeof(chunk);
+	out.length = 0;
+	out.total = 0;
+	out.sink = sink;
+	out.ctx = ctx;
+	return format_engine(&out, format, parameters);
+}
+
+int vsnprintf(char* __restrict__ buffer, size_t size, const char* __restrict__ format, va_list parameters) {
+	// Leave room for the terminator
+	struct format_out out;
+	out.buffer = buffer;
+	out.capacity = size > 0 ? size - 1 : 0;
+	out.length = 0;
+	out.total = 0;
+	out.sink = NULL;
+	out.ctx = NULL;
+	int written = format_engine(&out, format, parameters);
+	if (size > 0)
+		buffer[out.length] = '\0';
+	return written;
+}
+
+int snprintf(char* __restrict__ buffer, size_t size, const char* __restrict__ format, ...) {
+	va_list parameters;
+	va_start(parameters, format);
+	int written = vsnprintf(buffer, size, format, parameters);
+	va_end(parameters);
+	return written;
+}
+
+int putchar(int ic) {
+	char c = (char) ic;
+	console_putc(c);
+	console_flush();
+	return ic;
+}
+
+bool print(const char* data, size_t length) {
+	console_write(data, length);
+	console_flush();
+	return true;
+}
+
+static void console_sink(void* ctx, const char* data, size_t length) {
+	console_write(data, length);
+}
+
+int vprintf(const char* __restrict__ format, va_list parameters) {
+	int written = vformat(console_sink, NULL, format, parameters);
+
+	// One cursor update per printf
+	console_flush();
+	return written;
+}
+
+int printf(const char* __restrict__ format, ...) {
+	va_list parameters;
+	va_start(parameters, format);
+	int written = vprintf(format, parameters);
 	va_end(parameters);
 	return written;
-}
\ No newline at end of file
+}
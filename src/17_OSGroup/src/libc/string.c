@@ -37,3 +37,43 @@ size_t strlen(const char* str) {
 	return len;
 }
 
+
+int strcmp(const char* a, const char* b) {
+	while (*a && *a == *b) {
+		a++;
+		b++;
+	}
+	return (unsigned char)*a - (unsigned char)*b;
+}
+
+int strncmp(const char* a, const char* b, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		if (a[i] != b[i] || a[i] == '\0')
+			return (unsigned char)a[i] - (unsigned char)b[i];
+	}
+	return 0;
+}
+
+char* strcpy(char* dest, const char* src) {
+	char* d = dest;
+	while ((*d++ = *src++) != '\0')
+		;
+	return dest;
+}
+
+char* strchr(const char* str, int c) {
+	for (; *str != (char)c; str++) {
+		if (*str == '\0')
+			return NULL;
+	}
+	return (char*)str;
+}
+
+char* strrchr(const char* str, int c) {
+	const char* last = NULL;
+	do {
+		if (*str == (char)c)
+			last = str;
+	} while (*str++ != '\0');
+	return (char*)last;
+}
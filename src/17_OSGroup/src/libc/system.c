@@ -19,7 +19,7 @@ void __stack_chk_fail()
 void _exit(int status)
 {
     char buffer[64] = {};
-    printf(buffer, sizeof(buffer), "Exit called with status %d\n", status);
+    snprintf(buffer, sizeof(buffer), "Exit called with status %d\n", status);
     panic(buffer);
     __builtin_unreachable();
 }
@@ -1,5 +1,6 @@
 #include "memory/memory.h"
 #include "libc/system.h"
+#include "klog.h"
 
 #define MAX_PAGE_ALIGNED_ALLOCS 32
 
@@ -83,7 +84,7 @@ char* pmalloc(size_t size)
         pheap_desc[i] = 1;
 
         // Print the allocated memory range
-        printf("PAllocated from 0x%x to 0x%x\n", pheap_begin + i*4096, pheap_begin + (i+1)*4096);
+        klog(KLOG_DEBUG, "PAllocated from 0x%x to 0x%x\n", pheap_begin + i*4096, pheap_begin + (i+1)*4096);
 
         // Return the address of the allocated page
         return (char *)(pheap_begin + i*4096);
@@ -105,7 +106,7 @@ void* malloc(size_t size)
     while((uint32_t)mem < last_alloc)
     {
         alloc_t *a = (alloc_t *)mem;
-        printf("mem=0x%x a={.status=%d, .size=%d}\n", mem, a->status, a->size);
+        klog(KLOG_DEBUG, "mem=0x%x a={.status=%d, .size=%d}\n", mem, a->status, a->size);
 
         if(!a->size)
             goto nalloc;
@@ -122,7 +123,7 @@ void* malloc(size_t size)
         if(a->size >= size)
         {
             a->status = 1;
-            printf("RE:Allocated %d bytes from 0x%x to 0x%x\n", size, mem + sizeof(alloc_t), mem + sizeof(alloc_t) + size);
+            klog(KLOG_DEBUG, "RE:Allocated %d bytes from 0x%x to 0x%x\n", size, mem + sizeof(alloc_t), mem + sizeof(alloc_t) + size);
             memset(mem + sizeof(alloc_t), 0, size);
             memory_used += size + sizeof(alloc_t);
             return (char *)(mem + sizeof(alloc_t));
@@ -152,7 +153,7 @@ void* malloc(size_t size)
     last_alloc += 4; // Alignment padding
 
     // Print the allocated memory range
-    printf("Allocated %d bytes from 0x%x to 0x%x\n", size, (uint32_t)alloc + sizeof(alloc_t), last_alloc);
+    klog(KLOG_DEBUG, "Allocated %d bytes from 0x%x to 0x%x\n", size, (uint32_t)alloc + sizeof(alloc_t), last_alloc);
 
     // Update the memory usage counter
     memory_used += size + 4 + sizeof(alloc_t);
@@ -50,3 +50,62 @@ void* memset (void * ptr, int value, size_t num )
 
     return ptr;               // Return the pointer to the block of memory
 }
+
+// Function to copy memory between regions that may overlap
+void* memmove(void* dest, const void* src, size_t count)
+{
+    uint8_t* dst8 = (uint8_t*)dest;
+    const uint8_t* src8 = (const uint8_t*)src;
+
+    if (dst8 == src8 || count == 0)
+        return dest;
+
+    // Copy 4 bytes at a time when both pointers are word aligned
+    bool aligned = (((uint32_t)dst8 | (uint32_t)src8) & 3) == 0;
+
+    if (dst8 < src8) {
+        // Destination is below the source, copy front to back
+        if (aligned) {
+            uint32_t* dst32 = (uint32_t*)dst8;
+            const uint32_t* src32 = (const uint32_t*)src8;
+            for (size_t i = 0; i < count / 4; i++)
+                dst32[i] = src32[i];
+            dst8 += count & ~3;
+            src8 += count & ~3;
+            count &= 3;
+        }
+        while (count--)
+            *dst8++ = *src8++;
+    } else {
+        // Destination is above the source, copy back to front
+        dst8 += count;
+        src8 += count;
+        if (aligned) {
+            // Trailing bytes first, so the rest stays word aligned
+            while (count & 3) {
+                *--dst8 = *--src8;
+                count--;
+            }
+            uint32_t* dst32 = (uint32_t*)dst8;
+            const uint32_t* src32 = (const uint32_t*)src8;
+            for (size_t i = count / 4; i > 0; i--)
+                *--dst32 = *--src32;
+            count = 0;
+        }
+        while (count--)
+            *--dst8 = *--src8;
+    }
+
+    return dest;              // Return the destination pointer
+}
+
+int memcmp(const void* a, const void* b, size_t count)
+{
+    const uint8_t* a8 = (const uint8_t*)a;
+    const uint8_t* b8 = (const uint8_t*)b;
+    for (size_t i = 0; i < count; i++) {
+        if (a8[i] != b8[i])
+            return a8[i] - b8[i];
+    }
+    return 0;
+}
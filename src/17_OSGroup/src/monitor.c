@@ -4,6 +4,8 @@
 
 #include "monitor.h"
 #include "libc/system.h"
+#include "interrupts.h"
+#include "memory/memory.h"
 
 enum vga_color {
 	VGA_COLOR_BLACK = 0,
@@ -24,14 +26,79 @@ enum vga_color {
 	VGA_COLOR_WHITE = 15,
 };
  
-static const size_t VGA_WIDTH = 80;
-static const size_t VGA_HEIGHT = 25;
+#define VGA_WIDTH 80
+#define VGA_HEIGHT 25
  
 uint16_t *video_memory = (uint16_t *)0xB8000;
 size_t terminal_row;
 size_t terminal_column;
 uint8_t terminal_color;
-uint16_t* terminal_buffer;
+
+// Size of the text grid, 80x25 for VGA text mode but larger on a framebuffer
+static size_t screen_cols = VGA_WIDTH;
+static size_t screen_rows = VGA_HEIGHT;
+
+// All drawing goes to a shadow copy of the screen in RAM. Its rows form a
+// ring: screen row y lives in shadow_buffer[(shadow_origin + y) % screen_rows],
+// so scrolling only advances the origin. Rows changed since the last flush
+// are marked in shadow_dirty and drawn by the backend in one go.
+static uint16_t shadow_buffer[MONITOR_MAX_ROWS][MONITOR_MAX_COLS];
+static size_t shadow_origin = 0;
+static uint64_t shadow_dirty = 0;
+#define ROW_BIT(y) ((uint64_t)1 << (y))
+#define ALL_ROWS_DIRTY (screen_rows == 64 ? ~(uint64_t)0 : ROW_BIT(screen_rows) - 1)
+
+// Lines scrolled since the last flush. Backends that can move their
+// contents do so, the others redraw every row.
+static size_t pending_scroll = 0;
+
+// Cursor position last handed to the backend
+static size_t cursor_x = (size_t)-1;
+static size_t cursor_y = (size_t)-1;
+
+// When set, flushing to the screen is left to the timer tick
+static volatile bool deferred_flush = false;
+static bool flush_handler_registered = false;
+
+// VGA text mode backend: rows are copied to video memory as they are
+static void vga_draw_row(size_t y, const uint16_t* cells, size_t cols)
+{
+    // A row is 160 bytes, copy it as 32-bit words
+    const uint32_t* src = (const uint32_t*)cells;
+    uint32_t* dst = (uint32_t*)(video_memory + y * VGA_WIDTH);
+    for (size_t i = 0; i < cols / 2; i++)
+        dst[i] = src[i];
+}
+
+// Updates the hardware cursor.
+static void vga_set_cursor(size_t x, size_t y)
+{
+    // The screen is 80 characters wide...
+    uint16_t pos = y * VGA_WIDTH + x;
+
+	outb(0x3D4, 0x0F);
+	outb(0x3D5, (uint8_t) (pos & 0xFF));
+	outb(0x3D4, 0x0E);
+	outb(0x3D5, (uint8_t) ((pos >> 8) & 0xFF));
+}
+
+static const struct monitor_backend vga_backend = {
+    .draw_row = vga_draw_row,
+    .scroll = NULL,
+    .set_cursor = vga_set_cursor,
+    .soft_cursor = false,
+};
+
+static const struct monitor_backend* backend = &vga_backend;
+
+// Shadow row that is currently shown at screen row y
+static inline uint16_t* shadow_row(size_t y)
+{
+    size_t row = shadow_origin + y;
+    if (row >= screen_rows)
+        row -= screen_rows;
+    return shadow_buffer[row];
+}
 
 // Scrolls the text on the screen up by one line.
 static void scroll()
@@ -41,41 +108,98 @@ static void scroll()
     uint8_t attributeByte = (0 /*black*/ << 4) | (15 /*white*/ & 0x0F);
     uint16_t blank = 0x20 /* space */ | (attributeByte << 8);
 
-    // Row 25 is the end, this means we need to scroll up
-    if(terminal_row >= 25)
+    // The last row is the end, this means we need to scroll up
+    if(terminal_row >= screen_rows)
     {
-        // Move the current text chunk that makes up the screen
-        // back in the buffer by a line
-        int i;
-        for (i = 0*80; i < 24*80; i++)
-        {
-            terminal_buffer[i] = terminal_buffer[i+80];
-        }
+        // The old top row becomes the new bottom row
+        shadow_origin = (shadow_origin + 1) % screen_rows;
+
+        // The last line should now be blank.
+        memset16(shadow_row(screen_rows - 1), blank, screen_cols);
+
+        // Dirty rows move up with their contents, the new last row is dirty
+        shadow_dirty = (shadow_dirty >> 1) | ROW_BIT(screen_rows - 1);
+        pending_scroll++;
 
-        // The last line should now be blank. Do this by writing
-        // 80 spaces to it.
-        for (i = 24*80; i < 25*80; i++)
-        {
-    
-            terminal_buffer[i] = blank;
-        }
         // The cursor should now be on the last line.
-        terminal_row = 24;
+        terminal_row = screen_rows - 1;
     }
 }
 
+// Draws every dirty row from the shadow buffer and updates the cursor.
+// Must not be interrupted by other output.
+static void flush_locked()
+{
+    if (pending_scroll != 0) {
+        if (backend->scroll != NULL && pending_scroll < screen_rows) {
+            backend->scroll(pending_scroll);
+            // A soft cursor moved up with the pixels, redraw the row it landed on
+            if (backend->soft_cursor && cursor_y < screen_rows && cursor_y >= pending_scroll)
+                shadow_dirty |= ROW_BIT(cursor_y - pending_scroll);
+        } else {
+            shadow_dirty = ALL_ROWS_DIRTY;
+        }
+        pending_scroll = 0;
+    }
 
+    // A backend that draws its own cursor paints it over the row contents,
+    // so the rows under the old and the new cursor have to be redrawn
+    bool cursor_moved = terminal_column != cursor_x || terminal_row != cursor_y;
+    if (cursor_moved && backend->soft_cursor) {
+        if (cursor_y < screen_rows)
+            shadow_dirty |= ROW_BIT(cursor_y);
+        shadow_dirty |= ROW_BIT(terminal_row);
+    }
+    bool cursor_row_drawn = (shadow_dirty & ROW_BIT(terminal_row)) != 0;
 
-// Updates the hardware cursor.
-static void move_cursor()
+    uint64_t dirty = shadow_dirty;
+    shadow_dirty = 0;
+
+    for (size_t y = 0; dirty != 0; y++, dirty >>= 1) {
+        if (dirty & 1)
+            backend->draw_row(y, shadow_row(y), screen_cols);
+    }
+
+    if (cursor_moved || (backend->soft_cursor && cursor_row_drawn)) {
+        cursor_x = terminal_column;
+        cursor_y = terminal_row;
+        backend->set_cursor(cursor_x, cursor_y);
+    }
+}
+
+void monitor_flush()
 {
-    // The screen is 80 characters wide...
-    uint16_t pos = terminal_row * 80 + terminal_column;
+    uint32_t flags = interrupts_save();
+    flush_locked();
+    interrupts_restore(flags);
+}
 
-	outb(0x3D4, 0x0F);
-	outb(0x3D5, (uint8_t) (pos & 0xFF));
-	outb(0x3D4, 0x0E);
-	outb(0x3D5, (uint8_t) ((pos >> 8) & 0xFF));
+// Timer tick: pushes the changes of the last tick to the screen
+static int monitor_tick(registers_t* regs, void* context)
+{
+    if (deferred_flush)
+        flush_locked();
+    return IRQ_NONE;
+}
+
+void monitor_set_deferred(bool deferred)
+{
+    if (deferred && !flush_handler_registered) {
+        register_irq_handler(IRQ0, monitor_tick, NULL);
+        flush_handler_registered = true;
+    }
+    deferred_flush = deferred;
+
+    // Leaving deferred mode, show whatever is still pending
+    if (!deferred)
+        monitor_flush();
+}
+
+// Pushes changes to the screen right away unless the timer does it
+static void monitor_sync()
+{
+    if (!deferred_flush)
+        flush_locked();
 }
 
 
@@ -89,18 +213,54 @@ static inline uint16_t vga_entry(unsigned char uc, uint8_t color)
 	return (uint16_t) uc | (uint16_t) color << 8;
 }
 
+// Blanks the shadow buffer and marks every row for redrawing
+static void clear_shadow(uint16_t blank)
+{
+	shadow_origin = 0;
+	pending_scroll = 0;
+	for (size_t y = 0; y < screen_rows; y++) {
+		memset16(shadow_row(y), blank, screen_cols);
+	}
+	shadow_dirty = ALL_ROWS_DIRTY;
+}
+
 void monitor_initialize(void) 
 {
 	terminal_row = 0;
 	terminal_column = 0;
 	terminal_color = vga_entry_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
-	terminal_buffer = video_memory;
-	for (size_t y = 0; y < VGA_HEIGHT; y++) {
-		for (size_t x = 0; x < VGA_WIDTH; x++) {
-			const size_t index = y * VGA_WIDTH + x;
-			terminal_buffer[index] = vga_entry(' ', terminal_color);
-		}
+	clear_shadow(vga_entry(' ', terminal_color));
+	monitor_flush();
+}
+
+void monitor_set_backend(const struct monitor_backend* new_backend, size_t cols, size_t rows)
+{
+	if (new_backend == NULL) {
+		new_backend = &vga_backend;
+		cols = VGA_WIDTH;
+		rows = VGA_HEIGHT;
 	}
+	if (cols > MONITOR_MAX_COLS)
+		cols = MONITOR_MAX_COLS;
+	if (rows > MONITOR_MAX_ROWS)
+		rows = MONITOR_MAX_ROWS;
+
+	uint32_t flags = interrupts_save();
+	backend = new_backend;
+	screen_cols = cols;
+	screen_rows = rows;
+	terminal_row = 0;
+	terminal_column = 0;
+	cursor_x = cursor_y = (size_t)-1;
+	clear_shadow(vga_entry(' ', terminal_color));
+	flush_locked();
+	interrupts_restore(flags);
+}
+
+void monitor_get_size(size_t* cols, size_t* rows)
+{
+	*cols = screen_cols;
+	*rows = screen_rows;
 }
  
 void monitor_setcolor(uint8_t color) 
@@ -110,12 +270,13 @@ void monitor_setcolor(uint8_t color)
  
 void monitor_putentryat(char c, uint8_t color, size_t x, size_t y) 
 {
-	const size_t index = y * VGA_WIDTH + x;
-	terminal_buffer[index] = vga_entry(c, color);
+	shadow_row(y)[x] = vga_entry(c, color);
+	shadow_dirty |= ROW_BIT(y);
 }
 
 
 
+
  
 void _monitor_put(char c) 
 {
@@ -128,36 +289,71 @@ void _monitor_put(char c)
         scroll();
 		return;
 		break;
+	case '\b':
+		// Step back over the previous character, onto the previous row if
+		// need be. Erasing it is up to the caller ("\b \b").
+		if (terminal_column > 0) {
+			terminal_column--;
+		} else if (terminal_row > 0) {
+			terminal_row--;
+			terminal_column = screen_cols - 1;
+		}
+		return;
 	default:
 		break;
 	}
 
 	monitor_putentryat(c, terminal_color, terminal_column, terminal_row);
-	if (++terminal_column == VGA_WIDTH) {
+	if (++terminal_column == screen_cols) {
 		terminal_column = 0;
-		if (++terminal_row == VGA_HEIGHT)
-			terminal_row = 0;
+		terminal_row++;
+		scroll();
 	}
 }
 
 void monitor_put(char c) 
 {
+	// The timer tick may flush at any point, keep it out while the shadow
+	// buffer is in flux
+	uint32_t flags = interrupts_save();
 	_monitor_put(c);
     // Scroll the screen if needed.
     scroll();
-    // Move the hardware cursor.
-    move_cursor();
+    // Show the change and move the hardware cursor.
+    monitor_sync();
+	interrupts_restore(flags);
 }
  
 void monitor_write(const char* data, size_t size) 
 {
-	for (size_t i = 0; i < size; i++)
-		_monitor_put(data[i]);
-    
-    // Scroll the screen if needed.
-    scroll();
-    // Move the hardware cursor.
-    move_cursor();
+	uint32_t flags = interrupts_save();
+
+	size_t i = 0;
+	while (i < size) {
+		if (data[i] == '\n' || data[i] == '\b') {
+			_monitor_put(data[i++]);
+			continue;
+		}
+
+		// Copy the run of characters that fits on the current row
+		uint16_t* cell = shadow_row(terminal_row) + terminal_column;
+		size_t room = screen_cols - terminal_column;
+		size_t n = 0;
+		while (n < room && i < size && data[i] != '\n' && data[i] != '\b')
+			cell[n++] = vga_entry(data[i++], terminal_color);
+		shadow_dirty |= ROW_BIT(terminal_row);
+
+		terminal_column += n;
+		if (terminal_column == screen_cols) {
+			terminal_column = 0;
+			terminal_row++;
+			scroll();
+		}
+	}
+
+    // Show the change and move the hardware cursor, once for the whole run.
+    monitor_sync();
+	interrupts_restore(flags);
 }
  
 void monitor_writestring(const char* data) 
@@ -175,16 +371,14 @@ void monitor_clear()
     uint8_t attributeByte = (0 /*black*/ << 4) | (15 /*white*/ & 0x0F);
     uint16_t blank = 0x20 /* space */ | (attributeByte << 8);
 
-    int i;
-    for (i = 0; i < 80*25; i++)
-    {
-        terminal_buffer[i] = blank;
-    }
+    uint32_t flags = interrupts_save();
+    clear_shadow(blank);
 
     // Move the hardware cursor back to the start.
     terminal_row = 0;
     terminal_column = 0;
-    move_cursor();
+    monitor_sync();
+    interrupts_restore(flags);
 }
 
 
@@ -9,21 +9,24 @@ header_start:
     dd header_end - header_start 	                                ; Header length
     dd 0x100000000 - (0xe85250d6 + 0 + (header_end - header_start)) ; Checksum
 
-;align 8
-;framebuffer_tag_start:
-;    dw 5                                              ; type
-;    dw 1                                              ; flags
-;    dd framebuffer_tag_end - framebuffer_tag_start    ; size
-;    dd 800                                            ; width
-;    dd 600                                            ; height
-;    dd 32                                             ; depth
-;framebuffer_tag_end:
+%ifdef CONFIG_FRAMEBUFFER
+; Ask for a linear framebuffer for the graphical console (fbcon.c)
+align 8
+framebuffer_tag_start:
+    dw 5                                              ; type
+    dw 1                                              ; flags (optional)
+    dd framebuffer_tag_end - framebuffer_tag_start    ; size
+    dd 800                                            ; width
+    dd 600                                            ; height
+    dd 32                                             ; depth
+framebuffer_tag_end:
+%endif
 
 align 8
     ; Required end tag:
     dw 0	; type
     dw 0	; flags
-    dw 8	; size
+    dd 8	; size
 header_end:
 
 section .text
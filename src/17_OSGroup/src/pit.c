@@ -1,12 +1,53 @@
 #include "pit.h"
 #include "interrupts.h"
 #include "common.h"
+#include "idle.h"
 
-static uint32_t ticks = 0;  // Variable to keep track of the number of ticks
+static volatile uint32_t ticks = 0;  // Variable to keep track of the number of ticks
+
+#ifdef CONFIG_IRQ_STATS
+// Timer jitter: spread of the TSC time between consecutive ticks
+static uint64_t last_tick_tsc = 0;
+static uint32_t min_tick_period = 0xFFFFFFFF;
+static uint32_t max_tick_period = 0;
+
+static void pit_track_jitter() {
+    uint64_t now = read_tsc();
+    if (last_tick_tsc != 0) {
+        uint32_t period = (uint32_t)(now - last_tick_tsc);
+        if (period < min_tick_period)
+            min_tick_period = period;
+        if (period > max_tick_period)
+            max_tick_period = period;
+    }
+    last_tick_tsc = now;
+}
+
+void pit_jitter_reset() {
+    uint32_t flags = interrupts_save();
+    last_tick_tsc = 0;
+    min_tick_period = 0xFFFFFFFF;
+    max_tick_period = 0;
+    interrupts_restore(flags);
+}
+
+void pit_jitter_report() {
+    if (max_tick_period == 0) {
+        printf("Timer jitter: no samples\n");
+        return;
+    }
+    printf("Timer period (TSC cycles): min=%d max=%d jitter=%d\n",
+           min_tick_period, max_tick_period, max_tick_period - min_tick_period);
+}
+#endif
 
 // IRQ handler function for the PIT (Programmable Interval Timer)
-void pit_irq_handler(registers_t* regs, void* context) {
+int pit_irq_handler(registers_t* regs, void* context) {
     ticks++;  // Increment the tick count on each timer interrupt
+#ifdef CONFIG_IRQ_STATS
+    pit_track_jitter();
+#endif
+    return IRQ_HANDLED;
 }
 
 // Function to initialize the PIT
@@ -14,16 +55,29 @@ void init_pit() {
     // Register the IRQ handler for the PIT (IRQ0)
     register_irq_handler(IRQ0, pit_irq_handler, NULL);
 
+    pit_set_divisor(DIVIDER);
+}
+
+void pit_set_divisor(uint16_t divisor) {
+    uint32_t flags = interrupts_save();
+
     // Send the command byte to the PIT command port
     outb(PIT_CMD_PORT, 0x36);
 
-    // Calculate the frequency divisor for the desired timer frequency
-    uint8_t l_divisor = (uint8_t)(PIT_BASE_FREQUENCY / TARGET_FREQUENCY);
-    uint8_t h_divisor = (uint8_t)((PIT_BASE_FREQUENCY / TARGET_FREQUENCY) >> 8);
-
     // Send the frequency divisor to the PIT channel 0 data port
-    outb(PIT_CHANNEL0_PORT, l_divisor);  // Lower byte of divisor
-    outb(PIT_CHANNEL0_PORT, h_divisor);  // Upper byte of divisor
+    outb(PIT_CHANNEL0_PORT, (uint8_t)(divisor & 0xFF));  // Lower byte of divisor
+    outb(PIT_CHANNEL0_PORT, (uint8_t)(divisor >> 8));    // Upper byte of divisor
+
+    interrupts_restore(flags);
+}
+
+void pit_reset_divisor() {
+    pit_set_divisor(DIVIDER);
+}
+
+// Number of timer ticks (milliseconds) since the PIT was started
+uint32_t pit_get_ticks() {
+    return ticks;
 }
 
 // Function to sleep for a specified number of milliseconds using interrupts
@@ -35,8 +89,8 @@ void sleep_interrupt(uint32_t milliseconds){
     while (current_tick < end_ticks) {
         // Enable interrupts (sti)
         asm volatile("sti");
-        // Halt the CPU until the next interrupt (hlt)
-        asm volatile("hlt");
+        // Do background work, then halt the CPU until the next interrupt
+        idle();
         current_tick = ticks;  // Update the current tick count
     }
 }
@@ -53,3 +107,17 @@ void sleep_busy(uint32_t milliseconds){
         elapsed_ticks++;  // Increment the elapsed tick count
     }
 }
+
+uint32_t pit_tsc_per_ms() {
+    static uint32_t cycles = 0;
+    if (cycles == 0) {
+        // Start and end on tick edges so the whole tick is measured
+        uint32_t start_tick = ticks;
+        while (ticks == start_tick) {}
+        uint64_t start = read_tsc();
+        start_tick = ticks;
+        while (ticks == start_tick) {}
+        cycles = (uint32_t)(read_tsc() - start) / TICKS_PER_MS;
+    }
+    return cycles;
+}
@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""Check a FAT32 image independently of the kernel's driver.
+
+The image is a whole-disk filesystem or an MBR disk with it in the first
+partition. Fails on FAT copies that differ, broken or cross-linked chains, chains
+that do not match the file size, bad long name checksums, clusters in use
+that nothing owns, and an FSInfo free count that is wrong. Prints every
+file with the MD5 of its contents.
+"""
+
+import hashlib
+import struct
+import sys
+
+image = open(sys.argv[1], "rb").read()
+if image[82:90] != b"FAT32   ":
+    # A partitioned disk, take the first partition
+    start = struct.unpack_from("<I", image, 446 + 8)[0]
+    image = image[start * 512:]
+SECTOR, PER_CLUSTER, RESERVED, FATS = struct.unpack_from("<HBHB", image, 11)
+SECTORS = struct.unpack_from("<I", image, 32)[0]
+FAT_SECTORS = struct.unpack_from("<I", image, 36)[0]
+ROOT = struct.unpack_from("<I", image, 44)[0]
+FSINFO = struct.unpack_from("<H", image, 48)[0]
+
+fats = [image[(RESERVED + i * FAT_SECTORS) * SECTOR:(RESERVED + (i + 1) * FAT_SECTORS) * SECTOR]
+        for i in range(FATS)]
+assert all(fat == fats[0] for fat in fats), "FAT copies differ"
+fat = struct.unpack("<%dI" % (len(fats[0]) // 4), fats[0])
+
+DATA = RESERVED + FATS * FAT_SECTORS
+CLUSTERS = (SECTORS - DATA) // PER_CLUSTER
+CLUSTER_SIZE = PER_CLUSTER * SECTOR
+owners = {}
+
+
+def chain(cluster, owner):
+    clusters = []
+    while 2 <= cluster < CLUSTERS + 2:
+        assert cluster not in owners, "cluster %d in %s and %s" % (cluster, owner, owners[cluster])
+        owners[cluster] = owner
+        clusters.append(cluster)
+        following = fat[cluster] & 0x0FFFFFFF
+        if following >= 0x0FFFFFF8:
+            break
+        assert following >= 2, "%s: bad chain at %d -> %x" % (owner, cluster, following)
+        cluster = following
+    return clusters
+
+
+def contents(clusters):
+    return b"".join(image[(DATA + (c - 2) * PER_CLUSTER) * SECTOR:(DATA + (c - 1) * PER_CLUSTER) * SECTOR]
+                    for c in clusters)
+
+
+def checksum(short_name):
+    total = 0
+    for byte in short_name:
+        total = (((total & 1) << 7) + (total >> 1) + byte) & 0xFF
+    return total
+
+
+def walk(cluster, path):
+    raw = contents(chain(cluster, path or "/"))
+    long_name = {}
+    long_checksum = None
+    for offset in range(0, len(raw), 32):
+        entry = raw[offset:offset + 32]
+        if entry[0] == 0:
+            break
+        if entry[0] == 0xE5:
+            long_name = {}
+            continue
+        if entry[11] & 0x3F == 0x0F:
+            long_checksum = entry[13]
+            chars = entry[1:11] + entry[14:26] + entry[28:32]
+            long_name[entry[0] & 0x1F] = chars.decode("utf-16le")
+            continue
+        if entry[11] & 0x08:
+            continue
+
+        short_name = entry[:11]
+        if long_name:
+            assert long_checksum == checksum(short_name), "long name checksum of %s" % short_name
+            name = "".join(long_name[k] for k in sorted(long_name)).split("\0")[0]
+        else:
+            base = short_name[:8].decode().rstrip()
+            extension = short_name[8:].decode().rstrip()
+            name = base + ("." + extension if extension else "")
+        long_name = {}
+        if name in (".", ".."):
+            continue
+
+        first = struct.unpack_from("<H", entry, 20)[0] << 16 | struct.unpack_from("<H", entry, 26)[0]
+        size = struct.unpack_from("<I", entry, 28)[0]
+        child = path + "/" + name
+        if entry[11] & 0x10:
+            print("D", child)
+            walk(first, child)
+        else:
+            clusters = chain(first, child) if first else []
+            assert len(clusters) == (size + CLUSTER_SIZE - 1) // CLUSTER_SIZE, \
+                "%s: %d clusters for %d bytes" % (child, len(clusters), size)
+            print("F", child, size, hashlib.md5(contents(clusters)[:size]).hexdigest())
+
+
+walk(ROOT, "")
+free = sum(1 for c in range(2, CLUSTERS + 2) if fat[c] & 0x0FFFFFFF == 0)
+leaked = [c for c in range(2, CLUSTERS + 2) if fat[c] & 0x0FFFFFFF and c not in owners]
+assert not leaked, "%d clusters in use by nothing, the first is %d" % (len(leaked), leaked[0])
+recorded = struct.unpack_from("<I", image, FSINFO * SECTOR + 488)[0]
+assert recorded in (free, 0xFFFFFFFF), "FSInfo says %d free clusters, there are %d" % (recorded, free)
+print("free clusters", free)
@@ -0,0 +1,229 @@
+// Runs the FAT32 driver, with the block layer and buffer cache under it,
+// against a disk image file:
+//
+//   fat32_test write  <image> [nocache]   fill an empty filesystem
+//   fat32_test verify <image> [nocache]   read it back, then delete some
+//   fat32_test refuse <image>             check that it does not mount
+//
+// The image is loaded into memory, served by a block device and written
+// back when the filesystem has been unmounted. nocache drops the in-memory
+// FAT after mounting, so every FAT access goes through the buffer cache.
+#include "fs/fat32.h"
+#include "bcache.h"
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            printf("%s:%d: %s failed\n", __FILE__, __LINE__, #condition); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define BIG_FILE_SIZE 300000
+#define TRACKS        40
+
+static uint8_t* disk;
+
+static bool disk_read(blockdev_t* dev, uint32_t lba, uint32_t count, void* buffer) {
+    memcpy(buffer, disk + lba * BLOCKDEV_SECTOR_SIZE, count * BLOCKDEV_SECTOR_SIZE);
+    return true;
+}
+
+static bool disk_write(blockdev_t* dev, uint32_t lba, uint32_t count, const void* buffer) {
+    memcpy(disk + lba * BLOCKDEV_SECTOR_SIZE, buffer, count * BLOCKDEV_SECTOR_SIZE);
+    return true;
+}
+
+static bool disk_transfer(blockdev_t* dev, bool write, uint32_t lba, const blockdev_segment_t* segments,
+                          uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (write)
+            disk_write(dev, lba, segments[i].sectors, segments[i].buffer);
+        else
+            disk_read(dev, lba, segments[i].sectors, segments[i].buffer);
+        lba += segments[i].sectors;
+    }
+    return true;
+}
+
+static blockdev_t dev = {
+    .name = "img",
+    .max_sectors = 256,
+    .read = disk_read,
+    .write = disk_write,
+    .transfer = disk_transfer,
+    .max_segments = BLOCKDEV_MAX_SEGMENTS,
+};
+
+static fat32_fs_t fs;
+static uint8_t expected[BIG_FILE_SIZE];
+static uint8_t data[BIG_FILE_SIZE];
+
+// The same pseudo-random bytes in both runs
+static void make_expected() {
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < BIG_FILE_SIZE; i++) {
+        seed = seed * 1103515245 + 12345;
+        expected[i] = seed >> 16;
+    }
+}
+
+static uint32_t next_random() {
+    static uint32_t seed = 7;
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static void write_file(const char* path, const void* buffer, uint32_t size) {
+    fat32_file_t file;
+    CHECK(fat32_create(&fs, path, &file));
+    CHECK(fat32_write(&file, buffer, size) == (int32_t)size);
+    CHECK(fat32_close(&file));
+}
+
+static void fill() {
+    write_file("/hello.txt", "Hello, world!\n", 14);
+    write_file("README.TXT", "readme", 6);
+    CHECK(fat32_mkdir(&fs, "/Songs"));
+    CHECK(!fat32_mkdir(&fs, "/songs"));
+    CHECK(fat32_mkdir(&fs, "/Songs/Deep"));
+
+    // Written in pieces of odd sizes
+    fat32_file_t file;
+    CHECK(fat32_create(&fs, "/Songs/A Long File Name With Spaces.mid", &file));
+    for (uint32_t done = 0; done < BIG_FILE_SIZE;) {
+        uint32_t size = 1 + next_random() % 7000;
+        if (size > BIG_FILE_SIZE - done)
+            size = BIG_FILE_SIZE - done;
+        CHECK(fat32_write(&file, expected + done, size) == (int32_t)size);
+        done += size;
+    }
+    CHECK(fat32_close(&file));
+
+    // Enough long names to grow the directory and number the short aliases
+    for (int i = 0; i < TRACKS; i++) {
+        char path[64];
+        char text[16];
+        snprintf(path, sizeof(path), "/Songs/Deep/track number %02d.song", i);
+        write_file(path, text, snprintf(text, sizeof(text), "track %d", i));
+    }
+
+    // Two files growing at once end up in alternating clusters
+    fat32_file_t a, b;
+    CHECK(fat32_create(&fs, "/frag_a.bin", &a));
+    CHECK(fat32_create(&fs, "/frag_b.bin", &b));
+    for (int i = 0; i < 200; i++) {
+        CHECK(fat32_write(&a, expected + i * 600, 600) == 600);
+        CHECK(fat32_write(&b, expected + i * 700, 700) == 700);
+    }
+    CHECK(a.extent_count > 100);
+    CHECK(fat32_close(&a));
+    CHECK(fat32_close(&b));
+
+    CHECK(fat32_remove(&fs, "/Songs/Deep/track number 05.song"));
+    CHECK(!fat32_remove(&fs, "/Songs/Deep"));
+    write_file("/hello.txt", "Hi again\n", 9);
+    CHECK(fat32_mkdir(&fs, "/empty"));
+    CHECK(fat32_remove(&fs, "/empty"));
+}
+
+static void verify() {
+    fat32_dir_t dir;
+    static struct fat32_entry entry;
+    CHECK(fat32_opendir(&fs, "/", &dir));
+    uint32_t entries = 0;
+    while (fat32_readdir(&dir, &entry))
+        entries++;
+    fat32_closedir(&dir);
+    CHECK(entries == 5);
+
+    // Whole, then at random places
+    fat32_file_t file;
+    CHECK(fat32_open(&fs, "/songs/a long file name with spaces.MID", &file));
+    CHECK(fat32_read(&file, data, BIG_FILE_SIZE) == BIG_FILE_SIZE);
+    CHECK(memcmp(data, expected, BIG_FILE_SIZE) == 0);
+    for (int i = 0; i < 2000; i++) {
+        uint32_t position = next_random() % BIG_FILE_SIZE;
+        uint32_t size = next_random() % 3000;
+        uint32_t left = BIG_FILE_SIZE - position;
+        CHECK(fat32_seek(&file, position));
+        CHECK(fat32_read(&file, data, size) == (int32_t)(size < left ? size : left));
+        CHECK(memcmp(data, expected + position, size < left ? size : left) == 0);
+    }
+    CHECK(fat32_close(&file));
+
+    // Seeks in a fragmented file go through the binary search
+    CHECK(fat32_open(&fs, "frag_b.bin", &file));
+    CHECK(file.extent_count > 100);
+    for (int i = 0; i < 2000; i++) {
+        uint32_t position = next_random() % 140000;
+        CHECK(fat32_seek(&file, position));
+        CHECK(fat32_read(&file, data, 1) == 1);
+        CHECK(data[0] == expected[position]);
+    }
+    CHECK(fat32_close(&file));
+
+    // Short aliases, dot entries, and what was deleted
+    CHECK(fat32_open(&fs, "/Songs/Deep/TRACKN~3.SON", &file));
+    CHECK(fat32_close(&file));
+    CHECK(!fat32_open(&fs, "/Songs/Deep/track number 05.song", &file));
+    CHECK(fat32_open(&fs, "/Songs/Deep/../Deep/./track number 39.song", &file));
+    char text[16] = { 0 };
+    CHECK(fat32_read(&file, text, sizeof(text) - 1) == 8 && strcmp(text, "track 39") == 0);
+    CHECK(fat32_close(&file));
+
+    // After the first scan, lookups in a directory come from its hash
+    for (int i = 0; i < TRACKS; i++) {
+        char path[64];
+        snprintf(path, sizeof(path), "/Songs/Deep/track number %02d.song", i);
+        CHECK(fat32_open(&fs, path, &file) == (i != 5));
+        if (i != 5)
+            CHECK(fat32_close(&file));
+    }
+    CHECK(fs.stats.hashed > fs.stats.lookups * 9 / 10);
+    printf("%u lookups, %u hashed, %u directory scans, %u seeks, %u binary searches\n", fs.stats.lookups,
+           fs.stats.hashed, fs.stats.scans, fs.stats.seeks, fs.stats.searches);
+
+    uint32_t free_clusters = fs.free_clusters;
+    CHECK(fat32_remove(&fs, "/frag_a.bin"));
+    CHECK(fs.free_clusters == free_clusters + (120000 + fs.cluster_size - 1) / fs.cluster_size);
+}
+
+int main(int argc, char** argv) {
+    CHECK(argc >= 3);
+    FILE* image = fopen(argv[2], "r+b");
+    CHECK(image != NULL);
+    fseek(image, 0, SEEK_END);
+    dev.sectors = ftell(image) / BLOCKDEV_SECTOR_SIZE;
+    rewind(image);
+    disk = malloc(dev.sectors * BLOCKDEV_SECTOR_SIZE);
+    CHECK(fread(disk, BLOCKDEV_SECTOR_SIZE, dev.sectors, image) == dev.sectors);
+
+    blockdev_register(&dev);
+    init_block();
+    init_bcache();
+    if (strcmp(argv[1], "refuse") == 0) {
+        CHECK(!fat32_mount(&fs, &dev));
+        printf("not mounted\n");
+        return 0;
+    }
+    CHECK(fat32_mount(&fs, &dev));
+    if (argc > 3 && strcmp(argv[3], "nocache") == 0) {
+        free(fs.fat);
+        fs.fat = NULL;
+    }
+    printf("%u clusters of %u bytes, %u free, label %s, FAT %s\n", fs.clusters, fs.cluster_size,
+           fs.free_clusters, fs.label, fs.fat != NULL ? "in memory" : "through the cache");
+
+    make_expected();
+    if (strcmp(argv[1], "write") == 0)
+        fill();
+    else
+        verify();
+    CHECK(fat32_unmount(&fs));
+
+    rewind(image);
+    CHECK(fwrite(disk, BLOCKDEV_SECTOR_SIZE, dev.sectors, image) == dev.sectors);
+    fclose(image);
+    return 0;
+}
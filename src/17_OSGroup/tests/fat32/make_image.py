@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+"""Write an empty 32 MiB FAT32 image laid out the way mkfs.fat -F 32 does.
+
+For machines without dosfstools, run.sh uses mkfs.fat itself when it is
+there, as the create-fat32-disk target does. The layout: 512-byte
+sectors, one sector per cluster, 32 reserved sectors with FSInfo in
+sector 1 and the backup boot sector in sector 6, two FATs, root directory
+in cluster 2, no partition table. With --mbr the filesystem goes in the
+first partition of an MBR disk instead, starting at sector 2048.
+"""
+
+import struct
+import sys
+
+SECTOR = 512
+SECTORS = 32 * 1024 * 1024 // SECTOR
+RESERVED = 32
+FATS = 2
+PER_CLUSTER = 1
+PARTITION_START = 2048
+
+
+def fat_size():
+    # The FAT has to cover the clusters that are left once it is placed
+    size = 1
+    while True:
+        clusters = (SECTORS - RESERVED - FATS * size) // PER_CLUSTER
+        need = ((clusters + 2) * 4 + SECTOR - 1) // SECTOR
+        if need <= size:
+            return size, clusters
+        size = need
+
+
+def main(path, mbr):
+    fat_sectors, clusters = fat_size()
+    image = bytearray(SECTORS * SECTOR)
+
+    boot = bytearray(SECTOR)
+    boot[0:3] = b"\xeb\x58\x90"
+    boot[3:11] = b"mkfs.fat"
+    struct.pack_into("<HBHBHHBHHHII", boot, 11, SECTOR, PER_CLUSTER, RESERVED, FATS,
+                     0, 0, 0xF8, 0, 32, 8, 0, SECTORS)
+    struct.pack_into("<IHHIHH", boot, 36, fat_sectors, 0, 0, 2, 1, 6)
+    boot[64] = 0x80
+    boot[66] = 0x29
+    struct.pack_into("<I", boot, 67, 0x12345678)
+    boot[71:82] = b"NO NAME    "
+    boot[82:90] = b"FAT32   "
+    boot[510:512] = b"\x55\xaa"
+
+    fsinfo = bytearray(SECTOR)
+    struct.pack_into("<I", fsinfo, 0, 0x41615252)
+    struct.pack_into("<I", fsinfo, 484, 0x61417272)
+    struct.pack_into("<II", fsinfo, 488, clusters - 1, 2)
+    fsinfo[510:512] = b"\x55\xaa"
+
+    image[0:SECTOR] = boot
+    image[SECTOR:2 * SECTOR] = fsinfo
+    image[6 * SECTOR:7 * SECTOR] = boot
+    image[7 * SECTOR:8 * SECTOR] = fsinfo
+
+    # Media byte, end-of-chain marker, and the root directory's one cluster
+    for fat in range(FATS):
+        struct.pack_into("<III", image, (RESERVED + fat * fat_sectors) * SECTOR,
+                         0x0FFFFFF8, 0x0FFFFFFF, 0x0FFFFFF8)
+
+    if mbr:
+        table = bytearray(PARTITION_START * SECTOR)
+        struct.pack_into("<B3sB3sII", table, 446, 0, b"\0\0\0", 0x0C, b"\0\0\0", PARTITION_START, SECTORS)
+        table[510:512] = b"\x55\xaa"
+        struct.pack_into("<I", image, 28, PARTITION_START)     # Hidden sectors
+        image[6 * SECTOR:7 * SECTOR] = image[0:SECTOR]
+        image = table + image
+
+    with open(path, "wb") as f:
+        f.write(image)
+
+
+if __name__ == "__main__":
+    main(sys.argv[1], "--mbr" in sys.argv[2:])
@@ -0,0 +1,64 @@
+#!/bin/sh
+# Build the FAT32 driver for the host and run it against fresh images:
+# with the FAT in memory, with it read through the buffer cache, and in a
+# partition. Each image is checked by check_image.py, and by fsck.fat when
+# dosfstools is installed. Last, an image whose BPB claims a FAT big enough
+# to overflow the size sums must not mount.
+#
+# The images come from mkfs.fat -F 32 like the create-fat32-disk target
+# makes them. Without mkfs.fat, make_image.py writes the same layout.
+set -e
+here=$(dirname "$0")
+root=$here/../..
+work=${TMPDIR:-/tmp}/fat32_test
+mkdir -p "$work"
+
+# The kernel's headers, with the host stand-ins in tests/host over them
+rm -rf "$work/include"
+cp -r "$root/include" "$work/include"
+cp -r "$here/../host/include/." "$work/include/"
+
+cc -std=gnu99 -Wall -Wextra -Wno-unused-parameter -Wno-pointer-to-int-cast -g -fsanitize=address,undefined \
+    -I"$work/include" \
+    "$here/fat32_test.c" "$here/../host/stubs.c" \
+    "$root/src/fs/fat32.c" "$root/src/bcache.c" "$root/src/block.c" "$root/src/blockdev.c" \
+    -o "$work/fat32_test"
+
+new_image() {
+    rm -f "$1"
+    if [ "$2" != "--mbr" ] && command -v mkfs.fat >/dev/null; then
+        dd if=/dev/zero of="$1" bs=1M count=32 2>/dev/null
+        mkfs.fat -F 32 "$1" >/dev/null
+    else
+        python3 "$here/make_image.py" "$1" $2
+    fi
+}
+
+check() {
+    python3 "$here/check_image.py" "$1" >/dev/null
+    if [ "$2" != "--mbr" ] && command -v fsck.fat >/dev/null; then
+        fsck.fat -n "$1" >/dev/null
+    fi
+}
+
+for mode in cache nocache mbr; do
+    image=$work/$mode.img
+    layout=
+    [ $mode = mbr ] && layout=--mbr
+    new_image "$image" $layout
+    "$work/fat32_test" write "$image" $mode
+    check "$image" $layout
+    "$work/fat32_test" verify "$image" $mode
+    check "$image" $layout
+    echo "$mode: ok"
+done
+
+# 0x80000001 FAT sectors: times 512 bytes, or times 128 entries, wraps
+image=$work/badbpb.img
+new_image "$image"
+python3 -c 'import struct, sys
+with open(sys.argv[1], "r+b") as f:
+    f.seek(36)
+    f.write(struct.pack("<I", 0x80000001))' "$image"
+"$work/fat32_test" refuse "$image"
+echo "badbpb: ok"
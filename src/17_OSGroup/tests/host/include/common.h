@@ -0,0 +1,25 @@
+// Host stand-in for common.h: no port I/O, interrupts are never off
+#ifndef COMMON_H
+#define COMMON_H
+
+#include "libc/system.h"
+
+void outb(uint16_t port, uint8_t value);
+uint8_t inb(uint16_t port);
+
+// Counts up by a fixed step on every read
+static inline uint64_t read_tsc() {
+    static uint64_t tsc = 0;
+    return tsc += 100;
+}
+
+static inline uint64_t div64_32(uint64_t n, uint32_t d, uint32_t* rem) {
+    if (rem)
+        *rem = (uint32_t)(n % d);
+    return n / d;
+}
+
+static inline uint32_t interrupts_save() { return 0; }
+static inline void interrupts_restore(uint32_t flags) { (void)flags; }
+
+#endif // COMMON_H
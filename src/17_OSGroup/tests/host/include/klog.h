@@ -0,0 +1,12 @@
+// Host stand-in for klog.h, log messages are dropped
+#ifndef KLOG_H
+#define KLOG_H
+
+#define KLOG_ERR     3
+#define KLOG_WARNING 4
+#define KLOG_INFO    6
+#define KLOG_DEBUG   7
+
+void klog(int level, const char* format, ...);
+
+#endif // KLOG_H
@@ -0,0 +1,12 @@
+// Host stand-in for the kernel's libc, for the tests in tests/
+#ifndef SYSTEM_H
+#define SYSTEM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#endif // SYSTEM_H
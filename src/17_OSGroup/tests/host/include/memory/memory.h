@@ -0,0 +1,6 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include "libc/system.h"
+
+#endif // MEMORY_H
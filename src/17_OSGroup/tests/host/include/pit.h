@@ -0,0 +1,19 @@
+// Host stand-in for pit.h, time is whatever the test says it is
+#ifndef PIT_H
+#define PIT_H
+
+#include "libc/system.h"
+
+#define TARGET_FREQUENCY 1000
+#define TICKS_PER_MS     (TARGET_FREQUENCY / 1000)
+
+#define PIT_BASE_FREQUENCY 1193180
+#define PIT_CMD_PORT       0x43
+#define PIT_CHANNEL2_PORT  0x42
+#define PC_SPEAKER_PORT    0x61
+
+uint32_t pit_get_ticks();
+uint32_t pit_tsc_per_ms();
+void sleep_interrupt(uint32_t milliseconds);
+
+#endif // PIT_H
@@ -0,0 +1,19 @@
+// Hardware and kernel services the tests do not need, as no-ops. Time
+// stands still unless a test moves host_ticks.
+#include "common.h"
+#include "pit.h"
+#include "klog.h"
+#include "idle.h"
+
+uint32_t host_ticks = 0;
+
+void outb(uint16_t port, uint8_t value) {}
+uint8_t inb(uint16_t port) { return 0; }
+void klog(int level, const char* format, ...) {}
+
+uint32_t pit_get_ticks() { return host_ticks; }
+uint32_t pit_tsc_per_ms() { return 1000; }
+void sleep_interrupt(uint32_t milliseconds) { host_ticks += milliseconds; }
+
+// Nothing runs in the background, tests sync explicitly
+int register_idle_handler(idle_handler_t handler, void* ctx) { return 0; }
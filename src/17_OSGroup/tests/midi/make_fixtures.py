@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+"""Write the Standard MIDI File fixtures in songs/.
+
+Both hold the first line of Twinkle Twinkle Little Star, 14 melody notes
+over 16 quarter notes:
+
+  twinkle-0.mid  type 0, one track at 100 bpm: the melody with running
+                 status and note-on velocity 0 as note-off, a program
+                 change and a drum on every beat, 9600 ms
+  twinkle-1.mid  type 1: a tempo track at 120 bpm going to 240 bpm halfway,
+                 the melody, and a bass note held under it, 6000 ms
+
+The drums and the bass are there to be ignored by the melody extraction.
+tests/midi/run.sh checks what the kernel's player makes of them.
+
+Next to this script go two broken files the player has to turn down:
+
+  oversized-header.mid  MThd claims 0xFFFFFFF1 bytes, which wraps the
+                        chunk position if added unchecked
+  truncated.mid         twinkle-1.mid cut off inside the first track's
+                        chunk header
+"""
+
+import os
+import struct
+
+DIVISION = 480              # Ticks per quarter note
+MELODY = [(60, 1), (60, 1), (67, 1), (67, 1), (69, 1), (69, 1), (67, 2),
+          (65, 1), (65, 1), (64, 1), (64, 1), (62, 1), (62, 1), (60, 2)]
+BASS = 48                   # C3
+
+
+def vlq(value):
+    out = [value & 0x7F]
+    value >>= 7
+    while value:
+        out.insert(0, 0x80 | (value & 0x7F))
+        value >>= 7
+    return bytes(out)
+
+
+def tempo(bpm):
+    return b"\xff\x51\x03" + (60000000 // bpm).to_bytes(3, "big")
+
+
+def track(events):
+    """events: (absolute tick, bytes), in order"""
+    body = b""
+    now = 0
+    for time, data in events:
+        body += vlq(time - now) + data
+        now = time
+    body += b"\x00\xff\x2f\x00"
+    return b"MTrk" + struct.pack(">I", len(body)) + body
+
+
+def melody_events(running_status):
+    events = []
+    time = 0
+    for key, beats in MELODY:
+        events.append((time, bytes([0x90, key, 100])))
+        time += beats * DIVISION
+        events.append((time, bytes([0x90, key, 0])))
+    if running_status:
+        # Every event is a note-on on channel 0, so only the first one
+        # needs its status byte
+        events = [(t, data if i == 0 else data[1:]) for i, (t, data) in enumerate(events)]
+    return events
+
+
+def smf(format, tracks):
+    return b"MThd" + struct.pack(">IHHH", 6, format, len(tracks), DIVISION) + b"".join(tracks)
+
+
+def type0():
+    events = [(0, b"\xff\x03\x07twinkle"), (0, tempo(100)), (0, b"\xc0\x00")]
+    drums = []
+    for beat in range(16):
+        drums.append((beat * DIVISION, bytes([0x99, 36, 90])))
+        drums.append((beat * DIVISION + DIVISION // 2, bytes([0x89, 36, 0])))
+    # Merge keeping the melody's running status intact: drums go in front
+    # of a melody event at the same time and restate the status after
+    melody = melody_events(True)
+    merged = []
+    drum_index = 0
+    for i, (time, data) in enumerate(melody):
+        while drum_index < len(drums) and drums[drum_index][0] <= time:
+            merged.append(drums[drum_index])
+            drum_index += 1
+            if data[0] < 0x80:
+                data = bytes([0x90]) + data
+        merged.append((time, data))
+    merged += drums[drum_index:]
+    return smf(0, [track(events + merged)])
+
+
+def type1():
+    conductor = track([(0, tempo(120)), (8 * DIVISION, tempo(240))])
+    melody = track(melody_events(False))
+    bass = track([(0, bytes([0x91, BASS, 80])), (16 * DIVISION, bytes([0x81, BASS, 0]))])
+    return smf(1, [conductor, melody, bass])
+
+
+def oversized_header():
+    data = bytearray(type0())
+    data[4:8] = struct.pack(">I", 0xFFFFFFF1)
+    return bytes(data)
+
+
+def truncated():
+    return type1()[:14 + 5]
+
+
+if __name__ == "__main__":
+    here = os.path.dirname(os.path.abspath(__file__))
+    songs = os.path.join(here, "..", "..", "songs")
+    for name, data in (("twinkle-0.mid", type0()), ("twinkle-1.mid", type1())):
+        with open(os.path.join(songs, name), "wb") as f:
+            f.write(data)
+    for name, data in (("oversized-header.mid", oversized_header()), ("truncated.mid", truncated())):
+        with open(os.path.join(here, name), "wb") as f:
+            f.write(data)
@@ -0,0 +1,98 @@
+// Plays the MIDI fixtures in songs/ through the kernel's SMF player and
+// checks the melody it extracts, then feeds it the broken files in
+// tests/midi, which it has to refuse
+#include "song/midi.h"
+
+struct fixture {
+    const char* name;
+    uint32_t notes;
+    uint32_t duration;          // ms
+};
+
+static const struct fixture fixtures[] = {
+    { "twinkle-0.mid", 14, 9600 },
+    { "twinkle-1.mid", 14, 6000 },
+};
+
+static const char* const broken[] = { "oversized-header.mid", "truncated.mid" };
+
+// C4 C4 G4 G4 A4 A4 G4 F4 F4 E4 E4 D4 D4 C4
+static const uint32_t melody[] = { C4, C4, G4, G4, A4, A4, G4, F4, F4, E4, E4, D4, D4, C4 };
+
+static uint8_t* load(const char* path, uint32_t* size) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+    static uint8_t data[65536];
+    *size = fread(data, 1, sizeof(data), file);
+    fclose(file);
+    return data;
+}
+
+int main(int argc, char** argv) {
+    int failed = 0;
+    for (uint32_t i = 0; i < sizeof(fixtures) / sizeof(fixtures[0]); i++) {
+        const struct fixture* fixture = &fixtures[i];
+        char path[256];
+        snprintf(path, sizeof(path), "%s/%s", argv[1], fixture->name);
+
+        uint32_t size;
+        const uint8_t* data = load(path, &size);
+        static struct midi_file midi;
+        Song song;
+        if (data == NULL || !midi_init(&midi, data, size, &song)) {
+            printf("%s: not loaded\n", fixture->name);
+            failed = 1;
+            continue;
+        }
+
+        // Two cursors on the same song, interleaved, see the same notes
+        static song_cursor_t first, second;
+        Note a, b;
+        uint32_t notes = 0;
+        uint32_t duration = 0;
+        song_cursor_init(&first, &song);
+        song_cursor_init(&second, &song);
+        while (song_cursor_next(&first, &a)) {
+            if (!song_cursor_next(&second, &b) || a.frequency != b.frequency || a.duration != b.duration) {
+                printf("%s: cursors disagree at note %u\n", fixture->name, notes);
+                failed = 1;
+                break;
+            }
+            if (notes < sizeof(melody) / sizeof(melody[0]) && a.frequency != melody[notes]) {
+                printf("%s: note %u is %u Hz, not %u Hz\n", fixture->name, notes, a.frequency, melody[notes]);
+                failed = 1;
+            }
+            notes++;
+            duration += a.duration;
+        }
+
+        printf("%s: type %u, %u tracks, %u notes, %u ms\n", fixture->name, midi.format, midi.track_count,
+               song.length, duration);
+        if (song.length != fixture->notes || notes != fixture->notes || duration != fixture->duration ||
+            song_measure(&song) != fixture->duration) {
+            printf("%s: expected %u notes, %u ms\n", fixture->name, fixture->notes, fixture->duration);
+            failed = 1;
+        }
+    }
+
+    for (uint32_t i = 0; i < sizeof(broken) / sizeof(broken[0]); i++) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/%s", argv[2], broken[i]);
+
+        uint32_t size;
+        const uint8_t* data = load(path, &size);
+        static struct midi_file midi;
+        Song song;
+        if (data == NULL) {
+            printf("%s: missing\n", broken[i]);
+            failed = 1;
+        } else if (midi_init(&midi, data, size, &song)) {
+            printf("%s: loaded, should have been refused\n", broken[i]);
+            failed = 1;
+        } else {
+            printf("%s: refused\n", broken[i]);
+        }
+    }
+    return failed;
+}
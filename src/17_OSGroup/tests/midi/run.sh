@@ -0,0 +1,21 @@
+#!/bin/sh
+# Build the SMF player for the host and check it against the fixtures in
+# songs/ and the broken files here. Run make_fixtures.py first if they
+# were changed.
+set -e
+here=$(dirname "$0")
+root=$here/../..
+work=${TMPDIR:-/tmp}/midi_test
+mkdir -p "$work"
+
+# The kernel's headers, with the host stand-ins in tests/host over them
+rm -rf "$work/include"
+cp -r "$root/include" "$work/include"
+cp -r "$here/../host/include/." "$work/include/"
+
+cc -std=gnu99 -Wall -Wextra -Wno-unused-parameter -g -fsanitize=address,undefined \
+    -I"$work/include" \
+    "$here/midi_test.c" "$here/../host/stubs.c" "$root/src/apps/song/song.c" \
+    "$root/src/apps/song/midi.c" "$root/src/apps/song/song_format.c" \
+    -o "$work/midi_test"
+"$work/midi_test" "$root/songs" "$here"